@@ -0,0 +1,238 @@
+#include "concurrency_limiter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <map>
+#include <thread>
+#include <utility>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+using Admission = ConcurrencyLimiter::Admission;
+
+struct Decision {
+    ConcurrencyLimiter::Grant grant;
+    Admission admission;
+    Clock::duration waited;
+};
+
+void run_all(std::vector<Decision> &decisions) {
+    for (auto &decision : decisions) {
+        decision.grant(decision.admission, decision.waited);
+    }
+}
+} // namespace
+
+// The one thread that refuses queued waiters past their deadline, for every
+// limiter. It never holds its own lock while taking a limiter's, and runs
+// grants only after it has let go of the limiter, so a grant may destroy the
+// limiter that queued it.
+class LimiterDeadlines {
+  public:
+    // Process-wide instance. Never destroyed: limiters with static storage
+    // may outlive any other static, and the thread is detached.
+    static LimiterDeadlines &instance() {
+        static auto *deadlines = new LimiterDeadlines();
+        return *deadlines;
+    }
+
+    // Wake for limiter no later than deadline. Called with the limiter's
+    // lock held.
+    void schedule(ConcurrencyLimiter *limiter, Clock::time_point deadline) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto [it, inserted] = due_.emplace(limiter, deadline);
+        if (!inserted && deadline >= it->second) {
+            return;
+        }
+        it->second = deadline;
+        if (!started_) {
+            started_ = true;
+            std::thread([this]() { run(); }).detach();
+        }
+        changed_.notify_one();
+    }
+
+    // Forget limiter, waiting out a pass over it already under way.
+    void cancel(ConcurrencyLimiter *limiter) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        due_.erase(limiter);
+        changed_.wait(lock, [&]() { return visiting_ != limiter; });
+    }
+
+  private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            if (due_.empty()) {
+                changed_.wait(lock);
+                continue;
+            }
+            auto next = std::min_element(due_.begin(), due_.end(),
+                                         [](const auto &a, const auto &b) { return a.second < b.second; });
+            auto now = Clock::now();
+            if (now < next->second) {
+                changed_.wait_until(lock, next->second);
+                continue;
+            }
+            auto *limiter = next->first;
+            due_.erase(next);
+            visiting_ = limiter;
+            lock.unlock();
+            std::vector<ConcurrencyLimiter::Expired> expired;
+            auto later = limiter->take_expired(now, expired);
+            lock.lock();
+            if (later != Clock::time_point::max()) {
+                auto [it, inserted] = due_.emplace(limiter, later);
+                if (!inserted) {
+                    it->second = std::min(it->second, later);
+                }
+            }
+            visiting_ = nullptr;
+            changed_.notify_all();
+            lock.unlock();
+            for (auto &waiter : expired) {
+                waiter.grant(Admission::TimedOut, waiter.waited);
+            }
+            // Drop the grants unlocked too: one may own the last reference to
+            // its limiter, whose destructor calls cancel().
+            expired.clear();
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    // Earliest deadline to wake for, per limiter with queued waiters.
+    std::map<ConcurrencyLimiter *, Clock::time_point> due_;
+    ConcurrencyLimiter *visiting_{nullptr};
+    bool started_{false};
+};
+
+ConcurrencyLimiter::ConcurrencyLimiter(Options options) : options_(options) {
+    options_.min_limit = std::max<std::size_t>(1, options_.min_limit);
+    options_.max_limit = std::max(options_.min_limit, options_.max_limit);
+    options_.long_window = std::max<std::size_t>(1, options_.long_window);
+    limit_ = static_cast<double>(std::clamp(options_.initial_limit, options_.min_limit, options_.max_limit));
+}
+
+ConcurrencyLimiter::~ConcurrencyLimiter() {
+    close();
+    LimiterDeadlines::instance().cancel(this);
+}
+
+void ConcurrencyLimiter::acquire(Clock::time_point deadline, Grant grant) {
+    Admission admission = Admission::Admitted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) {
+            admission = Admission::Closed;
+        } else if (waiters_.empty() && in_flight_ < static_cast<std::size_t>(limit_)) {
+            ++in_flight_;
+        } else if (waiters_.size() >= options_.max_queue) {
+            admission = Admission::QueueFull;
+        } else if (deadline <= Clock::now()) {
+            admission = Admission::TimedOut;
+            ++queue_timeouts_;
+        } else {
+            bool earliest = std::none_of(waiters_.begin(), waiters_.end(),
+                                         [deadline](const Waiter &w) { return w.deadline <= deadline; });
+            waiters_.push_back({Clock::now(), deadline, std::move(grant)});
+            if (earliest) {
+                LimiterDeadlines::instance().schedule(this, deadline);
+            }
+            return;
+        }
+    }
+    grant(admission, Clock::duration::zero());
+}
+
+// Release a slot. Input: the operation's latency and overload flag. Admits as
+// many waiters as the (possibly changed) limit allows, oldest first, and
+// runs their grants on this thread after unlocking.
+void ConcurrencyLimiter::release(Clock::duration latency, bool overloaded) {
+    std::vector<Decision> decisions;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto in_flight = in_flight_;
+        if (in_flight_ > 0) {
+            --in_flight_;
+        }
+        update_limit(std::chrono::duration<double, std::micro>(latency).count(), overloaded, in_flight);
+        auto now = Clock::now();
+        while (!waiters_.empty() && in_flight_ < static_cast<std::size_t>(limit_)) {
+            auto waiter = std::move(waiters_.front());
+            waiters_.pop_front();
+            ++in_flight_;
+            decisions.push_back({std::move(waiter.grant), Admission::Admitted, now - waiter.enqueued});
+        }
+    }
+    run_all(decisions);
+}
+
+void ConcurrencyLimiter::close() {
+    std::vector<Decision> decisions;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        auto now = Clock::now();
+        for (auto &waiter : waiters_) {
+            decisions.push_back({std::move(waiter.grant), Admission::Closed, now - waiter.enqueued});
+        }
+        waiters_.clear();
+    }
+    run_all(decisions);
+}
+
+ConcurrencyLimiter::Stats ConcurrencyLimiter::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {static_cast<std::size_t>(limit_), in_flight_, waiters_.size(), queue_timeouts_};
+}
+
+void ConcurrencyLimiter::update_limit(double latency_us, bool overloaded, std::size_t in_flight) {
+    if (!options_.adaptive) {
+        return;
+    }
+    auto min_limit = static_cast<double>(options_.min_limit);
+    auto max_limit = static_cast<double>(options_.max_limit);
+    if (overloaded) {
+        limit_ = std::max(min_limit, limit_ * 0.9);
+        return;
+    }
+    latency_us = std::max(latency_us, 1.0);
+    if (long_latency_us_ == 0) {
+        long_latency_us_ = latency_us;
+    } else {
+        long_latency_us_ += (latency_us - long_latency_us_) / static_cast<double>(options_.long_window);
+    }
+    // After a slow spell the average lags far behind; pull it down faster
+    // so the limit can recover.
+    if (long_latency_us_ > 2 * latency_us) {
+        long_latency_us_ *= 0.95;
+    }
+    auto gradient = std::clamp(options_.tolerance * long_latency_us_ / latency_us, 0.5, 1.0);
+    auto target = limit_ * gradient + std::sqrt(limit_);
+    if (target > limit_ && static_cast<double>(in_flight) < limit_ / 2) {
+        return;
+    }
+    limit_ = std::clamp(limit_ * (1 - options_.smoothing) + target * options_.smoothing, min_limit, max_limit);
+}
+
+// Collect expired waiters. Input: the current time. Output: their grants and
+// queueing times, to be run by the caller once it has let go of this
+// limiter.
+Clock::time_point ConcurrencyLimiter::take_expired(Clock::time_point now, std::vector<Expired> &expired) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto later = Clock::time_point::max();
+    for (auto it = waiters_.begin(); it != waiters_.end();) {
+        if (it->deadline <= now) {
+            expired.push_back({std::move(it->grant), now - it->enqueued});
+            ++queue_timeouts_;
+            it = waiters_.erase(it);
+        } else {
+            later = std::min(later, it->deadline);
+            ++it;
+        }
+    }
+    return later;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+class LimiterDeadlines;
+
+// Admission control for operations: at most limit() run at once, and callers
+// beyond that wait in a bounded FIFO queue until a slot frees up or their
+// deadline passes.
+//
+// With adaptive set, the limit follows observed latency in the style of a
+// gradient limiter. A long-term average latency is compared with each new
+// sample. While samples stay within tolerance of the average, the limit grows
+// by about sqrt(limit) per sample. When samples rise above it (the downstream
+// is queueing), the limit shrinks in proportion, by at most half. The change
+// is smoothed. The limit never grows on samples taken while fewer than half
+// the slots were in use, so an idle period does not inflate it.
+//
+// Queue deadlines of every limiter in the process are enforced by one shared
+// thread, started with the first queued waiter, so limiters cost no thread
+// of their own and may be destroyed on any thread, a grant included.
+class ConcurrencyLimiter {
+  public:
+    struct Options {
+        std::size_t initial_limit{8};
+        std::size_t min_limit{1};
+        std::size_t max_limit{256};
+        bool adaptive{true};
+        // Waiters beyond this are refused at once; 0 disables queueing.
+        std::size_t max_queue{128};
+        // Latency ratio tolerated before the limit starts to shrink.
+        double tolerance{1.5};
+        // Weight of each new target limit.
+        double smoothing{0.2};
+        // Samples averaged into the long-term latency.
+        std::size_t long_window{100};
+    };
+
+    enum class Admission { Admitted, QueueFull, TimedOut, Closed };
+
+    // Receives the admission decision and how long the caller queued.
+    using Grant = std::function<void(Admission admission, std::chrono::steady_clock::duration waited)>;
+
+    explicit ConcurrencyLimiter(Options options);
+
+    // Refuse remaining waiters (Closed) and drop out of the deadline thread.
+    ~ConcurrencyLimiter();
+
+    ConcurrencyLimiter(const ConcurrencyLimiter &) = delete;
+    ConcurrencyLimiter &operator=(const ConcurrencyLimiter &) = delete;
+
+    // Ask for a slot. grant runs exactly once, never under the limiter's
+    // lock. It runs inline when a slot is free or the request is refused at
+    // once. A queued request is granted on the thread whose release() frees
+    // its slot, or refused on the shared deadline thread. Admitted callers
+    // must call release() exactly once.
+    void acquire(std::chrono::steady_clock::time_point deadline, Grant grant);
+
+    // Return a slot. Inputs: how long the operation held it, and whether it
+    // failed in a way that signals overload (for example a downstream
+    // timeout), which shrinks an adaptive limit by a tenth.
+    void release(std::chrono::steady_clock::duration latency, bool overloaded = false);
+
+    // Refuse every waiter and all later acquires with Closed.
+    void close();
+
+    struct Stats {
+        std::size_t limit{0};
+        std::size_t in_flight{0};
+        std::size_t queued{0};
+        std::uint64_t queue_timeouts{0};
+    };
+
+    Stats stats() const;
+
+  private:
+    friend class LimiterDeadlines;
+
+    struct Waiter {
+        std::chrono::steady_clock::time_point enqueued;
+        std::chrono::steady_clock::time_point deadline;
+        Grant grant;
+    };
+
+    // Fold one latency sample into the limit. Called with mutex_ held.
+    void update_limit(double latency_us, bool overloaded, std::size_t in_flight);
+
+    struct Expired {
+        Grant grant;
+        std::chrono::steady_clock::duration waited;
+    };
+
+    // Remove queued waiters whose deadline is at or before now into expired,
+    // without running their grants. Returns the earliest deadline left, or
+    // time_point::max() when none is.
+    std::chrono::steady_clock::time_point take_expired(std::chrono::steady_clock::time_point now,
+                                                       std::vector<Expired> &expired);
+
+    Options options_;
+    mutable std::mutex mutex_;
+    double limit_;
+    double long_latency_us_{0};
+    std::size_t in_flight_{0};
+    std::deque<Waiter> waiters_;
+    std::uint64_t queue_timeouts_{0};
+    bool closed_{false};
+};
@@ -0,0 +1,97 @@
+#include "content_store.h"
+
+#include "filesystem_utils.h"
+#include "hash_utils.h"
+#include "logging.h"
+
+std::string content_address(std::uint64_t hash, std::uint64_t size) { return to_hex(hash) + "-" + std::to_string(size); }
+
+std::string content_address(std::string_view content) { return content_address(fnv1a_64(content), content.size()); }
+
+ContentStore::ContentStore(fs::path root) : blobs_(std::move(root) / kBlobDirectory) {}
+
+fs::path ContentStore::blob_path(const std::string &address) const { return blobs_ / address; }
+
+// Store a staged file. Inputs: a complete file on the same filesystem and its
+// address. Output: true once the blob is durable. An existing blob only
+// counts as a duplicate when its bytes match, since the address is a 64-bit
+// hash. Two concurrent adopters of the same content both succeed; the later
+// rename replaces identical bytes.
+bool ContentStore::adopt(const fs::path &staged, std::string &address, bool &duplicate, std::error_code &ec) {
+    duplicate = false;
+    auto candidate = address;
+    for (std::size_t n = 1; fs::exists(blob_path(candidate), ec); ++n) {
+        if (files_equal(staged, blob_path(candidate), ec)) {
+            duplicate = true;
+            address = candidate;
+            fs::remove(staged, ec);
+            // Restart the prune grace: the blob is about to be linked again.
+            fs::last_write_time(blob_path(candidate), fs::file_time_type::clock::now(), ec);
+            ec.clear();
+            return true;
+        }
+        if (ec) {
+            std::error_code ignored;
+            fs::remove(staged, ignored);
+            return false;
+        }
+        log_info("Blob " + candidate + " holds different content; trying the next address");
+        candidate = address + "~" + std::to_string(n);
+    }
+    if (ec) {
+        std::error_code ignored;
+        fs::remove(staged, ignored);
+        return false;
+    }
+    address = candidate;
+    if (!ensure_directory(blobs_)) {
+        std::error_code ignored;
+        fs::remove(staged, ignored);
+        ec = std::make_error_code(std::errc::io_error);
+        return false;
+    }
+    return publish_file(staged, blob_path(address), ec);
+}
+
+// Link a name to a blob. Inputs: blob address and the versioned name. Output:
+// true when name resolves to the blob's content. The link is made under a
+// temp name and published over name, so readers never see name missing.
+bool ContentStore::link(const std::string &address, const fs::path &name, std::error_code &ec) {
+    auto blob = blob_path(address);
+    if (fs::equivalent(blob, name, ec)) {
+        return true;
+    }
+    auto temp = temp_path_for(name);
+    fs::create_hard_link(blob, temp, ec);
+    if (ec) {
+        log_debug("Hard link to " + blob.string() + " failed (" + ec.message() + "); copying instead");
+        ec.clear();
+        fs::copy_file(blob, temp, fs::copy_options::overwrite_existing, ec);
+        if (ec) {
+            std::error_code ignored;
+            fs::remove(temp, ignored);
+            return false;
+        }
+    }
+    return publish_file(temp, name, ec);
+}
+
+// Remove unreferenced blobs. A blob whose link count is one is only reachable
+// through the store itself; one modified within grace may be about to be
+// linked by a registration in flight, here or in another process.
+std::size_t ContentStore::prune(std::chrono::seconds grace) {
+    std::size_t removed = 0;
+    std::error_code ec;
+    auto cutoff = fs::file_time_type::clock::now() - grace;
+    for (fs::directory_iterator it(blobs_, ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code entry_ec;
+        if (it->is_regular_file(entry_ec) && fs::hard_link_count(it->path(), entry_ec) == 1 && !entry_ec &&
+            fs::last_write_time(it->path(), entry_ec) < cutoff && !entry_ec && fs::remove(it->path(), entry_ec)) {
+            ++removed;
+        }
+    }
+    if (removed > 0) {
+        log_info("Pruned " + std::to_string(removed) + " unreferenced spec blob(s) from " + blobs_.string());
+    }
+    return removed;
+}
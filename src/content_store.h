@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+// Directory under the mappings root that holds spec blobs.
+inline constexpr const char *kBlobDirectory = ".blobs";
+
+// How long a blob is kept after it was last adopted, linked or not.
+inline constexpr std::chrono::minutes kBlobPruneGrace{10};
+
+// Address of content with the given FNV-1a hash and size: "<hex hash>-<size>".
+// The size guards against the rare FNV collision between different lengths.
+std::string content_address(std::uint64_t hash, std::uint64_t size);
+
+// Address of a byte range.
+std::string content_address(std::string_view content);
+
+// Content-addressed blob store. Each distinct spec is stored once under
+// root/.blobs/<address>; versioned names are hard links to their blob, so
+// identical specs registered under many versions share one copy. Names are
+// only ever replaced by rename, never written in place, so a shared inode is
+// never modified. Thread-safe: all state lives on disk.
+class ContentStore {
+  public:
+    explicit ContentStore(fs::path root);
+
+    fs::path blob_path(const std::string &address) const;
+
+    // Move the fully written file staged into the store under address. When
+    // a blob with the same bytes already exists the staged copy is dropped,
+    // the blob's modification time is refreshed and duplicate is set. A blob
+    // at address with other bytes (a hash collision) is left alone and staged
+    // is stored under the next free "<address>~<n>" instead; address is
+    // updated to where it went. Returns false and sets ec on failure; staged
+    // is removed either way.
+    bool adopt(const fs::path &staged, std::string &address, bool &duplicate, std::error_code &ec);
+
+    // Point name at the blob for address, replacing whatever name held. Does
+    // nothing when name already is that blob. Falls back to a copy where hard
+    // links are unsupported. Returns false and sets ec on failure.
+    bool link(const std::string &address, const fs::path &name, std::error_code &ec);
+
+    // Remove blobs no versioned name links to any more and that were last
+    // adopted more than grace ago. Returns the number of blobs removed. The
+    // grace keeps a blob a registration in another process has just adopted
+    // but not yet linked; it must be longer than any registration takes.
+    std::size_t prune(std::chrono::seconds grace = kBlobPruneGrace);
+
+  private:
+    fs::path blobs_;
+};
@@ -2,7 +2,27 @@
 
 #include "logging.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 // Ensure a directory exists. Input: target path. Output: true when the path is
 // a directory after the call. Exceptions are not thrown; error codes are used.
@@ -56,19 +76,33 @@ bool read_file(const fs::path &path, std::string &content, std::error_code &ec)
 }
 
 // Write content to disk. Inputs: destination path and content string. Output:
-// true on success. Logs and returns false on failure. std::ofstream may throw
-// on allocation or OS-level errors.
+// true once the content is durable at path. Logs and returns false on
+// failure. std::ofstream may throw on allocation or OS-level errors.
 bool write_file(const fs::path &path, const std::string &content)
 {
-    std::ofstream file(path, std::ios::binary);
+    auto temp = temp_path_for(path);
+    std::ofstream file(temp, std::ios::binary);
     if (!file.is_open())
     {
-        log_error("Unable to open file for writing: " + path.string());
+        log_error("Unable to open file for writing: " + temp.string());
         return false;
     }
 
     file << content;
-    return static_cast<bool>(file);
+    file.close();
+    std::error_code ec;
+    if (!file)
+    {
+        log_error("Unable to write file: " + temp.string());
+        fs::remove(temp, ec);
+        return false;
+    }
+    if (!publish_file(temp, path, ec))
+    {
+        log_error("Unable to publish " + path.string() + ": " + ec.message());
+        return false;
+    }
+    return true;
 }
 
 // Copy a file to a destination, creating parent directories. Inputs: source and
@@ -78,15 +112,424 @@ bool copy_file_to(const fs::path &source, const fs::path &destination)
 {
     std::error_code ec;
     ensure_directory(destination.parent_path());
-    fs::copy_file(source, destination, fs::copy_options::overwrite_existing, ec);
+    auto temp = temp_path_for(destination);
+    fs::copy_file(source, temp, fs::copy_options::overwrite_existing, ec);
     if (ec)
     {
         log_error("Failed to copy file from " + source.string() + " to " + destination.string() + ": " + ec.message());
+        fs::remove(temp, ec);
+        return false;
+    }
+    if (!publish_file(temp, destination, ec))
+    {
+        log_error("Failed to publish " + destination.string() + ": " + ec.message());
         return false;
     }
     return true;
 }
 
+// Compare two files. Inputs: both paths. Output: true when they hold the same
+// bytes. Sizes are compared first, so files of different lengths are never
+// read. Returns false and sets ec when either cannot be read.
+bool files_equal(const fs::path &a, const fs::path &b, std::error_code &ec)
+{
+    auto size = fs::file_size(a, ec);
+    if (ec)
+    {
+        return false;
+    }
+    auto other_size = fs::file_size(b, ec);
+    if (ec || size != other_size)
+    {
+        return false;
+    }
+    std::ifstream first(a, std::ios::binary);
+    std::ifstream second(b, std::ios::binary);
+    if (!first || !second)
+    {
+        ec = std::make_error_code(std::errc::io_error);
+        return false;
+    }
+    std::vector<char> left(64 * 1024);
+    std::vector<char> right(left.size());
+    while (size > 0)
+    {
+        auto chunk = static_cast<std::streamsize>(std::min<std::uintmax_t>(size, left.size()));
+        if (!first.read(left.data(), chunk) || !second.read(right.data(), chunk))
+        {
+            ec = std::make_error_code(std::errc::io_error);
+            return false;
+        }
+        if (!std::equal(left.begin(), left.begin() + chunk, right.begin()))
+        {
+            return false;
+        }
+        size -= static_cast<std::uintmax_t>(chunk);
+    }
+    return true;
+}
+
+fs::path temp_path_for(const fs::path &destination)
+{
+    static std::atomic<unsigned long long> counter{0};
+#ifdef _WIN32
+    auto pid = ::_getpid();
+#else
+    auto pid = ::getpid();
+#endif
+    return destination.parent_path() / ("." + destination.filename().string() + ".tmp-" + std::to_string(pid) + "-" +
+                                        std::to_string(++counter));
+}
+
+namespace
+{
+// One caller's request to publish_file, shared with whichever caller leads
+// the batch it ends up in.
+struct Publication
+{
+    const fs::path *temp;
+    const fs::path *destination;
+    std::error_code ec;
+    bool done{false};
+};
+
+struct GroupCommit
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<Publication *> pending;
+    bool flushing{false};
+    DurableWriteStats stats;
+};
+
+GroupCommit &group_commit()
+{
+    static GroupCommit instance;
+    return instance;
+}
+
+#ifndef _WIN32
+std::error_code last_error()
+{
+    return std::error_code(errno, std::generic_category());
+}
+
+// Flush one file or directory. With data_only, metadata a later read does
+// not need (such as mtime) may be left unflushed.
+std::error_code fsync_path(const fs::path &path, bool data_only)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return last_error();
+    }
+    std::error_code ec;
+#if defined(__linux__)
+    int rc = data_only ? ::fdatasync(fd) : ::fsync(fd);
+#else
+    (void)data_only;
+    int rc = ::fsync(fd);
+#endif
+    if (rc != 0)
+    {
+        ec = last_error();
+    }
+    ::close(fd);
+    return ec;
+}
+#endif
+
+// Publish a batch. Input: publications whose temp files are fully written.
+// Output: each publication's ec. Each temp file is flushed before any rename,
+// so a published name never points at unflushed content, and then each
+// parent directory once, so the renames are durable before any caller
+// returns. Only the batch's own files are flushed, never the whole
+// filesystem.
+void flush_batch(const std::vector<Publication *> &batch)
+{
+#ifndef _WIN32
+    for (auto *publication : batch)
+    {
+        publication->ec = fsync_path(*publication->temp, true);
+    }
+#endif
+
+    for (auto *publication : batch)
+    {
+        if (!publication->ec)
+        {
+            fs::rename(*publication->temp, *publication->destination, publication->ec);
+        }
+        if (publication->ec)
+        {
+            std::error_code ignored;
+            fs::remove(*publication->temp, ignored);
+        }
+    }
+
+#ifndef _WIN32
+    std::set<fs::path> directories;
+    for (auto *publication : batch)
+    {
+        if (!publication->ec)
+        {
+            directories.insert(publication->destination->parent_path());
+        }
+    }
+    for (const auto &directory : directories)
+    {
+        auto ec = fsync_path(directory.empty() ? fs::path(".") : directory, false);
+        for (auto *publication : batch)
+        {
+            if (!publication->ec && publication->destination->parent_path() == directory)
+            {
+                publication->ec = ec;
+            }
+        }
+    }
+#endif
+}
+} // namespace
+
+// Publish a staged file. Inputs: the temp file and its final name. Output:
+// true once the rename is durable. The first caller to find no flush in
+// progress leads one batch of everything queued so far; callers arriving
+// meanwhile queue up for the next batch.
+bool publish_file(const fs::path &temp, const fs::path &destination, std::error_code &ec)
+{
+    auto &group = group_commit();
+    Publication publication{&temp, &destination, {}, false};
+    std::unique_lock<std::mutex> lock(group.mutex);
+    group.pending.push_back(&publication);
+    while (!publication.done)
+    {
+        if (group.flushing)
+        {
+            group.cv.wait(lock);
+            continue;
+        }
+        std::vector<Publication *> batch;
+        batch.swap(group.pending);
+        group.flushing = true;
+        ++group.stats.batches;
+        group.stats.files += batch.size();
+        lock.unlock();
+        flush_batch(batch);
+        lock.lock();
+        group.flushing = false;
+        for (auto *item : batch)
+        {
+            item->done = true;
+        }
+        group.cv.notify_all();
+    }
+    ec = publication.ec;
+    return !ec;
+}
+
+// Swap a staged directory in. Inputs: the complete staged directory and the
+// one it replaces, on the same filesystem. Output: true once destination
+// holds the staged contents.
+bool replace_directory(const fs::path &staged, const fs::path &destination, std::error_code &ec)
+{
+    ec.clear();
+    if (!fs::exists(destination, ec))
+    {
+        if (!ec)
+        {
+            fs::rename(staged, destination, ec);
+        }
+    }
+#if defined(__linux__)
+    else if (::renameat2(AT_FDCWD, staged.c_str(), AT_FDCWD, destination.c_str(), RENAME_EXCHANGE) == 0)
+    {
+        // staged now holds the old contents.
+        fs::remove_all(staged, ec);
+        ec.clear();
+    }
+#endif
+    else
+    {
+        auto old = temp_path_for(destination);
+        fs::rename(destination, old, ec);
+        if (!ec)
+        {
+            fs::rename(staged, destination, ec);
+            std::error_code restore_ec;
+            if (ec)
+            {
+                fs::rename(old, destination, restore_ec);
+            }
+            else
+            {
+                fs::remove_all(old, restore_ec);
+            }
+        }
+    }
+    if (ec)
+    {
+        return false;
+    }
+#ifndef _WIN32
+    auto parent = destination.parent_path();
+    ec = fsync_path(parent.empty() ? fs::path(".") : parent, false);
+#endif
+    return !ec;
+}
+
+// Mirror a directory tree with hard links. Inputs: existing source tree and
+// a destination that does not exist yet. Output: true once destination holds
+// every directory of source and an entry for every file. A file is copied
+// only where the filesystem refuses to link it, so the cost follows the
+// number of entries rather than their size.
+bool link_tree(const fs::path &source, const fs::path &destination, std::error_code &ec)
+{
+    ec.clear();
+    if (!fs::create_directory(destination, ec) || ec)
+    {
+        if (!ec)
+        {
+            ec = std::make_error_code(std::errc::file_exists);
+        }
+        return false;
+    }
+    for (fs::recursive_directory_iterator it(source, ec), end; !ec && it != end; it.increment(ec))
+    {
+        auto target = destination / it->path().lexically_relative(source);
+        if (it->is_directory(ec))
+        {
+            fs::create_directory(target, ec);
+        }
+        else if (!ec)
+        {
+            fs::create_hard_link(it->path(), target, ec);
+            if (ec)
+            {
+                fs::copy(it->path(), target, fs::copy_options::copy_symlinks, ec);
+            }
+        }
+    }
+    return !ec;
+}
+
+// Overlay one tree on another. Inputs: source tree and an existing
+// destination on the same filesystem. Output: true once every file of source
+// has been renamed to the same relative path under destination. Renaming
+// replaces the destination's directory entry, never the file it names, so a
+// hard-linked destination file is swapped out rather than rewritten.
+bool merge_tree(const fs::path &source, const fs::path &destination, std::error_code &ec)
+{
+    ec.clear();
+    // Collect first: renaming entries out of a directory mid-iteration
+    // leaves what the iterator sees next unspecified.
+    std::vector<fs::path> files;
+    for (fs::recursive_directory_iterator it(source, ec), end; !ec && it != end; it.increment(ec))
+    {
+        auto target = destination / it->path().lexically_relative(source);
+        if (it->is_directory(ec))
+        {
+            if (!ec && !fs::is_directory(target))
+            {
+                fs::create_directories(target, ec);
+            }
+        }
+        else if (!ec)
+        {
+            files.push_back(it->path());
+        }
+    }
+    for (std::size_t i = 0; !ec && i < files.size(); ++i)
+    {
+        fs::rename(files[i], destination / files[i].lexically_relative(source), ec);
+    }
+    return !ec;
+}
+
+DurableWriteStats durable_write_stats()
+{
+    auto &group = group_commit();
+    std::lock_guard<std::mutex> lock(group.mutex);
+    return group.stats;
+}
+
+// Stream a descriptor into a file. Inputs: source descriptor, destination
+// path and a per-chunk observer. Output: true when the source reached EOF and
+// every chunk was written. Each byte passes through one fixed buffer, so
+// memory use does not depend on the size of the source.
+bool stream_to_file(int fd, const fs::path &destination,
+                    const std::function<bool(std::string_view)> &on_chunk, std::error_code &ec)
+{
+#ifdef _WIN32
+    int out = ::_wopen(destination.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int out = ::open(destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+    if (out < 0)
+    {
+        ec = std::error_code(errno, std::generic_category());
+        return false;
+    }
+
+    std::vector<char> buffer(kStreamChunkSize);
+    ec.clear();
+    while (!ec)
+    {
+#ifdef _WIN32
+        auto n = ::_read(fd, buffer.data(), static_cast<unsigned>(buffer.size()));
+#else
+        auto n = ::read(fd, buffer.data(), buffer.size());
+#endif
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0)
+        {
+            ec = std::error_code(errno, std::generic_category());
+            break;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        std::string_view chunk(buffer.data(), static_cast<std::size_t>(n));
+        if (on_chunk && !on_chunk(chunk))
+        {
+            ec = std::make_error_code(std::errc::operation_canceled);
+            break;
+        }
+        while (!chunk.empty())
+        {
+#ifdef _WIN32
+            auto written = ::_write(out, chunk.data(), static_cast<unsigned>(chunk.size()));
+#else
+            auto written = ::write(out, chunk.data(), chunk.size());
+#endif
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                ec = written < 0 ? std::error_code(errno, std::generic_category())
+                                 : std::make_error_code(std::errc::io_error);
+                break;
+            }
+            chunk.remove_prefix(static_cast<std::size_t>(written));
+        }
+    }
+
+#ifdef _WIN32
+    if (::_close(out) != 0 && !ec)
+#else
+    if (::close(out) != 0 && !ec)
+#endif
+    {
+        ec = std::error_code(errno, std::generic_category());
+    }
+    return !ec;
+}
+
 bool is_writable_directory(const fs::path &path, std::string &message)
 {
     if (!ensure_directory(path))
@@ -116,3 +559,133 @@ bool is_writable_directory(const fs::path &path, std::string &message)
     message.clear();
     return true;
 }
+
+// Rewrite the generation stamp. Inputs: client kit root and an optional slot
+// for the new token. Output: true when the stamp file was written. The token
+// combines wall-clock time with a process local counter so back-to-back
+// generations always produce distinct values, even on filesystems with
+// coarse modification times.
+bool touch_generation_stamp(const fs::path &root, std::string *token)
+{
+    static std::atomic<unsigned long long> counter{0};
+    auto now = std::chrono::system_clock::now().time_since_epoch().count();
+    auto value = std::to_string(now) + "-" + std::to_string(++counter);
+    if (!write_file(root / kGenerationStampFile, value))
+    {
+        return false;
+    }
+    if (token)
+    {
+        *token = std::move(value);
+    }
+    return true;
+}
+
+// Read the generation stamp. Input: client kit root. Output: the stamp token,
+// or an empty string when the file is missing or unreadable.
+std::string read_generation_stamp(const fs::path &root)
+{
+    std::string content;
+    std::error_code ec;
+    if (!read_file(root / kGenerationStampFile, content, ec))
+    {
+        return {};
+    }
+    return content;
+}
+
+MappedFile::~MappedFile()
+{
+    reset();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        mapped_ = other.mapped_;
+        size_ = other.size_;
+        buffer_ = std::move(other.buffer_);
+        data_ = mapped_ ? other.data_ : buffer_.data();
+        other.data_ = nullptr;
+        other.size_ = 0;
+        other.mapped_ = false;
+    }
+    return *this;
+}
+
+// Map a file read-only. Input: path. Output: true on success; on failure ec
+// describes the error and the object stays empty. Does not throw apart from
+// allocation failures in the non-POSIX fallback.
+bool MappedFile::open(const fs::path &path, std::error_code &ec)
+{
+    reset();
+#ifdef _WIN32
+    if (!read_file(path, buffer_, ec))
+    {
+        return false;
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        ec = std::error_code(errno, std::generic_category());
+        return false;
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0)
+    {
+        ec = std::error_code(errno, std::generic_category());
+        ::close(fd);
+        return false;
+    }
+
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ == 0)
+    {
+        // mmap rejects zero-length mappings; an empty view is still valid.
+        ::close(fd);
+        data_ = buffer_.data();
+        ec.clear();
+        return true;
+    }
+
+    void *addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        ec = std::error_code(errno, std::generic_category());
+        size_ = 0;
+        return false;
+    }
+
+    data_ = static_cast<const char *>(addr);
+    mapped_ = true;
+    ec.clear();
+    return true;
+#endif
+}
+
+void MappedFile::reset()
+{
+#ifndef _WIN32
+    if (mapped_ && data_ != nullptr)
+    {
+        ::munmap(const_cast<char *>(data_), size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    buffer_.clear();
+}
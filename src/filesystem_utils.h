@@ -1,7 +1,12 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <string>
+#include <string_view>
+#include <system_error>
 
 namespace fs = std::filesystem;
 
@@ -13,15 +18,115 @@ bool ensure_directory(const fs::path &path);
 // on success, false on failure. On failure, the error code is set appropriately.
 bool read_file(const fs::path &path, std::string &content, std::error_code &ec);
 
-// Write the provided content to disk at the given path. Returns true on
-// success and logs errors on failure.
+// Write the provided content to disk at the given path. The content goes to
+// a sibling temp file that is published with publish_file, so readers see
+// either the old or the new file and a crash never leaves a torn one.
+// Returns true on success and logs errors on failure.
 bool write_file(const fs::path &path, const std::string &content);
 
 // Copy a file to the destination path, creating parent directories as needed.
-// Overwrites existing files and logs errors on failure.
+// Overwrites existing files atomically, as write_file does, and logs errors on
+// failure.
 bool copy_file_to(const fs::path &source, const fs::path &destination);
 
+// True when the files at a and b hold the same bytes. Returns false and sets
+// ec when either cannot be read.
+bool files_equal(const fs::path &a, const fs::path &b, std::error_code &ec);
+
+// A unique hidden path next to destination for staging its new contents.
+fs::path temp_path_for(const fs::path &destination);
+
+// Make the fully written file temp durable and rename it over destination,
+// then make the rename durable. Concurrent callers are group-committed: one
+// of them flushes for the whole batch (each temp file before the renames,
+// then each distinct parent directory once) while the others wait, so the
+// directory flushes are shared across the batch rather than paid per file.
+// Returns false and sets ec on failure, in which case temp has been removed.
+bool publish_file(const fs::path &temp, const fs::path &destination, std::error_code &ec);
+
+// Put the fully written directory staged in place of destination, then make
+// the rename durable. Where the platform can swap two names atomically
+// (renameat2 on Linux) destination never goes missing; elsewhere the old
+// directory is renamed aside first. The old contents are removed. Returns
+// false and sets ec on failure, in which case destination is unchanged and
+// staged is left for the caller to remove.
+bool replace_directory(const fs::path &staged, const fs::path &destination, std::error_code &ec);
+
+// Recreate the source tree at destination, hard-linking its files instead of
+// copying them. Linked files share their bytes with source: replace them
+// (e.g. with merge_tree or write_file), never rewrite them in place. Returns
+// false and sets ec on failure, leaving a partial destination for the caller
+// to remove.
+bool link_tree(const fs::path &source, const fs::path &destination, std::error_code &ec);
+
+// Move every file under source to the same relative path under destination,
+// replacing files already there. Returns false and sets ec on failure.
+bool merge_tree(const fs::path &source, const fs::path &destination, std::error_code &ec);
+
+struct DurableWriteStats {
+    std::uint64_t batches{0};
+    std::uint64_t files{0};
+};
+
+// Totals for publish_file since process start.
+DurableWriteStats durable_write_stats();
+
+// Size of the buffer stream_to_file reads into; the only per-call allocation.
+inline constexpr std::size_t kStreamChunkSize = 64 * 1024;
+
+// Copy everything readable from fd (a file, pipe or socket) into destination,
+// replacing it, in chunks of at most kStreamChunkSize bytes. Each chunk is
+// handed to on_chunk before it is written; when on_chunk returns false the
+// copy stops with ec set to operation_canceled. Returns false and sets ec on
+// read or write errors too, leaving a partial destination for the caller to
+// remove. fd is not closed.
+bool stream_to_file(int fd, const fs::path &destination,
+                    const std::function<bool(std::string_view)> &on_chunk, std::error_code &ec);
+
 // Check whether a directory exists (or can be created) and is writable by
 // attempting to create a temporary file within it. Returns true on success
 // and sets a descriptive message on failure.
 bool is_writable_directory(const fs::path &path, std::string &message);
+
+// Name of the marker file the generator rewrites under the client kit root
+// after every successful generation. Readers compare its contents to decide
+// whether a rescan of the tree is needed at all.
+inline constexpr const char *kGenerationStampFile = ".generation";
+
+// Replace the generation stamp under root with a fresh, unique token. Returns
+// true when the stamp was persisted; the new token is stored in token when
+// provided.
+bool touch_generation_stamp(const fs::path &root, std::string *token = nullptr);
+
+// Return the current generation stamp under root, or an empty string when no
+// stamp has been written yet.
+std::string read_generation_stamp(const fs::path &root);
+
+// Read-only view of a whole file. On POSIX systems the file is mapped with
+// mmap so callers can serve data straight from the page cache; elsewhere the
+// contents are read into an owned buffer. Non-copyable; move to transfer.
+class MappedFile {
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Map the file at path. Returns false and sets ec when the file cannot be
+    // opened or mapped. Empty files map successfully with size() == 0.
+    bool open(const fs::path &path, std::error_code &ec);
+
+    const char *data() const { return data_; }
+    std::size_t size() const { return size_; }
+    std::string_view view() const { return {data_, size_}; }
+
+  private:
+    void reset();
+
+    const char *data_{nullptr};
+    std::size_t size_{0};
+    bool mapped_{false};
+    std::string buffer_;
+};
@@ -0,0 +1,313 @@
+#include "generation_journal.h"
+
+#include "filesystem_utils.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <exception>
+#include <map>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Once every task is finished and the journal has grown past this size it is
+// truncated, so a long-running queue does not accumulate history.
+constexpr std::size_t kCompactBytes = 64 * 1024;
+
+// Record kinds, the first field of every line.
+constexpr char kEnqueue = 'E';
+constexpr char kStart = 'S';
+constexpr char kSuccess = 'D';
+constexpr char kFailure = 'F';
+constexpr char kSuperseded = 'X';
+
+std::string enqueue_record(const JournalEntry &entry) {
+    return std::string(1, kEnqueue) + "\t" + std::to_string(entry.id) + "\t" + entry.version + "\t" +
+           entry.spec_path.string() + "\t" + std::to_string(entry.priority) + "\n";
+}
+
+bool has_separator(const std::string &value) { return value.find_first_of("\t\n") != std::string::npos; }
+
+// Flush stdio buffers and force the file to stable storage.
+bool flush_and_sync(std::FILE *file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return ::fsync(::fileno(file)) == 0;
+#endif
+}
+} // namespace
+
+// Construct a journal for path with the given fsync batching. Nothing is
+// opened until open(); only allocation failures may throw.
+GenerationJournal::GenerationJournal(fs::path path, std::size_t sync_batch, std::chrono::milliseconds sync_interval)
+    : path_(std::move(path)), sync_batch_(sync_batch == 0 ? 1 : sync_batch), sync_interval_(sync_interval) {}
+
+GenerationJournal::~GenerationJournal() {
+    close();
+    if (lock_fd_ >= 0) {
+#ifdef _WIN32
+        _close(lock_fd_);
+#else
+        ::close(lock_fd_);
+#endif
+    }
+}
+
+// Replay and reopen the journal. Input: vector that receives unfinished tasks.
+// Output: true when the journal is ready for appends. Malformed lines are
+// skipped rather than failing the replay.
+bool GenerationJournal::open(std::vector<JournalEntry> &pending) {
+    close();
+    std::lock_guard<std::mutex> io_lock(io_mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending.clear();
+    outstanding_.clear();
+    if (!acquire_lock()) {
+        return false;
+    }
+
+    std::string content;
+    std::error_code ec;
+    std::map<std::uint64_t, JournalEntry> unfinished;
+    if (read_file(path_, content, ec)) {
+        std::size_t pos = 0;
+        // Only newline-terminated records count; a trailing fragment is a
+        // record torn by a crash mid-append.
+        for (auto end = content.find('\n'); end != std::string::npos; pos = end + 1, end = content.find('\n', pos)) {
+            std::string line = content.substr(pos, end - pos);
+            if (line.size() < 3 || line[1] != '\t') {
+                continue;
+            }
+            auto id_end = line.find('\t', 2);
+            std::uint64_t id = 0;
+            try {
+                id = std::stoull(line.substr(2, id_end == std::string::npos ? std::string::npos : id_end - 2));
+            } catch (const std::exception &) {
+                continue;
+            }
+            next_id_ = std::max(next_id_, id + 1);
+            if (line[0] == kEnqueue) {
+                auto version_end = id_end == std::string::npos ? std::string::npos : line.find('\t', id_end + 1);
+                if (version_end == std::string::npos) {
+                    continue;
+                }
+                JournalEntry entry{id, line.substr(id_end + 1, version_end - id_end - 1), {}};
+                // The priority field is optional; without it the rest of the
+                // line is the path.
+                auto path_end = line.find('\t', version_end + 1);
+                entry.spec_path = line.substr(version_end + 1, path_end == std::string::npos ? std::string::npos : path_end - version_end - 1);
+                if (path_end != std::string::npos) {
+                    try {
+                        entry.priority = static_cast<unsigned>(std::stoul(line.substr(path_end + 1)));
+                    } catch (const std::exception &) {
+                    }
+                }
+                unfinished[id] = std::move(entry);
+            } else if (line[0] == kSuccess || line[0] == kFailure || line[0] == kSuperseded) {
+                unfinished.erase(id);
+            }
+        }
+    }
+
+    for (auto &item : unfinished) {
+        outstanding_.insert(item.first);
+        pending.push_back(std::move(item.second));
+    }
+    if (!rewrite(pending)) {
+        return false;
+    }
+    file_ = std::fopen(path_.string().c_str(), "ab");
+    if (!file_) {
+        log_error("Unable to open generation journal " + path_.string());
+        return false;
+    }
+    last_sync_ = std::chrono::steady_clock::now();
+    open_ = true;
+    if (!pending.empty()) {
+        log_info("Generation journal replayed " + std::to_string(pending.size()) + " unfinished task(s)");
+    }
+    return true;
+}
+
+std::uint64_t GenerationJournal::record_enqueue(const std::string &version, const fs::path &spec_path, unsigned priority) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_ || has_separator(version) || has_separator(spec_path.string())) {
+        return 0;
+    }
+    JournalEntry entry{next_id_++, version, spec_path, priority};
+    buffer(enqueue_record(entry));
+    outstanding_.insert(entry.id);
+    return entry.id;
+}
+
+void GenerationJournal::record_start(std::uint64_t id) {
+    if (id != 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffer(std::string(1, kStart) + "\t" + std::to_string(id) + "\n");
+    }
+}
+
+void GenerationJournal::record_success(std::uint64_t id) { finish(kSuccess, id); }
+
+void GenerationJournal::record_failure(std::uint64_t id) { finish(kFailure, id); }
+
+void GenerationJournal::record_superseded(std::uint64_t id) { finish(kSuperseded, id); }
+
+std::size_t GenerationJournal::outstanding() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return outstanding_.size();
+}
+
+void GenerationJournal::finish(char kind, std::uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (id == 0 || outstanding_.erase(id) == 0) {
+        return;
+    }
+    buffer(std::string(1, kind) + "\t" + std::to_string(id) + "\n");
+}
+
+void GenerationJournal::buffer(std::string record) {
+    if (open_) {
+        buffered_ += record;
+        ++buffered_records_;
+    }
+}
+
+// Write buffered records. The buffer is taken under mutex_ while io_mutex_ is
+// held, so records reach the file in the order they were buffered.
+void GenerationJournal::flush() {
+    std::lock_guard<std::mutex> io_lock(io_mutex_);
+    std::string records;
+    std::size_t count = 0;
+    bool idle = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        records.swap(buffered_);
+        std::swap(count, buffered_records_);
+        idle = outstanding_.empty();
+    }
+    if (!file_ || records.empty()) {
+        return;
+    }
+    if (idle && bytes_ + records.size() >= kCompactBytes) {
+        // Nothing is unfinished, so an empty journal says the same thing.
+        std::fclose(file_);
+        file_ = std::fopen(path_.string().c_str(), "wb");
+        bytes_ = 0;
+        unsynced_ = 0;
+        if (!file_) {
+            log_error("Unable to truncate generation journal " + path_.string());
+        }
+        return;
+    }
+    if (std::fwrite(records.data(), 1, records.size(), file_) != records.size() || std::fflush(file_) != 0) {
+        log_error("Unable to append to generation journal " + path_.string());
+        return;
+    }
+    bytes_ += records.size();
+    unsynced_ += count;
+    if (unsynced_ >= sync_batch_ || std::chrono::steady_clock::now() - last_sync_ >= sync_interval_) {
+        sync_written();
+    }
+}
+
+void GenerationJournal::sync() {
+    flush();
+    std::lock_guard<std::mutex> io_lock(io_mutex_);
+    sync_written();
+}
+
+void GenerationJournal::sync_written() {
+    if (file_ && unsynced_ > 0) {
+        if (!flush_and_sync(file_)) {
+            log_error("Unable to sync generation journal " + path_.string());
+        }
+        unsynced_ = 0;
+        last_sync_ = std::chrono::steady_clock::now();
+    }
+}
+
+// Replace the journal with enqueue records for pending. Written to a temp
+// file, synced and renamed into place so a crash leaves either journal intact.
+bool GenerationJournal::rewrite(const std::vector<JournalEntry> &pending) {
+    std::string content;
+    for (const auto &entry : pending) {
+        content += enqueue_record(entry);
+    }
+    auto temp_path = path_;
+    temp_path += ".tmp";
+    std::FILE *temp = std::fopen(temp_path.string().c_str(), "wb");
+    if (!temp) {
+        log_error("Unable to write generation journal " + temp_path.string());
+        return false;
+    }
+    bool ok = std::fwrite(content.data(), 1, content.size(), temp) == content.size() && flush_and_sync(temp);
+    ok = std::fclose(temp) == 0 && ok;
+    std::error_code ec;
+    if (ok) {
+        fs::rename(temp_path, path_, ec);
+    }
+    if (!ok || ec) {
+        log_error("Unable to compact generation journal " + path_.string());
+        fs::remove(temp_path, ec);
+        return false;
+    }
+    bytes_ = content.size();
+    return true;
+}
+
+// Lock <path>.lock rather than the journal itself: rewrite() renames a new
+// file over the journal, which would leave a lock on the old inode behind.
+// The lock is never waited for; a second process runs without a journal.
+bool GenerationJournal::acquire_lock() {
+    if (lock_fd_ >= 0) {
+        return true;
+    }
+    auto lock_path = path_;
+    lock_path += ".lock";
+#ifdef _WIN32
+    // A deny-all share mode is exclusive for as long as the handle is open.
+    int fd = -1;
+    if (_sopen_s(&fd, lock_path.string().c_str(), _O_RDWR | _O_CREAT, _SH_DENYRW, _S_IREAD | _S_IWRITE) != 0) {
+        fd = -1;
+    }
+#else
+    int fd = ::open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd >= 0 && ::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(fd);
+        fd = -1;
+    }
+#endif
+    if (fd < 0) {
+        log_error("Generation journal " + path_.string() + " is locked by another process");
+        return false;
+    }
+    lock_fd_ = fd;
+    return true;
+}
+
+void GenerationJournal::close() {
+    sync();
+    std::lock_guard<std::mutex> io_lock(io_mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    open_ = false;
+    buffered_.clear();
+    buffered_records_ = 0;
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
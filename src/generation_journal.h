@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Name of the generation journal under the client kit root.
+inline constexpr const char *kGenerationJournalFile = ".generation.journal";
+
+// A task recorded in the journal.
+struct JournalEntry {
+    std::uint64_t id{0};
+    std::string version;
+    fs::path spec_path;
+    // Scheduling class as an opaque integer; see GenerationPriority.
+    unsigned priority{1};
+};
+
+// Append-only write-ahead log of generation task lifecycles. Each task gets an
+// id on enqueue; start, success, failure and supersession are appended as
+// one-line records. The record_* calls only buffer a record, in call order,
+// so a caller may make them under its own lock; flush() then writes the
+// buffer out and should be called once that lock is released. Records reach
+// the OS with every flush, so they survive a process crash; fsync is batched
+// across flushes to bound the power-loss window without paying a sync per
+// record. Thread-safe.
+class GenerationJournal {
+  public:
+    // An fsync happens once sync_batch records are unsynced, or on the first
+    // append after sync_interval has passed since the last one.
+    explicit GenerationJournal(fs::path path,
+                               std::size_t sync_batch = 16,
+                               std::chrono::milliseconds sync_interval = std::chrono::milliseconds(100));
+    ~GenerationJournal();
+    GenerationJournal(const GenerationJournal &) = delete;
+    GenerationJournal &operator=(const GenerationJournal &) = delete;
+
+    // Replay the journal and open it for appending. The process first takes
+    // an exclusive lock on <path>.lock and keeps it until destruction, so
+    // only one process replays and appends to a journal at a time. Returns
+    // false when the lock is held elsewhere or the file cannot be opened;
+    // otherwise pending receives every task that was
+    // enqueued but never finished, in enqueue order. The file is compacted to
+    // just those tasks, and a torn final record left by a crash is dropped.
+    bool open(std::vector<JournalEntry> &pending);
+
+    // Journal a new task and return its id, or 0 when the task cannot be
+    // recorded (journal not open, or a field contains a tab or newline).
+    std::uint64_t record_enqueue(const std::string &version, const fs::path &spec_path, unsigned priority);
+    void record_start(std::uint64_t id);
+    void record_success(std::uint64_t id);
+    void record_failure(std::uint64_t id);
+    // The task was replaced by a newer one for the same spec before it ran.
+    void record_superseded(std::uint64_t id);
+
+    // Write buffered records, syncing when the batch size or interval is
+    // reached. Once nothing is outstanding and the file has grown large, it
+    // is truncated instead.
+    void flush();
+
+    // Flush, then fsync any records written since the last sync.
+    void sync();
+
+    // Number of journaled tasks not yet finished.
+    std::size_t outstanding() const;
+
+  private:
+    void finish(char kind, std::uint64_t id);
+    // Queue a record for the next flush. Called with mutex_ held.
+    void buffer(std::string record);
+    // fsync written records. Called with io_mutex_ held.
+    void sync_written();
+    bool rewrite(const std::vector<JournalEntry> &pending);
+    void close();
+    // Take the process-wide lock file if not already held. Called with
+    // io_mutex_ held.
+    bool acquire_lock();
+
+    fs::path path_;
+    std::size_t sync_batch_;
+    std::chrono::milliseconds sync_interval_;
+
+    // Guards the task bookkeeping and the buffer; never held for I/O.
+    mutable std::mutex mutex_;
+    bool open_{false};
+    std::uint64_t next_id_{1};
+    std::set<std::uint64_t> outstanding_;
+    std::string buffered_;
+    std::size_t buffered_records_{0};
+
+    // Serializes writes, in buffer order; taken before mutex_.
+    std::mutex io_mutex_;
+    std::FILE *file_{nullptr};
+    std::size_t unsynced_{0};
+    std::chrono::steady_clock::time_point last_sync_{};
+    std::size_t bytes_{0};
+    // Descriptor holding the exclusive lock; -1 until acquired.
+    int lock_fd_{-1};
+};
@@ -1,134 +1,606 @@
 #include "generation_queue.h"
 
+#include "content_store.h"
 #include "filesystem_utils.h"
+#include "hash_utils.h"
+#include "route_index.h"
+#include "spec_diff.h"
+#include "spec_extractor.h"
 
+#include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <iterator>
 #include <sstream>
 
+namespace {
+// Backoff before the first retry; doubles per attempt up to the cap.
+constexpr std::chrono::milliseconds kRetryBaseDelay{50};
+constexpr std::chrono::milliseconds kRetryMaxDelay{5000};
+
+// Manifest line recording the hash of the spec a kit was generated from.
+const std::string kSpecHashPrefix = "spec_hash:";
+// Manifest line present when a backend produced the kit's sources.
+const std::string kSourcesLine = "sources:generated";
+// Manifest line with the content address of the spec bytes.
+const std::string kContentPrefix = "content:";
+// Manifest lines carrying the spec's servers and per-operation routes.
+const std::string kServerPrefix = "server:";
+const std::string kRoutePrefix = "route:";
+
+// Hash a spec's path and content. Input: spec path. Output: hex digest, or an
+// empty string when the spec cannot be read.
+std::string spec_content_hash(const fs::path &spec_path) {
+    MappedFile file;
+    std::error_code ec;
+    if (!file.open(spec_path, ec)) {
+        return {};
+    }
+    // The path is part of the manifest, so it is part of the identity too.
+    return to_hex(fnv1a_64(file.view(), fnv1a_64(spec_path.string())));
+}
+
+// True when the spec recorded on manifest's "spec:" line has the same bytes
+// as spec_path.
+bool same_spec_bytes(const std::string &manifest, const fs::path &spec_path) {
+    const std::string prefix = "spec:";
+    std::istringstream lines(manifest);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.rfind(prefix, 0) == 0) {
+            std::error_code ec;
+            return files_equal(line.substr(prefix.size()), spec_path, ec);
+        }
+    }
+    return false;
+}
+
+std::size_t class_index(GenerationPriority priority) { return static_cast<std::size_t>(priority); }
+} // namespace
+
+const char *generation_priority_name(GenerationPriority priority) {
+    switch (priority) {
+    case GenerationPriority::High:
+        return "high";
+    case GenerationPriority::Bulk:
+        return "bulk";
+    case GenerationPriority::Normal:
+        break;
+    }
+    return "normal";
+}
+
+std::optional<GenerationPriority> parse_generation_priority(std::string_view name) {
+    for (auto priority : {GenerationPriority::High, GenerationPriority::Normal, GenerationPriority::Bulk}) {
+        if (name == generation_priority_name(priority)) {
+            return priority;
+        }
+    }
+    return std::nullopt;
+}
+
+// Parse the routing lines of a manifest. Input: manifest path. Output: routes
+// holding its server URLs and one route per route line, with parameters
+// split on commas. Lines of other kinds are skipped.
+bool read_manifest_routes(const fs::path &manifest_path, SpecRoutes &routes, std::error_code &ec) {
+    std::string content;
+    if (!read_file(manifest_path, content, ec)) {
+        return false;
+    }
+    routes = {};
+    std::istringstream manifest(content);
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (line.rfind(kServerPrefix, 0) == 0) {
+            routes.servers.push_back(line.substr(kServerPrefix.size()));
+            continue;
+        }
+        if (line.rfind(kRoutePrefix, 0) != 0) {
+            continue;
+        }
+        std::istringstream fields(line.substr(kRoutePrefix.size()));
+        SpecRoute route;
+        std::string parameters;
+        std::getline(fields, route.operation_id, '\t');
+        std::getline(fields, route.method, '\t');
+        std::getline(fields, route.path, '\t');
+        std::getline(fields, parameters);
+        std::istringstream names(parameters);
+        std::string name;
+        while (std::getline(names, name, ',')) {
+            if (!name.empty()) {
+                route.parameters.push_back(name);
+            }
+        }
+        routes.routes.push_back(std::move(route));
+    }
+    return true;
+}
+
 // Construct a queue that targets a client kit root directory and caps retries
-// per task. Parameters: output root path and maximum retries. Only allocation
-// failures may throw during initialization.
+// per task. Parameters: output root path, maximum retries, queue bound,
+// metrics sink and worker count (at least one). Only allocation failures may
+// throw during initialization.
 GenerationQueue::GenerationQueue(fs::path clientkit_root,
                                  std::size_t max_retries,
                                  std::size_t max_queue_size,
-                                 std::shared_ptr<MetricsRegistry> metrics)
+                                 std::shared_ptr<MetricsRegistry> metrics,
+                                 std::size_t worker_count)
     : clientkit_root_(std::move(clientkit_root)),
       max_retries_(max_retries),
       max_queue_size_(max_queue_size),
+      worker_count_(std::max<std::size_t>(1, worker_count)),
       metrics_(std::move(metrics)) {}
 
+void GenerationQueue::enable_merged_index(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    merged_index_enabled_ = enabled;
+}
+
+// Open the journal and requeue its unfinished tasks. Input: journal path.
+// Output: true when journaling is active. Only allocation failures may throw.
+bool GenerationQueue::enable_journal(const fs::path &path) {
+    auto journal = std::make_unique<GenerationJournal>(path);
+    std::vector<JournalEntry> pending;
+    if (!ensure_directory(path.parent_path()) || !journal->open(pending)) {
+        log_error("Generation journal disabled; unable to open " + path.string());
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &entry : pending) {
+        auto priority = entry.priority < kGenerationPriorityCount ? static_cast<GenerationPriority>(entry.priority)
+                                                                  : GenerationPriority::Normal;
+        ScheduledTask scheduled{{std::move(entry.version), std::move(entry.spec_path), priority}};
+        scheduled.journal_id = entry.id;
+        scheduled.enqueued_at = std::chrono::steady_clock::now();
+        push_queued(std::move(scheduled));
+    }
+    journal_ = std::move(journal);
+    return true;
+}
+
+void GenerationQueue::set_backend(std::shared_ptr<GeneratorBackend> backend) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    backend_ = std::move(backend);
+}
+
 // Destructor ensures the worker is stopped. No inputs; best-effort cleanup that
 // should not throw.
 GenerationQueue::~GenerationQueue() { stop(); }
 
-// Start the worker thread. No parameters; returns void. No explicit exceptions,
-// but std::thread construction could throw.
+// Start the worker threads. No parameters; returns void. No explicit
+// exceptions, but std::thread construction could throw.
 void GenerationQueue::start() {
-    // Start the worker thread once; subsequent calls are no-ops.
+    // Start the workers once; subsequent calls are no-ops.
     std::lock_guard<std::mutex> lock(mutex_);
     if (running_) {
         return;
     }
     stopping_ = false;
     running_ = true;
-    worker_ = std::thread(&GenerationQueue::worker_loop, this);
+    auto now = std::chrono::steady_clock::now();
+    worker_states_.assign(worker_count_, WorkerState{});
+    for (auto &state : worker_states_) {
+        state.started = now;
+    }
+    for (std::size_t i = 0; i < worker_count_; ++i) {
+        workers_.emplace_back(&GenerationQueue::worker_loop, this, i);
+    }
 }
 
 void GenerationQueue::stop() {
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        // Signal the worker to drain outstanding tasks and exit.
+        // Signal the workers to drain outstanding tasks and exit.
         stopping_ = true;
     }
     cv_.notify_all();
-    if (worker_.joinable()) {
-        worker_.join();
+    for (auto &worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        workers_.clear();
+        running_ = false;
+    }
+    if (journal_) {
+        journal_->sync();
     }
-    running_ = false;
 }
 
 bool GenerationQueue::enqueue(const GenerationTask &task) {
+    EnqueueOutcome outcome;
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        if (stopping_) {
-            return false;
+        outcome = stopping_ ? EnqueueOutcome::Rejected : enqueue_locked(task);
+    }
+    if (outcome == EnqueueOutcome::Rejected) {
+        return false;
+    }
+    if (journal_) {
+        journal_->flush();
+    }
+    if (outcome == EnqueueOutcome::Queued) {
+        log_queued(task);
+    }
+    cv_.notify_one();
+    return true;
+}
+
+// Enqueue several tasks under one acquisition of the queue lock. Input: tasks
+// in submission order. Output: per task, whether it was accepted (queued or
+// coalesced). Later tasks in the batch supersede earlier ones for the same
+// spec exactly as separate enqueue() calls would.
+std::vector<bool> GenerationQueue::enqueue_batch(const std::vector<GenerationTask> &tasks) {
+    std::vector<EnqueueOutcome> outcomes(tasks.size(), EnqueueOutcome::Rejected);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!stopping_) {
+            for (std::size_t i = 0; i < tasks.size(); ++i) {
+                outcomes[i] = enqueue_locked(tasks[i]);
+            }
         }
-        if (queue_.size() >= max_queue_size_) {
-            if (metrics_) {
-                metrics_->record_generation_queue_full();
+    }
+    if (journal_) {
+        journal_->flush();
+    }
+    std::vector<bool> accepted(tasks.size(), false);
+    for (std::size_t i = 0; i < tasks.size(); ++i) {
+        accepted[i] = outcomes[i] != EnqueueOutcome::Rejected;
+        if (outcomes[i] == EnqueueOutcome::Queued) {
+            log_queued(tasks[i]);
+        }
+    }
+    cv_.notify_all();
+    return accepted;
+}
+
+GenerationQueue::EnqueueOutcome GenerationQueue::enqueue_locked(const GenerationTask &task) {
+    auto same_spec = [&task](const GenerationTask &queued) {
+        return queued.version == task.version && queued.spec_path == task.spec_path;
+    };
+    // A retry waiting out its backoff would only regenerate from the same
+    // file, so the new task supersedes it too -- but only once the new task
+    // is actually queued, or a rejected enqueue would lose the retry.
+    auto drop_retries = [this, &same_spec]() {
+        for (auto it = retries_.begin(); it != retries_.end();) {
+            if (!same_spec(it->second.task)) {
+                ++it;
+                continue;
             }
-            return false;
+            if (journal_) {
+                journal_->record_superseded(it->second.journal_id);
+            }
+            it = retries_.erase(it);
+        }
+    };
+    for (auto &cls : classes_) {
+        auto lane = cls.lanes.find(task.version);
+        if (lane == cls.lanes.end()) {
+            continue;
+        }
+        auto pending = std::find_if(lane->second.begin(), lane->second.end(),
+                                    [&same_spec](const ScheduledTask &queued) { return same_spec(queued.task); });
+        if (pending == lane->second.end()) {
+            continue;
         }
-        queue_.push(task);
+        // The older task has not started yet; the newer one replaces it,
+        // keeping its place in line. Within the same class it also keeps
+        // the journal record, which names the same spec.
+        ScheduledTask scheduled{task};
+        scheduled.journal_id = pending->journal_id;
+        scheduled.enqueued_at = pending->enqueued_at;
+        if (&cls == &classes_[class_index(task.priority)]) {
+            *pending = std::move(scheduled);
+        } else {
+            lane->second.erase(pending);
+            --queued_;
+            if (lane->second.empty()) {
+                cls.lanes.erase(lane);
+                auto turn = std::find(cls.rotation.begin(), cls.rotation.end(), task.version);
+                if (turn == cls.rotation.begin()) {
+                    cls.served = 0;
+                }
+                cls.rotation.erase(turn);
+            }
+            if (journal_) {
+                journal_->record_superseded(scheduled.journal_id);
+                scheduled.journal_id = journal_->record_enqueue(
+                    task.version, task.spec_path, static_cast<unsigned>(class_index(task.priority)));
+            }
+            push_queued(std::move(scheduled));
+        }
+        drop_retries();
+        log_info("Coalesced generation for version " + task.version + " using spec " + task.spec_path.string());
+        if (metrics_) {
+            metrics_->record_generation_coalesced();
+        }
+        return EnqueueOutcome::Coalesced;
+    }
+    if (queued_ >= max_queue_size_) {
+        if (metrics_) {
+            metrics_->record_generation_queue_full();
+        }
+        return EnqueueOutcome::Rejected;
+    }
+    ScheduledTask scheduled{task};
+    scheduled.enqueued_at = std::chrono::steady_clock::now();
+    if (journal_) {
+        scheduled.journal_id =
+            journal_->record_enqueue(task.version, task.spec_path, static_cast<unsigned>(class_index(task.priority)));
     }
-    log_info("Queued generation for version " + task.version + " using spec " + task.spec_path.string());
+    push_queued(std::move(scheduled));
+    drop_retries();
+    return EnqueueOutcome::Queued;
+}
+
+void GenerationQueue::log_queued(const GenerationTask &task) {
+    log_info("Queued " + std::string(generation_priority_name(task.priority)) + " generation for version " +
+             task.version + " using spec " + task.spec_path.string());
     if (metrics_) {
         metrics_->record_generation_enqueued();
     }
-    cv_.notify_one();
-    return true;
 }
 
-// Block until no tasks remain in the queue or are active. No parameters;
-// returns void and should not throw under normal circumstances.
+void GenerationQueue::set_version_weight(const std::string &version, std::size_t weight) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    version_weights_[version] = std::max<std::size_t>(1, weight);
+}
+
+// Register a completion listener. Input: callback. Output: id for
+// unsubscribe. Only allocation failures may throw.
+std::size_t GenerationQueue::subscribe(Listener listener) {
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    auto id = next_listener_id_++;
+    listeners_.emplace(id, std::move(listener));
+    return id;
+}
+
+void GenerationQueue::unsubscribe(std::size_t id) {
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    listeners_.erase(id);
+}
+
+void GenerationQueue::publish(const GenerationEvent &event) {
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    for (const auto &entry : listeners_) {
+        entry.second(event);
+    }
+}
+
+// Block until no tasks remain queued, awaiting a retry, or active. No
+// parameters; returns void and should not throw under normal circumstances.
 void GenerationQueue::wait_for_idle() {
     // Block until all queued tasks have been processed.
     std::unique_lock<std::mutex> lock(mutex_);
-    cv_.wait(lock, [this]() { return queue_.empty() && active_ == 0; });
+    cv_.wait(lock, [this]() { return queued_ == 0 && retries_.empty() && active_ == 0; });
 }
 
 GenerationQueue::Stats GenerationQueue::stats() const {
     std::lock_guard<std::mutex> lock(mutex_);
-    return {queue_.size(), active_, max_queue_size_, running_, stopping_};
+    Stats stats{queued_, active_, retries_.size(), max_queue_size_, running_, stopping_, {}, {}};
+    auto now = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < kGenerationPriorityCount; ++i) {
+        const auto &cls = classes_[i];
+        auto &out = stats.classes[i];
+        std::chrono::steady_clock::duration oldest{};
+        for (const auto &lane : cls.lanes) {
+            out.depth += lane.second.size();
+            for (const auto &scheduled : lane.second) {
+                oldest = std::max(oldest, now - scheduled.enqueued_at);
+            }
+        }
+        out.oldest_wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(oldest).count();
+        out.dispatched = cls.dispatched;
+        out.wait_ms_total = std::chrono::duration_cast<std::chrono::milliseconds>(cls.wait_total).count();
+    }
+    for (const auto &state : worker_states_) {
+        auto busy = state.busy;
+        if (state.busy_now) {
+            busy += now - state.task_started;
+        }
+        auto lifetime = now - state.started;
+        WorkerStats worker;
+        worker.tasks_completed = state.tasks_completed;
+        worker.busy_ms = std::chrono::duration_cast<std::chrono::milliseconds>(busy).count();
+        worker.utilization = lifetime.count() > 0 ? static_cast<double>(busy.count()) / lifetime.count() : 0.0;
+        stats.workers.push_back(worker);
+    }
+    return stats;
 }
 
-// Background worker loop that processes tasks until stop is requested. Internal
-// use only; exceptions from generation are not expected to propagate.
-void GenerationQueue::worker_loop() {
-    log_info("Generation worker started");
+std::string GenerationQueue::kit_key(const GenerationTask &task) {
+    return task.version + "/" + task.spec_path.stem().string();
+}
+
+bool GenerationQueue::take_ready_task(std::chrono::steady_clock::time_point now, ScheduledTask &out) {
+    auto kit_free = [this](const ScheduledTask &scheduled) { return busy_kits_.count(kit_key(scheduled.task)) == 0; };
+    // A retry that has waited out its backoff gets back in line with its own
+    // class rather than ahead of every class, so a failing low-priority spec
+    // cannot jump queued critical work.
+    while (!retries_.empty() && retries_.begin()->first <= now) {
+        auto due = retries_.begin();
+        auto scheduled = std::move(due->second);
+        scheduled.enqueued_at = due->first;
+        retries_.erase(due);
+        push_queued(std::move(scheduled));
+    }
+    for (auto &cls : classes_) {
+        for (std::size_t turn = 0; turn < cls.rotation.size(); ++turn) {
+            auto version = cls.rotation[turn];
+            auto lane = cls.lanes.find(version);
+            auto it = std::find_if(lane->second.begin(), lane->second.end(), kit_free);
+            if (it == lane->second.end()) {
+                // Every queued kit of this version is busy; let the next
+                // version go without ending this one's turn.
+                continue;
+            }
+            out = std::move(*it);
+            lane->second.erase(it);
+            --queued_;
+            ++cls.dispatched;
+            cls.wait_total += now - out.enqueued_at;
+
+            bool drained = lane->second.empty();
+            if (drained) {
+                cls.lanes.erase(lane);
+            }
+            if (turn == 0) {
+                auto weight = version_weights_.find(version);
+                auto allowance = weight == version_weights_.end() ? 1 : weight->second;
+                if (!drained && ++cls.served < allowance) {
+                    return true;
+                }
+                cls.served = 0;
+            }
+            // The version's turn is over: it goes to the back of the
+            // rotation, or leaves it when it has nothing left.
+            cls.rotation.erase(cls.rotation.begin() + static_cast<std::ptrdiff_t>(turn));
+            if (!drained) {
+                cls.rotation.push_back(version);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void GenerationQueue::push_queued(ScheduledTask scheduled) {
+    auto &cls = classes_[class_index(scheduled.task.priority)];
+    auto &lane = cls.lanes[scheduled.task.version];
+    if (lane.empty()) {
+        cls.rotation.push_back(scheduled.task.version);
+    }
+    lane.push_back(std::move(scheduled));
+    ++queued_;
+}
+
+std::chrono::milliseconds GenerationQueue::retry_delay(std::size_t attempt) {
+    auto delay = kRetryBaseDelay;
+    for (std::size_t i = 1; i < attempt && delay < kRetryMaxDelay; ++i) {
+        delay *= 2;
+    }
+    delay = std::min(delay, kRetryMaxDelay);
+    // Jitter into [delay / 2, delay] so specs that failed together, e.g.
+    // during one outage, do not all retry in the same instant.
+    std::uniform_int_distribution<long long> jitter(delay.count() / 2, delay.count());
+    return std::chrono::milliseconds(jitter(jitter_rng_));
+}
+
+// Background worker loop that processes tasks until stop is requested.
+// Input: the worker's index for accounting. Internal use only; exceptions
+// from generation are not expected to propagate.
+void GenerationQueue::worker_loop(std::size_t worker_index) {
+    log_info("Generation worker " + std::to_string(worker_index) + " started");
     while (true) {
-        GenerationTask task;
+        ScheduledTask scheduled;
+        bool have_task = false;
+        std::string key;
         {
             std::unique_lock<std::mutex> lock(mutex_);
-            cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
-            if (stopping_ && queue_.empty()) {
+            while (true) {
+                auto now = std::chrono::steady_clock::now();
+                if (take_ready_task(now, scheduled)) {
+                    have_task = true;
+                    break;
+                }
+                if (stopping_ && queued_ == 0 && retries_.empty()) {
+                    break;
+                }
+                // Sleep until the next retry falls due; queued tasks blocked
+                // on a busy kit are woken by that kit's release.
+                if (!retries_.empty()) {
+                    cv_.wait_until(lock, retries_.begin()->first);
+                } else {
+                    cv_.wait(lock);
+                }
+            }
+            if (!have_task) {
                 // Exit when no additional work remains.
                 break;
             }
-            task = queue_.front();
-            queue_.pop();
+            key = kit_key(scheduled.task);
+            // Claim the kit so no other worker writes the same directory.
+            busy_kits_.insert(key);
             ++active_;
+            auto &state = worker_states_[worker_index];
+            state.busy_now = true;
+            state.task_started = std::chrono::steady_clock::now();
+            if (scheduled.attempt == 1) {
+                scheduled.first_started = state.task_started;
+                if (journal_) {
+                    journal_->record_start(scheduled.journal_id);
+                }
+            }
+        }
+        if (journal_) {
+            journal_->flush();
         }
 
-        run_task_with_retries(task);
+        auto result = run_attempt(scheduled);
 
         {
             std::lock_guard<std::mutex> lock(mutex_);
+            busy_kits_.erase(key);
             --active_;
+            auto &state = worker_states_[worker_index];
+            state.busy_now = false;
+            auto now = std::chrono::steady_clock::now();
+            state.busy += now - state.task_started;
+            if (result != AttemptResult::Retry) {
+                ++state.tasks_completed;
+                if (journal_ && result == AttemptResult::Succeeded) {
+                    journal_->record_success(scheduled.journal_id);
+                } else if (journal_) {
+                    journal_->record_failure(scheduled.journal_id);
+                }
+            } else {
+                // Park the task instead of sleeping so this worker can move
+                // on to other ready tasks during the backoff.
+                auto delay = retry_delay(scheduled.attempt);
+                ++scheduled.attempt;
+                retries_.emplace(now + delay, std::move(scheduled));
+            }
         }
+        if (journal_) {
+            journal_->flush();
+        }
+        // Wake waiters for idleness and workers blocked on this kit.
         cv_.notify_all();
     }
-    log_info("Generation worker stopped");
+    log_info("Generation worker " + std::to_string(worker_index) + " stopped");
 }
 
-bool GenerationQueue::run_task_with_retries(const GenerationTask &task) {
-    auto start = std::chrono::steady_clock::now();
-    // Retry transient failures with a simple linear backoff.
-    for (std::size_t attempt = 1; attempt <= max_retries_; ++attempt) {
-        if (generate_client_kit(task)) {
-            log_info("Successfully generated client kit for version " + task.version + " on attempt " + std::to_string(attempt));
-            if (metrics_) {
-                metrics_->record_generation_success();
-                auto end = std::chrono::steady_clock::now();
-                auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-                metrics_->record_generation_latency_ms(duration_ms);
-            }
-            return true;
+GenerationQueue::AttemptResult GenerationQueue::run_attempt(const ScheduledTask &scheduled) {
+    const auto &task = scheduled.task;
+    auto attempt = scheduled.attempt;
+    auto start = scheduled.first_started;
+    auto spec_hash = spec_content_hash(task.spec_path);
+    if (!spec_hash.empty() && kit_is_current(task, spec_hash)) {
+        log_info("Client kit for version " + task.version + " already matches " + task.spec_path.string() + "; skipping generation");
+        if (metrics_) {
+            metrics_->record_generation_unchanged();
+        }
+        return AttemptResult::Succeeded;
+    }
+    GenerationEvent event;
+    if (generate_client_kit(task, spec_hash, event)) {
+        log_info("Successfully generated client kit for version " + task.version + " on attempt " + std::to_string(attempt));
+        if (metrics_) {
+            metrics_->record_generation_success();
+            auto end = std::chrono::steady_clock::now();
+            auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+            metrics_->record_generation_latency_ms(duration_ms);
         }
+        publish(event);
+        return AttemptResult::Succeeded;
+    }
 
-        log_error("Generation attempt " + std::to_string(attempt) + " failed for " + task.spec_path.string());
-        std::this_thread::sleep_for(std::chrono::milliseconds(50 * attempt));
+    log_error("Generation attempt " + std::to_string(attempt) + " failed for " + task.spec_path.string());
+    if (attempt < max_retries_) {
+        return AttemptResult::Retry;
     }
 
     log_error("Exhausted retries for " + task.spec_path.string());
@@ -138,10 +610,83 @@ bool GenerationQueue::run_task_with_retries(const GenerationTask &task) {
         auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
         metrics_->record_generation_latency_ms(duration_ms);
     }
+    return AttemptResult::Failed;
+}
+
+// Copy another kit's generated sources. Inputs: spec content address and
+// the kit directory to fill. Output: true when output_dir now holds sources
+// generated from that content. The source kit is claimed like a running task
+// so no worker rewrites it mid-copy. Sources are copied rather than hard
+// linked because the generator may rewrite files in place.
+bool GenerationQueue::copy_shared_sources(const std::string &address, const fs::path &spec_path,
+                                          const fs::path &output_dir) {
+    std::string owner;
+    std::error_code ec;
+    if (!read_file(clientkit_root_ / kContentIndexDirectory / address, owner, ec) || owner.empty()) {
+        return false;
+    }
+    auto source_dir = clientkit_root_ / owner;
+    if (source_dir == output_dir) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!busy_kits_.insert(owner).second) {
+            return false;
+        }
+    }
+
+    bool copied = false;
+    std::string manifest;
+    // The index may be stale: only trust a kit whose manifest still records
+    // this content and generated sources. The address is a 64-bit hash, so
+    // the kit's spec must also still hold the same bytes as ours.
+    if (read_file(source_dir / "manifest.txt", manifest, ec) &&
+        manifest.find(kContentPrefix + address + "\n") != std::string::npos &&
+        manifest.find(kSourcesLine + "\n") != std::string::npos &&
+        same_spec_bytes(manifest, spec_path)) {
+        fs::remove_all(output_dir, ec);
+        copied = ensure_directory(output_dir);
+        for (fs::directory_iterator it(source_dir, ec), end; copied && !ec && it != end; it.increment(ec)) {
+            auto name = it->path().filename();
+            if (name == "manifest.txt" || name == kRouteIndexFile) {
+                continue;
+            }
+            fs::copy(it->path(), output_dir / name, fs::copy_options::recursive | fs::copy_options::overwrite_existing, ec);
+        }
+        copied = copied && !ec;
+        if (!copied) {
+            log_error("Unable to copy generated sources from " + source_dir.string() + ": " + ec.message());
+            fs::remove_all(output_dir, ec);
+            ensure_directory(output_dir);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        busy_kits_.erase(owner);
+    }
+    cv_.notify_all();
+    return copied;
+}
+
+bool GenerationQueue::kit_is_current(const GenerationTask &task, const std::string &spec_hash) const {
+    fs::path output_dir = clientkit_root_ / task.version / task.spec_path.stem().string();
+    std::error_code ec;
+    if (!fs::exists(output_dir / kRouteIndexFile, ec)) {
+        return false;
+    }
+    std::ifstream manifest(output_dir / "manifest.txt");
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (line.rfind(kSpecHashPrefix, 0) == 0) {
+            return line.compare(kSpecHashPrefix.size(), std::string::npos, spec_hash) == 0;
+        }
+    }
     return false;
 }
 
-bool GenerationQueue::generate_client_kit(const GenerationTask &task) {
+bool GenerationQueue::generate_client_kit(const GenerationTask &task, const std::string &spec_hash, GenerationEvent &event) {
     // Validate spec existence.
     if (!fs::exists(task.spec_path)) {
         log_error("Spec file missing: " + task.spec_path.string());
@@ -150,66 +695,188 @@ bool GenerationQueue::generate_client_kit(const GenerationTask &task) {
 
     auto kit_name = task.spec_path.stem().string();
     fs::path output_dir = clientkit_root_ / task.version / kit_name;
+    // The new kit is built in a hidden sibling and swapped in only once it
+    // is complete, so a failed run leaves the last good kit in place.
+    fs::path staging_dir = temp_path_for(output_dir);
+
+    if (!ensure_directory(output_dir.parent_path())) {
+        log_error("Unable to create client kit directory: " + output_dir.parent_path().string());
+        return false;
+    }
+
+    // Diff the spec against the fingerprint the current kit was built from;
+    // when only some operations changed, only they are regenerated.
+    // The spec is mapped once and both the fingerprint and the route records
+    // are taken from the same view.
+    MappedFile spec_file;
+    std::error_code read_ec;
+    if (!spec_file.open(task.spec_path, read_ec)) {
+        log_error("Unable to read spec " + task.spec_path.string() + ": " + read_ec.message());
+        return false;
+    }
+    auto fingerprint = fingerprint_spec(spec_file.view());
+    auto routes = extract_spec_routes(spec_file.view());
+    auto address = content_address(spec_file.view());
+    GeneratorRequest request{task.spec_path, staging_dir, {}};
+    bool run_backend = backend_ != nullptr;
+    // Whether the current kit's sources stay valid and are carried over.
+    bool keep_sources = false;
+    std::string previous_manifest;
+    SpecFingerprint previous;
+    if (run_backend && copy_shared_sources(address, task.spec_path, staging_dir)) {
+        // Another version registered identical bytes; its sources are ours.
+        log_info("Reusing generated sources for " + output_dir.string() + " from content " + address);
+        run_backend = false;
+        if (metrics_) {
+            metrics_->record_generation_shared();
+        }
+    } else if (read_file(output_dir / "manifest.txt", previous_manifest, read_ec) &&
+        parse_fingerprint_lines(previous_manifest, previous) &&
+        (!backend_ || previous_manifest.find(kSourcesLine + "\n") != std::string::npos)) {
+        auto diff = diff_spec_fingerprints(previous, fingerprint);
+        if (!diff.full) {
+            log_info("Regenerating " + std::to_string(diff.changed_operation_ids.size()) + " changed operation(s) of " +
+                     output_dir.string());
+            run_backend = run_backend && !diff.changed_operation_ids.empty();
+            keep_sources = true;
+            request.operation_ids = std::move(diff.changed_operation_ids);
+            if (metrics_) {
+                metrics_->record_generation_incremental();
+            }
+        }
+    }
 
-    if (!ensure_directory(output_dir)) {
-        log_error("Unable to create client kit directory: " + output_dir.string());
+    std::error_code ec;
+    if (keep_sources) {
+        // Carry the unchanged sources over as hard links, so staging costs
+        // one entry per file rather than a copy of the kit. The backend then
+        // writes into an empty directory that is renamed over the links;
+        // writing into the links would change the live kit's files too.
+        link_tree(output_dir, staging_dir, ec);
+        request.output_dir = temp_path_for(output_dir);
+        if (!ec && run_backend) {
+            fs::create_directory(request.output_dir, ec);
+        }
+    } else {
+        fs::create_directory(staging_dir, ec);
+    }
+    if (ec) {
+        log_error("Unable to stage client kit " + staging_dir.string() + ": " + ec.message());
+        fs::remove_all(staging_dir, ec);
+        fs::remove_all(request.output_dir, ec);
         return false;
     }
 
-    auto operations = extract_operation_ids(task.spec_path);
+    if (run_backend) {
+        auto generated = backend_->generate(request);
+        if (!generated.output.empty()) {
+            log_debug("Generator output for " + task.spec_path.string() + ":\n" + generated.output);
+        }
+        if (generated.ok && request.output_dir != staging_dir && !merge_tree(request.output_dir, staging_dir, ec)) {
+            generated.ok = false;
+            generated.message = "unable to stage regenerated sources: " + ec.message();
+        }
+        if (request.output_dir != staging_dir) {
+            std::error_code cleanup_ec;
+            fs::remove_all(request.output_dir, cleanup_ec);
+        }
+        if (!generated.ok) {
+            log_error("Generator failed for " + task.spec_path.string() + ": " + generated.message);
+            fs::remove_all(staging_dir, ec);
+            return false;
+        }
+    }
+
+    std::vector<std::string> operations;
+    for (const auto &route : routes.routes) {
+        if (!route.operation_id.empty()) {
+            operations.push_back(route.operation_id);
+        }
+    }
     if (operations.empty()) {
         // Fall back to a default operation so the manifest is never empty.
         operations.push_back("default_operation");
     }
 
-    fs::path manifest_path = output_dir / "manifest.txt";
+    fs::path manifest_path = staging_dir / "manifest.txt";
     std::ostringstream manifest;
     manifest << "version:" << task.version << "\n";
     manifest << "spec:" << task.spec_path.string() << "\n";
+    if (!spec_hash.empty()) {
+        manifest << kSpecHashPrefix << spec_hash << "\n";
+    }
+    manifest << kContentPrefix << address << "\n";
+    if (backend_) {
+        manifest << kSourcesLine << "\n";
+    }
+    manifest << format_fingerprint_lines(fingerprint);
     for (const auto &op : operations) {
         manifest << "operation:" << op << "\n";
     }
+    // Routing details for each operation: method, path and parameter names.
+    for (const auto &server : routes.servers) {
+        manifest << kServerPrefix << server << "\n";
+    }
+    for (const auto &route : routes.routes) {
+        if (route.operation_id.empty() || route.method.empty()) {
+            continue;
+        }
+        manifest << kRoutePrefix << route.operation_id << "\t" << route.method << "\t" << route.path << "\t";
+        for (std::size_t i = 0; i < route.parameters.size(); ++i) {
+            manifest << (i == 0 ? "" : ",") << route.parameters[i];
+        }
+        manifest << "\n";
+    }
 
     if (!write_file(manifest_path, manifest.str())) {
-        fs::remove_all(output_dir);
+        fs::remove_all(staging_dir, ec);
         return false;
     }
 
-    fs::path cache_path = output_dir / "routes.cache";
-    std::ostringstream cache;
+    // Emit the binary route index next to the manifest. It records the
+    // manifest's size and mtime so the registry can trust it without parsing
+    // the manifest again.
+    RouteIndexSource source;
+    source.manifest_size = fs::file_size(manifest_path, ec);
+    source.manifest_mtime = ec ? 0 : file_time_ticks(fs::last_write_time(manifest_path, ec));
+    std::vector<RouteIndexRecord> records;
+    records.reserve(operations.size());
     for (const auto &op : operations) {
-        cache << op << " -> " << kit_name << "\n";
+        records.push_back({op, task.version, kit_name});
     }
-    if (!write_file(cache_path, cache.str())) {
-        fs::remove_all(output_dir);
+    if (ec || !write_route_index(staging_dir / kRouteIndexFile, records, source)) {
+        fs::remove_all(staging_dir, ec);
         return false;
     }
+    if (!replace_directory(staging_dir, output_dir, ec)) {
+        log_error("Unable to publish client kit " + output_dir.string() + ": " + ec.message());
+        fs::remove_all(staging_dir, ec);
+        return false;
+    }
+    if (backend_ && (!ensure_directory(clientkit_root_ / kContentIndexDirectory) ||
+                     !write_file(clientkit_root_ / kContentIndexDirectory / address, kit_key(task)))) {
+        // Only sharing is lost; the kit itself is complete.
+        log_error("Unable to record content " + address + " for " + output_dir.string());
+    }
 
-    log_debug("Generated manifest at " + manifest_path.string());
-    return true;
-}
-
-std::vector<std::string> GenerationQueue::extract_operation_ids(const fs::path &spec_path) const {
-    std::ifstream file(spec_path);
-    std::vector<std::string> operations;
-    std::string line;
-    while (std::getline(file, line)) {
-        auto pos = line.find("operationId");
-        if (pos == std::string::npos) {
-            continue;
-        }
+    // Bump the generation stamp so runtime registries know a rescan is due.
+    // The stamps on either side of this kit travel with the completion event.
+    std::lock_guard<std::mutex> stamp_lock(stamp_mutex_);
+    auto previous_stamp = read_generation_stamp(clientkit_root_);
+    std::string stamp;
+    if (!touch_generation_stamp(clientkit_root_, &stamp)) {
+        log_error("Unable to update generation stamp under " + clientkit_root_.string());
+    } else if (merged_index_enabled_ && !build_merged_route_index(clientkit_root_)) {
+        log_error("Unable to rebuild merged route index under " + clientkit_root_.string());
+    }
 
-        auto colon = line.find(":", pos);
-        if (colon == std::string::npos) {
-            continue;
-        }
+    event.version = task.version;
+    event.kit_name = kit_name;
+    event.output_dir = output_dir;
+    event.operation_ids = std::move(operations);
+    event.previous_stamp = std::move(previous_stamp);
+    event.stamp = std::move(stamp);
 
-        auto value = line.substr(colon + 1);
-        auto start = value.find_first_not_of(" \t\"'");
-        auto end = value.find_last_not_of(" \t\"'");
-        if (start != std::string::npos && end != std::string::npos && end >= start) {
-            operations.emplace_back(value.substr(start, end - start + 1));
-        }
-    }
-    return operations;
+    log_debug("Generated manifest at " + (output_dir / "manifest.txt").string());
+    return true;
 }
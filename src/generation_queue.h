@@ -1,23 +1,67 @@
 #pragma once
 
+#include "generation_journal.h"
+#include "generator_backend.h"
 #include "logging.h"
 #include "metrics.h"
+#include "spec_extractor.h"
 
+#include <array>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
-#include <queue>
+#include <random>
+#include <set>
 #include <string>
+#include <string_view>
+#include <system_error>
 #include <thread>
 #include <vector>
 
 namespace fs = std::filesystem;
 
+// Scheduling classes, served strictly in this order. Within a class, versions
+// share workers by weighted round-robin.
+enum class GenerationPriority { High, Normal, Bulk };
+inline constexpr std::size_t kGenerationPriorityCount = 3;
+
+// Lowercase name of a priority ("high", "normal", "bulk").
+const char *generation_priority_name(GenerationPriority priority);
+
+// Parse a name produced by generation_priority_name.
+std::optional<GenerationPriority> parse_generation_priority(std::string_view name);
+
+// Directory under the client kit root mapping spec content addresses to the
+// kit last generated from that content, one small file per address.
+inline constexpr const char *kContentIndexDirectory = ".content";
+
+// Read the servers and per-operation routes a generated kit's manifest
+// records. Returns false and sets ec when the manifest cannot be read.
+bool read_manifest_routes(const fs::path &manifest_path, SpecRoutes &routes, std::error_code &ec);
+
 struct GenerationTask {
     std::string version;
     fs::path spec_path;
+    GenerationPriority priority{GenerationPriority::Normal};
+};
+
+// Published after a client kit has been generated successfully. Carries the
+// kit's operation list so live registries can patch themselves without a
+// rescan, plus the generation stamps immediately before and after this kit
+// was written so a registry can tell whether it missed any other generation.
+struct GenerationEvent {
+    std::string version;
+    std::string kit_name;
+    fs::path output_dir;
+    std::vector<std::string> operation_ids;
+    std::string previous_stamp;
+    std::string stamp;
 };
 
 struct GenerationStatus {
@@ -28,66 +72,221 @@ struct GenerationStatus {
 
 class GenerationQueue {
   public:
-    // Initialize a queue that writes client kits under clientkit_root. The
-    // worker thread will retry failed generation attempts up to max_retries.
+    // Initialize a queue that writes client kits under clientkit_root. Up to
+    // worker_count worker threads consume tasks; each retries failed
+    // generation attempts up to max_retries.
     GenerationQueue(fs::path clientkit_root,
                     std::size_t max_retries = 3,
                     std::size_t max_queue_size = 32,
-                    std::shared_ptr<MetricsRegistry> metrics = nullptr);
+                    std::shared_ptr<MetricsRegistry> metrics = nullptr,
+                    std::size_t worker_count = 1);
     ~GenerationQueue();
 
-    // Start the background worker thread. Safe to call multiple times; the
-    // worker will only start once.
+    // Also rebuild the merged route index at the client kit root after every
+    // successful generation, so cold starts can map a single file instead of
+    // walking every kit. Call before start().
+    void enable_merged_index(bool enabled);
+
+    // Record every task's lifecycle in an append-only journal at path and
+    // requeue the tasks a previous process left unfinished there, so a
+    // restart resumes only that work. Call before start(). Returns false and
+    // runs without a journal when it cannot be opened.
+    bool enable_journal(const fs::path &path);
+
+    // Run backend for every task to produce client sources in the kit
+    // directory before the manifest and route index are written. A backend
+    // failure fails the attempt, so it is retried like any other. Without a
+    // backend only the manifest and index are written. Call before start().
+    void set_backend(std::shared_ptr<GeneratorBackend> backend);
+
+    // Start the background worker threads. Safe to call multiple times; the
+    // workers will only start once.
     void start();
 
-    // Signal the worker thread to stop and join it. Additional enqueued tasks
-    // will not be processed once stop has been requested.
+    // Signal the worker threads to stop and join them. Additional enqueued
+    // tasks will not be processed once stop has been requested.
     void stop();
 
-    // Enqueue a new generation task with the target version and spec path. The
-    // worker thread consumes tasks in FIFO order.
+    // Enqueue a new generation task with the target version and spec path.
+    // Workers take the highest priority class with work; within a class they
+    // rotate across versions, taking up to the version's weight of tasks in
+    // FIFO order before moving on. A task whose kit
+    // (clientkit/<version>/<spec stem>) is already being generated waits and
+    // lets later tasks go first. A task for the same version and spec path as
+    // one still pending supersedes it instead of taking another queue slot.
     bool enqueue(const GenerationTask &task);
 
+    // Enqueue several tasks taking the queue lock once, e.g. for a bulk
+    // registration. Returns, per task, what enqueue() would have returned.
+    std::vector<bool> enqueue_batch(const std::vector<GenerationTask> &tasks);
+
+    // Number of consecutive tasks a version may take from its class before
+    // the next version gets a turn. Versions default to 1; 0 is treated as 1.
+    void set_version_weight(const std::string &version, std::size_t weight);
+
+    using Listener = std::function<void(const GenerationEvent &)>;
+
+    // Register a listener for completion events and return a subscription id.
+    // Listeners run on the worker thread that finished the task, before the
+    // task counts as idle, and must not call back into subscribe/unsubscribe.
+    std::size_t subscribe(Listener listener);
+
+    // Remove a listener. Blocks until any in-flight callback has returned, so
+    // the listener's captures may be destroyed once this returns.
+    void unsubscribe(std::size_t id);
+
     // Block the caller until the queue is empty and no tasks are active. Useful
     // for graceful shutdowns in tests or CLI flows.
     void wait_for_idle();
 
+    struct WorkerStats {
+        std::size_t tasks_completed{0};
+        long long busy_ms{0};
+        // Fraction of the worker's lifetime spent running tasks, in [0, 1].
+        double utilization{0.0};
+    };
+
+    struct ClassStats {
+        std::size_t depth{0};
+        // Age of the oldest queued task in the class.
+        long long oldest_wait_ms{0};
+        // Tasks handed to workers so far, and their summed queueing time.
+        std::size_t dispatched{0};
+        long long wait_ms_total{0};
+    };
+
     struct Stats {
         std::size_t queue_depth{0};
         std::size_t active{0};
+        // Failed tasks waiting out their backoff before the next attempt.
+        std::size_t retry_pending{0};
         std::size_t max_queue_size{0};
         bool running{false};
         bool stopping{false};
+        std::vector<WorkerStats> workers;
+        // Indexed by GenerationPriority.
+        std::array<ClassStats, kGenerationPriorityCount> classes{};
     };
 
     Stats stats() const;
 
   private:
+    // A task together with its retry bookkeeping.
+    struct ScheduledTask {
+        GenerationTask task;
+        std::size_t attempt{1};
+        std::chrono::steady_clock::time_point first_started{};
+        // Id in journal_, or 0 when the task is not journaled.
+        std::uint64_t journal_id{0};
+        std::chrono::steady_clock::time_point enqueued_at{};
+    };
+
+    // Queued tasks of one priority class: a FIFO lane per version and the
+    // order in which versions with queued work take their turns.
+    struct PriorityClass {
+        std::map<std::string, std::deque<ScheduledTask>> lanes;
+        std::deque<std::string> rotation;
+        // Tasks rotation.front() has taken during its current turn.
+        std::size_t served{0};
+        std::size_t dispatched{0};
+        std::chrono::steady_clock::duration wait_total{};
+    };
+
+    enum class AttemptResult { Succeeded, Failed, Retry };
+
     // Main worker loop that consumes tasks until stop is requested.
-    void worker_loop();
+    void worker_loop(std::size_t worker_index);
+
+    // Move retries due by now into their class queues, then move the next
+    // runnable task into out, chosen by priority and version round-robin and
+    // skipping any whose kit is being generated. Returns false when nothing
+    // can run at now. Requires mutex_.
+    bool take_ready_task(std::chrono::steady_clock::time_point now, ScheduledTask &out);
+
+    enum class EnqueueOutcome { Queued, Coalesced, Rejected };
+
+    // Queue, coalesce or reject one task. Requires mutex_ and !stopping_.
+    EnqueueOutcome enqueue_locked(const GenerationTask &task);
 
-    // Attempt to run a generation task with bounded retries. Returns true on
-    // the first successful attempt.
-    bool run_task_with_retries(const GenerationTask &task);
+    // Log and count a newly queued task. Called without mutex_.
+    void log_queued(const GenerationTask &task);
+
+    // Add a task to its class and version lane. Requires mutex_.
+    void push_queued(ScheduledTask scheduled);
+
+    // Delay before the given attempt is retried: exponential in the attempt
+    // number with random jitter, capped. Requires mutex_.
+    std::chrono::milliseconds retry_delay(std::size_t attempt);
+
+    // Key identifying the client kit directory a task writes.
+    static std::string kit_key(const GenerationTask &task);
+
+    // Run one attempt of a task. Succeeded covers both a generated kit
+    // (publishing a completion event) and one left alone because it already
+    // matches its spec; Failed means retries are exhausted; Retry asks the
+    // caller to schedule another attempt.
+    AttemptResult run_attempt(const ScheduledTask &scheduled);
 
     // Perform the actual client kit generation. Returns false if the spec is
     // missing, the output directory cannot be created, or manifests fail to
-    // persist.
-    bool generate_client_kit(const GenerationTask &task);
+    // persist. spec_hash is recorded in the manifest when non-empty. On
+    // success event describes the generated kit.
+    bool generate_client_kit(const GenerationTask &task, const std::string &spec_hash, GenerationEvent &event);
+
+    // Fill output_dir with the generated sources of another kit built from
+    // the spec content at address, as recorded under kContentIndexDirectory,
+    // provided that kit's spec has the same bytes as spec_path. Returns false
+    // when there is no such kit or it is busy, leaving output_dir untouched.
+    bool copy_shared_sources(const std::string &address, const fs::path &spec_path, const fs::path &output_dir);
 
-    // Parse operation identifiers from the spec file. The parser is lightweight
-    // and uses substring matching to find `operationId` entries.
-    std::vector<std::string> extract_operation_ids(const fs::path &spec_path) const;
+    // True when the task's kit has a route index and a manifest recording
+    // spec_hash, i.e. regenerating it would produce the same output.
+    bool kit_is_current(const GenerationTask &task, const std::string &spec_hash) const;
+
+    // Deliver an event to every listener.
+    void publish(const GenerationEvent &event);
 
     fs::path clientkit_root_;
     std::size_t max_retries_;
     std::size_t max_queue_size_;
-    std::queue<GenerationTask> queue_;
+    std::size_t worker_count_;
+    // Queued tasks by priority; queued_ counts them. Guarded by mutex_.
+    std::array<PriorityClass, kGenerationPriorityCount> classes_;
+    std::size_t queued_{0};
+    std::map<std::string, std::size_t> version_weights_;
+    // Failed tasks keyed by when their next attempt is due; guarded by mutex_.
+    std::multimap<std::chrono::steady_clock::time_point, ScheduledTask> retries_;
+    std::mt19937 jitter_rng_{std::random_device{}()};
     mutable std::mutex mutex_;
     std::condition_variable cv_;
     bool running_{false};
     bool stopping_{false};
-    std::thread worker_;
+    std::vector<std::thread> workers_;
     std::size_t active_{0};
+    // Kits currently being generated; guarded by mutex_.
+    std::set<std::string> busy_kits_;
+
+    // Per-worker accounting; guarded by mutex_.
+    struct WorkerState {
+        std::size_t tasks_completed{0};
+        std::chrono::steady_clock::duration busy{};
+        std::chrono::steady_clock::time_point started{};
+        std::chrono::steady_clock::time_point task_started{};
+        bool busy_now{false};
+    };
+    std::vector<WorkerState> worker_states_;
+
+    // Serializes stamp updates and merged index rebuilds across workers so
+    // the before/after stamps in each event form a consistent chain.
+    std::mutex stamp_mutex_;
     std::shared_ptr<MetricsRegistry> metrics_;
+    bool merged_index_enabled_{false};
+    std::shared_ptr<GeneratorBackend> backend_;
+    // Optional write-ahead journal, set before start(). Records are buffered
+    // under mutex_ and flushed to disk only after it is released.
+    std::unique_ptr<GenerationJournal> journal_;
+    // Guards listeners_; held while callbacks run so unsubscribe can wait.
+    std::mutex listeners_mutex_;
+    std::map<std::size_t, Listener> listeners_;
+    std::size_t next_listener_id_{1};
 };
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// One spec to turn into client sources under output_dir.
+struct GeneratorRequest {
+    fs::path spec_path;
+    fs::path output_dir;
+    // When non-empty, only these operations changed since the kit was last
+    // generated; the backend may regenerate just them (for example via
+    // openapi-generator's FILTER normalizer). output_dir then starts empty,
+    // and each file written there replaces the kit's file of the same name
+    // while the rest of the kit is kept. Empty means the whole spec.
+    std::vector<std::string> operation_ids;
+};
+
+struct GeneratorResult {
+    bool ok{false};
+    // Failure reason when ok is false.
+    std::string message;
+    // Diagnostic output the generator produced for this request.
+    std::string output;
+};
+
+// Produces client sources for a spec. GenerationQueue calls generate() from
+// its worker threads, so implementations must be thread-safe.
+class GeneratorBackend {
+  public:
+    virtual ~GeneratorBackend() = default;
+    virtual GeneratorResult generate(const GeneratorRequest &request) = 0;
+};
@@ -0,0 +1,323 @@
+#include "generator_pool.h"
+
+#include "logging.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// How long idle processes get to exit on their own once the pool closes
+// their stdin at shutdown.
+constexpr std::chrono::milliseconds kShutdownGrace{2000};
+
+// Fail every request in the batch that has not been answered yet.
+template <typename Batch>
+void fail_unanswered(const Batch &batch, const std::vector<bool> &answered, const std::string &message) {
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        if (!answered[i]) {
+            batch[i]->result.ok = false;
+            batch[i]->result.message = message;
+        }
+    }
+}
+} // namespace
+
+// Create a pool. Processes are spawned lazily on first use, so construction
+// does no I/O. Input: pool options; counts of zero are treated as one.
+GeneratorProcessPool::GeneratorProcessPool(Options options) : options_(std::move(options)) {
+    options_.processes = std::max<std::size_t>(1, options_.processes);
+    options_.max_batch = std::max<std::size_t>(1, options_.max_batch);
+    processes_.resize(options_.processes);
+#ifndef _WIN32
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+}
+
+// Close every process's stdin so it can exit cleanly, then reap it. All
+// processes share one grace period; any still running after it are killed.
+GeneratorProcessPool::~GeneratorProcessPool() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() {
+        return std::none_of(processes_.begin(), processes_.end(), [](const Process &p) { return p.busy; });
+    });
+#ifndef _WIN32
+    for (auto &process : processes_) {
+        if (process.to_child >= 0) {
+            ::close(process.to_child);
+            process.to_child = -1;
+        }
+    }
+#endif
+    auto deadline = std::chrono::steady_clock::now() + kShutdownGrace;
+    for (auto &process : processes_) {
+        terminate(process, deadline);
+    }
+}
+
+// Generate one spec. Input: request. Output: the generator's result. Blocks
+// until a process has handled the request, possibly in a batch started by
+// another caller. Does not throw apart from allocation failures.
+GeneratorResult GeneratorProcessPool::generate(const GeneratorRequest &request) {
+    Pending pending{request, {}, false};
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiting_.push_back(&pending);
+    while (!pending.done) {
+        auto idle = std::find_if(processes_.begin(), processes_.end(), [](const Process &p) { return !p.busy; });
+        if (idle == processes_.end() || waiting_.empty()) {
+            cv_.wait(lock);
+            continue;
+        }
+        // Lead a batch of the oldest waiting requests, which may or may not
+        // include this caller's.
+        std::vector<Pending *> batch;
+        while (!waiting_.empty() && batch.size() < options_.max_batch) {
+            batch.push_back(waiting_.front());
+            waiting_.pop_front();
+        }
+        idle->busy = true;
+        ++stats_.batches;
+        stats_.requests += batch.size();
+        lock.unlock();
+        run_batch(*idle, batch);
+        lock.lock();
+        idle->busy = false;
+        for (auto *item : batch) {
+            item->done = true;
+        }
+        cv_.notify_all();
+    }
+    return pending.result;
+}
+
+GeneratorProcessPool::Stats GeneratorProcessPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+#ifdef _WIN32
+void GeneratorProcessPool::run_batch(Process &, const std::vector<Pending *> &batch) {
+    fail_unanswered(batch, std::vector<bool>(batch.size(), false), "generator process pool requires POSIX");
+}
+
+bool GeneratorProcessPool::spawn(Process &) { return false; }
+
+void GeneratorProcessPool::terminate(Process &, std::chrono::steady_clock::time_point) {}
+
+bool GeneratorProcessPool::read_line(Process &, std::chrono::steady_clock::time_point, std::string &, bool &timed_out) {
+    timed_out = false;
+    return false;
+}
+#else
+// Send a batch and collect its answers. Inputs: a reserved process and the
+// requests to run. Every request's result is filled before returning.
+void GeneratorProcessPool::run_batch(Process &process, const std::vector<Pending *> &batch) {
+    std::vector<bool> answered(batch.size(), false);
+    if (process.pid < 0 && !spawn(process)) {
+        fail_unanswered(batch, answered, "unable to start generator process");
+        return;
+    }
+
+    std::string request = "BATCH " + std::to_string(batch.size()) + "\n";
+    for (const auto *item : batch) {
+        request += item->request.spec_path.string() + "\t" + item->request.output_dir.string();
+        for (std::size_t i = 0; i < item->request.operation_ids.size(); ++i) {
+            request += (i == 0 ? "\t" : ",") + item->request.operation_ids[i];
+        }
+        request += "\n";
+    }
+    for (std::size_t written = 0; written < request.size();) {
+        auto n = ::write(process.to_child, request.data() + written, request.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            log_error("Generator process " + std::to_string(process.pid) + " stopped accepting requests");
+            terminate(process);
+            fail_unanswered(batch, answered, "generator process exited");
+            return;
+        }
+        written += static_cast<std::size_t>(n);
+    }
+
+    std::size_t remaining = batch.size();
+    auto deadline = std::chrono::steady_clock::now() + options_.task_timeout;
+    while (remaining > 0) {
+        std::string line;
+        bool timed_out = false;
+        if (!read_line(process, deadline, line, timed_out)) {
+            log_error("Generator process " + std::to_string(process.pid) +
+                      (timed_out ? " timed out" : " exited mid-batch") + "; restarting it");
+            terminate(process);
+            if (timed_out) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++stats_.timeouts;
+            }
+            fail_unanswered(batch, answered, timed_out ? "generator timed out" : "generator process exited");
+            return;
+        }
+
+        // Parse "<kind> <index>[ <text>]".
+        auto kind_end = line.find(' ');
+        auto kind = line.substr(0, kind_end);
+        std::size_t index = batch.size();
+        std::string text;
+        if (kind_end != std::string::npos) {
+            auto index_end = line.find(' ', kind_end + 1);
+            try {
+                index = std::stoul(line.substr(kind_end + 1, index_end == std::string::npos ? std::string::npos
+                                                                                              : index_end - kind_end - 1));
+            } catch (const std::exception &) {
+            }
+            if (index_end != std::string::npos) {
+                text = line.substr(index_end + 1);
+            }
+        }
+        if (index >= batch.size() || answered[index] || (kind != "LOG" && kind != "OK" && kind != "ERR")) {
+            log_error("Generator process " + std::to_string(process.pid) + " sent an invalid line: " + line);
+            terminate(process);
+            fail_unanswered(batch, answered, "generator protocol error");
+            return;
+        }
+
+        auto &result = batch[index]->result;
+        if (kind == "LOG") {
+            result.output += text;
+            result.output += '\n';
+            continue;
+        }
+        result.ok = kind == "OK";
+        result.message = std::move(text);
+        answered[index] = true;
+        --remaining;
+        deadline = std::chrono::steady_clock::now() + options_.task_timeout;
+    }
+}
+
+// Start the generator with pipes on its stdin and stdout. Input: an empty
+// process slot. Output: true when the child was forked; a command that fails
+// to exec shows up as EOF on the first batch.
+bool GeneratorProcessPool::spawn(Process &process) {
+    if (options_.command.empty()) {
+        return false;
+    }
+    int to_child[2];
+    int from_child[2];
+    if (::pipe2(to_child, O_CLOEXEC) != 0) {
+        return false;
+    }
+    if (::pipe2(from_child, O_CLOEXEC) != 0) {
+        ::close(to_child[0]);
+        ::close(to_child[1]);
+        return false;
+    }
+
+    // Build argv before forking: only async-signal-safe calls may follow.
+    std::vector<char *> argv;
+    for (auto &arg : options_.command) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    auto pid = ::fork();
+    if (pid == 0) {
+        ::dup2(to_child[0], STDIN_FILENO);
+        ::dup2(from_child[1], STDOUT_FILENO);
+        ::execvp(argv[0], argv.data());
+        ::_exit(127);
+    }
+    ::close(to_child[0]);
+    ::close(from_child[1]);
+    if (pid < 0) {
+        ::close(to_child[1]);
+        ::close(from_child[0]);
+        return false;
+    }
+
+    process.pid = pid;
+    process.to_child = to_child[1];
+    process.from_child = from_child[0];
+    process.buffer.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.processes_spawned;
+    }
+    log_info("Started generator process " + std::to_string(pid) + ": " + options_.command.front());
+    return true;
+}
+
+// Stop a process and reap it. Closing stdin lets a healthy generator exit on
+// its own, so it is given until grace_deadline to do so; SIGKILL covers one
+// that is stuck or still running then. The default deadline kills at once,
+// as for a process that already timed out or broke the protocol.
+void GeneratorProcessPool::terminate(Process &process, std::chrono::steady_clock::time_point grace_deadline) {
+    if (process.pid < 0) {
+        return;
+    }
+    if (process.to_child >= 0) {
+        ::close(process.to_child);
+    }
+    ::close(process.from_child);
+    int status = 0;
+    pid_t reaped = 0;
+    while (std::chrono::steady_clock::now() < grace_deadline &&
+           ((reaped = ::waitpid(process.pid, &status, WNOHANG)) == 0 || (reaped < 0 && errno == EINTR))) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    if (reaped <= 0) {
+        ::kill(process.pid, SIGKILL);
+        while (::waitpid(process.pid, &status, 0) < 0 && errno == EINTR) {
+        }
+    }
+    // busy stays as it is: the slot is still reserved by its caller, and only
+    // generate() releases it, under mutex_.
+    process.pid = -1;
+    process.to_child = -1;
+    process.from_child = -1;
+    process.buffer.clear();
+}
+
+bool GeneratorProcessPool::read_line(Process &process, std::chrono::steady_clock::time_point deadline,
+                                     std::string &line, bool &timed_out) {
+    timed_out = false;
+    while (true) {
+        auto newline = process.buffer.find('\n');
+        if (newline != std::string::npos) {
+            line = process.buffer.substr(0, newline);
+            process.buffer.erase(0, newline + 1);
+            return true;
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) {
+            timed_out = true;
+            return false;
+        }
+        pollfd fd{process.from_child, POLLIN, 0};
+        auto ready = ::poll(&fd, 1, static_cast<int>(left.count()));
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            timed_out = ready == 0;
+            return false;
+        }
+        char chunk[4096];
+        auto n = ::read(process.from_child, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        process.buffer.append(chunk, static_cast<std::size_t>(n));
+    }
+}
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "generator_backend.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Keeps long-lived generator processes warm and feeds them specs over pipes,
+// so the generator's startup cost (a JVM for openapi-generator) is paid once
+// per process rather than once per spec.
+//
+// Protocol, one line per record, fields separated by tabs. The pool writes
+//   BATCH <n>
+//   <spec_path>\t<output_dir>[\t<id>,<id>...]   (n lines)
+// to the process's stdin; the optional third field lists the only operations
+// to regenerate. The process answers on stdout with any number of
+//   LOG <i> <text>                     (captured into result i's output)
+// and exactly one of
+//   OK <i>
+//   ERR <i> <message>
+// per request, in any order. A process that misses a per-task deadline,
+// exits or breaks the protocol is killed and replaced on next use; requests
+// still pending in its batch fail. When the pool is destroyed it closes
+// every process's stdin, which should make the process exit; any still
+// running two seconds later is killed.
+//
+// When every process is busy, callers wait and the next free process takes
+// up to max_batch waiting requests in one invocation. POSIX only; elsewhere
+// every request fails. The pool ignores SIGPIPE process-wide so a dead child
+// surfaces as a write error.
+class GeneratorProcessPool : public GeneratorBackend {
+  public:
+    struct Options {
+        // argv of the generator process; argv[0] is looked up on PATH.
+        std::vector<std::string> command;
+        std::size_t processes{1};
+        std::size_t max_batch{4};
+        // Time allowed for each result, counted from the previous one.
+        std::chrono::milliseconds task_timeout{std::chrono::seconds(120)};
+    };
+
+    struct Stats {
+        std::size_t processes_spawned{0};
+        std::size_t batches{0};
+        std::size_t requests{0};
+        std::size_t timeouts{0};
+    };
+
+    explicit GeneratorProcessPool(Options options);
+    ~GeneratorProcessPool() override;
+    GeneratorProcessPool(const GeneratorProcessPool &) = delete;
+    GeneratorProcessPool &operator=(const GeneratorProcessPool &) = delete;
+
+    GeneratorResult generate(const GeneratorRequest &request) override;
+
+    Stats stats() const;
+
+  private:
+    struct Process {
+        int pid{-1};
+        int to_child{-1};
+        int from_child{-1};
+        // Bytes read from the child past the last complete line.
+        std::string buffer;
+        bool busy{false};
+    };
+
+    struct Pending {
+        GeneratorRequest request;
+        GeneratorResult result;
+        bool done{false};
+    };
+
+    // Run one batch on process, filling every pending result. Called
+    // without mutex_; the process is reserved through its busy flag.
+    void run_batch(Process &process, const std::vector<Pending *> &batch);
+    bool spawn(Process &process);
+    // Close the process's pipes, give it until grace_deadline to exit, then
+    // kill and reap it. The slot's busy flag is left alone.
+    void terminate(Process &process, std::chrono::steady_clock::time_point grace_deadline = {});
+    // Read one line from the child, waiting until deadline. Returns false on
+    // timeout (timed_out set), EOF or error.
+    bool read_line(Process &process, std::chrono::steady_clock::time_point deadline, std::string &line,
+                   bool &timed_out);
+
+    Options options_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Process> processes_;
+    std::deque<Pending *> waiting_;
+    Stats stats_;
+};
@@ -0,0 +1,24 @@
+#include "hash_utils.h"
+
+// Hash a byte range. Inputs: data view and running seed. Output: the updated
+// 64-bit FNV-1a state. Does not throw.
+std::uint64_t fnv1a_64(std::string_view data, std::uint64_t seed) {
+    constexpr std::uint64_t prime = 1099511628211ULL;
+    std::uint64_t hash = seed;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= prime;
+    }
+    return hash;
+}
+
+// Format a hash as 16 hexadecimal digits. Only allocation failures may throw.
+std::string to_hex(std::uint64_t value) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        out[static_cast<std::size_t>(i)] = digits[value & 0xF];
+        value >>= 4;
+    }
+    return out;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// 64-bit FNV-1a offset basis; pass a previous result as seed to hash data
+// incrementally across several calls.
+inline constexpr std::uint64_t kFnv1aSeed = 14695981039346656037ULL;
+
+// Hash a byte range with 64-bit FNV-1a. Fast and dependency free; suitable
+// for checksums and change detection, not for security.
+std::uint64_t fnv1a_64(std::string_view data, std::uint64_t seed = kFnv1aSeed);
+
+// Render a hash as a fixed-width lowercase hexadecimal string.
+std::string to_hex(std::uint64_t value);
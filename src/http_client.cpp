@@ -0,0 +1,863 @@
+#include "http_client.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <system_error>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+using Clock = std::chrono::steady_clock;
+using Error = HttpResult::Error;
+
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+           });
+}
+
+// True when value, a comma-separated header list, contains token.
+bool has_token(std::string_view value, std::string_view token) {
+    while (!value.empty()) {
+        auto comma = value.find(',');
+        auto item = value.substr(0, comma);
+        while (!item.empty() && std::isspace(static_cast<unsigned char>(item.front()))) {
+            item.remove_prefix(1);
+        }
+        while (!item.empty() && std::isspace(static_cast<unsigned char>(item.back()))) {
+            item.remove_suffix(1);
+        }
+        if (iequals(item, token)) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// Methods a client may repeat without changing the outcome (RFC 9110 9.2.2).
+bool idempotent(std::string_view method) {
+    return method == "GET" || method == "HEAD" || method == "PUT" || method == "DELETE" || method == "OPTIONS" ||
+           method == "TRACE";
+}
+
+std::string pool_name(const std::string &host, std::uint16_t port) { return host + ":" + std::to_string(port); }
+
+HttpResult failure(Error error, std::string message) {
+    HttpResult result;
+    result.error = error;
+    result.message = std::move(message);
+    return result;
+}
+
+#ifdef _WIN32
+void close_socket(int) {}
+#else
+constexpr std::size_t kReadChunk = 16 * 1024;
+constexpr std::size_t kMaxHeaderBytes = 64 * 1024;
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+void close_socket(int fd) { ::close(fd); }
+
+// Wait until fd reports events or deadline passes. Returns poll's result: 0
+// on timeout, negative on error.
+int wait_fd(int fd, short events, Clock::time_point deadline) {
+    while (true) {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (remaining <= 0) {
+            return 0;
+        }
+        pollfd entry{fd, events, 0};
+        int ready = ::poll(&entry, 1, static_cast<int>(std::min<long long>(remaining, INT_MAX)));
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        return ready;
+    }
+}
+
+// A name lookup shared between the caller and the thread running it. The
+// last one to let go of an answer nobody waits for frees it.
+struct Lookup {
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done{false};
+    bool abandoned{false};
+    int rc{0};
+    addrinfo *addresses{nullptr};
+};
+
+// Resolve host:port. getaddrinfo() has no timeout of its own, so a name that
+// is not a numeric address is looked up on a detached thread and waited for
+// only until deadline. Returns the addresses, or nullptr with result's error
+// set.
+addrinfo *resolve(const std::string &host, std::uint16_t port, Clock::time_point deadline, HttpResult &result) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICHOST;
+    auto service = std::to_string(port);
+    addrinfo *addresses = nullptr;
+    if (::getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) == 0) {
+        return addresses;
+    }
+    hints.ai_flags = 0;
+    auto lookup = std::make_shared<Lookup>();
+    try {
+        std::thread([lookup, host, service, hints]() {
+            addrinfo *found = nullptr;
+            int rc = ::getaddrinfo(host.c_str(), service.c_str(), &hints, &found);
+            std::lock_guard<std::mutex> lock(lookup->mutex);
+            if (lookup->abandoned) {
+                if (rc == 0) {
+                    ::freeaddrinfo(found);
+                }
+                return;
+            }
+            lookup->rc = rc;
+            lookup->addresses = found;
+            lookup->done = true;
+            lookup->finished.notify_one();
+        }).detach();
+    } catch (const std::system_error &) {
+        // No thread to spare: resolve here, unbounded, rather than fail.
+        lookup->rc = ::getaddrinfo(host.c_str(), service.c_str(), &hints, &lookup->addresses);
+        lookup->done = true;
+    }
+    std::unique_lock<std::mutex> lock(lookup->mutex);
+    if (!lookup->finished.wait_until(lock, deadline, [&]() { return lookup->done; })) {
+        lookup->abandoned = true;
+        result = failure(Error::Timeout, "Timed out resolving " + host);
+        return nullptr;
+    }
+    if (lookup->rc != 0) {
+        result = failure(Error::Connect, "Cannot resolve " + host + ": " + ::gai_strerror(lookup->rc));
+        return nullptr;
+    }
+    return lookup->addresses;
+}
+
+// Connect to host:port, trying each resolved address until deadline. Returns
+// the non-blocking socket, or -1 with result's error set.
+int connect_to(const std::string &host, std::uint16_t port, Clock::time_point deadline, HttpResult &result) {
+    addrinfo *addresses = resolve(host, port, deadline, result);
+    if (!addresses) {
+        return -1;
+    }
+    int fd = -1;
+    Error error = Error::Connect;
+    std::string reason = "no address";
+    for (auto *address = addresses; address && fd < 0; address = address->ai_next) {
+        int socket_fd = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (socket_fd < 0) {
+            reason = std::strerror(errno);
+            continue;
+        }
+        ::fcntl(socket_fd, F_SETFD, FD_CLOEXEC);
+        ::fcntl(socket_fd, F_SETFL, ::fcntl(socket_fd, F_GETFL) | O_NONBLOCK);
+        if (::connect(socket_fd, address->ai_addr, address->ai_addrlen) < 0) {
+            if (errno != EINPROGRESS) {
+                reason = std::strerror(errno);
+                ::close(socket_fd);
+                continue;
+            }
+            int ready = wait_fd(socket_fd, POLLOUT, deadline);
+            int socket_error = 0;
+            socklen_t length = sizeof(socket_error);
+            if (ready == 0) {
+                error = Error::Timeout;
+                reason = "connect timed out";
+                ::close(socket_fd);
+                break;
+            }
+            if (ready < 0 || ::getsockopt(socket_fd, SOL_SOCKET, SO_ERROR, &socket_error, &length) < 0 ||
+                socket_error != 0) {
+                reason = std::strerror(ready < 0 ? errno : socket_error);
+                ::close(socket_fd);
+                continue;
+            }
+        }
+        int one = 1;
+        ::setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fd = socket_fd;
+    }
+    ::freeaddrinfo(addresses);
+    if (fd < 0) {
+        result = failure(error, "Cannot connect to " + pool_name(host, port) + ": " + reason);
+    }
+    return fd;
+}
+
+bool write_all(int fd, std::string_view data, Clock::time_point deadline, HttpResult &result) {
+    while (!data.empty()) {
+        auto n = ::send(fd, data.data(), data.size(), kSendFlags);
+        if (n > 0) {
+            data.remove_prefix(static_cast<std::size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (int ready = wait_fd(fd, POLLOUT, deadline); ready <= 0) {
+                result = ready == 0 ? failure(Error::Timeout, "Timed out sending request")
+                                    : failure(Error::Protocol, std::string("send: ") + std::strerror(errno));
+                return false;
+            }
+            continue;
+        }
+        result = failure(Error::Protocol, std::string("send: ") + std::strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void append_request(std::string &out, const HttpRequest &request) {
+    out += request.method;
+    out += ' ';
+    out += request.target.empty() ? "/" : request.target;
+    out += " HTTP/1.1\r\nHost: ";
+    // IPv6 literals are bracketed in the Host header.
+    if (request.host.find(':') != std::string::npos) {
+        out += "[" + request.host + "]";
+    } else {
+        out += request.host;
+    }
+    if (request.port != 80) {
+        out += ":" + std::to_string(request.port);
+    }
+    out += "\r\n";
+    for (const auto &header : request.headers) {
+        out += header.first + ": " + header.second + "\r\n";
+    }
+    if (!request.body.empty() || request.method == "POST" || request.method == "PUT" || request.method == "PATCH") {
+        out += "Content-Length: " + std::to_string(request.body.size()) + "\r\n";
+    }
+    out += "\r\n";
+    out += request.body;
+}
+
+// Reads one response at a time from a connection's socket and buffer.
+class ResponseReader {
+  public:
+    ResponseReader(int fd, std::string &buffer, Clock::time_point deadline, std::size_t max_bytes)
+        : fd_(fd), buffer_(buffer), deadline_(deadline), max_bytes_(max_bytes) {}
+
+    // Read the response to a request with method. Returns false with result's
+    // error set on failure; keep_alive reports whether the connection may
+    // carry another request.
+    bool read(std::string_view method, HttpResult &result, bool &keep_alive) {
+        auto &response = result.response;
+        int minor = 1;
+        // Skip interim 1xx responses.
+        do {
+            std::size_t end;
+            while ((end = buffer_.find("\r\n\r\n")) == std::string::npos) {
+                if (buffer_.size() > kMaxHeaderBytes) {
+                    return fail(result, Error::Protocol, "Response headers too large");
+                }
+                if (!fill(result, "Connection closed before the response")) {
+                    return false;
+                }
+            }
+            if (!parse_head(std::string_view(buffer_).substr(0, end), response, minor)) {
+                return fail(result, Error::Protocol, "Malformed response head");
+            }
+            buffer_.erase(0, end + 4);
+        } while (response.status >= 100 && response.status < 200 && response.status != 101);
+
+        const auto *connection = response.header("Connection");
+        keep_alive = minor >= 1 ? !(connection && has_token(*connection, "close"))
+                                : connection && has_token(*connection, "keep-alive");
+        if (method == "HEAD" || response.status == 204 || response.status == 304) {
+            return true;
+        }
+        if (const auto *encoding = response.header("Transfer-Encoding"); encoding && has_token(*encoding, "chunked")) {
+            return read_chunked(result);
+        }
+        if (const auto *length = response.header("Content-Length")) {
+            std::size_t size = 0;
+            try {
+                size = static_cast<std::size_t>(std::stoull(*length));
+            } catch (const std::exception &) {
+                return fail(result, Error::Protocol, "Malformed Content-Length");
+            }
+            if (size > max_bytes_) {
+                return fail(result, Error::Protocol, "Response too large");
+            }
+            while (buffer_.size() < size) {
+                if (!fill(result, "Connection closed mid-body")) {
+                    return false;
+                }
+            }
+            response.body.assign(buffer_, 0, size);
+            buffer_.erase(0, size);
+            return true;
+        }
+        // Delimited by the end of the connection.
+        keep_alive = false;
+        while (true) {
+            if (buffer_.size() > max_bytes_) {
+                return fail(result, Error::Protocol, "Response too large");
+            }
+            auto status = receive();
+            if (status == Received::Eof) {
+                break;
+            }
+            if (status != Received::Data) {
+                return fail_receive(result, status);
+            }
+        }
+        response.body = std::move(buffer_);
+        buffer_.clear();
+        return true;
+    }
+
+    // True once any byte has been read from the socket.
+    bool received() const { return received_; }
+
+  private:
+    enum class Received { Data, Eof, Timeout, Failed };
+
+    Received receive() {
+        if (int ready = wait_fd(fd_, POLLIN, deadline_); ready <= 0) {
+            return ready == 0 ? Received::Timeout : Received::Failed;
+        }
+        char chunk[kReadChunk];
+        while (true) {
+            auto n = ::recv(fd_, chunk, sizeof(chunk), 0);
+            if (n > 0) {
+                buffer_.append(chunk, static_cast<std::size_t>(n));
+                received_ = true;
+                return Received::Data;
+            }
+            if (n == 0) {
+                return Received::Eof;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return receive();
+            }
+            return Received::Failed;
+        }
+    }
+
+    // Read more bytes; end of stream is an error described by eof_message.
+    bool fill(HttpResult &result, const char *eof_message) {
+        auto status = receive();
+        if (status == Received::Data) {
+            return true;
+        }
+        if (status == Received::Eof) {
+            return fail(result, Error::Protocol, eof_message);
+        }
+        return fail_receive(result, status);
+    }
+
+    bool fail_receive(HttpResult &result, Received status) {
+        if (status == Received::Timeout) {
+            return fail(result, Error::Timeout, "Timed out waiting for the response");
+        }
+        return fail(result, Error::Protocol, std::string("recv: ") + std::strerror(errno));
+    }
+
+    static bool fail(HttpResult &result, Error error, std::string message) {
+        result.error = error;
+        result.message = std::move(message);
+        return false;
+    }
+
+    // Parse the status line and headers (without the blank line).
+    static bool parse_head(std::string_view head, HttpResponse &response, int &minor) {
+        auto line_end = head.find("\r\n");
+        auto status_line = head.substr(0, line_end);
+        if (status_line.size() < 12 || status_line.compare(0, 7, "HTTP/1.") != 0 || status_line[8] != ' ' ||
+            !std::isdigit(static_cast<unsigned char>(status_line[7]))) {
+            return false;
+        }
+        minor = status_line[7] - '0';
+        response.status = 0;
+        for (std::size_t i = 9; i < 12; ++i) {
+            if (!std::isdigit(static_cast<unsigned char>(status_line[i]))) {
+                return false;
+            }
+            response.status = response.status * 10 + (status_line[i] - '0');
+        }
+        response.headers.clear();
+        while (line_end != std::string_view::npos) {
+            head.remove_prefix(line_end + 2);
+            line_end = head.find("\r\n");
+            auto line = head.substr(0, line_end);
+            auto colon = line.find(':');
+            if (colon == std::string_view::npos || colon == 0) {
+                return false;
+            }
+            auto value = line.substr(colon + 1);
+            while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+                value.remove_prefix(1);
+            }
+            while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+                value.remove_suffix(1);
+            }
+            response.headers.emplace_back(std::string(line.substr(0, colon)), std::string(value));
+        }
+        return true;
+    }
+
+    // Take one CRLF-terminated line off the buffer into line.
+    bool take_line(HttpResult &result, std::string &line) {
+        std::size_t end;
+        while ((end = buffer_.find("\r\n")) == std::string::npos) {
+            if (buffer_.size() > kMaxHeaderBytes) {
+                return fail(result, Error::Protocol, "Chunk header too large");
+            }
+            if (!fill(result, "Connection closed mid-body")) {
+                return false;
+            }
+        }
+        line.assign(buffer_, 0, end);
+        buffer_.erase(0, end + 2);
+        return true;
+    }
+
+    bool read_chunked(HttpResult &result) {
+        auto &body = result.response.body;
+        std::string line;
+        while (true) {
+            if (!take_line(result, line)) {
+                return false;
+            }
+            std::size_t size = 0;
+            try {
+                size = static_cast<std::size_t>(std::stoull(line.substr(0, line.find(';')), nullptr, 16));
+            } catch (const std::exception &) {
+                return fail(result, Error::Protocol, "Malformed chunk size");
+            }
+            if (size == 0) {
+                break;
+            }
+            if (body.size() + size > max_bytes_) {
+                return fail(result, Error::Protocol, "Response too large");
+            }
+            while (buffer_.size() < size + 2) {
+                if (!fill(result, "Connection closed mid-body")) {
+                    return false;
+                }
+            }
+            body.append(buffer_, 0, size);
+            buffer_.erase(0, size + 2);
+        }
+        // Trailer fields, if any, end with an empty line.
+        do {
+            if (!take_line(result, line)) {
+                return false;
+            }
+        } while (!line.empty());
+        return true;
+    }
+
+    int fd_;
+    std::string &buffer_;
+    Clock::time_point deadline_;
+    std::size_t max_bytes_;
+    bool received_{false};
+};
+#endif
+} // namespace
+
+// Parse an http:// URL. Input: the URL text. The host keeps its case; a
+// bracketed IPv6 literal is returned without brackets. Any fragment is
+// dropped from the target.
+std::optional<HttpUrl> parse_http_url(std::string_view url) {
+    constexpr std::string_view scheme = "http://";
+    if (url.size() < scheme.size() || !iequals(url.substr(0, scheme.size()), scheme)) {
+        return std::nullopt;
+    }
+    url.remove_prefix(scheme.size());
+    url = url.substr(0, url.find('#'));
+    auto authority_end = url.find_first_of("/?");
+    auto authority = url.substr(0, authority_end);
+    if (auto at = authority.rfind('@'); at != std::string_view::npos) {
+        authority.remove_prefix(at + 1);
+    }
+    HttpUrl parsed;
+    std::string_view port;
+    if (!authority.empty() && authority.front() == '[') {
+        auto close = authority.find(']');
+        if (close == std::string_view::npos) {
+            return std::nullopt;
+        }
+        parsed.host = std::string(authority.substr(1, close - 1));
+        auto rest = authority.substr(close + 1);
+        if (!rest.empty()) {
+            if (rest.front() != ':') {
+                return std::nullopt;
+            }
+            port = rest.substr(1);
+        }
+    } else {
+        auto colon = authority.rfind(':');
+        parsed.host = std::string(authority.substr(0, colon));
+        if (colon != std::string_view::npos) {
+            port = authority.substr(colon + 1);
+        }
+    }
+    if (parsed.host.empty()) {
+        return std::nullopt;
+    }
+    if (!port.empty()) {
+        unsigned long value = 0;
+        for (char c : port) {
+            if (!std::isdigit(static_cast<unsigned char>(c)) || (value = value * 10 + (c - '0')) > 65535) {
+                return std::nullopt;
+            }
+        }
+        if (value == 0) {
+            return std::nullopt;
+        }
+        parsed.port = static_cast<std::uint16_t>(value);
+    }
+    parsed.target = authority_end == std::string_view::npos ? "/" : std::string(url.substr(authority_end));
+    if (parsed.target.front() == '?') {
+        parsed.target.insert(0, "/");
+    }
+    return parsed;
+}
+
+const std::string *HttpResponse::header(std::string_view name) const {
+    for (const auto &header : headers) {
+        if (iequals(header.first, name)) {
+            return &header.second;
+        }
+    }
+    return nullptr;
+}
+
+HttpClient::HttpClient(Options options, std::shared_ptr<MetricsRegistry> metrics)
+    : options_(options), metrics_(std::move(metrics)) {
+    options_.max_connections_per_host = std::max<std::size_t>(1, options_.max_connections_per_host);
+    options_.io_threads = std::max<std::size_t>(1, options_.io_threads);
+    options_.io_threads_per_host = std::clamp<std::size_t>(options_.io_threads_per_host, 1, options_.io_threads);
+}
+
+HttpClient::~HttpClient() {
+    std::unique_ptr<WorkStealingExecutor> io;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        io = std::move(io_);
+    }
+    // Joining the I/O threads runs the calls still queued on them.
+    io.reset();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &entry : pools_) {
+        auto &pool = *entry.second;
+        for (auto &connection : pool.idle) {
+            close_socket(connection.fd);
+        }
+        publish(-static_cast<long long>(pool.idle.size()), -static_cast<long long>(pool.idle.size()));
+        pool.open -= pool.idle.size();
+        pool.idle.clear();
+    }
+}
+
+// Send one request. Input: the request. Output: its response, or the
+// transport failure. A stale keep-alive connection costs one retry for
+// idempotent methods; nothing is retried after a timeout.
+HttpResult HttpClient::send(const HttpRequest &request) {
+    auto &pool = pool_for(pool_name(request.host, request.port));
+    for (int attempt = 0;; ++attempt) {
+        Connection connection;
+        HttpResult result;
+        if (!checkout(request, pool, connection, result)) {
+            record(result);
+            return result;
+        }
+        std::vector<HttpResult> results(1);
+        bool keep_alive = false;
+        bool received = false;
+        bool reused = connection.reused;
+        auto done = exchange(connection, {&request}, results, keep_alive, received);
+        checkin(pool, std::move(connection), done == 1 && keep_alive);
+        if (done == 0 && reused && !received && attempt == 0 && results[0].error != Error::Timeout &&
+            idempotent(request.method)) {
+            continue;
+        }
+        record(results[0]);
+        return std::move(results[0]);
+    }
+}
+
+// Queue an asynchronous send. Inputs: the request and its callback. A host
+// already holding its share of I/O threads queues the call on its pool, so
+// the threads stay free for other hosts.
+void HttpClient::send_async(HttpRequest request, std::function<void(HttpResult)> done) {
+    auto &pool = pool_for(pool_name(request.host, request.port));
+    WorkStealingExecutor *io;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!io_) {
+            io_ = std::make_unique<WorkStealingExecutor>(options_.io_threads);
+        }
+        io = io_.get();
+        if (pool.async_running >= options_.io_threads_per_host) {
+            pool.async_waiting.emplace_back(std::move(request), std::move(done));
+            return;
+        }
+        ++pool.async_running;
+    }
+    run_async(*io, pool, std::move(request), std::move(done));
+}
+
+// Post one call. Inputs: the I/O executor (held directly, since the
+// destructor drains it after clearing io_), the host's pool and the call.
+// The pool's next waiting call is handed the slot before done runs.
+void HttpClient::run_async(WorkStealingExecutor &io, Pool &pool, HttpRequest request,
+                           std::function<void(HttpResult)> done) {
+    io.post([this, &io, &pool, request = std::move(request), done = std::move(done)]() {
+        auto result = send(request);
+        std::optional<std::pair<HttpRequest, std::function<void(HttpResult)>>> next;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (pool.async_waiting.empty()) {
+                --pool.async_running;
+            } else {
+                next = std::move(pool.async_waiting.front());
+                pool.async_waiting.pop_front();
+            }
+        }
+        if (next) {
+            run_async(io, pool, std::move(next->first), std::move(next->second));
+        }
+        done(std::move(result));
+    });
+}
+
+// Send a batch. Input: the requests. When there are several, all GET or HEAD
+// for the same host, they are written back to back on one connection and the
+// responses read in order; requests left unanswered when the connection
+// fails or closes are sent again one by one, unless it timed out.
+std::vector<HttpResult> HttpClient::send_batch(const std::vector<HttpRequest> &requests) {
+    std::vector<HttpResult> results;
+    bool pipeline = requests.size() > 1 && std::all_of(requests.begin(), requests.end(), [&](const HttpRequest &r) {
+                        return (r.method == "GET" || r.method == "HEAD") && r.host == requests.front().host &&
+                               r.port == requests.front().port;
+                    });
+    if (!pipeline) {
+        for (const auto &request : requests) {
+            results.push_back(send(request));
+        }
+        return results;
+    }
+
+    auto &pool = pool_for(pool_name(requests.front().host, requests.front().port));
+    Connection connection;
+    HttpResult refused;
+    if (!checkout(requests.front(), pool, connection, refused)) {
+        results.assign(requests.size(), refused);
+        for (const auto &result : results) {
+            record(result);
+        }
+        return results;
+    }
+    std::vector<const HttpRequest *> pending;
+    for (const auto &request : requests) {
+        pending.push_back(&request);
+    }
+    results.resize(requests.size());
+    bool keep_alive = false;
+    bool received = false;
+    auto done = exchange(connection, pending, results, keep_alive, received);
+    checkin(pool, std::move(connection), done == requests.size() && keep_alive);
+    for (std::size_t i = 0; i < done; ++i) {
+        record(results[i]);
+    }
+    bool timed_out = done < requests.size() && results[done].error == Error::Timeout;
+    for (std::size_t i = done; i < requests.size(); ++i) {
+        if (timed_out) {
+            results[i] = results[done];
+            record(results[i]);
+        } else {
+            results[i] = send(requests[i]);
+        }
+    }
+    return results;
+}
+
+std::vector<HttpClient::PoolStats> HttpClient::pool_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<PoolStats> stats;
+    for (const auto &entry : pools_) {
+        stats.push_back({entry.first, entry.second->open, entry.second->idle.size()});
+    }
+    return stats;
+}
+
+HttpClient::Pool &HttpClient::pool_for(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &pool = pools_[name];
+    if (!pool) {
+        pool = std::make_unique<Pool>();
+    }
+    return *pool;
+}
+
+void HttpClient::record(const HttpResult &result) {
+    if (!metrics_) {
+        return;
+    }
+    metrics_->record_downstream_request();
+    if (!result.ok()) {
+        metrics_->record_downstream_failure();
+        if (result.error == Error::Timeout) {
+            metrics_->record_downstream_timeout();
+        }
+    }
+}
+
+void HttpClient::publish(long long open_delta, long long idle_delta) {
+    if (metrics_) {
+        metrics_->adjust_downstream_connections(open_delta, idle_delta);
+    }
+}
+
+#ifdef _WIN32
+bool HttpClient::checkout(const HttpRequest &request, Pool &, Connection &, HttpResult &result) {
+    result = failure(Error::Connect,
+                     "Cannot connect to " + pool_name(request.host, request.port) + ": HTTP client requires POSIX sockets");
+    return false;
+}
+
+void HttpClient::checkin(Pool &, Connection, bool) {}
+
+std::size_t HttpClient::exchange(Connection &, const std::vector<const HttpRequest *> &, std::vector<HttpResult> &,
+                                 bool &keep_alive, bool &received) {
+    keep_alive = false;
+    received = false;
+    return 0;
+}
+#else
+// Check a connection out of pool. Inputs: the request (for its host), the
+// pool. Idle connections past idle_timeout, or readable while idle (closed
+// by the server, or sending unsolicited data), are closed on the way.
+// Connecting happens outside the lock with the slot already counted.
+bool HttpClient::checkout(const HttpRequest &request, Pool &pool, Connection &connection, HttpResult &result) {
+    auto deadline = Clock::now() + options_.connect_timeout;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            while (!pool.idle.empty()) {
+                auto candidate = std::move(pool.idle.back());
+                pool.idle.pop_back();
+                pollfd entry{candidate.fd, POLLIN, 0};
+                if (Clock::now() - candidate.idle_since > options_.idle_timeout || ::poll(&entry, 1, 0) != 0) {
+                    ::close(candidate.fd);
+                    --pool.open;
+                    publish(-1, -1);
+                    continue;
+                }
+                publish(0, -1);
+                if (metrics_) {
+                    metrics_->record_downstream_connection_reused();
+                }
+                candidate.reused = true;
+                connection = std::move(candidate);
+                return true;
+            }
+            if (pool.open < options_.max_connections_per_host) {
+                ++pool.open;
+                break;
+            }
+            if (pool.available.wait_until(lock, deadline) == std::cv_status::timeout && pool.idle.empty() &&
+                pool.open >= options_.max_connections_per_host) {
+                result = failure(Error::Timeout, "No free connection to " + pool_name(request.host, request.port));
+                return false;
+            }
+        }
+    }
+    int fd = connect_to(request.host, request.port, deadline, result);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd < 0) {
+        --pool.open;
+        pool.available.notify_one();
+        return false;
+    }
+    publish(1, 0);
+    if (metrics_) {
+        metrics_->record_downstream_connection_opened();
+    }
+    connection = Connection{};
+    connection.fd = fd;
+    return true;
+}
+
+// Return a connection to pool. Only a connection with nothing left over in
+// its buffer is kept: leftover bytes belong to no request.
+void HttpClient::checkin(Pool &pool, Connection connection, bool keep_alive) {
+    keep_alive = keep_alive && connection.buffer.empty();
+    if (!keep_alive) {
+        ::close(connection.fd);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (keep_alive) {
+        connection.idle_since = Clock::now();
+        pool.idle.push_back(std::move(connection));
+        publish(0, 1);
+    } else {
+        --pool.open;
+        publish(-1, 0);
+    }
+    pool.available.notify_one();
+}
+
+std::size_t HttpClient::exchange(Connection &connection, const std::vector<const HttpRequest *> &requests,
+                                 std::vector<HttpResult> &results, bool &keep_alive, bool &received) {
+    keep_alive = false;
+    received = false;
+    std::string out;
+    for (const auto *request : requests) {
+        append_request(out, *request);
+    }
+    auto deadline = Clock::now() + options_.read_timeout;
+    if (!write_all(connection.fd, out, deadline, results[0])) {
+        return 0;
+    }
+    deadline = Clock::now() + options_.read_timeout;
+    ResponseReader reader(connection.fd, connection.buffer, deadline, options_.max_response_bytes);
+    std::size_t done = 0;
+    while (done < requests.size()) {
+        bool more = false;
+        bool ok = reader.read(requests[done]->method, results[done], more);
+        received = received || reader.received();
+        if (!ok) {
+            return done;
+        }
+        ++done;
+        if (!more) {
+            return done;
+        }
+    }
+    keep_alive = true;
+    return done;
+}
+#endif
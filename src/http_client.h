@@ -0,0 +1,186 @@
+#pragma once
+
+#include "metrics.h"
+#include "work_stealing_executor.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Parts of an absolute http:// URL.
+struct HttpUrl {
+    std::string host;
+    std::uint16_t port{80};
+    // Path and query; "/" when the URL has neither.
+    std::string target;
+};
+
+// Parse an http:// URL. Returns nullopt for other schemes (https included),
+// a missing host or a bad port.
+std::optional<HttpUrl> parse_http_url(std::string_view url);
+
+struct HttpRequest {
+    std::string method{"GET"};
+    std::string host;
+    std::uint16_t port{80};
+    std::string target{"/"};
+    // Sent as given; Host and Content-Length are added by the client.
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+};
+
+struct HttpResponse {
+    int status{0};
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+
+    // Value of the first header called name (case-insensitive), or nullptr.
+    const std::string *header(std::string_view name) const;
+};
+
+// Outcome of one exchange. A response with any status is ok(); error tells
+// transport failures apart so callers can treat timeouts as overload.
+struct HttpResult {
+    enum class Error { None, Connect, Timeout, Protocol };
+    Error error{Error::None};
+    std::string message;
+    HttpResponse response;
+
+    bool ok() const { return error == Error::None; }
+};
+
+// HttpClient is an HTTP/1.1 client for downstream calls. Each
+// host:port has its own pool of keep-alive connections, capped at
+// max_connections_per_host; a caller that finds every connection busy waits
+// up to connect_timeout for one to come back. Idle connections are reused
+// newest first, and one found closed by the server is dropped before use.
+// Safe to call from many threads.
+//
+// send() blocks the calling thread. send_async() runs the same exchange on
+// the client's own I/O threads, so callers on a CPU pool never wait on the
+// network themselves. Each host:port may hold only io_threads_per_host of
+// those threads; its further calls wait in that host's own queue without
+// holding one, so a stalled downstream cannot starve the others.
+//
+// A request that fails on a reused connection before any response byte
+// arrives is retried once on a fresh one, but only for idempotent methods.
+// send_batch pipelines GET and HEAD requests for one host on a single
+// connection; other batches are sent one by one.
+//
+// Bodies may be framed by Content-Length, chunked encoding or connection
+// close. No TLS, proxies or redirects.
+class HttpClient {
+  public:
+    struct Options {
+        std::size_t max_connections_per_host{16};
+        // Limit on resolving the host, connecting and waiting for a free
+        // connection.
+        std::chrono::milliseconds connect_timeout{1000};
+        // Limit on waiting for a response, counted from when the request is
+        // sent.
+        std::chrono::milliseconds read_timeout{10000};
+        // Idle connections older than this are closed rather than reused.
+        std::chrono::milliseconds idle_timeout{30000};
+        std::size_t max_response_bytes{16 * 1024 * 1024};
+        // Threads that carry send_async() calls; at most this many wait on
+        // downstreams at once and later calls queue in order.
+        std::size_t io_threads{16};
+        // Most of those threads one host:port may hold at once; its later
+        // send_async() calls queue in order behind its own.
+        std::size_t io_threads_per_host{4};
+    };
+
+    explicit HttpClient(Options options, std::shared_ptr<MetricsRegistry> metrics = nullptr);
+
+    // Finish queued send_async() calls, then close every idle connection.
+    // Blocking calls still in flight must have returned.
+    ~HttpClient();
+
+    HttpClient(const HttpClient &) = delete;
+    HttpClient &operator=(const HttpClient &) = delete;
+
+    HttpResult send(const HttpRequest &request);
+
+    // Send request on an I/O thread and hand the result to done there. done
+    // must not throw.
+    void send_async(HttpRequest request, std::function<void(HttpResult)> done);
+
+    // Send requests and return their results in the same order.
+    std::vector<HttpResult> send_batch(const std::vector<HttpRequest> &requests);
+
+    struct PoolStats {
+        // "host:port".
+        std::string name;
+        std::size_t open{0};
+        std::size_t idle{0};
+    };
+
+    // Per-host connection counts, sorted by name.
+    std::vector<PoolStats> pool_stats() const;
+
+  private:
+    struct Connection {
+        int fd{-1};
+        // Bytes read past the last response, e.g. from a pipelined one.
+        std::string buffer;
+        std::chrono::steady_clock::time_point idle_since;
+        bool reused{false};
+    };
+
+    struct Pool {
+        // Connections checked out or idle.
+        std::size_t open{0};
+        std::vector<Connection> idle;
+        std::condition_variable available;
+        // send_async() calls holding an I/O thread, and those waiting for
+        // one of the host's share.
+        std::size_t async_running{0};
+        std::deque<std::pair<HttpRequest, std::function<void(HttpResult)>>> async_waiting;
+    };
+
+    // Take an idle connection for request's host or open a new one. Returns
+    // false with result's error set when neither is possible in time.
+    bool checkout(const HttpRequest &request, Pool &pool, Connection &connection, HttpResult &result);
+
+    // Return a connection for reuse, or close it when keep_alive is false.
+    void checkin(Pool &pool, Connection connection, bool keep_alive);
+
+    Pool &pool_for(const std::string &name);
+
+    // Run one send_async() call for pool on io, then start the pool's next
+    // waiting call in its place, if any.
+    void run_async(WorkStealingExecutor &io, Pool &pool, HttpRequest request, std::function<void(HttpResult)> done);
+
+    // Write requests on connection, then read one response per request into
+    // results, stopping at the first failure or a response that closes the
+    // connection. Returns the number of responses read and records the
+    // failure, if any, in the next result. keep_alive reports whether the
+    // connection may be reused afterwards; received whether any response
+    // byte arrived.
+    std::size_t exchange(Connection &connection, const std::vector<const HttpRequest *> &requests,
+                         std::vector<HttpResult> &results, bool &keep_alive, bool &received);
+
+    // Count a finished request in the metrics.
+    void record(const HttpResult &result);
+
+    // Count the change in open and idle connections.
+    void publish(long long open_delta, long long idle_delta);
+
+    Options options_;
+    std::shared_ptr<MetricsRegistry> metrics_;
+    mutable std::mutex mutex_;
+    // Pools by "host:port"; never erased, so references stay valid.
+    std::map<std::string, std::unique_ptr<Pool>> pools_;
+    // Started with the first send_async(); guarded by mutex_.
+    std::unique_ptr<WorkStealingExecutor> io_;
+};
@@ -0,0 +1,399 @@
+#include "json.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+constexpr int kMaxDepth = 64;
+
+class Parser {
+  public:
+    explicit Parser(std::string_view text) : text_(text) {}
+
+    bool parse(JsonValue &out, std::string &error) {
+        skip_space();
+        if (!value(out, 0)) {
+            error = error_.empty() ? "unexpected end of input" : error_;
+            return false;
+        }
+        skip_space();
+        if (pos_ != text_.size()) {
+            error = "trailing content at offset " + std::to_string(pos_);
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    bool fail(const std::string &message) {
+        if (error_.empty()) {
+            error_ = message + " at offset " + std::to_string(pos_);
+        }
+        return false;
+    }
+
+    void skip_space() {
+        while (pos_ < text_.size() &&
+               (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\r' || text_[pos_] == '\n')) {
+            ++pos_;
+        }
+    }
+
+    bool literal(std::string_view word) {
+        if (text_.substr(pos_, word.size()) != word) {
+            return fail("invalid literal");
+        }
+        pos_ += word.size();
+        return true;
+    }
+
+    bool value(JsonValue &out, int depth) {
+        if (depth > kMaxDepth) {
+            return fail("nesting too deep");
+        }
+        if (pos_ >= text_.size()) {
+            return fail("unexpected end of input");
+        }
+        switch (text_[pos_]) {
+        case '{':
+            return object(out, depth);
+        case '[':
+            return array(out, depth);
+        case '"':
+            out.type = JsonValue::Type::String;
+            return string(out.string);
+        case 't':
+            out = JsonValue::make_bool(true);
+            return literal("true");
+        case 'f':
+            out = JsonValue::make_bool(false);
+            return literal("false");
+        case 'n':
+            out = JsonValue{};
+            return literal("null");
+        default:
+            return number(out);
+        }
+    }
+
+    bool object(JsonValue &out, int depth) {
+        out = JsonValue::make_object();
+        ++pos_;
+        skip_space();
+        if (pos_ < text_.size() && text_[pos_] == '}') {
+            ++pos_;
+            return true;
+        }
+        while (true) {
+            skip_space();
+            std::string key;
+            if (pos_ >= text_.size() || text_[pos_] != '"' || !string(key)) {
+                return fail("expected member name");
+            }
+            skip_space();
+            if (pos_ >= text_.size() || text_[pos_] != ':') {
+                return fail("expected ':'");
+            }
+            ++pos_;
+            skip_space();
+            JsonValue member;
+            if (!value(member, depth + 1)) {
+                return false;
+            }
+            out.members.emplace_back(std::move(key), std::move(member));
+            skip_space();
+            if (pos_ < text_.size() && text_[pos_] == ',') {
+                ++pos_;
+                continue;
+            }
+            if (pos_ < text_.size() && text_[pos_] == '}') {
+                ++pos_;
+                return true;
+            }
+            return fail("expected ',' or '}'");
+        }
+    }
+
+    bool array(JsonValue &out, int depth) {
+        out = JsonValue::make_array();
+        ++pos_;
+        skip_space();
+        if (pos_ < text_.size() && text_[pos_] == ']') {
+            ++pos_;
+            return true;
+        }
+        while (true) {
+            skip_space();
+            JsonValue item;
+            if (!value(item, depth + 1)) {
+                return false;
+            }
+            out.items.push_back(std::move(item));
+            skip_space();
+            if (pos_ < text_.size() && text_[pos_] == ',') {
+                ++pos_;
+                continue;
+            }
+            if (pos_ < text_.size() && text_[pos_] == ']') {
+                ++pos_;
+                return true;
+            }
+            return fail("expected ',' or ']'");
+        }
+    }
+
+    bool hex4(unsigned &code) {
+        if (pos_ + 4 > text_.size()) {
+            return fail("truncated escape");
+        }
+        code = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = text_[pos_++];
+            code <<= 4;
+            if (c >= '0' && c <= '9') {
+                code |= static_cast<unsigned>(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                code |= static_cast<unsigned>(c - 'a' + 10);
+            } else if (c >= 'A' && c <= 'F') {
+                code |= static_cast<unsigned>(c - 'A' + 10);
+            } else {
+                return fail("invalid escape");
+            }
+        }
+        return true;
+    }
+
+    static void append_utf8(std::string &out, unsigned code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool string(std::string &out) {
+        ++pos_;
+        while (pos_ < text_.size()) {
+            char c = text_[pos_++];
+            if (c == '"') {
+                return true;
+            }
+            if (static_cast<unsigned char>(c) < 0x20) {
+                return fail("control character in string");
+            }
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos_ >= text_.size()) {
+                break;
+            }
+            switch (text_[pos_++]) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned code = 0;
+                if (!hex4(code)) {
+                    return false;
+                }
+                // A high surrogate followed by a low one encodes one code
+                // point above the BMP; a lone surrogate becomes U+FFFD.
+                if (code >= 0xD800 && code < 0xDC00 && text_.substr(pos_, 2) == "\\u") {
+                    pos_ += 2;
+                    unsigned low = 0;
+                    if (!hex4(low)) {
+                        return false;
+                    }
+                    code = low >= 0xDC00 && low < 0xE000 ? 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00) : 0xFFFD;
+                } else if (code >= 0xD800 && code < 0xE000) {
+                    code = 0xFFFD;
+                }
+                append_utf8(out, code);
+                break;
+            }
+            default:
+                return fail("invalid escape");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    bool number(JsonValue &out) {
+        auto start = pos_;
+        if (pos_ < text_.size() && text_[pos_] == '-') {
+            ++pos_;
+        }
+        auto digits = pos_;
+        while (pos_ < text_.size() && ((text_[pos_] >= '0' && text_[pos_] <= '9') || text_[pos_] == '.' ||
+                                       text_[pos_] == 'e' || text_[pos_] == 'E' || text_[pos_] == '+' ||
+                                       text_[pos_] == '-')) {
+            ++pos_;
+        }
+        if (pos_ == digits) {
+            return fail("unexpected character");
+        }
+        std::string token(text_.substr(start, pos_ - start));
+        char *end = nullptr;
+        double parsed = std::strtod(token.c_str(), &end);
+        if (end != token.c_str() + token.size() || !std::isfinite(parsed)) {
+            pos_ = start;
+            return fail("invalid number");
+        }
+        out = JsonValue::make_number(parsed);
+        return true;
+    }
+
+    std::string_view text_;
+    std::size_t pos_{0};
+    std::string error_;
+};
+
+void append_json(std::string &out, const JsonValue &value) {
+    switch (value.type) {
+    case JsonValue::Type::Null:
+        out += "null";
+        break;
+    case JsonValue::Type::Bool:
+        out += value.boolean ? "true" : "false";
+        break;
+    case JsonValue::Type::Number: {
+        char buffer[32];
+        if (std::floor(value.number) == value.number && std::fabs(value.number) < 9007199254740992.0) {
+            std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value.number));
+        } else {
+            std::snprintf(buffer, sizeof(buffer), "%.17g", value.number);
+        }
+        out += buffer;
+        break;
+    }
+    case JsonValue::Type::String:
+        append_json_string(out, value.string);
+        break;
+    case JsonValue::Type::Array:
+        out += '[';
+        for (std::size_t i = 0; i < value.items.size(); ++i) {
+            if (i > 0) {
+                out += ',';
+            }
+            append_json(out, value.items[i]);
+        }
+        out += ']';
+        break;
+    case JsonValue::Type::Object:
+        out += '{';
+        for (std::size_t i = 0; i < value.members.size(); ++i) {
+            if (i > 0) {
+                out += ',';
+            }
+            append_json_string(out, value.members[i].first);
+            out += ':';
+            append_json(out, value.members[i].second);
+        }
+        out += '}';
+        break;
+    }
+}
+} // namespace
+
+JsonValue JsonValue::make_bool(bool value) {
+    JsonValue out;
+    out.type = Type::Bool;
+    out.boolean = value;
+    return out;
+}
+
+JsonValue JsonValue::make_number(double value) {
+    JsonValue out;
+    out.type = Type::Number;
+    out.number = value;
+    return out;
+}
+
+JsonValue JsonValue::make_string(std::string value) {
+    JsonValue out;
+    out.type = Type::String;
+    out.string = std::move(value);
+    return out;
+}
+
+JsonValue JsonValue::make_array() {
+    JsonValue out;
+    out.type = Type::Array;
+    return out;
+}
+
+JsonValue JsonValue::make_object() {
+    JsonValue out;
+    out.type = Type::Object;
+    return out;
+}
+
+const JsonValue *JsonValue::find(std::string_view key) const {
+    if (type != Type::Object) {
+        return nullptr;
+    }
+    for (const auto &member : members) {
+        if (member.first == key) {
+            return &member.second;
+        }
+    }
+    return nullptr;
+}
+
+JsonValue &JsonValue::set(std::string key, JsonValue value) {
+    members.emplace_back(std::move(key), std::move(value));
+    return members.back().second;
+}
+
+bool parse_json(std::string_view text, JsonValue &out, std::string &error) {
+    out = JsonValue{};
+    return Parser(text).parse(out, error);
+}
+
+std::string to_json(const JsonValue &value) {
+    std::string out;
+    append_json(out, value);
+    return out;
+}
+
+void append_json_string(std::string &out, std::string_view value) {
+    static const char kHex[] = "0123456789abcdef";
+    out += '"';
+    for (char c : value) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out += "\\u00";
+                out += kHex[(c >> 4) & 0xF];
+                out += kHex[c & 0xF];
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A parsed JSON document node. Just enough of JSON for the JSON-RPC framing
+// of the MCP server: objects keep their members in document order and
+// numbers are held as doubles.
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type{Type::Null};
+    bool boolean{false};
+    double number{0};
+    std::string string;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    static JsonValue make_bool(bool value);
+    static JsonValue make_number(double value);
+    static JsonValue make_string(std::string value);
+    static JsonValue make_array();
+    static JsonValue make_object();
+
+    bool is_null() const { return type == Type::Null; }
+    bool is_string() const { return type == Type::String; }
+    bool is_object() const { return type == Type::Object; }
+    bool is_array() const { return type == Type::Array; }
+
+    // Member lookup on objects. Returns nullptr when this is not an object or
+    // the key is absent.
+    const JsonValue *find(std::string_view key) const;
+
+    // Append a member to an object and return it for further filling.
+    JsonValue &set(std::string key, JsonValue value);
+};
+
+// Parse text as a single JSON value. Returns false and sets error when the
+// text is malformed, nests deeper than 64 levels, or has trailing content.
+bool parse_json(std::string_view text, JsonValue &out, std::string &error);
+
+// Serialize compactly. Integral numbers are written without a fraction so
+// JSON-RPC ids round-trip unchanged.
+std::string to_json(const JsonValue &value);
+
+// Append value as a quoted, escaped JSON string.
+void append_json_string(std::string &out, std::string_view value);
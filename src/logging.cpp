@@ -26,7 +26,7 @@ spdlog::level::level_enum SetupLogging::parse_level(const std::string &level) {
     return spdlog::level::info;
 }
 
-void SetupLogging::configure_from_env() {
+void SetupLogging::configure_from_env(bool console_to_stderr) {
     auto log_file = env_or_default("GATEWAY_LOG_FILE", "logs/gateway.log");
     auto level_str = env_or_default("GATEWAY_LOG_LEVEL", "info");
     auto level = parse_level(level_str);
@@ -36,15 +36,20 @@ void SetupLogging::configure_from_env() {
         std::filesystem::create_directories(log_path.parent_path());
     }
 
-    init_logging(log_file, level);
+    init_logging(log_file, level, console_to_stderr);
 }
 
 // Configure spdlog with both console and file sinks. The default logger is
 // replaced so the inline helpers in logging.h forward correctly.
-void init_logging(const std::string &log_file, spdlog::level::level_enum level) {
+void init_logging(const std::string &log_file, spdlog::level::level_enum level, bool console_to_stderr) {
     std::vector<spdlog::sink_ptr> sinks;
 
-    auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+    spdlog::sink_ptr console_sink;
+    if (console_to_stderr) {
+        console_sink = std::make_shared<spdlog::sinks::stderr_color_sink_mt>();
+    } else {
+        console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+    }
     console_sink->set_pattern("%Y-%m-%d %H:%M:%S [%^%l%$] %v");
     sinks.push_back(console_sink);
 
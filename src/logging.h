@@ -8,16 +8,19 @@
 // Supported variables:
 // - GATEWAY_LOG_FILE: log file path (default: logs/gateway.log)
 // - GATEWAY_LOG_LEVEL: debug|info|warn|error (default: info)
+// console_to_stderr keeps stdout free for a protocol stream such as the MCP
+// stdio transport.
 class SetupLogging {
   public:
-    static void configure_from_env();
+    static void configure_from_env(bool console_to_stderr = false);
     static spdlog::level::level_enum parse_level(const std::string &level);
 };
 
 // Initialize spdlog with console and file sinks. The file will be appended.
 // Call once at startup before emitting logs.
 void init_logging(const std::string &log_file,
-                  spdlog::level::level_enum level = spdlog::level::info);
+                  spdlog::level::level_enum level = spdlog::level::info,
+                  bool console_to_stderr = false);
 
 inline void log_debug(const std::string &message) { spdlog::debug(message); }
 inline void log_info(const std::string &message) { spdlog::info(message); }
@@ -1,27 +1,45 @@
+#include "content_store.h"
 #include "filesystem_utils.h"
 #include "generation_queue.h"
+#include "generator_pool.h"
+#include "http_client.h"
 #include "logging.h"
 #include "mcp_gateway.h"
+#include "mcp_rpc.h"
+#include "mcp_server.h"
 #include "metrics.h"
 #include "registration_service.h"
+#include "route_index.h"
 #include "runtime_registry.h"
 
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <filesystem>
 #include <cstdlib>
 #include <exception>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
 #include <optional>
+#include <sstream>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace fs = std::filesystem;
 
 void print_usage() {
     std::cout << "cpp-mcp-gateway\n"
               << "Usage:\n"
-              << "  cpp-mcp-gateway register <version> <spec_path>\n"
+              << "  cpp-mcp-gateway register <version> <spec_path> [high|normal|bulk]\n"
+              << "  cpp-mcp-gateway register-bulk <version> <dir|manifest> [high|normal|bulk]\n"
               << "  cpp-mcp-gateway list\n"
+              << "  cpp-mcp-gateway index\n"
+              << "  cpp-mcp-gateway prune\n"
               << "  cpp-mcp-gateway execute <operation_id> <payload>\n"
+              << "  cpp-mcp-gateway serve [http|stdio|both]\n"
               << "  cpp-mcp-gateway metrics\n"
               << "  cpp-mcp-gateway health\n";
 }
@@ -37,6 +55,118 @@ std::optional<std::size_t> read_size_t_env(const char *name) {
     return std::nullopt;
 }
 
+// Apply CPP_MCP_GENERATION_VERSION_WEIGHTS, a comma-separated list of
+// version=weight pairs, to the generator. Malformed pairs are ignored.
+void apply_version_weights(GenerationQueue &generator) {
+    const char *value = std::getenv("CPP_MCP_GENERATION_VERSION_WEIGHTS");
+    if (!value) {
+        return;
+    }
+    std::stringstream pairs(value);
+    std::string pair;
+    while (std::getline(pairs, pair, ',')) {
+        auto eq = pair.find('=');
+        if (eq == std::string::npos || eq == 0) {
+            continue;
+        }
+        try {
+            generator.set_version_weight(pair.substr(0, eq), static_cast<std::size_t>(std::stoul(pair.substr(eq + 1))));
+        } catch (const std::exception &) {
+            log_error("Ignoring generation weight " + pair);
+        }
+    }
+}
+
+// Apply CPP_MCP_BULKHEAD_KEY (none, kit, version or host) and
+// CPP_MCP_BULKHEAD_LIMITS, a comma-separated list of bulkhead=limit pairs, to
+// the gateway. Unknown keys and malformed pairs are ignored.
+void apply_bulkheads(McpGateway &gateway) {
+    const char *key_name = std::getenv("CPP_MCP_BULKHEAD_KEY");
+    if (!key_name) {
+        return;
+    }
+    auto key = parse_bulkhead_key(key_name);
+    if (!key) {
+        log_error(std::string("Ignoring bulkhead key ") + key_name);
+        return;
+    }
+    std::map<std::string, std::size_t> limits;
+    if (const char *value = std::getenv("CPP_MCP_BULKHEAD_LIMITS")) {
+        std::stringstream pairs(value);
+        std::string pair;
+        while (std::getline(pairs, pair, ',')) {
+            auto eq = pair.rfind('=');
+            if (eq == std::string::npos || eq == 0) {
+                continue;
+            }
+            try {
+                limits[pair.substr(0, eq)] = static_cast<std::size_t>(std::stoul(pair.substr(eq + 1)));
+            } catch (const std::exception &) {
+                log_error("Ignoring bulkhead limit " + pair);
+            }
+        }
+    }
+    gateway.configure_bulkheads(*key, std::move(limits));
+}
+
+// Prometheus lines for each bulkhead's limit, in-flight count and queue
+// depth, labelled by bulkhead name.
+std::string bulkhead_metrics(const McpGateway &gateway) {
+    std::ostringstream out;
+    for (const auto &bulkhead : gateway.bulkhead_stats()) {
+        std::string label;
+        for (char c : bulkhead.name) {
+            if (c == '"' || c == '\\') {
+                label += '\\';
+            }
+            label += c;
+        }
+        out << "cpp_mcp_bulkhead_limit{bulkhead=\"" << label << "\"} " << bulkhead.stats.limit << "\n";
+        out << "cpp_mcp_bulkhead_in_flight{bulkhead=\"" << label << "\"} " << bulkhead.stats.in_flight << "\n";
+        out << "cpp_mcp_bulkhead_queued{bulkhead=\"" << label << "\"} " << bulkhead.stats.queued << "\n";
+    }
+    return out.str();
+}
+
+// Specs named by a register-bulk source: the .yaml, .yml and .json files of a
+// directory, in name order, or the paths listed one per line in a manifest
+// file (relative to the manifest; blank lines and # comments skipped).
+std::vector<fs::path> collect_bulk_sources(const fs::path &source) {
+    std::vector<fs::path> specs;
+    std::error_code ec;
+    if (fs::is_directory(source, ec)) {
+        for (fs::directory_iterator it(source, ec), end; !ec && it != end; it.increment(ec)) {
+            auto extension = it->path().extension();
+            if (it->is_regular_file(ec) && (extension == ".yaml" || extension == ".yml" || extension == ".json")) {
+                specs.push_back(it->path());
+            }
+        }
+        std::sort(specs.begin(), specs.end());
+        return specs;
+    }
+    std::ifstream manifest(source);
+    std::string line;
+    while (std::getline(manifest, line)) {
+        auto start = line.find_first_not_of(" \t");
+        auto end = line.find_last_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        fs::path spec = line.substr(start, end - start + 1);
+        specs.push_back(spec.is_absolute() ? spec : source.parent_path() / spec);
+    }
+    return specs;
+}
+
+// The running server, for the signal handler.
+McpServer *g_server = nullptr;
+
+void handle_stop_signal(int) {
+    if (g_server) {
+        g_server->request_stop();
+    }
+}
+
 int main(int argc, char **argv) {
     if (argc < 2) {
         print_usage();
@@ -45,20 +175,80 @@ int main(int argc, char **argv) {
 
     fs::path mappings_root{"mappings"};
     fs::path clientkit_root{"clientkit"};
-    SetupLogging::configure_from_env();
+    std::string command = argv[1];
+    std::string serve_mode = command == "serve" && argc > 2 ? argv[2] : "http";
+    // The stdio transport owns stdout, so console logs move to stderr.
+    SetupLogging::configure_from_env(command == "serve" && serve_mode != "http");
 
     auto metrics = std::make_shared<MetricsRegistry>();
     auto max_queue_size = read_size_t_env("CPP_MCP_MAX_QUEUE_SIZE").value_or(32);
     auto max_concurrent_ops = read_size_t_env("CPP_MCP_MAX_CONCURRENT_OPS").value_or(8);
+    auto generation_workers = read_size_t_env("CPP_MCP_GENERATION_WORKERS").value_or(2);
+    auto scan_workers = read_size_t_env("CPP_MCP_REGISTRY_SCAN_WORKERS").value_or(4);
 
-    auto generator = std::make_shared<GenerationQueue>(clientkit_root, 3, max_queue_size, metrics);
+    std::vector<fs::path> bulk_sources;
+    if (command == "register-bulk" && argc >= 4) {
+        bulk_sources = collect_bulk_sources(argv[3]);
+        // This process exists only to generate the batch, so the queue must
+        // hold all of it rather than push back.
+        max_queue_size = std::max(max_queue_size, bulk_sources.size());
+    }
+
+    auto generator = std::make_shared<GenerationQueue>(clientkit_root, 3, max_queue_size, metrics, generation_workers);
+    generator->enable_merged_index(read_size_t_env("CPP_MCP_MERGED_ROUTE_INDEX").value_or(0) != 0);
+    // Only commands that generate keep a journal: replaying it from a
+    // read-only command would run someone else's unfinished work.
+    bool generates = command == "serve" || command == "register" || command == "register-bulk";
+    if (generates && read_size_t_env("CPP_MCP_GENERATION_JOURNAL").value_or(1) != 0) {
+        generator->enable_journal(clientkit_root / kGenerationJournalFile);
+    }
+    apply_version_weights(*generator);
+    if (const char *command = std::getenv("CPP_MCP_GENERATOR_COMMAND")) {
+        // A pool of warm generator processes, one per worker by default.
+        GeneratorProcessPool::Options options;
+        std::istringstream words(command);
+        for (std::string word; words >> word;) {
+            options.command.push_back(word);
+        }
+        options.processes = read_size_t_env("CPP_MCP_GENERATOR_PROCESSES").value_or(generation_workers);
+        options.max_batch = read_size_t_env("CPP_MCP_GENERATOR_BATCH").value_or(options.max_batch);
+        options.task_timeout = std::chrono::milliseconds(
+            read_size_t_env("CPP_MCP_GENERATOR_TIMEOUT_MS").value_or(options.task_timeout.count()));
+        generator->set_backend(std::make_shared<GeneratorProcessPool>(std::move(options)));
+    }
     generator->start();
 
     RegistrationService registration(mappings_root, generator, metrics);
     RuntimeRegistry registry(clientkit_root, metrics);
+    registry.set_scan_workers(scan_workers);
     McpGateway gateway(std::move(registry), max_concurrent_ops, metrics);
-
-    std::string command = argv[1];
+    ConcurrencyLimiter::Options admission;
+    admission.initial_limit = max_concurrent_ops;
+    admission.adaptive = read_size_t_env("CPP_MCP_ADAPTIVE_CONCURRENCY").value_or(1) != 0;
+    admission.min_limit = read_size_t_env("CPP_MCP_CONCURRENCY_MIN").value_or(admission.min_limit);
+    admission.max_limit =
+        read_size_t_env("CPP_MCP_CONCURRENCY_MAX").value_or(std::max(admission.max_limit, max_concurrent_ops));
+    admission.max_queue = read_size_t_env("CPP_MCP_EXECUTE_QUEUE_SIZE").value_or(admission.max_queue);
+    gateway.configure_admission(
+        admission, std::chrono::milliseconds(read_size_t_env("CPP_MCP_EXECUTE_QUEUE_TIMEOUT_MS").value_or(1000)));
+    apply_bulkheads(gateway);
+    if (read_size_t_env("CPP_MCP_FORWARD").value_or(1) != 0) {
+        HttpClient::Options downstream;
+        downstream.max_connections_per_host =
+            read_size_t_env("CPP_MCP_DOWNSTREAM_POOL_SIZE").value_or(downstream.max_connections_per_host);
+        downstream.connect_timeout = std::chrono::milliseconds(
+            read_size_t_env("CPP_MCP_DOWNSTREAM_CONNECT_TIMEOUT_MS").value_or(downstream.connect_timeout.count()));
+        downstream.read_timeout = std::chrono::milliseconds(
+            read_size_t_env("CPP_MCP_DOWNSTREAM_READ_TIMEOUT_MS").value_or(downstream.read_timeout.count()));
+        downstream.idle_timeout = std::chrono::milliseconds(
+            read_size_t_env("CPP_MCP_DOWNSTREAM_IDLE_TIMEOUT_MS").value_or(downstream.idle_timeout.count()));
+        downstream.io_threads =
+            std::max<std::size_t>(1, read_size_t_env("CPP_MCP_DOWNSTREAM_IO_THREADS").value_or(downstream.io_threads));
+        downstream.io_threads_per_host =
+            read_size_t_env("CPP_MCP_DOWNSTREAM_IO_THREADS_PER_HOST").value_or(downstream.io_threads_per_host);
+        gateway.set_http_client(std::make_shared<HttpClient>(downstream, metrics));
+    }
+    gateway.follow(generator);
 
     if (command == "register") {
         if (argc < 4) {
@@ -68,7 +258,16 @@ int main(int argc, char **argv) {
 
         std::string version = argv[2];
         fs::path spec_path = argv[3];
-        auto result = registration.register_spec(version, spec_path);
+        auto priority = GenerationPriority::Normal;
+        if (argc > 4) {
+            auto parsed = parse_generation_priority(argv[4]);
+            if (!parsed) {
+                print_usage();
+                return 1;
+            }
+            priority = *parsed;
+        }
+        auto result = registration.register_spec(version, spec_path, priority);
         generator->wait_for_idle();
         generator->stop();
         if (!result.ok) {
@@ -79,12 +278,81 @@ int main(int argc, char **argv) {
         return 0;
     }
 
+    if (command == "register-bulk") {
+        if (argc < 4) {
+            print_usage();
+            return 1;
+        }
+        std::string version = argv[2];
+        auto priority = GenerationPriority::Normal;
+        if (argc > 4) {
+            auto parsed = parse_generation_priority(argv[4]);
+            if (!parsed) {
+                print_usage();
+                return 1;
+            }
+            priority = *parsed;
+        }
+        if (bulk_sources.empty()) {
+            generator->stop();
+            std::cerr << "No specs found in " << argv[3] << std::endl;
+            return 1;
+        }
+
+        auto workers = read_size_t_env("CPP_MCP_REGISTRATION_WORKERS")
+                           .value_or(std::max(1u, std::thread::hardware_concurrency()));
+        auto start = std::chrono::steady_clock::now();
+        auto results = registration.register_specs(version, bulk_sources, priority, workers);
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::size_t succeeded = 0;
+        std::uintmax_t bytes = 0;
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            if (results[i].ok) {
+                ++succeeded;
+                std::error_code ec;
+                auto size = fs::file_size(results[i].stored_path, ec);
+                bytes += ec ? 0 : size;
+                std::cout << "ok " << bulk_sources[i].string() << " -> " << results[i].stored_path.string()
+                          << (results[i].deduplicated ? " (deduplicated)" : "") << "\n";
+            } else {
+                std::cout << "failed " << bulk_sources[i].string() << ": " << results[i].message << "\n";
+            }
+        }
+        auto seconds = std::max(elapsed, 1e-9);
+        std::cout << "Registered " << succeeded << "/" << results.size() << " specs (" << bytes << " bytes) in "
+                  << static_cast<long long>(elapsed * 1000) << " ms: " << static_cast<long long>(results.size() / seconds)
+                  << " specs/s, " << std::fixed << std::setprecision(2) << bytes / seconds / (1024 * 1024) << " MiB/s"
+                  << std::endl;
+        generator->wait_for_idle();
+        generator->stop();
+        return succeeded == results.size() ? 0 : 1;
+    }
+
     if (command == "list") {
         generator->stop();
         std::cout << gateway.list_operations();
         return 0;
     }
 
+    if (command == "index") {
+        generator->stop();
+        if (!build_merged_route_index(clientkit_root)) {
+            std::cerr << "Failed to build merged route index under " << clientkit_root << std::endl;
+            return 1;
+        }
+        std::cout << "Merged route index written to " << (clientkit_root / kRouteIndexFile) << std::endl;
+        return 0;
+    }
+
+    if (command == "prune") {
+        // Drop spec blobs that re-registrations left unreferenced.
+        generator->stop();
+        auto removed = ContentStore(mappings_root).prune();
+        std::cout << "Pruned " << removed << " unreferenced spec blob(s)" << std::endl;
+        return 0;
+    }
+
     if (command == "execute") {
         if (argc < 4) {
             print_usage();
@@ -103,7 +371,23 @@ int main(int argc, char **argv) {
         std::cout << metrics->to_prometheus();
         std::cout << "cpp_mcp_generation_queue_depth " << stats.queue_depth << "\n";
         std::cout << "cpp_mcp_generation_active " << stats.active << "\n";
+        std::cout << "cpp_mcp_generation_retry_pending " << stats.retry_pending << "\n";
+        for (std::size_t i = 0; i < kGenerationPriorityCount; ++i) {
+            const auto &cls = stats.classes[i];
+            auto name = generation_priority_name(static_cast<GenerationPriority>(i));
+            std::cout << "cpp_mcp_generation_class_depth{class=\"" << name << "\"} " << cls.depth << "\n";
+            std::cout << "cpp_mcp_generation_class_oldest_wait_ms{class=\"" << name << "\"} " << cls.oldest_wait_ms << "\n";
+            std::cout << "cpp_mcp_generation_class_wait_ms_total{class=\"" << name << "\"} " << cls.wait_ms_total << "\n";
+            std::cout << "cpp_mcp_generation_class_dispatched_total{class=\"" << name << "\"} " << cls.dispatched << "\n";
+        }
         std::cout << "cpp_mcp_generation_queue_max " << stats.max_queue_size << "\n";
+        for (std::size_t i = 0; i < stats.workers.size(); ++i) {
+            std::cout << "cpp_mcp_generation_worker_tasks_total{worker=\"" << i << "\"} " << stats.workers[i].tasks_completed << "\n";
+            std::cout << "cpp_mcp_generation_worker_utilization{worker=\"" << i << "\"} " << stats.workers[i].utilization << "\n";
+        }
+        auto durable = durable_write_stats();
+        std::cout << "cpp_mcp_durable_write_batches_total " << durable.batches << "\n";
+        std::cout << "cpp_mcp_durable_write_files_total " << durable.files << "\n";
         return 0;
     }
 
@@ -115,6 +399,7 @@ int main(int argc, char **argv) {
         bool clientkit_ok = is_writable_directory(clientkit_root, clientkit_message);
 
         RuntimeRegistry health_registry(clientkit_root, metrics);
+        health_registry.set_scan_workers(scan_workers);
         health_registry.load();
         auto registry_stats = health_registry.stats();
         auto queue_stats = generator->stats();
@@ -132,11 +417,60 @@ int main(int argc, char **argv) {
         std::cout << "generator.running: " << (queue_stats.running ? "true" : "false") << "\n";
         std::cout << "generator.queue_depth: " << queue_stats.queue_depth << "\n";
         std::cout << "generator.active: " << queue_stats.active << "\n";
+        std::cout << "generator.workers: " << queue_stats.workers.size() << "\n";
         std::cout << "registry.operation_count: " << registry_stats.operation_count << "\n";
         std::cout << "registry.last_load_ms: " << registry_stats.last_load_latency_ms << "\n";
+        std::cout << "registry.memory_bytes: " << registry_stats.memory_bytes << "\n";
+        std::cout << "registry.scan_workers: " << registry_stats.last_scan.workers << "\n";
+        std::cout << "registry.scan_walk_us: " << registry_stats.last_scan.walk_us << "\n";
+        std::cout << "registry.scan_read_us: " << registry_stats.last_scan.read_us << "\n";
+        std::cout << "registry.scan_build_us: " << registry_stats.last_scan.build_us << "\n";
         return ok ? 0 : 1;
     }
 
+    if (command == "serve") {
+        if (serve_mode != "http" && serve_mode != "stdio" && serve_mode != "both") {
+            generator->stop();
+            print_usage();
+            return 1;
+        }
+        McpServer::Options options;
+        options.http = serve_mode != "stdio";
+        options.stdio = serve_mode != "http";
+        if (const char *address = std::getenv("CPP_MCP_SERVE_ADDRESS")) {
+            options.address = address;
+        }
+        options.port = static_cast<std::uint16_t>(read_size_t_env("CPP_MCP_SERVE_PORT").value_or(options.port));
+        options.io_threads = read_size_t_env("CPP_MCP_SERVE_IO_THREADS").value_or(options.io_threads);
+        options.metrics = [&metrics, &gateway]() { return metrics->to_prometheus() + bulkhead_metrics(gateway); };
+
+        if (auto threads = read_size_t_env("CPP_MCP_EXECUTOR_THREADS")) {
+            gateway.set_executor(std::make_shared<WorkStealingExecutor>(*threads));
+        }
+        // Load the registry before accepting traffic so the first request
+        // does not pay for the scan.
+        gateway.operations();
+        McpRpcHandler handler(gateway);
+        McpServer server(handler, options);
+        std::string error;
+        if (!server.start(error)) {
+            generator->stop();
+            std::cerr << "Failed to start server: " << error << std::endl;
+            return 1;
+        }
+        g_server = &server;
+        std::signal(SIGINT, handle_stop_signal);
+        std::signal(SIGTERM, handle_stop_signal);
+        if (options.http) {
+            log_info("MCP server listening on http://" + options.address + ":" + std::to_string(server.port()) + "/mcp");
+        }
+        server.wait();
+        g_server = nullptr;
+        log_info("MCP server stopped");
+        generator->stop();
+        return 0;
+    }
+
     print_usage();
     generator->stop();
     return 1;
@@ -1,7 +1,71 @@
 #include "mcp_gateway.h"
 
-#include <chrono>
+#include "json.h"
+
+#include <algorithm>
+#include <cctype>
 #include <sstream>
+#include <thread>
+
+namespace {
+// Host and port of an absolute URL, lower-cased (e.g. "api.example.com:8443"),
+// or an empty string when url has no scheme.
+std::string url_host(std::string_view url) {
+    auto scheme = url.find("://");
+    if (scheme == std::string_view::npos) {
+        return {};
+    }
+    auto authority = url.substr(scheme + 3);
+    authority = authority.substr(0, authority.find_first_of("/?#"));
+    if (auto at = authority.rfind('@'); at != std::string_view::npos) {
+        authority.remove_prefix(at + 1);
+    }
+    std::string host(authority);
+    std::transform(host.begin(), host.end(), host.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return host;
+}
+
+// True when url uses the http scheme, the only one HttpClient can serve.
+bool is_http_url(std::string_view url) {
+    constexpr std::string_view scheme = "http://";
+    return url.size() >= scheme.size() &&
+           std::equal(scheme.begin(), scheme.end(), url.begin(),
+                      [](char a, char b) { return a == std::tolower(static_cast<unsigned char>(b)); });
+}
+
+// Percent-encode everything but RFC 3986 unreserved characters.
+std::string percent_encode(std::string_view text) {
+    static const char kHex[] = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : text) {
+        if (std::isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~') {
+            out += static_cast<char>(c);
+        } else {
+            out += '%';
+            out += kHex[c >> 4];
+            out += kHex[c & 0xF];
+        }
+    }
+    return out;
+}
+} // namespace
+
+std::optional<BulkheadKey> parse_bulkhead_key(std::string_view name) {
+    if (name == "none") {
+        return BulkheadKey::None;
+    }
+    if (name == "kit") {
+        return BulkheadKey::Kit;
+    }
+    if (name == "version") {
+        return BulkheadKey::Version;
+    }
+    if (name == "host") {
+        return BulkheadKey::Host;
+    }
+    return std::nullopt;
+}
 
 // Construct a gateway that fronts the provided runtime registry. The registry
 // is stored by value; no exceptions are thrown here beyond potential
@@ -10,25 +74,74 @@ McpGateway::McpGateway(RuntimeRegistry registry,
                        std::size_t max_concurrent_operations,
                        std::shared_ptr<MetricsRegistry> metrics)
     : registry_(std::move(registry)),
-      max_concurrent_operations_(max_concurrent_operations),
-      metrics_(std::move(metrics)) {}
+      metrics_(std::move(metrics)) {
+    admission_.initial_limit = max_concurrent_operations;
+    admission_.max_limit = std::max(admission_.max_limit, max_concurrent_operations);
+}
+
+McpGateway::~McpGateway() {
+    unfollow();
+    // Refuse queued calls first so no new operation starts while waiting.
+    std::vector<std::shared_ptr<Bulkhead>> bulkheads;
+    {
+        std::lock_guard<std::mutex> lock(bulkheads_mutex_);
+        for (const auto &entry : bulkheads_) {
+            bulkheads.push_back(entry.second);
+        }
+    }
+    for (const auto &bulkhead : bulkheads) {
+        bulkhead->limiter.close();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return active_ == 0; });
+}
+
+// Follow a generation queue. Input: the queue to subscribe to (ignored when
+// null). Each completion event is applied to the registry on the generator's
+// worker thread. Only allocation failures may throw.
+void McpGateway::follow(std::shared_ptr<GenerationQueue> generator) {
+    unfollow();
+    if (!generator) {
+        return;
+    }
+    generator_ = std::move(generator);
+    subscription_ = generator_->subscribe([this](const GenerationEvent &event) {
+        registry_.apply_kit({event.version, event.kit_name, event.operation_ids, event.previous_stamp, event.stamp});
+        invalidate_kit_routes();
+    });
+}
 
-// List known operations discovered by the registry. The method reloads the
+void McpGateway::unfollow() {
+    if (generator_) {
+        generator_->unsubscribe(subscription_);
+        generator_.reset();
+        subscription_ = 0;
+    }
+}
+
+// List known operations discovered by the registry. The method refreshes the
 // registry, takes no parameters, returns a newline-delimited string of
 // operation summaries, and does not throw beyond standard library allocation
 // failures.
 std::string McpGateway::list_operations() {
+    std::ostringstream oss;
+    for (const auto &operation : operations()) {
+        oss << operation.operation_id << " (version: " << operation.version << ", kit: " << operation.kit_name << ")\n";
+    }
+    return oss.str();
+}
+
+std::vector<OperationDescriptor> McpGateway::operations() {
     if (metrics_) {
         metrics_->record_mcp_list_request();
     }
     // Refresh the registry on each call so newly generated client kits are
-    // discoverable without restarting the service.
-    registry_.load();
-    std::ostringstream oss;
-    for (const auto &operation : registry_.list_operations()) {
-        oss << operation.operation_id << " (version: " << operation.version << ", kit: " << operation.kit_name << ")\n";
+    // discoverable without restarting the service. The refresh is incremental
+    // and skips the directory walk when nothing was generated since last time.
+    if (registry_.refresh()) {
+        invalidate_kit_routes();
     }
-    return oss.str();
+    return registry_.list_operations();
 }
 
 // Execute a simulated MCP operation lookup. Accepts an operation identifier and
@@ -37,49 +150,486 @@ std::string McpGateway::list_operations() {
 // not explicitly thrown; standard library exceptions may propagate if string
 // operations or registry interactions fail internally.
 std::string McpGateway::execute_operation(const std::string &operation_id, const std::string &payload) {
-    if (metrics_) {
-        metrics_->record_mcp_execute_request();
+    return execute(operation_id, payload).message;
+}
+
+ExecuteResult McpGateway::execute(const std::string &operation_id, const std::string &payload) {
+    auto op = lookup(operation_id, true);
+    if (!op) {
+        return not_found(operation_id);
     }
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (active_ >= max_concurrent_operations_) {
-            if (metrics_) {
-                metrics_->record_mcp_execute_rejected();
-            }
-            return "Backpressure: too many concurrent operations";
+    auto bulkhead = bulkhead_for(op);
+    auto admitted = std::make_shared<std::promise<std::optional<ExecuteResult>>>();
+    auto decision = admitted->get_future();
+    admit(bulkhead, [admitted](std::optional<ExecuteResult> rejection) { admitted->set_value(std::move(rejection)); });
+    if (auto rejection = decision.get()) {
+        return *rejection;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto call = prepare(op, payload);
+    bool overloaded = false;
+    auto result = call.result ? std::move(*call.result) : finish(call.client->send(call.request), overloaded);
+    release(*bulkhead, start, overloaded);
+    return result;
+}
+
+// Start an operation asynchronously. Inputs: operation id, payload and the
+// completion callback. The lookup happens on the calling thread, since it
+// picks the bulkhead; once admitted, the call is prepared as one executor
+// task, and a downstream round trip continues on the HTTP client's I/O
+// threads. Only allocation failures may throw, before the operation is
+// queued.
+void McpGateway::execute_operation_async(const std::string &operation_id, std::string payload, ExecuteCallback done) {
+    // The caller may be an event loop, so it only decides the call itself
+    // when that needs no disk access beyond the registry's stamp check. A
+    // lookup that would rescan clientkit/, or a host bulkhead whose kit
+    // manifest is not cached yet, moves to the executor.
+    if (registry_.is_current()) {
+        auto op = lookup(operation_id, false);
+        if (!op) {
+            done(not_found(operation_id));
+            return;
+        }
+        if (bulkhead_is_cached(op)) {
+            auto bulkhead = bulkhead_for(op);
+            run_admitted(std::move(bulkhead), std::move(op), std::move(payload), std::move(done));
+            return;
         }
-        ++active_;
     }
+    post_tracked([this, operation_id, payload = std::move(payload), done = std::move(done)]() mutable {
+        auto op = lookup(operation_id, true);
+        if (!op) {
+            done(not_found(operation_id));
+            return;
+        }
+        auto bulkhead = bulkhead_for(op);
+        run_admitted(std::move(bulkhead), std::move(op), std::move(payload), std::move(done));
+    });
+}
 
-    auto start = std::chrono::steady_clock::now();
-    auto finish = [this, start]() {
-        if (metrics_) {
-            auto end = std::chrono::steady_clock::now();
-            auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-            metrics_->record_mcp_execute_latency_ms(duration_ms);
+// Admit op through bulkhead, then serve it on the executor. Inputs: the
+// found operation, its bulkhead, the payload and the caller's callback.
+void McpGateway::run_admitted(std::shared_ptr<Bulkhead> bulkhead, RuntimeRegistry::OperationRef op,
+                              std::string payload, ExecuteCallback done) {
+    admit(bulkhead, [this, op = std::move(op), bulkhead, payload = std::move(payload), done = std::move(done)](
+                        std::optional<ExecuteResult> rejection) mutable {
+        if (rejection) {
+            done(std::move(*rejection));
+            return;
         }
+        auto start = std::chrono::steady_clock::now();
+        executor().post([this, op = std::move(op), bulkhead = std::move(bulkhead), payload = std::move(payload),
+                         done = std::move(done), start]() mutable {
+            auto call = prepare(op, payload);
+            if (call.result) {
+                release(*bulkhead, start, false);
+                done(std::move(*call.result));
+                return;
+            }
+            call.client->send_async(std::move(call.request),
+                                    [this, bulkhead = std::move(bulkhead), done = std::move(done), start](
+                                        HttpResult http) mutable {
+                                        bool overloaded = false;
+                                        auto result = finish(std::move(http), overloaded);
+                                        release(*bulkhead, start, overloaded);
+                                        done(std::move(result));
+                                    });
+        });
+    });
+}
+
+void McpGateway::operations_async(std::function<void(std::vector<OperationDescriptor>)> done) {
+    post_tracked([this, done = std::move(done)]() { done(operations()); });
+}
+
+// Run task on the executor, counted in active_ until it returns so the
+// destructor waits for it like an admitted operation.
+void McpGateway::post_tracked(std::function<void()> task) {
+    {
         std::lock_guard<std::mutex> lock(mutex_);
-        if (active_ > 0) {
-            --active_;
+        ++active_;
+    }
+    executor().post([this, task = std::move(task)]() {
+        task();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0) {
+            idle_.notify_all();
+        }
+    });
+}
+
+std::future<ExecuteResult> McpGateway::execute_operation_async(const std::string &operation_id, std::string payload) {
+    auto promise = std::make_shared<std::promise<ExecuteResult>>();
+    auto future = promise->get_future();
+    execute_operation_async(operation_id, std::move(payload),
+                            [promise](ExecuteResult result) { promise->set_value(std::move(result)); });
+    return future;
+}
+
+void McpGateway::set_executor(std::shared_ptr<WorkStealingExecutor> executor) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    executor_ = std::move(executor);
+    registry_.set_scan_executor(executor_);
+}
+
+void McpGateway::set_http_client(std::shared_ptr<HttpClient> client) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    http_client_ = std::move(client);
+}
+
+void McpGateway::configure_admission(ConcurrencyLimiter::Options options, std::chrono::milliseconds queue_timeout) {
+    std::lock_guard<std::mutex> lock(bulkheads_mutex_);
+    admission_ = options;
+    queue_timeout_ = queue_timeout;
+    retire_bulkheads();
+}
+
+void McpGateway::configure_bulkheads(BulkheadKey key, std::map<std::string, std::size_t> limits) {
+    std::lock_guard<std::mutex> lock(bulkheads_mutex_);
+    bulkhead_key_ = key;
+    bulkhead_limits_ = std::move(limits);
+    retire_bulkheads();
+}
+
+// Bulkheads in use are retired rather than destroyed: operations they
+// admitted still release into them, but they no longer count towards the
+// gauges and new calls get fresh bulkheads.
+void McpGateway::retire_bulkheads() {
+    for (auto &entry : bulkheads_) {
+        auto &bulkhead = *entry.second;
+        bulkhead.retired = true;
+        total_limit_ -= static_cast<long long>(bulkhead.published_limit);
+        total_queued_ -= static_cast<long long>(bulkhead.published_queued);
+    }
+    bulkheads_.clear();
+    if (metrics_) {
+        metrics_->set_mcp_admission_state(total_limit_, total_queued_);
+    }
+}
+
+ConcurrencyLimiter::Stats McpGateway::admission_stats() const {
+    ConcurrencyLimiter::Stats total;
+    for (const auto &bulkhead : bulkhead_stats()) {
+        total.limit += bulkhead.stats.limit;
+        total.in_flight += bulkhead.stats.in_flight;
+        total.queued += bulkhead.stats.queued;
+        total.queue_timeouts += bulkhead.stats.queue_timeouts;
+    }
+    return total;
+}
+
+std::vector<McpGateway::BulkheadStats> McpGateway::bulkhead_stats() const {
+    std::vector<std::shared_ptr<Bulkhead>> bulkheads;
+    {
+        std::lock_guard<std::mutex> lock(bulkheads_mutex_);
+        for (const auto &entry : bulkheads_) {
+            bulkheads.push_back(entry.second);
         }
-    };
+    }
+    std::vector<BulkheadStats> stats;
+    stats.reserve(bulkheads.size());
+    for (const auto &bulkhead : bulkheads) {
+        stats.push_back({bulkhead->name, bulkhead->limiter.stats()});
+    }
+    return stats;
+}
 
+WorkStealingExecutor &McpGateway::executor() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!executor_) {
+        executor_ = std::make_shared<WorkStealingExecutor>(std::max(2u, std::thread::hardware_concurrency()));
+        registry_.set_scan_executor(executor_);
+    }
+    return *executor_;
+}
+
+RuntimeRegistry::OperationRef McpGateway::lookup(const std::string &operation_id, bool refresh) {
+    if (metrics_) {
+        metrics_->record_mcp_execute_request();
+    }
     // Ensure the registry is current before attempting an operation lookup.
-    registry_.load();
+    if (refresh && registry_.refresh()) {
+        invalidate_kit_routes();
+    }
     auto op = registry_.find_operation(operation_id);
-    if (!op) {
+    if (!op && metrics_) {
+        metrics_->record_mcp_execute_not_found();
+    }
+    return op;
+}
+
+std::shared_ptr<const SpecRoutes> McpGateway::kit_routes(const RuntimeRegistry::OperationRef &op) {
+    auto key = op.manifest_path().string();
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+        auto it = routes_.find(key);
+        if (it != routes_.end()) {
+            return it->second;
+        }
+    }
+    // Read outside the lock; two callers racing on a cold kit both read it
+    // and the first to finish wins.
+    auto routes = std::make_shared<SpecRoutes>();
+    std::error_code ec;
+    if (!read_manifest_routes(op.manifest_path(), *routes, ec)) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(routes_mutex_);
+    return routes_.emplace(key, std::move(routes)).first->second;
+}
+
+bool McpGateway::bulkhead_is_cached(const RuntimeRegistry::OperationRef &op) {
+    {
+        std::lock_guard<std::mutex> lock(bulkheads_mutex_);
+        if (bulkhead_key_ != BulkheadKey::Host) {
+            return true;
+        }
+    }
+    std::lock_guard<std::mutex> lock(routes_mutex_);
+    return routes_.count(op.manifest_path().string()) > 0;
+}
+
+void McpGateway::invalidate_kit_routes() {
+    std::lock_guard<std::mutex> lock(routes_mutex_);
+    routes_.clear();
+}
+
+// Pick op's bulkhead. Input: a found operation. The name follows the
+// configured key; only BulkheadKey::Host reads the kit's routes. A new
+// bulkhead starts at the configured limit for its name, if any.
+std::shared_ptr<McpGateway::Bulkhead> McpGateway::bulkhead_for(const RuntimeRegistry::OperationRef &op) {
+    BulkheadKey key;
+    {
+        std::lock_guard<std::mutex> lock(bulkheads_mutex_);
+        key = bulkhead_key_;
+    }
+    std::string name;
+    switch (key) {
+    case BulkheadKey::None:
+        name = "default";
+        break;
+    case BulkheadKey::Version:
+        name = std::string(op.version());
+        break;
+    case BulkheadKey::Host:
+        if (auto routes = kit_routes(op); routes && !routes->servers.empty()) {
+            name = url_host(routes->servers.front());
+        }
+        if (!name.empty()) {
+            break;
+        }
+        [[fallthrough]];
+    case BulkheadKey::Kit:
+        name = std::string(op.version()) + "/" + std::string(op.kit_name());
+        break;
+    }
+
+    std::lock_guard<std::mutex> lock(bulkheads_mutex_);
+    auto &bulkhead = bulkheads_[name];
+    if (!bulkhead) {
+        auto options = admission_;
+        if (auto limit = bulkhead_limits_.find(name); limit != bulkhead_limits_.end()) {
+            options.initial_limit = limit->second;
+            options.max_limit = std::max(options.max_limit, limit->second);
+        }
+        bulkhead = std::make_shared<Bulkhead>(name, options);
+    }
+    return bulkhead;
+}
+
+// Admit a call through bulkhead. Input: the bulkhead and the continuation.
+// Counts the queue wait and any rejection. An admitted call is counted in
+// active_ before next runs.
+void McpGateway::admit(const std::shared_ptr<Bulkhead> &bulkhead, AdmitCallback next) {
+    auto deadline = std::chrono::steady_clock::now() + queue_timeout_;
+    bulkhead->limiter.acquire(deadline, [this, bulkhead, next = std::move(next)](
+                                            ConcurrencyLimiter::Admission admission,
+                                            std::chrono::steady_clock::duration waited) {
+        using Admission = ConcurrencyLimiter::Admission;
+        if (metrics_ && waited > std::chrono::steady_clock::duration::zero()) {
+            metrics_->record_mcp_execute_queue_wait_ms(
+                std::chrono::duration_cast<std::chrono::milliseconds>(waited).count());
+        }
+        publish_admission_state(*bulkhead);
+        if (admission == Admission::Admitted) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++active_;
+            }
+            next(std::nullopt);
+            return;
+        }
         if (metrics_) {
-            metrics_->record_mcp_execute_not_found();
+            metrics_->record_mcp_execute_rejected();
+            if (admission == Admission::TimedOut) {
+                metrics_->record_mcp_execute_queue_timeout();
+            }
         }
-        finish();
-        return "Operation not found: " + operation_id;
+        switch (admission) {
+        case Admission::TimedOut:
+            next(ExecuteResult{ExecuteResult::Status::Rejected, "Backpressure: timed out waiting for a concurrency slot"});
+            break;
+        case Admission::Closed:
+            next(ExecuteResult{ExecuteResult::Status::Rejected, "Backpressure: gateway is shutting down"});
+            break;
+        default:
+            next(ExecuteResult{ExecuteResult::Status::Rejected, "Backpressure: too many concurrent operations"});
+        }
+    });
+}
+
+// Fold one bulkhead's state into the gateway-wide gauges by the change since
+// it last published, so the cost does not grow with the number of bulkheads.
+void McpGateway::publish_admission_state(Bulkhead &bulkhead) {
+    if (!metrics_) {
+        return;
+    }
+    auto stats = bulkhead.limiter.stats();
+    std::lock_guard<std::mutex> lock(bulkheads_mutex_);
+    if (bulkhead.retired) {
+        return;
+    }
+    total_limit_ += static_cast<long long>(stats.limit) - static_cast<long long>(bulkhead.published_limit);
+    total_queued_ += static_cast<long long>(stats.queued) - static_cast<long long>(bulkhead.published_queued);
+    bulkhead.published_limit = stats.limit;
+    bulkhead.published_queued = stats.queued;
+    metrics_->set_mcp_admission_state(total_limit_, total_queued_);
+}
+
+McpGateway::Call McpGateway::prepare(const RuntimeRegistry::OperationRef &op, const std::string &payload) {
+    Call call;
+    std::shared_ptr<HttpClient> client;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        client = http_client_;
+    }
+    std::shared_ptr<const SpecRoutes> routes;
+    if (client) {
+        routes = kit_routes(op);
+    }
+    // Servers the client cannot reach (https, or none declared) keep the echo.
+    if (routes && !routes->servers.empty() && is_http_url(routes->servers.front())) {
+        const auto &server = routes->servers.front();
+        auto route = std::find_if(routes->routes.begin(), routes->routes.end(),
+                                  [&](const SpecRoute &r) { return r.operation_id == op.operation_id(); });
+        auto url = parse_http_url(server);
+        if (!url) {
+            call.result = ExecuteResult{ExecuteResult::Status::Failed, "Invalid downstream server: " + server};
+            return call;
+        }
+        if (route == routes->routes.end()) {
+            call.result =
+                ExecuteResult{ExecuteResult::Status::Failed, "No route recorded for " + std::string(op.operation_id())};
+            return call;
+        }
+        call.result = build_request(*url, *route, payload, call.request);
+        call.client = std::move(client);
+        return call;
     }
 
     std::ostringstream oss;
-    oss << "Executed " << op->operation_id << " for version " << op->version << " with payload: " << payload;
+    oss << "Executed " << op.operation_id() << " for version " << op.version() << " with payload: " << payload;
     if (metrics_) {
         metrics_->record_mcp_execute_success();
     }
-    finish();
-    return oss.str();
+    call.result = ExecuteResult{ExecuteResult::Status::Ok, oss.str()};
+    return call;
+}
+
+// Build the downstream request for route. Inputs: the server URL (its path
+// prefixes the route's), the route and the payload. Output: request.
+std::optional<ExecuteResult> McpGateway::build_request(const HttpUrl &server, const SpecRoute &route,
+                                                       const std::string &payload, HttpRequest &request) {
+    JsonValue arguments;
+    std::string error;
+    if (!parse_json(payload, arguments, error) || !arguments.is_object()) {
+        arguments = JsonValue::make_object();
+    }
+    auto text = [](const JsonValue &value) { return value.is_string() ? value.string : to_json(value); };
+
+    request.method = route.method;
+    request.host = server.host;
+    request.port = server.port;
+    auto base = server.target.substr(0, server.target.find('?'));
+    while (!base.empty() && base.back() == '/') {
+        base.pop_back();
+    }
+    std::string path;
+    std::vector<std::string> in_path;
+    for (std::size_t i = 0; i < route.path.size();) {
+        auto open = route.path.find('{', i);
+        auto close = open == std::string::npos ? std::string::npos : route.path.find('}', open);
+        if (close == std::string::npos) {
+            path += route.path.substr(i);
+            break;
+        }
+        path += route.path.substr(i, open - i);
+        auto name = route.path.substr(open + 1, close - open - 1);
+        const auto *value = arguments.find(name);
+        if (!value) {
+            return ExecuteResult{ExecuteResult::Status::Failed, "Missing path parameter: " + name};
+        }
+        path += percent_encode(text(*value));
+        in_path.push_back(name);
+        i = close + 1;
+    }
+    request.target = base + path;
+    char separator = '?';
+    for (const auto &name : route.parameters) {
+        const auto *value = arguments.find(name);
+        if (!value || std::find(in_path.begin(), in_path.end(), name) != in_path.end()) {
+            continue;
+        }
+        request.target += separator + percent_encode(name) + "=" + percent_encode(text(*value));
+        separator = '&';
+    }
+    request.headers.emplace_back("Accept", "application/json");
+    if (route.method == "POST" || route.method == "PUT" || route.method == "PATCH") {
+        const auto *body = arguments.find("body");
+        request.body = body ? text(*body) : payload;
+        request.headers.emplace_back("Content-Type", "application/json");
+    }
+    return std::nullopt;
+}
+
+// Map a downstream exchange to an outcome: the response body for a 2xx
+// answer, a Failed result otherwise.
+ExecuteResult McpGateway::finish(HttpResult result, bool &overloaded) {
+    if (!result.ok()) {
+        overloaded = result.error == HttpResult::Error::Timeout;
+        return {ExecuteResult::Status::Failed, "Downstream request failed: " + result.message};
+    }
+    auto status = result.response.status;
+    if (status >= 200 && status < 300) {
+        if (metrics_) {
+            metrics_->record_mcp_execute_success();
+        }
+        return {ExecuteResult::Status::Ok, std::move(result.response.body)};
+    }
+    overloaded = status == 429 || status == 503;
+    return {ExecuteResult::Status::Failed,
+            "Downstream returned " + std::to_string(status) + ": " + result.response.body};
+}
+
+void McpGateway::release(Bulkhead &bulkhead, std::chrono::steady_clock::time_point start, bool overloaded) {
+    auto latency = std::chrono::steady_clock::now() - start;
+    if (metrics_) {
+        metrics_->record_mcp_execute_latency_ms(std::chrono::duration_cast<std::chrono::milliseconds>(latency).count());
+    }
+    // Hand the slot on first: a waiter admitted here is counted in active_
+    // before this operation leaves it, so the destructor never sees a false
+    // zero.
+    bulkhead.limiter.release(latency, overloaded);
+    publish_admission_state(bulkhead);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (active_ > 0) {
+        --active_;
+    }
+    if (active_ == 0) {
+        idle_.notify_all();
+    }
+}
+
+ExecuteResult McpGateway::not_found(const std::string &operation_id) {
+    return {ExecuteResult::Status::NotFound, "Operation not found: " + operation_id};
 }
@@ -1,39 +1,266 @@
 #pragma once
 
+#include "concurrency_limiter.h"
+#include "generation_queue.h"
+#include "http_client.h"
 #include "metrics.h"
 #include "runtime_registry.h"
+#include "work_stealing_executor.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+// Outcome of one operation call. message is the text returned to the client
+// in every case; status tells a transport whether to report it as an error.
+// Failed covers a downstream call that could not be made or did not succeed.
+struct ExecuteResult {
+    enum class Status { Ok, NotFound, Rejected, Failed };
+    Status status{Status::Ok};
+    std::string message;
+
+    bool ok() const { return status == Status::Ok; }
+};
+
+// What separates one bulkhead (an independent concurrency pool) from another:
+// nothing (a single shared pool), the client kit, the kit version, or the
+// downstream host named by the first entry of the spec's servers.
+enum class BulkheadKey { None, Kit, Version, Host };
+
+// Parse "none", "kit", "version" or "host".
+std::optional<BulkheadKey> parse_bulkhead_key(std::string_view name);
 
 // McpGateway provides a thin façade over the runtime registry to expose
-// Model Context Protocol style operations. It refreshes the registry on
-// every call so that newly generated client kits are discoverable without
-// restarting the process.
+// Model Context Protocol style operations. It incrementally refreshes the
+// registry on every call so that newly generated client kits are discoverable
+// without restarting the process.
 class McpGateway {
   public:
     // Construct a gateway with a concrete runtime registry. The registry is
     // stored by value so the gateway can manage lifecycle calls (e.g., load)
-    // without assuming ownership semantics.
+    // without assuming ownership semantics. max_concurrent_operations is the
+    // starting limit of the adaptive admission controller; see
+    // configure_admission.
     explicit McpGateway(RuntimeRegistry registry,
                         std::size_t max_concurrent_operations = 8,
                         std::shared_ptr<MetricsRegistry> metrics = nullptr);
 
+    // Stop following the generation queue, if any, and wait for operations
+    // still in flight on the executor.
+    ~McpGateway();
+
+    // Subscribe to completion events from generator and patch the registry
+    // with each newly generated kit as soon as it is written, so new tools
+    // appear without a rescan on the request path. Replaces any previous
+    // subscription.
+    void follow(std::shared_ptr<GenerationQueue> generator);
+
     // Return a formatted list of all operations known to the registry. Each
     // entry includes the operation identifier, the client kit version, and
     // the kit name extracted from the generated manifest.
     std::string list_operations();
 
-    // Execute a simulated MCP operation lookup. If the operation exists the
-    // method returns a descriptive string that echoes the payload; otherwise
-    // it returns a human-friendly not-found message.
+    // Refresh the registry and return its operations sorted by operation id,
+    // for transports that render their own tool listing.
+    std::vector<OperationDescriptor> operations();
+
+    // As operations(), but the refresh runs on the executor and done
+    // receives the result there. done must not throw.
+    void operations_async(std::function<void(std::vector<OperationDescriptor>)> done);
+
+    // Execute an MCP operation. With an HTTP client set (see
+    // set_http_client) and an http:// server in the operation's spec, the
+    // call is forwarded and the response body returned. Otherwise the method
+    // returns a descriptive string that echoes the payload. An unknown
+    // operation yields a human-friendly not-found message.
     std::string execute_operation(const std::string &operation_id, const std::string &payload);
 
+    // As execute_operation, but keeps the outcome alongside the message.
+    ExecuteResult execute(const std::string &operation_id, const std::string &payload);
+
+    using ExecuteCallback = std::function<void(ExecuteResult)>;
+
+    // Start an operation without blocking the caller. When every slot of the
+    // operation's bulkhead is in use the call waits in that bulkhead's queue,
+    // without holding a thread, until a slot frees up or its queue timeout
+    // passes. The calling thread only looks the operation up and queues it
+    // when that needs no disk access beyond a read of the generation stamp;
+    // a lookup that must rescan clientkit/ or read a kit manifest runs on
+    // the executor instead. done receives the outcome on an executor thread,
+    // or for a call forwarded downstream on one of the HTTP client's I/O
+    // threads, which block on the network in the executor's place, at most
+    // io_threads_per_host of them per downstream host; an unknown operation
+    // or a refusal may instead be reported on the calling thread before
+    // this returns, or on the limiters' shared deadline thread. An
+    // admitted operation holds its slot until just before done is called,
+    // whichever threads it runs on. done must not throw.
+    void execute_operation_async(const std::string &operation_id, std::string payload, ExecuteCallback done);
+
+    // Future-returning form of the above.
+    std::future<ExecuteResult> execute_operation_async(const std::string &operation_id, std::string payload);
+
+    // Run asynchronous operations on executor, which may be shared with other
+    // components. Without one, a pool sized to the hardware is created on
+    // first use. Registry scans borrow it for their extra workers. Call
+    // before the first asynchronous operation.
+    void set_executor(std::shared_ptr<WorkStealingExecutor> executor);
+
+    // Forward operations to their downstream service through client. The
+    // payload, when a JSON object, supplies path parameters ({name} in the
+    // route), the operation's other declared parameters as a query string,
+    // and for POST, PUT and PATCH its "body" member as the request body (the
+    // whole payload when it has none). Downstream timeouts and 429 or 503
+    // answers count as overload for the adaptive limit. Operations whose
+    // spec names no http:// server (none, a relative one, or https) keep the
+    // echo behaviour. Call before the first operation.
+    void set_http_client(std::shared_ptr<HttpClient> client);
+
+    // Replace the admission controller of every bulkhead. Calls that find
+    // every slot busy wait up to queue_timeout for one. By default the limit
+    // starts at max_concurrent_operations and adapts, with a queue of 128 and
+    // a one second timeout. Call before the first operation.
+    void configure_admission(ConcurrencyLimiter::Options options, std::chrono::milliseconds queue_timeout);
+
+    // Split admission into bulkheads chosen by key, so a slow kit, version or
+    // downstream host can only exhaust its own slots and queue. Each bulkhead
+    // gets a limiter built from the admission options; limits overrides the
+    // starting limit of bulkheads by name (see bulkhead_stats). Bulkheads
+    // cost no threads: their queue deadlines share the limiters' one
+    // deadline thread. Operations whose spec names no absolute server URL
+    // fall back to a per-kit bulkhead under BulkheadKey::Host. Defaults to
+    // BulkheadKey::None. Call before the first operation.
+    void configure_bulkheads(BulkheadKey key, std::map<std::string, std::size_t> limits = {});
+
+    // Admission state summed over every bulkhead.
+    ConcurrencyLimiter::Stats admission_stats() const;
+
+    struct BulkheadStats {
+        // "default", the version, "<version>/<kit>", or the host as
+        // "host[:port]".
+        std::string name;
+        ConcurrencyLimiter::Stats stats;
+    };
+
+    // Per-bulkhead admission state, sorted by name. Bulkheads are created on
+    // first use.
+    std::vector<BulkheadStats> bulkhead_stats() const;
+
   private:
+    // One concurrency pool. Shared with the operations it admitted, so it
+    // outlives a reconfiguration that replaces it.
+    struct Bulkhead {
+        Bulkhead(std::string name, ConcurrencyLimiter::Options options)
+            : name(std::move(name)), limiter(options) {}
+
+        std::string name;
+        ConcurrencyLimiter limiter;
+        // Limit and queue depth last folded into the gateway-wide gauges, and
+        // whether the bulkhead still counts towards them. Guarded by
+        // bulkheads_mutex_.
+        std::size_t published_limit{0};
+        std::size_t published_queued{0};
+        bool retired{false};
+    };
+
+    // Drop the current generation subscription.
+    void unfollow();
+
+    // Run task on the executor; the destructor waits for it.
+    void post_tracked(std::function<void()> task);
+
+    // Find the operation, counting the request and a miss, after refreshing
+    // the registry when refresh is set. Returns an empty handle when it is
+    // unknown.
+    RuntimeRegistry::OperationRef lookup(const std::string &operation_id, bool refresh);
+
+    // Routing details of the operation's kit, read from its manifest once
+    // and cached until the registry changes. Null when unreadable.
+    std::shared_ptr<const SpecRoutes> kit_routes(const RuntimeRegistry::OperationRef &op);
+
+    // Forget cached kit routes, e.g. after a kit was regenerated.
+    void invalidate_kit_routes();
+
+    // Drop every bulkhead so new calls create them from the current
+    // settings. Called with bulkheads_mutex_ held.
+    void retire_bulkheads();
+
+    // Return the bulkhead op is admitted through, creating it on first use.
+    std::shared_ptr<Bulkhead> bulkhead_for(const RuntimeRegistry::OperationRef &op);
+
+    // True when bulkhead_for(op) needs no manifest read.
+    bool bulkhead_is_cached(const RuntimeRegistry::OperationRef &op);
+
+    // Admit op through bulkhead and serve it; see execute_operation_async.
+    void run_admitted(std::shared_ptr<Bulkhead> bulkhead, RuntimeRegistry::OperationRef op, std::string payload,
+                      ExecuteCallback done);
+
+    // Receives std::nullopt once a slot is held, or the rejection to return.
+    using AdmitCallback = std::function<void(std::optional<ExecuteResult> rejection)>;
+
+    // Queue for a slot of bulkhead; next runs as described for
+    // execute_operation_async.
+    void admit(const std::shared_ptr<Bulkhead> &bulkhead, AdmitCallback next);
+
+    // Fold the bulkhead's current limit and queue depth into the gauges.
+    void publish_admission_state(Bulkhead &bulkhead);
+
+    // How a found operation is served: result is set when it already
+    // finished (echoed, or failed before reaching the downstream); otherwise
+    // request is to be sent through client.
+    struct Call {
+        std::optional<ExecuteResult> result;
+        std::shared_ptr<HttpClient> client;
+        HttpRequest request;
+    };
+
+    // Decide how to serve a found operation. Called with a slot held.
+    Call prepare(const RuntimeRegistry::OperationRef &op, const std::string &payload);
+
+    // Build the request for route on server from payload. Returns a Failed
+    // result instead when the payload lacks a path parameter.
+    static std::optional<ExecuteResult> build_request(const HttpUrl &server, const SpecRoute &route,
+                                                      const std::string &payload, HttpRequest &request);
+
+    // Turn a downstream exchange into the call's outcome. Sets overloaded
+    // when the downstream signalled overload.
+    ExecuteResult finish(HttpResult http, bool &overloaded);
+
+    // Return the slot taken at start and record the operation's latency.
+    void release(Bulkhead &bulkhead, std::chrono::steady_clock::time_point start, bool overloaded);
+
+    WorkStealingExecutor &executor();
+
+    static ExecuteResult not_found(const std::string &operation_id);
+
     RuntimeRegistry registry_;
-    std::size_t max_concurrent_operations_;
     std::shared_ptr<MetricsRegistry> metrics_;
+    std::chrono::milliseconds queue_timeout_{1000};
     mutable std::mutex mutex_;
+    // Admitted operations and tracked executor tasks not yet finished; the
+    // destructor waits for zero.
     std::size_t active_{0};
+    std::condition_variable idle_;
+    std::shared_ptr<WorkStealingExecutor> executor_;
+    std::shared_ptr<HttpClient> http_client_;
+    mutable std::mutex bulkheads_mutex_;
+    ConcurrencyLimiter::Options admission_;
+    BulkheadKey bulkhead_key_{BulkheadKey::None};
+    std::map<std::string, std::size_t> bulkhead_limits_;
+    std::map<std::string, std::shared_ptr<Bulkhead>> bulkheads_;
+    // Sums of the published per-bulkhead limits and queue depths.
+    long long total_limit_{0};
+    long long total_queued_{0};
+    std::mutex routes_mutex_;
+    // Kit routes by manifest path.
+    std::unordered_map<std::string, std::shared_ptr<const SpecRoutes>> routes_;
+    std::shared_ptr<GenerationQueue> generator_;
+    std::size_t subscription_{0};
 };
@@ -0,0 +1,187 @@
+#include "mcp_rpc.h"
+
+#include <future>
+#include <memory>
+#include <mutex>
+
+namespace {
+// JSON-RPC 2.0 error codes.
+constexpr int kParseError = -32700;
+constexpr int kInvalidRequest = -32600;
+constexpr int kMethodNotFound = -32601;
+constexpr int kInvalidParams = -32602;
+
+JsonValue make_response(const JsonValue &id) {
+    auto response = JsonValue::make_object();
+    response.set("jsonrpc", JsonValue::make_string("2.0"));
+    response.set("id", id);
+    return response;
+}
+
+JsonValue make_error(const JsonValue &id, int code, std::string message) {
+    auto response = make_response(id);
+    auto &error = response.set("error", JsonValue::make_object());
+    error.set("code", JsonValue::make_number(code));
+    error.set("message", JsonValue::make_string(std::move(message)));
+    return response;
+}
+} // namespace
+
+McpRpcHandler::McpRpcHandler(McpGateway &gateway) : gateway_(gateway) {}
+
+// Handle a message. Input: raw JSON text and the reply callback. Malformed
+// JSON yields a parse error response with a null id, as JSON-RPC requires.
+// Batch members may finish in any order; their responses are sent together,
+// in request order, once the last one is done. Only allocation failures may
+// throw.
+void McpRpcHandler::handle(std::string_view message, Reply reply) {
+    JsonValue parsed;
+    std::string error;
+    if (!parse_json(message, parsed, error)) {
+        reply(to_json(make_error({}, kParseError, "Parse error: " + error)));
+        return;
+    }
+    if (!parsed.is_array()) {
+        dispatch(parsed, [reply = std::move(reply)](JsonValue response, bool respond) {
+            reply(respond ? to_json(response) : std::string());
+        });
+        return;
+    }
+    if (parsed.items.empty()) {
+        reply(to_json(make_error({}, kInvalidRequest, "Invalid Request: empty batch")));
+        return;
+    }
+
+    struct Batch {
+        std::mutex mutex;
+        std::vector<JsonValue> responses;
+        std::vector<bool> respond;
+        std::size_t remaining;
+        Reply reply;
+    };
+    auto batch = std::make_shared<Batch>();
+    batch->responses.resize(parsed.items.size());
+    batch->respond.resize(parsed.items.size(), false);
+    batch->remaining = parsed.items.size();
+    batch->reply = std::move(reply);
+    for (std::size_t i = 0; i < parsed.items.size(); ++i) {
+        dispatch(parsed.items[i], [batch, i](JsonValue response, bool respond) {
+            {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                batch->responses[i] = std::move(response);
+                batch->respond[i] = respond;
+                if (--batch->remaining > 0) {
+                    return;
+                }
+            }
+            auto responses = JsonValue::make_array();
+            for (std::size_t j = 0; j < batch->responses.size(); ++j) {
+                if (batch->respond[j]) {
+                    responses.items.push_back(std::move(batch->responses[j]));
+                }
+            }
+            batch->reply(responses.items.empty() ? std::string() : to_json(responses));
+        });
+    }
+}
+
+std::string McpRpcHandler::handle(std::string_view message) {
+    std::promise<std::string> promise;
+    auto future = promise.get_future();
+    handle(message, [&promise](std::string response) { promise.set_value(std::move(response)); });
+    return future.get();
+}
+
+void McpRpcHandler::dispatch(const JsonValue &request, Done done) {
+    const auto *version = request.find("jsonrpc");
+    const auto *method = request.find("method");
+    const auto *id = request.find("id");
+    auto request_id = id ? *id : JsonValue{};
+    if (!request.is_object() || !version || version->string != "2.0" || !method || !method->is_string()) {
+        done(make_error(request_id, kInvalidRequest, "Invalid Request"), true);
+        return;
+    }
+    // Requests without an id are notifications and never get a reply, not
+    // even an error.
+    bool respond = id != nullptr;
+    const auto *params = request.find("params");
+    const auto &name = method->string;
+    auto response = make_response(request_id);
+
+    if (name == "initialize") {
+        const auto *requested = params ? params->find("protocolVersion") : nullptr;
+        auto &result = response.set("result", JsonValue::make_object());
+        result.set("protocolVersion",
+                   JsonValue::make_string(requested && requested->is_string() ? requested->string : kMcpProtocolVersion));
+        auto &capabilities = result.set("capabilities", JsonValue::make_object());
+        capabilities.set("tools", JsonValue::make_object()).set("listChanged", JsonValue::make_bool(false));
+        auto &info = result.set("serverInfo", JsonValue::make_object());
+        info.set("name", JsonValue::make_string("cpp-mcp-gateway"));
+        info.set("version", JsonValue::make_string("0.1.0"));
+        done(std::move(response), respond);
+        return;
+    }
+    if (name == "ping") {
+        response.set("result", JsonValue::make_object());
+        done(std::move(response), respond);
+        return;
+    }
+    if (name == "tools/list") {
+        // Listing refreshes the registry, which may walk clientkit/, so it
+        // runs on the gateway's executor rather than the reading thread.
+        gateway_.operations_async([response = std::move(response), respond, done = std::move(done)](
+                                      std::vector<OperationDescriptor> operations) mutable {
+            response.set("result", tools_list(operations));
+            done(std::move(response), respond);
+        });
+        return;
+    }
+    if (name == "tools/call") {
+        const auto *tool = params ? params->find("name") : nullptr;
+        if (!tool || !tool->is_string()) {
+            done(make_error(request_id, kInvalidParams, "Invalid params: tools/call needs a string name"), respond);
+            return;
+        }
+        std::string payload;
+        if (const auto *arguments = params->find("arguments")) {
+            const auto *field = arguments->find("payload");
+            payload = field && field->is_string() ? field->string : to_json(*arguments);
+        }
+        gateway_.execute_operation_async(
+            tool->string, std::move(payload),
+            [response = std::move(response), respond, done = std::move(done)](ExecuteResult outcome) mutable {
+                auto &result = response.set("result", JsonValue::make_object());
+                auto &content = result.set("content", JsonValue::make_array());
+                auto text = JsonValue::make_object();
+                text.set("type", JsonValue::make_string("text"));
+                text.set("text", JsonValue::make_string(std::move(outcome.message)));
+                content.items.push_back(std::move(text));
+                result.set("isError", JsonValue::make_bool(!outcome.ok()));
+                done(std::move(response), respond);
+            });
+        return;
+    }
+    if (name.compare(0, 14, "notifications/") == 0) {
+        done(std::move(response), false);
+        return;
+    }
+    done(make_error(request_id, kMethodNotFound, "Method not found: " + name), respond);
+}
+
+JsonValue McpRpcHandler::tools_list(const std::vector<OperationDescriptor> &operations) {
+    auto result = JsonValue::make_object();
+    auto &tools = result.set("tools", JsonValue::make_array());
+    for (const auto &operation : operations) {
+        auto tool = JsonValue::make_object();
+        tool.set("name", JsonValue::make_string(operation.operation_id));
+        tool.set("description", JsonValue::make_string(operation.operation_id + " (version: " + operation.version +
+                                                       ", kit: " + operation.kit_name + ")"));
+        auto &schema = tool.set("inputSchema", JsonValue::make_object());
+        schema.set("type", JsonValue::make_string("object"));
+        schema.set("properties", JsonValue::make_object())
+            .set("payload", JsonValue::make_object())
+            .set("type", JsonValue::make_string("string"));
+        tools.items.push_back(std::move(tool));
+    }
+    return result;
+}
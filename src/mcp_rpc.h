@@ -0,0 +1,52 @@
+#pragma once
+
+#include "json.h"
+#include "mcp_gateway.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Protocol revision reported by initialize when the client does not ask for
+// one.
+constexpr const char *kMcpProtocolVersion = "2025-06-18";
+
+// McpRpcHandler maps MCP JSON-RPC 2.0 messages onto a McpGateway. It knows
+// nothing about transports: the HTTP and stdio front ends in McpServer feed
+// it message bodies and write back whatever it returns. Safe to call from
+// several threads at once when the gateway is.
+//
+// Supported methods: initialize, ping, tools/list and tools/call. Each
+// registry operation is one tool; tools/call passes arguments.payload (or the
+// whole arguments object serialized as JSON when payload is not a string) to
+// McpGateway::execute_operation_async. Neither tools/list nor tools/call
+// rescans the registry or runs an operation on the thread that read the
+// message; that work happens on the gateway's executor.
+class McpRpcHandler {
+  public:
+    // Receives the serialized response, or an empty string when nothing needs
+    // to be sent back (notifications, or a batch of them).
+    using Reply = std::function<void(std::string)>;
+
+    explicit McpRpcHandler(McpGateway &gateway);
+
+    // Handle one message, which may be a request, a notification or a batch
+    // array. message is parsed before this returns and need not outlive the
+    // call. reply runs exactly once: inline for everything but tools/list and
+    // tools/call, otherwise on a gateway executor thread. reply must not
+    // throw.
+    void handle(std::string_view message, Reply reply);
+
+    // Blocking form of the above, for callers without an event loop.
+    std::string handle(std::string_view message);
+
+  private:
+    // Receives one request's response; respond is false for notifications.
+    using Done = std::function<void(JsonValue response, bool respond)>;
+
+    void dispatch(const JsonValue &request, Done done);
+
+    static JsonValue tools_list(const std::vector<OperationDescriptor> &operations);
+
+    McpGateway &gateway_;
+};
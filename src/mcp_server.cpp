@@ -0,0 +1,680 @@
+#include "mcp_server.h"
+
+#include "logging.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+McpServer::McpServer(McpRpcHandler &handler, Options options) : handler_(handler), options_(std::move(options)) {
+    options_.io_threads = std::max<std::size_t>(1, options_.io_threads);
+}
+
+McpServer::~McpServer() {
+    request_stop();
+    shutdown();
+}
+
+#ifndef __linux__
+bool McpServer::start(std::string &error) {
+    error = "serve requires Linux (epoll)";
+    return false;
+}
+
+void McpServer::request_stop() {}
+
+void McpServer::wait() {}
+
+void McpServer::io_loop(int) {}
+
+void McpServer::stdio_loop() {}
+
+void McpServer::shutdown() {}
+#else
+namespace {
+constexpr std::size_t kMaxHeaderBytes = 16 * 1024;
+constexpr std::size_t kReadChunk = 16 * 1024;
+constexpr int kMaxEvents = 64;
+// Requests a connection may have in flight before its input stops being
+// parsed.
+constexpr std::size_t kMaxPipelined = 32;
+
+// epoll tags for the fixed descriptors of a loop; connections are numbered
+// from kFirstConnection.
+constexpr std::uint64_t kListenTag = 0;
+constexpr std::uint64_t kStopTag = 1;
+constexpr std::uint64_t kWakeTag = 2;
+constexpr std::uint64_t kFirstConnection = 3;
+
+struct Connection {
+    int fd{-1};
+    std::string in;
+    std::string out;
+    std::size_t out_offset{0};
+    // Responses in request order; empty until the handler answers. The front
+    // one has sequence number first_seq.
+    std::deque<std::optional<std::string>> responses;
+    std::uint64_t first_seq{0};
+    // Set once a request that ends the connection is read; nothing more is
+    // read and the socket closes when every response has been written.
+    bool closing{false};
+    // Events currently registered with epoll.
+    std::uint32_t events{EPOLLIN | EPOLLRDHUP};
+};
+
+struct InboundRequest {
+    std::string method;
+    std::string target;
+    bool keep_alive{true};
+    std::string_view body;
+};
+
+enum class ParseStatus { Incomplete, Complete, Invalid };
+
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+           });
+}
+
+std::string_view trim(std::string_view value) {
+    auto start = value.find_first_not_of(" \t");
+    if (start == std::string_view::npos) {
+        return {};
+    }
+    return value.substr(start, value.find_last_not_of(" \t") - start + 1);
+}
+
+// Parse the request at the front of buffer. On Complete, consumed is its total
+// length and request.body views into buffer. On Invalid, status is the HTTP
+// error to answer with before closing.
+ParseStatus parse_request(std::string_view buffer, std::size_t max_body, InboundRequest &request, std::size_t &consumed,
+                          int &status) {
+    auto header_end = buffer.find("\r\n\r\n");
+    if (header_end == std::string_view::npos) {
+        if (buffer.size() > kMaxHeaderBytes) {
+            status = 431;
+            return ParseStatus::Invalid;
+        }
+        return ParseStatus::Incomplete;
+    }
+    status = 400;
+    auto head = buffer.substr(0, header_end);
+    auto line_end = head.find("\r\n");
+    auto request_line = head.substr(0, line_end);
+    auto first_space = request_line.find(' ');
+    auto second_space = first_space == std::string_view::npos ? first_space : request_line.find(' ', first_space + 1);
+    if (second_space == std::string_view::npos) {
+        return ParseStatus::Invalid;
+    }
+    request.method = std::string(request_line.substr(0, first_space));
+    request.target = std::string(request_line.substr(first_space + 1, second_space - first_space - 1));
+    auto version = request_line.substr(second_space + 1);
+    if (version != "HTTP/1.1" && version != "HTTP/1.0") {
+        status = 505;
+        return ParseStatus::Invalid;
+    }
+    request.keep_alive = version == "HTTP/1.1";
+
+    std::size_t content_length = 0;
+    while (line_end != std::string_view::npos) {
+        auto start = line_end + 2;
+        line_end = head.find("\r\n", start);
+        auto line = head.substr(start, line_end == std::string_view::npos ? std::string_view::npos : line_end - start);
+        auto colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            return ParseStatus::Invalid;
+        }
+        auto name = line.substr(0, colon);
+        auto value = trim(line.substr(colon + 1));
+        if (iequals(name, "Content-Length")) {
+            if (value.empty() || value.size() > 18 || value.find_first_not_of("0123456789") != std::string_view::npos) {
+                return ParseStatus::Invalid;
+            }
+            content_length = std::stoull(std::string(value));
+        } else if (iequals(name, "Transfer-Encoding")) {
+            // MCP clients send sized bodies; chunked uploads are refused
+            // rather than half supported.
+            status = 501;
+            return ParseStatus::Invalid;
+        } else if (iequals(name, "Connection")) {
+            if (iequals(value, "close")) {
+                request.keep_alive = false;
+            } else if (iequals(value, "keep-alive")) {
+                request.keep_alive = true;
+            }
+        }
+    }
+    if (content_length > max_body) {
+        status = 413;
+        return ParseStatus::Invalid;
+    }
+    auto total = header_end + 4 + content_length;
+    if (buffer.size() < total) {
+        return ParseStatus::Incomplete;
+    }
+    request.body = buffer.substr(header_end + 4, content_length);
+    consumed = total;
+    return ParseStatus::Complete;
+}
+
+const char *reason_phrase(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 202: return "Accepted";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 501: return "Not Implemented";
+    case 505: return "HTTP Version Not Supported";
+    default: return "Error";
+    }
+}
+
+void append_response(std::string &out, int status, std::string_view content_type, std::string_view body,
+                     bool keep_alive) {
+    out += "HTTP/1.1 ";
+    out += std::to_string(status);
+    out += ' ';
+    out += reason_phrase(status);
+    out += "\r\n";
+    if (!content_type.empty()) {
+        out += "Content-Type: ";
+        out += content_type;
+        out += "\r\n";
+    }
+    if (status == 405) {
+        out += "Allow: POST\r\n";
+    }
+    out += "Content-Length: ";
+    out += std::to_string(body.size());
+    out += keep_alive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+    out += body;
+}
+
+// Write as much of out as the socket takes. Returns false when the peer is
+// gone.
+bool flush(int fd, Connection &connection) {
+    while (connection.out_offset < connection.out.size()) {
+        auto n = ::send(fd, connection.out.data() + connection.out_offset, connection.out.size() - connection.out_offset,
+                        MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        connection.out_offset += static_cast<std::size_t>(n);
+    }
+    connection.out.clear();
+    connection.out_offset = 0;
+    return true;
+}
+
+bool write_all(int fd, std::string_view data) {
+    while (!data.empty()) {
+        auto n = ::write(fd, data.data(), data.size());
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data.remove_prefix(static_cast<std::size_t>(n));
+    }
+    return true;
+}
+} // namespace
+
+// Start serving. Input: none beyond the options. Output: true once every
+// thread is running. Does not throw apart from thread creation failures.
+bool McpServer::start(std::string &error) {
+    std::signal(SIGPIPE, SIG_IGN);
+    stop_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stop_fd_ < 0) {
+        error = std::string("eventfd: ") + std::strerror(errno);
+        return false;
+    }
+
+    if (options_.http) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(options_.port);
+        if (::inet_pton(AF_INET, options_.address.c_str(), &addr.sin_addr) != 1) {
+            error = "invalid listen address " + options_.address;
+            return false;
+        }
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        if (listen_fd_ < 0 || ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+            ::bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listen_fd_, SOMAXCONN) != 0) {
+            error = "cannot listen on " + options_.address + ":" + std::to_string(options_.port) + ": " +
+                    std::strerror(errno);
+            return false;
+        }
+        socklen_t length = sizeof(addr);
+        ::getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &length);
+        port_ = ntohs(addr.sin_port);
+
+        for (std::size_t i = 0; i < options_.io_threads; ++i) {
+            int epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+            // EPOLLEXCLUSIVE wakes one loop per incoming connection instead
+            // of all of them.
+            epoll_event listen_event{};
+            listen_event.events = EPOLLIN | EPOLLEXCLUSIVE;
+            listen_event.data.u64 = kListenTag;
+            epoll_event stop_event{};
+            stop_event.events = EPOLLIN;
+            stop_event.data.u64 = kStopTag;
+            if (epoll_fd < 0 || ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd_, &listen_event) != 0 ||
+                ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd_, &stop_event) != 0) {
+                error = std::string("epoll: ") + std::strerror(errno);
+                if (epoll_fd >= 0) {
+                    ::close(epoll_fd);
+                }
+                request_stop();
+                shutdown();
+                return false;
+            }
+            threads_.emplace_back([this, epoll_fd]() { io_loop(epoll_fd); });
+        }
+    }
+    if (options_.stdio) {
+        threads_.emplace_back([this]() { stdio_loop(); });
+    }
+    started_ = true;
+    return true;
+}
+
+void McpServer::request_stop() {
+    if (stop_fd_ >= 0) {
+        std::uint64_t one = 1;
+        // The counter is never read, so every loop keeps seeing it readable.
+        [[maybe_unused]] auto n = ::write(stop_fd_, &one, sizeof(one));
+    }
+}
+
+void McpServer::wait() {
+    if (started_) {
+        pollfd fd{stop_fd_, POLLIN, 0};
+        while (::poll(&fd, 1, -1) < 0 && errno == EINTR) {
+        }
+    }
+    shutdown();
+}
+
+void McpServer::shutdown() {
+    for (auto &thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+    started_ = false;
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+    if (stop_fd_ >= 0) {
+        ::close(stop_fd_);
+        stop_fd_ = -1;
+    }
+}
+
+namespace {
+// Hands finished responses from executor threads back to an I/O loop. Shared
+// with every pending callback, so it outlives the loop; once closed, late
+// responses are dropped.
+struct Mailbox {
+    struct Delivery {
+        std::uint64_t connection;
+        std::uint64_t seq;
+        std::string response;
+    };
+
+    std::mutex mutex;
+    std::vector<Delivery> deliveries;
+    int wake_fd{-1};
+    std::thread::id owner;
+    bool closed{false};
+
+    void deliver(Delivery delivery) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed) {
+            return;
+        }
+        deliveries.push_back(std::move(delivery));
+        // The loop drains its mailbox after every dispatch, so answers given
+        // inline need no wakeup.
+        if (std::this_thread::get_id() != owner) {
+            std::uint64_t one = 1;
+            [[maybe_unused]] auto n = ::write(wake_fd, &one, sizeof(one));
+        }
+    }
+};
+} // namespace
+
+// Run one I/O thread. Input: its epoll instance, which already watches the
+// listener and the stop eventfd. Connections it accepts are read and written
+// only here. Requests are handed to the handler without waiting; responses
+// come back through the loop's mailbox and are written in request order.
+void McpServer::io_loop(int epoll_fd) {
+    auto mailbox = std::make_shared<Mailbox>();
+    mailbox->owner = std::this_thread::get_id();
+    mailbox->wake_fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    epoll_event wake_event{};
+    wake_event.events = EPOLLIN;
+    wake_event.data.u64 = kWakeTag;
+    if (mailbox->wake_fd < 0 || ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, mailbox->wake_fd, &wake_event) != 0) {
+        log_error(std::string("MCP I/O loop cannot create its wakeup eventfd: ") + std::strerror(errno));
+        ::close(epoll_fd);
+        return;
+    }
+
+    std::unordered_map<std::uint64_t, Connection> connections;
+    std::uint64_t next_connection = kFirstConnection;
+    auto close_connection = [&](std::uint64_t id) {
+        auto fd = connections[id].fd;
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections.erase(id);
+    };
+    // Watch for EPOLLOUT only while output is pending, and stop watching
+    // input once the connection is closing.
+    auto update_interest = [&](std::uint64_t id, Connection &connection) {
+        std::uint32_t events = (connection.closing ? 0u : EPOLLIN | EPOLLRDHUP) | (connection.out.empty() ? 0u : EPOLLOUT);
+        if (events == connection.events) {
+            return;
+        }
+        connection.events = events;
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = id;
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+    };
+    auto respond = [](Connection &connection, std::string response) {
+        connection.responses.emplace_back(std::move(response));
+    };
+    // Parse the complete requests buffered on a connection and dispatch
+    // them, up to kMaxPipelined outstanding.
+    auto serve = [&](std::uint64_t id, Connection &connection) {
+        std::size_t offset = 0;
+        while (!connection.closing && connection.responses.size() < kMaxPipelined) {
+            InboundRequest request;
+            std::size_t consumed = 0;
+            int status = 0;
+            auto parsed = parse_request(std::string_view(connection.in).substr(offset), options_.max_body_bytes,
+                                        request, consumed, status);
+            if (parsed == ParseStatus::Incomplete) {
+                break;
+            }
+            std::string response;
+            if (parsed == ParseStatus::Invalid) {
+                append_response(response, status, "text/plain", reason_phrase(status), false);
+                respond(connection, std::move(response));
+                connection.closing = true;
+                break;
+            }
+            offset += consumed;
+            connection.closing = !request.keep_alive;
+            auto path = request.target.substr(0, request.target.find('?'));
+            if (path == "/health") {
+                append_response(response, 200, "text/plain", "ok\n", request.keep_alive);
+            } else if (path == "/metrics" && options_.metrics) {
+                append_response(response, 200, "text/plain; version=0.0.4", options_.metrics(), request.keep_alive);
+            } else if (path != "/mcp" && path != "/") {
+                append_response(response, 404, "text/plain", "not found\n", request.keep_alive);
+            } else if (request.method != "POST") {
+                append_response(response, 405, "text/plain", "use POST\n", request.keep_alive);
+            } else {
+                auto seq = connection.first_seq + connection.responses.size();
+                connection.responses.emplace_back();
+                handler_.handle(request.body, [mailbox, id, seq, keep_alive = request.keep_alive](std::string reply) {
+                    std::string response;
+                    if (reply.empty()) {
+                        append_response(response, 202, {}, {}, keep_alive);
+                    } else {
+                        append_response(response, 200, "application/json", reply, keep_alive);
+                    }
+                    mailbox->deliver({id, seq, std::move(response)});
+                });
+                continue;
+            }
+            respond(connection, std::move(response));
+        }
+        connection.in.erase(0, offset);
+    };
+    // Move answered responses at the head of the queue to the output buffer
+    // and write. Returns false when the connection should be closed.
+    auto pump = [&](std::uint64_t id, Connection &connection) {
+        while (!connection.responses.empty() && connection.responses.front()) {
+            connection.out += *connection.responses.front();
+            connection.responses.pop_front();
+            ++connection.first_seq;
+        }
+        if (!flush(connection.fd, connection)) {
+            return false;
+        }
+        if (connection.closing && connection.responses.empty() && connection.out.empty()) {
+            return false;
+        }
+        update_interest(id, connection);
+        return true;
+    };
+    auto drain_mailbox = [&]() {
+        std::vector<Mailbox::Delivery> deliveries;
+        {
+            std::lock_guard<std::mutex> lock(mailbox->mutex);
+            deliveries.swap(mailbox->deliveries);
+        }
+        for (auto &delivery : deliveries) {
+            auto it = connections.find(delivery.connection);
+            if (it == connections.end()) {
+                continue;
+            }
+            auto &connection = it->second;
+            connection.responses[delivery.seq - connection.first_seq] = std::move(delivery.response);
+            // A drained pipeline may let buffered requests through.
+            bool was_full = connection.responses.size() >= kMaxPipelined;
+            if (!pump(delivery.connection, connection)) {
+                close_connection(delivery.connection);
+                continue;
+            }
+            if (was_full && connection.responses.size() < kMaxPipelined) {
+                serve(delivery.connection, connection);
+            }
+        }
+    };
+
+    epoll_event events[kMaxEvents];
+    char buffer[kReadChunk];
+    bool running = true;
+    while (running) {
+        int ready = ::epoll_wait(epoll_fd, events, kMaxEvents, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error(std::string("epoll_wait failed: ") + std::strerror(errno));
+            break;
+        }
+        for (int i = 0; i < ready; ++i) {
+            auto tag = events[i].data.u64;
+            if (tag == kStopTag) {
+                running = false;
+                break;
+            }
+            if (tag == kWakeTag) {
+                std::uint64_t count = 0;
+                [[maybe_unused]] auto n = ::read(mailbox->wake_fd, &count, sizeof(count));
+                continue;
+            }
+            if (tag == kListenTag) {
+                while (true) {
+                    int client = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (client < 0) {
+                        // EAGAIN: another loop took it or the backlog is
+                        // empty. Anything else (EMFILE, aborted handshakes)
+                        // is retried on the next wakeup.
+                        break;
+                    }
+                    int one = 1;
+                    ::setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    auto id = next_connection++;
+                    epoll_event event{};
+                    event.events = EPOLLIN | EPOLLRDHUP;
+                    event.data.u64 = id;
+                    if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &event) != 0) {
+                        ::close(client);
+                        continue;
+                    }
+                    connections[id].fd = client;
+                }
+                continue;
+            }
+
+            auto it = connections.find(tag);
+            if (it == connections.end()) {
+                continue;
+            }
+            auto &connection = it->second;
+            if (events[i].events & EPOLLERR) {
+                close_connection(tag);
+                continue;
+            }
+            if ((events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && !connection.closing) {
+                bool peer_done = false;
+                while (true) {
+                    auto n = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+                    if (n > 0) {
+                        connection.in.append(buffer, static_cast<std::size_t>(n));
+                        continue;
+                    }
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    peer_done = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+                    break;
+                }
+                serve(tag, connection);
+                // The peer finished sending: answer what was complete, then
+                // close.
+                connection.closing = connection.closing || peer_done;
+            }
+            if (!pump(tag, connection)) {
+                close_connection(tag);
+            }
+        }
+        drain_mailbox();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mailbox->mutex);
+        mailbox->closed = true;
+        ::close(mailbox->wake_fd);
+    }
+    for (auto &entry : connections) {
+        ::close(entry.second.fd);
+    }
+    ::close(epoll_fd);
+}
+
+// Serve the stdio transport: one JSON-RPC message per input line, one reply
+// per output line. Replies are written as they complete, so they may come
+// back out of request order; clients match them by id. Polls the stop
+// eventfd alongside stdin so shutdown does not wait for input.
+void McpServer::stdio_loop() {
+    struct Output {
+        std::mutex mutex;
+        std::condition_variable idle;
+        std::size_t outstanding{0};
+        bool failed{false};
+    } output;
+    std::string pending;
+    char buffer[kReadChunk];
+    auto handle_line = [&](std::string_view line) {
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.find_first_not_of(" \t") == std::string_view::npos) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(output.mutex);
+            ++output.outstanding;
+        }
+        handler_.handle(line, [this, &output](std::string reply) {
+            std::lock_guard<std::mutex> lock(output.mutex);
+            if (!reply.empty() && !output.failed) {
+                output.failed = !write_all(options_.stdout_fd, reply + "\n");
+            }
+            if (--output.outstanding == 0) {
+                output.idle.notify_all();
+            }
+        });
+    };
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(output.mutex);
+            if (output.failed) {
+                break;
+            }
+        }
+        pollfd fds[2] = {{options_.stdin_fd, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents != 0) {
+            break;
+        }
+        auto n = ::read(options_.stdin_fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            handle_line(pending);
+            // The client hung up; nothing else keeps a stdio server alive.
+            log_info("MCP stdio input closed; stopping server");
+            request_stop();
+            break;
+        }
+        pending.append(buffer, static_cast<std::size_t>(n));
+        std::size_t start = 0;
+        for (auto newline = pending.find('\n'); newline != std::string::npos; newline = pending.find('\n', start)) {
+            handle_line(std::string_view(pending).substr(start, newline - start));
+            start = newline + 1;
+        }
+        pending.erase(0, start);
+    }
+    // Replies still running reference output; let them finish.
+    std::unique_lock<std::mutex> lock(output.mutex);
+    output.idle.wait(lock, [&output]() { return output.outstanding == 0; });
+}
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "mcp_rpc.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// McpServer is the long-running front end behind `cpp-mcp-gateway serve`. It
+// accepts MCP JSON-RPC over HTTP and over stdio and hands every message to one
+// shared McpRpcHandler, so all clients hit the same warm gateway.
+//
+// HTTP is served by a few I/O threads, each running its own non-blocking
+// epoll loop over the shared listening socket. A connection stays on the
+// thread that accepted it, is kept alive across requests (HTTP/1.1 rules),
+// and may pipeline. Operations run on the gateway's executor, never on an
+// I/O thread; their responses are written back in request order. Messages
+// are POSTed to /mcp (or /); GET /health answers "ok". The stdio transport
+// reads newline-delimited JSON-RPC from stdin and writes one response line
+// per reply to stdout; end of input stops the server. Requires Linux;
+// elsewhere start() fails.
+class McpServer {
+  public:
+    struct Options {
+        bool http{true};
+        bool stdio{false};
+        std::string address{"127.0.0.1"};
+        // 0 binds an ephemeral port; port() reports the one chosen.
+        std::uint16_t port{8080};
+        std::size_t io_threads{2};
+        // Larger request bodies get 413 and the connection is closed.
+        std::size_t max_body_bytes{4 * 1024 * 1024};
+        int stdin_fd{0};
+        int stdout_fd{1};
+        // When set, GET /metrics answers with its text (Prometheus format).
+        // Called on an I/O thread, so it must be cheap.
+        std::function<std::string()> metrics;
+    };
+
+    McpServer(McpRpcHandler &handler, Options options);
+
+    // Stop and join every thread.
+    ~McpServer();
+
+    McpServer(const McpServer &) = delete;
+    McpServer &operator=(const McpServer &) = delete;
+
+    // Bind the listener and start the I/O and stdio threads. Returns false and
+    // sets error when the socket cannot be set up.
+    bool start(std::string &error);
+
+    // Port the HTTP listener is bound to, valid after start().
+    std::uint16_t port() const { return port_; }
+
+    // Ask every loop to exit. Only performs a write(2), so it is safe to call
+    // from a signal handler.
+    void request_stop();
+
+    // Block until request_stop() is called or stdin reaches end of input,
+    // then join the threads and close every socket.
+    void wait();
+
+  private:
+    void io_loop(int epoll_fd);
+    void stdio_loop();
+    void shutdown();
+
+    McpRpcHandler &handler_;
+    Options options_;
+    int listen_fd_{-1};
+    int stop_fd_{-1};
+    std::uint16_t port_{0};
+    std::vector<std::thread> threads_;
+    std::atomic<bool> started_{false};
+};
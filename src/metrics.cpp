@@ -6,6 +6,8 @@ void MetricsRegistry::record_registration_failure() { ++registrations_failed_; }
 
 void MetricsRegistry::record_registration_validation_failure() { ++registrations_validation_failed_; }
 
+void MetricsRegistry::record_registration_deduplicated() { ++registrations_deduplicated_; }
+
 void MetricsRegistry::record_generation_enqueued() { ++generation_enqueued_; }
 
 void MetricsRegistry::record_generation_queue_full() { ++generation_queue_full_; }
@@ -14,6 +16,14 @@ void MetricsRegistry::record_generation_success() { ++generation_success_; }
 
 void MetricsRegistry::record_generation_failure() { ++generation_failure_; }
 
+void MetricsRegistry::record_generation_coalesced() { ++generation_coalesced_; }
+
+void MetricsRegistry::record_generation_unchanged() { ++generation_unchanged_; }
+
+void MetricsRegistry::record_generation_incremental() { ++generation_incremental_; }
+
+void MetricsRegistry::record_generation_shared() { ++generation_shared_; }
+
 void MetricsRegistry::record_generation_latency_ms(long long duration_ms) {
     generation_latency_ms_total_ += duration_ms;
     ++generation_latency_samples_;
@@ -25,6 +35,16 @@ void MetricsRegistry::record_registry_load(long long duration_ms) {
     ++registry_load_latency_samples_;
 }
 
+void MetricsRegistry::record_registry_refresh_skipped() { ++registry_refresh_skipped_; }
+
+void MetricsRegistry::record_registry_kits_parsed(long long count) { registry_kits_parsed_ += count; }
+
+void MetricsRegistry::record_registry_scan_phases(long long walk_us, long long read_us, long long build_us) {
+    registry_scan_walk_us_total_ += walk_us;
+    registry_scan_read_us_total_ += read_us;
+    registry_scan_build_us_total_ += build_us;
+}
+
 void MetricsRegistry::record_mcp_list_request() { ++mcp_list_requests_; }
 
 void MetricsRegistry::record_mcp_execute_request() { ++mcp_execute_requests_; }
@@ -40,20 +60,57 @@ void MetricsRegistry::record_mcp_execute_latency_ms(long long duration_ms) {
     ++mcp_execute_latency_samples_;
 }
 
+void MetricsRegistry::record_mcp_execute_queue_wait_ms(long long duration_ms) {
+    ++mcp_execute_queued_;
+    mcp_execute_queue_wait_ms_total_ += duration_ms;
+}
+
+void MetricsRegistry::record_mcp_execute_queue_timeout() { ++mcp_execute_queue_timeouts_; }
+
+void MetricsRegistry::set_mcp_admission_state(long long limit, long long queue_depth) {
+    mcp_concurrency_limit_ = limit;
+    mcp_execute_queue_depth_ = queue_depth;
+}
+
+void MetricsRegistry::record_downstream_request() { ++downstream_requests_; }
+
+void MetricsRegistry::record_downstream_failure() { ++downstream_failures_; }
+
+void MetricsRegistry::record_downstream_timeout() { ++downstream_timeouts_; }
+
+void MetricsRegistry::record_downstream_connection_opened() { ++downstream_connections_opened_; }
+
+void MetricsRegistry::record_downstream_connection_reused() { ++downstream_connections_reused_; }
+
+void MetricsRegistry::adjust_downstream_connections(long long open_delta, long long idle_delta) {
+    downstream_connections_open_ += open_delta;
+    downstream_connections_idle_ += idle_delta;
+}
+
 MetricsSnapshot MetricsRegistry::snapshot() const {
     MetricsSnapshot snapshot;
     snapshot.registrations_total = registrations_total_.load();
     snapshot.registrations_failed = registrations_failed_.load();
     snapshot.registrations_validation_failed = registrations_validation_failed_.load();
+    snapshot.registrations_deduplicated = registrations_deduplicated_.load();
     snapshot.generation_enqueued = generation_enqueued_.load();
     snapshot.generation_queue_full = generation_queue_full_.load();
     snapshot.generation_success = generation_success_.load();
     snapshot.generation_failure = generation_failure_.load();
+    snapshot.generation_coalesced = generation_coalesced_.load();
+    snapshot.generation_unchanged = generation_unchanged_.load();
+    snapshot.generation_incremental = generation_incremental_.load();
+    snapshot.generation_shared = generation_shared_.load();
     snapshot.generation_latency_ms_total = generation_latency_ms_total_.load();
     snapshot.generation_latency_samples = generation_latency_samples_.load();
     snapshot.registry_loads = registry_loads_.load();
     snapshot.registry_load_latency_ms_total = registry_load_latency_ms_total_.load();
     snapshot.registry_load_latency_samples = registry_load_latency_samples_.load();
+    snapshot.registry_refresh_skipped = registry_refresh_skipped_.load();
+    snapshot.registry_kits_parsed = registry_kits_parsed_.load();
+    snapshot.registry_scan_walk_us_total = registry_scan_walk_us_total_.load();
+    snapshot.registry_scan_read_us_total = registry_scan_read_us_total_.load();
+    snapshot.registry_scan_build_us_total = registry_scan_build_us_total_.load();
     snapshot.mcp_list_requests = mcp_list_requests_.load();
     snapshot.mcp_execute_requests = mcp_execute_requests_.load();
     snapshot.mcp_execute_success = mcp_execute_success_.load();
@@ -61,6 +118,18 @@ MetricsSnapshot MetricsRegistry::snapshot() const {
     snapshot.mcp_execute_rejected = mcp_execute_rejected_.load();
     snapshot.mcp_execute_latency_ms_total = mcp_execute_latency_ms_total_.load();
     snapshot.mcp_execute_latency_samples = mcp_execute_latency_samples_.load();
+    snapshot.mcp_execute_queued = mcp_execute_queued_.load();
+    snapshot.mcp_execute_queue_wait_ms_total = mcp_execute_queue_wait_ms_total_.load();
+    snapshot.mcp_execute_queue_timeouts = mcp_execute_queue_timeouts_.load();
+    snapshot.mcp_concurrency_limit = mcp_concurrency_limit_.load();
+    snapshot.mcp_execute_queue_depth = mcp_execute_queue_depth_.load();
+    snapshot.downstream_requests = downstream_requests_.load();
+    snapshot.downstream_failures = downstream_failures_.load();
+    snapshot.downstream_timeouts = downstream_timeouts_.load();
+    snapshot.downstream_connections_opened = downstream_connections_opened_.load();
+    snapshot.downstream_connections_reused = downstream_connections_reused_.load();
+    snapshot.downstream_connections_open = downstream_connections_open_.load();
+    snapshot.downstream_connections_idle = downstream_connections_idle_.load();
     return snapshot;
 }
 
@@ -70,15 +139,25 @@ std::string MetricsRegistry::to_prometheus() const {
     out << "cpp_mcp_registrations_total " << snapshot.registrations_total << "\n";
     out << "cpp_mcp_registrations_failed_total " << snapshot.registrations_failed << "\n";
     out << "cpp_mcp_registrations_validation_failed_total " << snapshot.registrations_validation_failed << "\n";
+    out << "cpp_mcp_registrations_deduplicated_total " << snapshot.registrations_deduplicated << "\n";
     out << "cpp_mcp_generation_enqueued_total " << snapshot.generation_enqueued << "\n";
     out << "cpp_mcp_generation_queue_full_total " << snapshot.generation_queue_full << "\n";
     out << "cpp_mcp_generation_success_total " << snapshot.generation_success << "\n";
     out << "cpp_mcp_generation_failure_total " << snapshot.generation_failure << "\n";
+    out << "cpp_mcp_generation_coalesced_total " << snapshot.generation_coalesced << "\n";
+    out << "cpp_mcp_generation_unchanged_total " << snapshot.generation_unchanged << "\n";
+    out << "cpp_mcp_generation_incremental_total " << snapshot.generation_incremental << "\n";
+    out << "cpp_mcp_generation_shared_total " << snapshot.generation_shared << "\n";
     out << "cpp_mcp_generation_latency_ms_total " << snapshot.generation_latency_ms_total << "\n";
     out << "cpp_mcp_generation_latency_ms_count " << snapshot.generation_latency_samples << "\n";
     out << "cpp_mcp_registry_loads_total " << snapshot.registry_loads << "\n";
     out << "cpp_mcp_registry_load_latency_ms_total " << snapshot.registry_load_latency_ms_total << "\n";
     out << "cpp_mcp_registry_load_latency_ms_count " << snapshot.registry_load_latency_samples << "\n";
+    out << "cpp_mcp_registry_refresh_skipped_total " << snapshot.registry_refresh_skipped << "\n";
+    out << "cpp_mcp_registry_kits_parsed_total " << snapshot.registry_kits_parsed << "\n";
+    out << "cpp_mcp_registry_scan_walk_us_total " << snapshot.registry_scan_walk_us_total << "\n";
+    out << "cpp_mcp_registry_scan_read_us_total " << snapshot.registry_scan_read_us_total << "\n";
+    out << "cpp_mcp_registry_scan_build_us_total " << snapshot.registry_scan_build_us_total << "\n";
     out << "cpp_mcp_mcp_list_requests_total " << snapshot.mcp_list_requests << "\n";
     out << "cpp_mcp_mcp_execute_requests_total " << snapshot.mcp_execute_requests << "\n";
     out << "cpp_mcp_mcp_execute_success_total " << snapshot.mcp_execute_success << "\n";
@@ -86,5 +165,17 @@ std::string MetricsRegistry::to_prometheus() const {
     out << "cpp_mcp_mcp_execute_rejected_total " << snapshot.mcp_execute_rejected << "\n";
     out << "cpp_mcp_mcp_execute_latency_ms_total " << snapshot.mcp_execute_latency_ms_total << "\n";
     out << "cpp_mcp_mcp_execute_latency_ms_count " << snapshot.mcp_execute_latency_samples << "\n";
+    out << "cpp_mcp_mcp_execute_queue_wait_ms_total " << snapshot.mcp_execute_queue_wait_ms_total << "\n";
+    out << "cpp_mcp_mcp_execute_queue_wait_ms_count " << snapshot.mcp_execute_queued << "\n";
+    out << "cpp_mcp_mcp_execute_queue_timeouts_total " << snapshot.mcp_execute_queue_timeouts << "\n";
+    out << "cpp_mcp_mcp_execute_queue_depth " << snapshot.mcp_execute_queue_depth << "\n";
+    out << "cpp_mcp_mcp_concurrency_limit " << snapshot.mcp_concurrency_limit << "\n";
+    out << "cpp_mcp_downstream_requests_total " << snapshot.downstream_requests << "\n";
+    out << "cpp_mcp_downstream_failures_total " << snapshot.downstream_failures << "\n";
+    out << "cpp_mcp_downstream_timeouts_total " << snapshot.downstream_timeouts << "\n";
+    out << "cpp_mcp_downstream_connections_opened_total " << snapshot.downstream_connections_opened << "\n";
+    out << "cpp_mcp_downstream_connections_reused_total " << snapshot.downstream_connections_reused << "\n";
+    out << "cpp_mcp_downstream_connections_open " << snapshot.downstream_connections_open << "\n";
+    out << "cpp_mcp_downstream_connections_idle " << snapshot.downstream_connections_idle << "\n";
     return out.str();
 }
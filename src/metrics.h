@@ -8,15 +8,25 @@ struct MetricsSnapshot {
     long long registrations_total{0};
     long long registrations_failed{0};
     long long registrations_validation_failed{0};
+    long long registrations_deduplicated{0};
     long long generation_enqueued{0};
     long long generation_queue_full{0};
     long long generation_success{0};
     long long generation_failure{0};
+    long long generation_coalesced{0};
+    long long generation_unchanged{0};
+    long long generation_incremental{0};
+    long long generation_shared{0};
     long long generation_latency_ms_total{0};
     long long generation_latency_samples{0};
     long long registry_loads{0};
     long long registry_load_latency_ms_total{0};
     long long registry_load_latency_samples{0};
+    long long registry_refresh_skipped{0};
+    long long registry_kits_parsed{0};
+    long long registry_scan_walk_us_total{0};
+    long long registry_scan_read_us_total{0};
+    long long registry_scan_build_us_total{0};
     long long mcp_list_requests{0};
     long long mcp_execute_requests{0};
     long long mcp_execute_success{0};
@@ -24,6 +34,18 @@ struct MetricsSnapshot {
     long long mcp_execute_rejected{0};
     long long mcp_execute_latency_ms_total{0};
     long long mcp_execute_latency_samples{0};
+    long long mcp_execute_queued{0};
+    long long mcp_execute_queue_wait_ms_total{0};
+    long long mcp_execute_queue_timeouts{0};
+    long long mcp_concurrency_limit{0};
+    long long mcp_execute_queue_depth{0};
+    long long downstream_requests{0};
+    long long downstream_failures{0};
+    long long downstream_timeouts{0};
+    long long downstream_connections_opened{0};
+    long long downstream_connections_reused{0};
+    long long downstream_connections_open{0};
+    long long downstream_connections_idle{0};
 };
 
 class MetricsRegistry {
@@ -31,18 +53,37 @@ class MetricsRegistry {
     void record_registration_attempt();
     void record_registration_failure();
     void record_registration_validation_failure();
+    void record_registration_deduplicated();
     void record_generation_enqueued();
     void record_generation_queue_full();
     void record_generation_success();
     void record_generation_failure();
+    void record_generation_coalesced();
+    void record_generation_unchanged();
+    void record_generation_incremental();
+    void record_generation_shared();
     void record_generation_latency_ms(long long duration_ms);
     void record_registry_load(long long duration_ms);
+    void record_registry_refresh_skipped();
+    void record_registry_kits_parsed(long long count);
+    void record_registry_scan_phases(long long walk_us, long long read_us, long long build_us);
     void record_mcp_list_request();
     void record_mcp_execute_request();
     void record_mcp_execute_success();
     void record_mcp_execute_not_found();
     void record_mcp_execute_rejected();
     void record_mcp_execute_latency_ms(long long duration_ms);
+    void record_mcp_execute_queue_wait_ms(long long duration_ms);
+    void record_mcp_execute_queue_timeout();
+    // Gauges: the current adaptive limit and the number of waiting calls.
+    void set_mcp_admission_state(long long limit, long long queue_depth);
+    void record_downstream_request();
+    void record_downstream_failure();
+    void record_downstream_timeout();
+    void record_downstream_connection_opened();
+    void record_downstream_connection_reused();
+    // Gauges: pooled downstream connections (idle ones included in open).
+    void adjust_downstream_connections(long long open_delta, long long idle_delta);
 
     MetricsSnapshot snapshot() const;
     std::string to_prometheus() const;
@@ -51,15 +92,25 @@ class MetricsRegistry {
     std::atomic<long long> registrations_total_{0};
     std::atomic<long long> registrations_failed_{0};
     std::atomic<long long> registrations_validation_failed_{0};
+    std::atomic<long long> registrations_deduplicated_{0};
     std::atomic<long long> generation_enqueued_{0};
     std::atomic<long long> generation_queue_full_{0};
     std::atomic<long long> generation_success_{0};
     std::atomic<long long> generation_failure_{0};
+    std::atomic<long long> generation_coalesced_{0};
+    std::atomic<long long> generation_unchanged_{0};
+    std::atomic<long long> generation_incremental_{0};
+    std::atomic<long long> generation_shared_{0};
     std::atomic<long long> generation_latency_ms_total_{0};
     std::atomic<long long> generation_latency_samples_{0};
     std::atomic<long long> registry_loads_{0};
     std::atomic<long long> registry_load_latency_ms_total_{0};
     std::atomic<long long> registry_load_latency_samples_{0};
+    std::atomic<long long> registry_refresh_skipped_{0};
+    std::atomic<long long> registry_kits_parsed_{0};
+    std::atomic<long long> registry_scan_walk_us_total_{0};
+    std::atomic<long long> registry_scan_read_us_total_{0};
+    std::atomic<long long> registry_scan_build_us_total_{0};
     std::atomic<long long> mcp_list_requests_{0};
     std::atomic<long long> mcp_execute_requests_{0};
     std::atomic<long long> mcp_execute_success_{0};
@@ -67,4 +118,16 @@ class MetricsRegistry {
     std::atomic<long long> mcp_execute_rejected_{0};
     std::atomic<long long> mcp_execute_latency_ms_total_{0};
     std::atomic<long long> mcp_execute_latency_samples_{0};
+    std::atomic<long long> mcp_execute_queued_{0};
+    std::atomic<long long> mcp_execute_queue_wait_ms_total_{0};
+    std::atomic<long long> mcp_execute_queue_timeouts_{0};
+    std::atomic<long long> mcp_concurrency_limit_{0};
+    std::atomic<long long> mcp_execute_queue_depth_{0};
+    std::atomic<long long> downstream_requests_{0};
+    std::atomic<long long> downstream_failures_{0};
+    std::atomic<long long> downstream_timeouts_{0};
+    std::atomic<long long> downstream_connections_opened_{0};
+    std::atomic<long long> downstream_connections_reused_{0};
+    std::atomic<long long> downstream_connections_open_{0};
+    std::atomic<long long> downstream_connections_idle_{0};
 };
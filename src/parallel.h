@@ -0,0 +1,90 @@
+#pragma once
+
+#include "work_stealing_executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Run fn(i) for every i in [0, count) on up to workers threads. Indices are
+// handed out through a shared counter so slow items do not stall a fixed
+// partition. fn must not throw.
+//
+// The calling thread always takes part. Without pool the other workers are
+// threads started for this call; with pool they are tasks posted to it, so a
+// caller that runs often (a registry rescan) starts no threads. Helpers the
+// pool gets to only after the caller has run out of indices do nothing, so
+// the caller only waits for helpers already running, never for a busy pool,
+// even when it is one of the pool's threads.
+template <typename Fn>
+void parallel_for(std::size_t count, std::size_t workers, Fn fn, WorkStealingExecutor *pool = nullptr) {
+    workers = std::max<std::size_t>(1, std::min(workers, count));
+    if (workers == 1) {
+        for (std::size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+    if (!pool) {
+        std::atomic<std::size_t> next{0};
+        auto run = [&next, count, &fn]() {
+            for (auto i = next++; i < count; i = next++) {
+                fn(i);
+            }
+        };
+        std::vector<std::thread> threads;
+        threads.reserve(workers - 1);
+        for (std::size_t w = 1; w < workers; ++w) {
+            threads.emplace_back(run);
+        }
+        run();
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        return;
+    }
+
+    // Shared with the posted helpers, which may outlive this call; fn is only
+    // reached while the call is open.
+    struct State {
+        std::atomic<std::size_t> next{0};
+        std::size_t count{0};
+        Fn *fn{nullptr};
+        std::mutex mutex;
+        std::condition_variable idle;
+        std::size_t running{0};
+        bool closed{false};
+    };
+    auto state = std::make_shared<State>();
+    state->count = count;
+    state->fn = &fn;
+    for (std::size_t w = 1; w < workers; ++w) {
+        pool->post([state]() {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->closed) {
+                    return;
+                }
+                ++state->running;
+            }
+            for (auto i = state->next++; i < state->count; i = state->next++) {
+                (*state->fn)(i);
+            }
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (--state->running == 0) {
+                state->idle.notify_all();
+            }
+        });
+    }
+    for (auto i = state->next++; i < count; i = state->next++) {
+        fn(i);
+    }
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->closed = true;
+    state->idle.wait(lock, [&state]() { return state->running == 0; });
+}
@@ -1,10 +1,54 @@
 #include "registration_service.h"
 
 #include "filesystem_utils.h"
+#include "hash_utils.h"
 #include "logging.h"
+#include "parallel.h"
 
-#include <fstream>
-#include <sstream>
+#include <cerrno>
+#include <set>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Remove the hidden link keep_previous made, if any.
+void drop_previous(fs::path &previous) {
+    if (!previous.empty()) {
+        std::error_code ignored;
+        fs::remove(previous, ignored);
+        previous.clear();
+    }
+}
+
+// Hold on to what destination names before it is relinked. Inputs: the
+// versioned name and where to record the hidden link kept to its old blob.
+// Output: false with ec set when the old content could not be kept; previous
+// stays empty when destination did not exist.
+bool keep_previous(const fs::path &destination, fs::path &previous, std::error_code &ec) {
+    if (!fs::exists(destination, ec)) {
+        return !ec;
+    }
+    previous = temp_path_for(destination);
+    fs::create_hard_link(destination, previous, ec);
+    if (ec) {
+        ec.clear();
+        fs::copy_file(destination, previous, ec);
+    }
+    if (ec) {
+        drop_previous(previous);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
 
 // Build a registration service configured with a mappings directory, an
 // optional generation queue, and a validation strategy. Only allocation-related
@@ -16,80 +60,214 @@ RegistrationService::RegistrationService(fs::path mappings_root,
     : mappings_root_(std::move(mappings_root)),
       generator_(std::move(generator)),
       metrics_(std::move(metrics)),
-      validator_(std::move(validator)) {}
+      validator_(std::move(validator)),
+      store_(mappings_root_) {}
 
-// Validate and persist a specification. Inputs: version string and source file
-// path. Output: RegistrationResult containing success flag, message, and stored
-// path. Explicitly avoids throwing; errors are surfaced in the result object,
-// though filesystem or allocation exceptions could still propagate.
-RegistrationResult RegistrationService::register_spec(const std::string &version, const fs::path &source_path) {
+// Validate and persist a specification. Inputs: version string, source file
+// path and generation priority. Output: RegistrationResult containing success
+// flag, message, and stored path. Explicitly avoids throwing; errors are
+// surfaced in the result object, though filesystem or allocation exceptions
+// could still propagate.
+RegistrationResult RegistrationService::register_spec(const std::string &version,
+                                                      const fs::path &source_path,
+                                                      GenerationPriority priority) {
     if (metrics_) {
         metrics_->record_registration_attempt();
     }
     // Early validation ensures clear error messages before touching the
     // filesystem.
     if (version.empty()) {
-        if (metrics_) {
-            metrics_->record_registration_failure();
-        }
-        return {false, "Version is required", {}};
+        return fail("Version is required");
+    }
+    fs::path previous;
+    auto result = persist_file(version, source_path, previous);
+    if (result.ok && generator_ && !generator_->enqueue({version, result.stored_path, priority})) {
+        reject_unqueued(result, previous);
+    }
+    drop_previous(previous);
+    return result;
+}
+
+// Validate and persist a streamed specification. Inputs: version string, the
+// file name to store it under, a readable descriptor and generation priority.
+// Output: as for register_spec.
+RegistrationResult RegistrationService::register_stream(const std::string &version,
+                                                        const std::string &file_name,
+                                                        int fd,
+                                                        GenerationPriority priority) {
+    if (metrics_) {
+        metrics_->record_registration_attempt();
     }
+    if (version.empty()) {
+        return fail("Version is required");
+    }
+    fs::path previous;
+    auto result = persist(version, file_name, fd, previous);
+    if (result.ok && generator_ && !generator_->enqueue({version, result.stored_path, priority})) {
+        reject_unqueued(result, previous);
+    }
+    drop_previous(previous);
+    return result;
+}
 
-    if (!fs::exists(source_path)) {
-        if (metrics_) {
-            metrics_->record_registration_failure();
+// Register a batch of specs. Inputs: version, source paths, priority and the
+// number of persist threads. Output: one result per source, in input order.
+// Validation and persistence run in parallel; generation is enqueued for all
+// accepted specs under a single queue lock afterwards.
+std::vector<RegistrationResult> RegistrationService::register_specs(const std::string &version,
+                                                                    const std::vector<fs::path> &sources,
+                                                                    GenerationPriority priority,
+                                                                    std::size_t workers) {
+    std::vector<RegistrationResult> results(sources.size());
+    if (metrics_) {
+        for (std::size_t i = 0; i < sources.size(); ++i) {
+            metrics_->record_registration_attempt();
         }
-        return {false, "Spec file not found: " + source_path.string(), {}};
     }
-
-    std::error_code content_ec = std::error_code{};
-    std::string content;
-    if(!read_file(source_path, content, content_ec)) {
-        log_error("Error reading spec file " + source_path.string() + ": " + content_ec.message());
-        if (metrics_) {
-            metrics_->record_registration_failure();
+    if (version.empty()) {
+        for (auto &result : results) {
+            result = fail("Version is required");
         }
-        return {false, "Failed to read spec file", {}};
+        return results;
     }
 
-    auto validation = validator_.validate(content);
-    if (!validation.ok) {
-        log_error("Validation failed for spec " + source_path.string() + ": " + validation.message);
-        if (metrics_) {
-            metrics_->record_registration_validation_failure();
-            metrics_->record_registration_failure();
+    // Two sources with the same file name would race for one mapping; the
+    // first one in the batch wins, deterministically.
+    std::vector<bool> duplicate(sources.size(), false);
+    std::set<fs::path> names;
+    for (std::size_t i = 0; i < sources.size(); ++i) {
+        duplicate[i] = !names.insert(sources[i].filename()).second;
+    }
+    std::vector<fs::path> previous(sources.size());
+    parallel_for(sources.size(), workers, [&](std::size_t i) {
+        results[i] = duplicate[i] ? fail("Duplicate spec file name in batch: " + sources[i].filename().string())
+                                  : persist_file(version, sources[i], previous[i]);
+    });
+
+    if (generator_) {
+        std::vector<GenerationTask> tasks;
+        std::vector<std::size_t> owners;
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            if (results[i].ok) {
+                tasks.push_back({version, results[i].stored_path, priority});
+                owners.push_back(i);
+            }
+        }
+        auto accepted = generator_->enqueue_batch(tasks);
+        for (std::size_t t = 0; t < tasks.size(); ++t) {
+            if (!accepted[t]) {
+                reject_unqueued(results[owners[t]], previous[owners[t]]);
+            }
         }
-        return {false, validation.message, {}};
+    }
+    for (auto &path : previous) {
+        drop_previous(path);
+    }
+    return results;
+}
+
+RegistrationResult RegistrationService::persist_file(const std::string &version, const fs::path &source_path,
+                                                     fs::path &previous) {
+    if (!fs::exists(source_path)) {
+        return fail("Spec file not found: " + source_path.string());
+    }
+
+#ifdef _WIN32
+    int fd = ::_wopen(source_path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    int fd = ::open(source_path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+    if (fd < 0) {
+        log_error("Error reading spec file " + source_path.string() + ": " + std::generic_category().message(errno));
+        return fail("Failed to read spec file");
+    }
+    auto result = persist(version, source_path.filename().string(), fd, previous);
+#ifdef _WIN32
+    ::_close(fd);
+#else
+    ::close(fd);
+#endif
+    return result;
+}
+
+RegistrationResult RegistrationService::persist(const std::string &version, const std::string &file_name, int fd,
+                                                fs::path &previous) {
+    // The name becomes a path component under mappings/, so it must not
+    // contain separators or refer to a directory.
+    if (file_name.empty() || file_name == "." || file_name == ".." ||
+        fs::path(file_name).filename().string() != file_name) {
+        return fail("Invalid spec file name: " + file_name);
     }
 
     fs::path target_dir = mappings_root_ / version;
     if (!ensure_directory(target_dir)) {
-        if (metrics_) {
-            metrics_->record_registration_failure();
-        }
-        return {false, "Unable to create mappings directory", {}};
+        return fail("Unable to create mappings directory");
     }
 
-    fs::path destination = target_dir / source_path.filename();
-    if (!copy_file_to(source_path, destination)) {
+    // Validate, hash and write in a single pass. The bytes land in a hidden
+    // temp file that replaces the stored spec only once the whole upload has
+    // been accepted, so an invalid upload never clobbers the previous one.
+    fs::path destination = target_dir / file_name;
+    fs::path partial = temp_path_for(destination);
+    auto validation = validator_.stream();
+    auto hash = kFnv1aSeed;
+    std::uint64_t size = 0;
+    std::error_code ec;
+    bool copied = stream_to_file(fd, partial, [&](std::string_view chunk) {
+        hash = fnv1a_64(chunk, hash);
+        size += chunk.size();
+        return validation.feed(chunk);
+    }, ec);
+    auto verdict = validation.finish();
+    if (!verdict.ok) {
+        fs::remove(partial, ec);
+        log_error("Validation failed for spec " + file_name + ": " + verdict.message);
         if (metrics_) {
-            metrics_->record_registration_failure();
+            metrics_->record_registration_validation_failure();
         }
-        return {false, "Failed to persist spec to mappings", {}};
+        return fail(verdict.message);
+    }
+    if (!copied) {
+        log_error("Error streaming spec " + file_name + " to " + partial.string() + ": " + ec.message());
+        fs::remove(partial, ec);
+        return fail("Failed to persist spec to mappings");
+    }
+    // Identical content, under this or any other version, is stored once;
+    // the versioned name is a hard link to its blob.
+    auto address = content_address(hash, size);
+    bool deduplicated = false;
+    if (!store_.adopt(partial, address, deduplicated, ec) || !keep_previous(destination, previous, ec) ||
+        !store_.link(address, destination, ec)) {
+        drop_previous(previous);
+        log_error("Failed to store " + destination.string() + " as blob " + address + ": " + ec.message());
+        return fail("Failed to persist spec to mappings");
+    }
+    if (deduplicated && metrics_) {
+        metrics_->record_registration_deduplicated();
     }
 
     log_info("Registered spec " + destination.string());
+    return {true, "Registration accepted", destination, to_hex(hash), deduplicated};
+}
 
-    if (generator_) {
-        // Enqueue generation asynchronously so registration returns quickly.
-        if (!generator_->enqueue({version, destination})) {
-            fs::remove(destination);
-            if (metrics_) {
-                metrics_->record_registration_failure();
-            }
-            return {false, "Generation queue is full; try again later", {}};
-        }
+// Undo a persisted registration whose generation could not be queued, so the
+// caller can retry it later: the name goes back to the content it had before,
+// or away when it is new.
+void RegistrationService::reject_unqueued(RegistrationResult &result, fs::path &previous) {
+    std::error_code ec;
+    if (previous.empty()) {
+        fs::remove(result.stored_path, ec);
+    } else if (publish_file(previous, result.stored_path, ec)) {
+        previous.clear();
+    } else {
+        log_error("Failed to restore " + result.stored_path.string() + ": " + ec.message());
     }
+    result = fail("Generation queue is full; try again later");
+}
 
-    return {true, "Registration accepted", destination};
+RegistrationResult RegistrationService::fail(std::string message) {
+    if (metrics_) {
+        metrics_->record_registration_failure();
+    }
+    return {false, std::move(message), {}, {}, false};
 }
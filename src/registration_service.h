@@ -1,5 +1,6 @@
 #pragma once
 
+#include "content_store.h"
 #include "generation_queue.h"
 #include "metrics.h"
 #include "spec_validation.h"
@@ -7,6 +8,8 @@
 #include <filesystem>
 #include <memory>
 #include <string>
+#include <system_error>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -14,6 +17,11 @@ struct RegistrationResult {
     bool ok{false};
     std::string message;
     fs::path stored_path;
+    // FNV-1a of the stored bytes, in hex; empty when registration failed.
+    std::string content_hash;
+    // True when identical content was already stored, possibly under another
+    // version, and the new name was linked to it instead of stored again.
+    bool deduplicated{false};
 };
 
 class RegistrationService {
@@ -27,12 +35,46 @@ class RegistrationService {
                         SpecValidator validator = SpecValidator());
 
     // Persist and validate a spec for a version. On success, the spec is
-    // copied into the mappings directory and a generation task is enqueued.
-    RegistrationResult register_spec(const std::string &version, const fs::path &source_path);
+    // stored in the mappings blob store, linked as
+    // mappings/<version>/<file name>, and a generation task is enqueued with
+    // the given scheduling priority.
+    RegistrationResult register_spec(const std::string &version,
+                                     const fs::path &source_path,
+                                     GenerationPriority priority = GenerationPriority::Normal);
+
+    // Register a spec read from fd, which may be a file, pipe or socket, and
+    // store it as file_name under the version's mappings directory. The spec
+    // is validated, hashed and written in one pass over fixed-size chunks, so
+    // memory use does not grow with the spec. fd is not closed.
+    RegistrationResult register_stream(const std::string &version,
+                                       const std::string &file_name,
+                                       int fd,
+                                       GenerationPriority priority = GenerationPriority::Normal);
+
+    // Register many specs for one version, e.g. when onboarding a directory.
+    // Files are validated and persisted on up to workers threads; accepted
+    // specs are then enqueued together through GenerationQueue::enqueue_batch.
+    // Returns one result per source, in order.
+    std::vector<RegistrationResult> register_specs(const std::string &version,
+                                                   const std::vector<fs::path> &sources,
+                                                   GenerationPriority priority = GenerationPriority::Normal,
+                                                   std::size_t workers = 4);
 
   private:
+    // Validate and store a spec without enqueuing generation. The attempt
+    // has already been counted and the version checked. When the name
+    // already held a spec, previous is set to a hidden link to it, which the
+    // caller removes once the registration is settled.
+    RegistrationResult persist(const std::string &version, const std::string &file_name, int fd,
+                               fs::path &previous);
+    RegistrationResult persist_file(const std::string &version, const fs::path &source_path, fs::path &previous);
+
+    void reject_unqueued(RegistrationResult &result, fs::path &previous);
+    RegistrationResult fail(std::string message);
+
     fs::path mappings_root_;
     std::shared_ptr<GenerationQueue> generator_;
     std::shared_ptr<MetricsRegistry> metrics_;
     SpecValidator validator_;
+    ContentStore store_;
 };
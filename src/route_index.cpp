@@ -0,0 +1,260 @@
+#include "route_index.h"
+
+#include "hash_utils.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+namespace {
+constexpr char kMagic[8] = {'M', 'C', 'P', 'R', 'I', 'D', 'X', '\0'};
+constexpr std::uint32_t kByteOrderMark = 0x01020304;
+constexpr std::size_t kHeaderSize = 64;
+constexpr std::size_t kEntrySize = 6 * sizeof(std::uint32_t);
+
+// On-disk header. Copied in and out with memcpy so the mapping needs no
+// particular alignment.
+struct Header {
+    char magic[8];
+    std::uint32_t format_version;
+    std::uint32_t byte_order;
+    std::uint32_t entry_count;
+    std::uint32_t reserved;
+    std::uint64_t strings_size;
+    std::uint64_t checksum;
+    std::uint64_t manifest_size;
+    std::int64_t manifest_mtime;
+    std::uint64_t stamp_hash;
+};
+static_assert(sizeof(Header) == kHeaderSize, "route index header layout changed");
+
+void append_u32(std::string &out, std::uint32_t value) {
+    char bytes[sizeof(value)];
+    std::memcpy(bytes, &value, sizeof(value));
+    out.append(bytes, sizeof(value));
+}
+
+std::uint32_t read_u32(const char *data) {
+    std::uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+} // namespace
+
+// Serialize records into a binary route index. Inputs: destination path, the
+// records in precedence order (later duplicates win) and the provenance for
+// the header. Output: true when the index was published. Only allocation
+// failures may throw.
+bool write_route_index(const fs::path &path,
+                       const std::vector<RouteIndexRecord> &records,
+                       const RouteIndexSource &source) {
+    // Resolve duplicates and sort by operation id in one pass.
+    std::map<std::string_view, const RouteIndexRecord *> ordered;
+    for (const auto &record : records) {
+        ordered[record.operation_id] = &record;
+    }
+
+    std::string strings;
+    std::map<std::string_view, std::uint32_t> shared_offsets;
+    auto intern = [&strings, &shared_offsets](std::string_view value) {
+        // Versions and kit names repeat on every entry; store them once.
+        auto it = shared_offsets.find(value);
+        if (it != shared_offsets.end()) {
+            return it->second;
+        }
+        auto offset = static_cast<std::uint32_t>(strings.size());
+        strings.append(value.data(), value.size());
+        shared_offsets.emplace(value, offset);
+        return offset;
+    };
+
+    std::string body;
+    body.reserve(ordered.size() * kEntrySize);
+    for (const auto &item : ordered) {
+        const auto &record = *item.second;
+        auto op_offset = static_cast<std::uint32_t>(strings.size());
+        strings.append(record.operation_id);
+        append_u32(body, op_offset);
+        append_u32(body, static_cast<std::uint32_t>(record.operation_id.size()));
+        append_u32(body, intern(record.version));
+        append_u32(body, static_cast<std::uint32_t>(record.version.size()));
+        append_u32(body, intern(record.kit_name));
+        append_u32(body, static_cast<std::uint32_t>(record.kit_name.size()));
+    }
+    body += strings;
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.format_version = kRouteIndexFormatVersion;
+    header.byte_order = kByteOrderMark;
+    header.entry_count = static_cast<std::uint32_t>(ordered.size());
+    header.strings_size = strings.size();
+    header.checksum = fnv1a_64(body);
+    header.manifest_size = source.manifest_size;
+    header.manifest_mtime = source.manifest_mtime;
+    header.stamp_hash = source.stamp_hash;
+
+    std::string content(reinterpret_cast<const char *>(&header), sizeof(header));
+    content += body;
+    // write_file renames a sibling temp file into place, so a reader that
+    // already mapped the previous index never sees it truncated underneath.
+    return write_file(path, content);
+}
+
+// Map and validate an index. Input: path. Output: the index, or nullptr when
+// the file is absent or fails any structural or checksum check. Does not
+// throw apart from allocation failures.
+std::shared_ptr<const RouteIndex> RouteIndex::open(const fs::path &path) {
+    std::shared_ptr<RouteIndex> index(new RouteIndex());
+    std::error_code ec;
+    if (!index->file_.open(path, ec)) {
+        return nullptr;
+    }
+
+    const auto size = index->file_.size();
+    if (size < kHeaderSize) {
+        return nullptr;
+    }
+    Header header;
+    std::memcpy(&header, index->file_.data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.format_version != kRouteIndexFormatVersion ||
+        header.byte_order != kByteOrderMark) {
+        return nullptr;
+    }
+
+    const std::uint64_t entries_size = static_cast<std::uint64_t>(header.entry_count) * kEntrySize;
+    if (size - kHeaderSize != entries_size + header.strings_size) {
+        return nullptr;
+    }
+    std::string_view body(index->file_.data() + kHeaderSize, size - kHeaderSize);
+    if (fnv1a_64(body) != header.checksum) {
+        log_error("Route index checksum mismatch: " + path.string());
+        return nullptr;
+    }
+
+    index->entries_ = body.data();
+    index->strings_ = body.data() + entries_size;
+    index->count_ = header.entry_count;
+    index->source_ = {header.manifest_size, header.manifest_mtime, header.stamp_hash};
+
+    // Reject offsets that point outside the string table up front so lookups
+    // never need bounds checks.
+    for (std::size_t i = 0; i < index->count_; ++i) {
+        const char *raw = index->entries_ + i * kEntrySize;
+        for (int field = 0; field < 3; ++field) {
+            std::uint64_t offset = read_u32(raw + field * 8);
+            std::uint64_t length = read_u32(raw + field * 8 + 4);
+            if (offset + length > header.strings_size) {
+                return nullptr;
+            }
+        }
+    }
+    return index;
+}
+
+std::string_view RouteIndex::string_at(std::uint32_t offset, std::uint32_t length) const {
+    return {strings_ + offset, length};
+}
+
+RouteIndex::Entry RouteIndex::entry(std::size_t position) const {
+    const char *raw = entries_ + position * kEntrySize;
+    return {string_at(read_u32(raw), read_u32(raw + 4)),
+            string_at(read_u32(raw + 8), read_u32(raw + 12)),
+            string_at(read_u32(raw + 16), read_u32(raw + 20))};
+}
+
+// Binary search the sorted entry array. Input: operation id. Output: the entry
+// when present. Allocation free and non-throwing.
+std::optional<RouteIndex::Entry> RouteIndex::find(std::string_view operation_id) const {
+    std::size_t low = 0;
+    std::size_t high = count_;
+    while (low < high) {
+        auto mid = low + (high - low) / 2;
+        const char *raw = entries_ + mid * kEntrySize;
+        auto key = string_at(read_u32(raw), read_u32(raw + 4));
+        auto cmp = key.compare(operation_id);
+        if (cmp == 0) {
+            return entry(mid);
+        }
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return std::nullopt;
+}
+
+// Extract the operation ids listed in a generated manifest. Input: manifest
+// path. Output: ids in file order; empty when the file is missing.
+std::vector<std::string> read_manifest_operations(const fs::path &manifest_path) {
+    std::vector<std::string> operation_ids;
+    std::ifstream manifest(manifest_path);
+    std::string line;
+    const std::string prefix = "operation:";
+    while (std::getline(manifest, line)) {
+        if (line.rfind(prefix, 0) == 0) {
+            operation_ids.push_back(line.substr(prefix.size()));
+        }
+    }
+    return operation_ids;
+}
+
+// Build the merged root index. Input: client kit root. Output: true when the
+// merged index was written. Kits are visited in path order so duplicate
+// operation ids resolve exactly as RuntimeRegistry resolves them.
+bool build_merged_route_index(const fs::path &clientkit_root) {
+    std::error_code ec;
+    if (!fs::is_directory(clientkit_root, ec)) {
+        return false;
+    }
+
+    // Read the stamp before walking: a generation that lands mid-walk bumps
+    // the stamp and makes this index stale rather than silently incomplete.
+    auto stamp = read_generation_stamp(clientkit_root);
+
+    std::map<fs::path, std::string> kits;
+    for (const auto &version_entry : fs::directory_iterator(clientkit_root, ec)) {
+        if (!version_entry.is_directory()) {
+            continue;
+        }
+        for (const auto &kit_entry : fs::directory_iterator(version_entry.path(), ec)) {
+            // Hidden entries are kits still being staged by the generator.
+            if (kit_entry.path().filename().string().front() != '.' && kit_entry.is_directory()) {
+                kits.emplace(kit_entry.path(), version_entry.path().filename().string());
+            }
+        }
+    }
+
+    std::vector<RouteIndexRecord> records;
+    for (const auto &kit : kits) {
+        auto manifest_path = kit.first / "manifest.txt";
+        auto size = fs::file_size(manifest_path, ec);
+        if (ec) {
+            continue;
+        }
+        auto mtime = fs::last_write_time(manifest_path, ec);
+        if (ec) {
+            continue;
+        }
+        auto kit_name = kit.first.filename().string();
+        auto kit_index = RouteIndex::open(kit.first / kRouteIndexFile);
+        if (kit_index && kit_index->source().manifest_size == size &&
+            kit_index->source().manifest_mtime == file_time_ticks(mtime)) {
+            for (std::size_t i = 0; i < kit_index->size(); ++i) {
+                records.push_back({std::string(kit_index->entry(i).operation_id), kit.second, kit_name});
+            }
+            continue;
+        }
+        for (auto &op_id : read_manifest_operations(manifest_path)) {
+            records.push_back({std::move(op_id), kit.second, kit_name});
+        }
+    }
+
+    RouteIndexSource source;
+    source.stamp_hash = stamp.empty() ? 0 : fnv1a_64(stamp);
+    return write_route_index(clientkit_root / kRouteIndexFile, records, source);
+}
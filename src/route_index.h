@@ -0,0 +1,99 @@
+#pragma once
+
+#include "filesystem_utils.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// File name of the per-kit binary route index written next to manifest.txt,
+// and of the optional merged index written at the client kit root.
+inline constexpr const char *kRouteIndexFile = "routes.idx";
+
+// Bumped whenever the on-disk layout changes; readers reject other versions.
+inline constexpr std::uint32_t kRouteIndexFormatVersion = 1;
+
+// One operation as stored in a route index.
+struct RouteIndexRecord {
+    std::string operation_id;
+    std::string version;
+    std::string kit_name;
+};
+
+// Provenance stored in the index header. Per-kit indexes record the size and
+// mtime of the manifest they were written alongside so a hand-edited manifest
+// invalidates the index. The merged index records a hash of the generation
+// stamp it was built against.
+struct RouteIndexSource {
+    std::uint64_t manifest_size{0};
+    std::int64_t manifest_mtime{0};
+    std::uint64_t stamp_hash{0};
+};
+
+// Convert a file time into the tick count stored in index headers.
+inline std::int64_t file_time_ticks(fs::file_time_type time) {
+    return static_cast<std::int64_t>(time.time_since_epoch().count());
+}
+
+// Serialize records into a route index at path. Layout (host byte order):
+//   header  magic "MCPRIDX", format version, byte-order mark, entry count,
+//           string table size, FNV-1a checksum of everything after the
+//           header, and the RouteIndexSource fields;
+//   entries fixed-size (offset, length) triples for operation id, version and
+//           kit name, sorted by operation id;
+//   strings concatenated string table the entries point into.
+// Duplicate operation ids keep the last record. Returns false on I/O failure.
+bool write_route_index(const fs::path &path,
+                       const std::vector<RouteIndexRecord> &records,
+                       const RouteIndexSource &source);
+
+// Immutable, memory-mapped route index. Lookups are binary searches over the
+// mapped entry array and return views into the mapping, so serving a lookup
+// allocates nothing. Views stay valid for the lifetime of the RouteIndex.
+class RouteIndex {
+  public:
+    struct Entry {
+        std::string_view operation_id;
+        std::string_view version;
+        std::string_view kit_name;
+    };
+
+    // Map and validate the index at path. Returns nullptr when the file is
+    // missing, truncated, of another format version, or fails its checksum.
+    static std::shared_ptr<const RouteIndex> open(const fs::path &path);
+
+    std::size_t size() const { return count_; }
+    Entry entry(std::size_t position) const;
+    std::optional<Entry> find(std::string_view operation_id) const;
+    const RouteIndexSource &source() const { return source_; }
+
+    // Base of the string table. Every view returned by entry() points into
+    // it, so callers can store compact offsets instead of views.
+    const char *string_table() const { return strings_; }
+
+  private:
+    RouteIndex() = default;
+
+    std::string_view string_at(std::uint32_t offset, std::uint32_t length) const;
+
+    MappedFile file_;
+    const char *entries_{nullptr};
+    const char *strings_{nullptr};
+    std::size_t count_{0};
+    RouteIndexSource source_;
+};
+
+// Read the operation ids listed in a generated manifest.txt.
+std::vector<std::string> read_manifest_operations(const fs::path &manifest_path);
+
+// Build the merged index at <clientkit_root>/routes.idx from every kit under
+// the root, preferring each kit's own index and falling back to its manifest.
+// The merged index is tagged with the current generation stamp so readers can
+// tell when a later generation made it stale. Returns false on I/O failure.
+bool build_merged_route_index(const fs::path &clientkit_root);
@@ -0,0 +1,31 @@
+#include "route_table.h"
+
+// Allocate an empty bucket array for count keys. Capacity is the smallest
+// power of two that keeps the load factor at or below one half, which keeps
+// linear probe sequences short. Only allocation failures may throw.
+void RouteTable::reset(std::size_t count) {
+    buckets_.clear();
+    mask_ = 0;
+    if (count == 0) {
+        return;
+    }
+    std::size_t capacity = 8;
+    while (capacity < count * 2) {
+        capacity <<= 1;
+    }
+    buckets_.assign(capacity, Bucket{});
+    mask_ = capacity - 1;
+}
+
+// Place a position in the first free bucket of its probe sequence. Callers
+// guarantee unique keys, so no equality check is needed while building.
+void RouteTable::insert(std::uint64_t h, std::uint32_t position) {
+    for (std::size_t i = h & mask_;; i = (i + 1) & mask_) {
+        auto &bucket = buckets_[i];
+        if (bucket.position == kEmpty) {
+            bucket.fragment = fragment_of(h);
+            bucket.position = position;
+            return;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// RouteTable is a flat, open-addressing hash index from operation ids to
+// positions in a caller-owned dense array. Buckets are eight bytes (a hash
+// fragment plus a position) in one contiguous vector probed linearly, so a
+// lookup touches a single cache line in the common case and never allocates.
+// Keys are not stored: the table asks the caller for the key at a position,
+// which lets the key bytes live wherever the owner keeps them (a mapped route
+// index, an arena, ...). The table is immutable after build().
+class RouteTable {
+  public:
+    // Index count keys. key_at(i) must return the key for position i and keep
+    // returning the same bytes for the table's lifetime. Keys must be unique.
+    template <typename KeyAt>
+    void build(std::size_t count, KeyAt key_at) {
+        reset(count);
+        for (std::size_t position = 0; position < count; ++position) {
+            insert(hash(key_at(position)), static_cast<std::uint32_t>(position));
+        }
+    }
+
+    // Return the position of key, or nullopt when it is not present.
+    template <typename KeyAt>
+    std::optional<std::size_t> find(std::string_view key, KeyAt key_at) const {
+        if (buckets_.empty()) {
+            return std::nullopt;
+        }
+        auto h = hash(key);
+        auto fragment = fragment_of(h);
+        for (std::size_t i = h & mask_;; i = (i + 1) & mask_) {
+            const auto &bucket = buckets_[i];
+            if (bucket.position == kEmpty) {
+                return std::nullopt;
+            }
+            if (bucket.fragment == fragment && key_at(bucket.position) == key) {
+                return bucket.position;
+            }
+        }
+    }
+
+    std::size_t capacity() const { return buckets_.size(); }
+
+    static std::uint64_t hash(std::string_view key) { return std::hash<std::string_view>{}(key); }
+
+  private:
+    static constexpr std::uint32_t kEmpty = 0xFFFFFFFFu;
+
+    struct Bucket {
+        std::uint32_t fragment{0};
+        std::uint32_t position{kEmpty};
+    };
+
+    static std::uint32_t fragment_of(std::uint64_t h) { return static_cast<std::uint32_t>(h >> 32); }
+
+    // Size the bucket array to a power of two at most half full.
+    void reset(std::size_t count);
+
+    void insert(std::uint64_t h, std::uint32_t position);
+
+    std::vector<Bucket> buckets_;
+    std::size_t mask_{0};
+};
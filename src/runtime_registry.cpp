@@ -1,97 +1,549 @@
 #include "runtime_registry.h"
 
+#include "filesystem_utils.h"
+#include "hash_utils.h"
+#include "parallel.h"
+
+#include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <map>
 #include <sstream>
+#include <thread>
+#include <utility>
+
+namespace {
+// An operation gathered during a scan, before the snapshot arrays are laid out.
+struct PendingOperation {
+    std::string_view operation_id;
+    std::uint32_t kit{0};
+};
+
+// Register a kit in the snapshot's kit table. Inputs: snapshot, the kit state
+// that owns the manifest path, and the base its operation ids are relative to.
+std::uint32_t add_kit(RuntimeRegistry::Snapshot &snapshot, const RuntimeRegistry::KitState *state, const char *strings) {
+    RuntimeRegistry::Snapshot::KitRecord record;
+    record.version_id = snapshot.names.intern(state->version);
+    record.name_id = snapshot.names.intern(state->kit_name);
+    record.strings = strings;
+    record.state = state;
+    snapshot.kit_table.push_back(record);
+    return static_cast<std::uint32_t>(snapshot.kit_table.size() - 1);
+}
+
+// Sort pending operations by id, drop shadowed duplicates, lay the survivors
+// out as the snapshot's struct of arrays and index them. Pending operations
+// arrive in kit path order and the stable sort preserves it among equal ids,
+// so keeping the last of each run matches the historical "last kit wins"
+// resolution.
+void assemble_operations(RuntimeRegistry::Snapshot &snapshot, std::vector<PendingOperation> pending) {
+    std::stable_sort(pending.begin(), pending.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs.operation_id < rhs.operation_id;
+    });
+
+    std::size_t unique = 0;
+    for (std::size_t i = 0; i < pending.size(); ++i) {
+        if (i + 1 == pending.size() || pending[i + 1].operation_id != pending[i].operation_id) {
+            ++unique;
+        }
+    }
+    snapshot.op_kit.reserve(unique);
+    snapshot.op_offset.reserve(unique);
+    snapshot.op_length.reserve(unique);
+    for (std::size_t i = 0; i < pending.size(); ++i) {
+        if (i + 1 < pending.size() && pending[i + 1].operation_id == pending[i].operation_id) {
+            continue;
+        }
+        const auto &op = pending[i];
+        snapshot.op_kit.push_back(op.kit);
+        snapshot.op_offset.push_back(static_cast<std::uint32_t>(op.operation_id.data() - snapshot.kit_table[op.kit].strings));
+        snapshot.op_length.push_back(static_cast<std::uint32_t>(op.operation_id.size()));
+    }
+
+    const auto &view = snapshot;
+    snapshot.table.build(snapshot.size(), [&view](std::size_t i) { return view.operation_id(i); });
+}
+
+// Lay out the operation arrays of a snapshot from its kit map. Kits are
+// visited in path order, which fixes duplicate resolution.
+void build_operations(RuntimeRegistry::Snapshot &snapshot) {
+    std::vector<PendingOperation> pending;
+    for (const auto &entry : snapshot.kits) {
+        const auto *kit = entry.second.get();
+        auto kit_id = add_kit(snapshot, kit, kit->strings());
+        if (kit->index) {
+            for (std::size_t i = 0; i < kit->index->size(); ++i) {
+                pending.push_back({kit->index->entry(i).operation_id, kit_id});
+            }
+        }
+        std::uint32_t begin = 0;
+        for (auto end : kit->id_ends) {
+            pending.push_back({std::string_view(kit->id_arena.data() + begin, end - begin), kit_id});
+            begin = end;
+        }
+    }
+    assemble_operations(snapshot, std::move(pending));
+}
+
+long long elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Build the state for one kit directory whose manifest has the given size and
+// mtime. Prefers the generator's binary index and falls back to the manifest
+// text when the index is missing or was not written alongside it.
+std::shared_ptr<const RuntimeRegistry::KitState> read_kit(const fs::path &kit_dir, std::uintmax_t size, fs::file_time_type mtime) {
+    auto kit = std::make_shared<RuntimeRegistry::KitState>();
+    kit->version = kit_dir.parent_path().filename().string();
+    kit->kit_name = kit_dir.filename().string();
+    kit->manifest_path = kit_dir / "manifest.txt";
+    kit->manifest_mtime = mtime;
+    kit->manifest_size = size;
+    auto index = RouteIndex::open(kit_dir / kRouteIndexFile);
+    if (index && index->source().manifest_size == size && index->source().manifest_mtime == file_time_ticks(mtime)) {
+        kit->index = std::move(index);
+    } else {
+        if (!std::ifstream(kit->manifest_path)) {
+            // Unreadable for now, e.g. permissions; leave it out of the
+            // snapshot so the next scan tries again instead of caching a kit
+            // without operations.
+            log_error("Unable to read manifest " + kit->manifest_path.string() + "; skipping kit");
+            return nullptr;
+        }
+        // Pack the parsed ids into one arena instead of one string each.
+        for (const auto &op_id : read_manifest_operations(kit->manifest_path)) {
+            kit->id_arena += op_id;
+            kit->id_ends.push_back(static_cast<std::uint32_t>(kit->id_arena.size()));
+        }
+        kit->id_arena.shrink_to_fit();
+    }
+    return kit;
+}
+} // namespace
 
 // Create a registry rooted at a client kit directory. The constructor stores
-// the path by value; only allocation failures could throw.
+// the path by value and publishes an empty snapshot; only allocation failures
+// could throw.
 RuntimeRegistry::RuntimeRegistry(fs::path clientkit_root, std::shared_ptr<MetricsRegistry> metrics)
-    : clientkit_root_(std::move(clientkit_root)), metrics_(std::move(metrics)) {}
+    : clientkit_root_(std::move(clientkit_root)),
+      metrics_(std::move(metrics)),
+      current_(std::make_shared<const Snapshot>()) {}
+
+// Copy a registry. The published snapshot is immutable, so the copy simply
+// shares it; the reload lock is never shared.
+RuntimeRegistry::RuntimeRegistry(const RuntimeRegistry &other)
+    : clientkit_root_(other.clientkit_root_),
+      metrics_(other.metrics_),
+      current_(other.snapshot()),
+      last_load_latency_ms_(other.last_load_latency_ms_.load()),
+      scan_workers_(other.scan_workers_.load()),
+      scan_executor_(std::atomic_load(&other.scan_executor_)) {}
 
-// Refresh the registry from disk. No parameters; repopulates the internal map
-// and logs informative messages. Returns void. Uses non-throwing filesystem
-// operations where possible, but standard library exceptions may propagate if
-// allocations fail.
+RuntimeRegistry &RuntimeRegistry::operator=(const RuntimeRegistry &other) {
+    if (this != &other) {
+        std::lock_guard<std::mutex> lock(reload_mutex_);
+        clientkit_root_ = other.clientkit_root_;
+        metrics_ = other.metrics_;
+        publish(other.snapshot());
+        last_load_latency_ms_ = other.last_load_latency_ms_.load();
+        scan_workers_ = other.scan_workers_.load();
+        std::atomic_store(&scan_executor_, std::atomic_load(&other.scan_executor_));
+    }
+    return *this;
+}
+
+void RuntimeRegistry::set_scan_workers(std::size_t workers) {
+    scan_workers_ = std::max<std::size_t>(1, workers);
+}
+
+void RuntimeRegistry::set_scan_executor(std::shared_ptr<WorkStealingExecutor> executor) {
+    std::atomic_store(&scan_executor_, std::move(executor));
+}
+
+// Refresh the registry from disk. No parameters; re-parses every manifest,
+// publishes a new snapshot and logs informative messages. Returns void. Uses
+// non-throwing filesystem operations where possible, but standard library
+// exceptions may propagate if allocations fail.
 void RuntimeRegistry::load() {
+    std::lock_guard<std::mutex> lock(reload_mutex_);
     auto start = std::chrono::steady_clock::now();
-    // Clear previous state to guarantee the registry reflects the filesystem on
-    // every invocation.
-    operations_.clear();
-    if (!fs::exists(clientkit_root_)) {
-        log_info("No clientkit directory found at " + clientkit_root_.string());
-        auto end = std::chrono::steady_clock::now();
-        last_load_latency_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    // Read the stamp before scanning so a generation that lands mid-scan is
+    // picked up by the next refresh.
+    auto stamp = read_generation_stamp(clientkit_root_);
+    auto next = open_merged(stamp);
+    if (!next) {
+        bool changed = false;
+        next = scan(*snapshot(), true, changed);
+    }
+    next->generation_stamp = std::move(stamp);
+    auto count = next->size();
+    publish(std::move(next));
+    record_load_latency(start);
+    log_info("Loaded " + std::to_string(count) + " operations from client kits");
+}
+
+// Incrementally refresh the registry. No parameters; returns true when a new
+// snapshot with changed operations was published. The stamp comparison runs
+// without locks, the walk is skipped when the stamp matches the published
+// snapshot, and concurrent callers never queue up behind an in-flight reload.
+// Exceptions follow the same rules as load().
+bool RuntimeRegistry::is_current() const {
+    auto stamp = read_generation_stamp(clientkit_root_);
+    auto current = snapshot();
+    return current->loaded && !stamp.empty() && stamp == current->generation_stamp;
+}
+
+bool RuntimeRegistry::refresh() {
+    auto stamp = read_generation_stamp(clientkit_root_);
+    auto current = snapshot();
+    if (current->loaded && !stamp.empty() && stamp == current->generation_stamp) {
         if (metrics_) {
-            metrics_->record_registry_load(last_load_latency_ms_);
+            metrics_->record_registry_refresh_skipped();
         }
-        return;
+        return false;
     }
 
-    for (const auto &version_entry : fs::directory_iterator(clientkit_root_)) {
-        if (!version_entry.is_directory()) {
-            continue;
+    std::unique_lock<std::mutex> lock(reload_mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        // Another thread is already rebuilding; keep serving the current
+        // snapshot rather than blocking the request path.
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    // Re-read under the lock: the previous writer may have just published.
+    stamp = read_generation_stamp(clientkit_root_);
+    current = snapshot();
+    if (current->loaded && !stamp.empty() && stamp == current->generation_stamp) {
+        return false;
+    }
+
+    bool changed = true;
+    auto next = open_merged(stamp);
+    if (!next) {
+        next = scan(*current, false, changed);
+    }
+    next->generation_stamp = std::move(stamp);
+    auto count = next->size();
+    publish(std::move(next));
+    record_load_latency(start);
+    if (changed) {
+        log_debug("Refreshed registry; " + std::to_string(count) + " operations from client kits");
+    }
+    return changed;
+}
+
+// Patch the published snapshot with one kit. Input: the kit delta from a
+// completed generation. Output: true when a new snapshot was published. The
+// only filesystem access is a stat of the kit's manifest, recorded so later
+// refreshes treat the kit as up to date. Exceptions follow load().
+bool RuntimeRegistry::apply_kit(const KitDelta &delta) {
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+    auto current = snapshot();
+    if (!current->loaded || current->merged) {
+        // Nothing to patch yet, or the snapshot is served from the merged
+        // index; the next refresh picks the kit up from disk.
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto kit_dir = clientkit_root_ / delta.version / delta.kit_name;
+    std::error_code ec;
+    auto manifest_path = kit_dir / "manifest.txt";
+    auto size = fs::file_size(manifest_path, ec);
+    if (ec) {
+        return false;
+    }
+    auto mtime = fs::last_write_time(manifest_path, ec);
+    if (ec) {
+        return false;
+    }
+
+    auto kit = std::make_shared<KitState>();
+    kit->version = delta.version;
+    kit->kit_name = delta.kit_name;
+    kit->manifest_path = manifest_path;
+    kit->manifest_mtime = mtime;
+    kit->manifest_size = size;
+    for (const auto &op_id : delta.operation_ids) {
+        kit->id_arena += op_id;
+        kit->id_ends.push_back(static_cast<std::uint32_t>(kit->id_arena.size()));
+    }
+    kit->id_arena.shrink_to_fit();
+
+    auto next = std::make_shared<Snapshot>();
+    next->loaded = true;
+    next->kits = current->kits;
+    next->kits[kit_dir] = std::move(kit);
+    build_operations(*next);
+    next->timings = current->timings;
+    // Adopt the new stamp only when this generation is the sole change since
+    // the snapshot was taken; otherwise keep the old stamp so the next
+    // refresh reconciles whatever else happened.
+    next->generation_stamp = (!delta.stamp.empty() && delta.previous_stamp == current->generation_stamp)
+                                 ? delta.stamp
+                                 : current->generation_stamp;
+    auto count = next->size();
+    publish(std::move(next));
+    record_load_latency(start);
+    log_debug("Applied generated kit " + delta.version + "/" + delta.kit_name + "; " + std::to_string(count) +
+              " operations in registry");
+    return true;
+}
+
+std::shared_ptr<const RuntimeRegistry::Snapshot> RuntimeRegistry::snapshot() const {
+    return std::atomic_load(&current_);
+}
+
+// Try to serve a snapshot from the merged root index. Input: the generation
+// stamp read for this pass. Output: a snapshot, or nullptr when the merged
+// index is missing, invalid, or was built against a different stamp. Slots
+// point straight into the mapping; only one KitState per kit is allocated.
+std::shared_ptr<RuntimeRegistry::Snapshot> RuntimeRegistry::open_merged(const std::string &stamp) const {
+    if (stamp.empty()) {
+        return nullptr;
+    }
+    auto merged = RouteIndex::open(clientkit_root_ / kRouteIndexFile);
+    if (!merged || merged->source().stamp_hash != fnv1a_64(stamp)) {
+        return nullptr;
+    }
+    auto next = std::make_shared<Snapshot>();
+    next->loaded = true;
+
+    std::map<std::pair<std::string_view, std::string_view>, std::uint32_t> kits;
+    std::vector<PendingOperation> pending;
+    pending.reserve(merged->size());
+    for (std::size_t i = 0; i < merged->size(); ++i) {
+        auto entry = merged->entry(i);
+        auto inserted = kits.emplace(std::make_pair(entry.version, entry.kit_name), 0);
+        if (inserted.second) {
+            auto state = std::make_shared<KitState>();
+            state->version = std::string(entry.version);
+            state->kit_name = std::string(entry.kit_name);
+            state->manifest_path = clientkit_root_ / state->version / state->kit_name / "manifest.txt";
+            inserted.first->second = add_kit(*next, state.get(), merged->string_table());
+            next->merged_kits.push_back(std::move(state));
         }
-        auto version = version_entry.path().filename().string();
-        for (const auto &kit_entry : fs::directory_iterator(version_entry)) {
-            if (!kit_entry.is_directory()) {
-                continue;
-            }
-            auto kit_name = kit_entry.path().filename().string();
-            auto manifest_path = kit_entry.path() / "manifest.txt";
-            if (!fs::exists(manifest_path)) {
-                // Skip partially generated or invalid kits that do not include a
-                // manifest file.
-                continue;
-            }
+        pending.push_back({entry.operation_id, inserted.first->second});
+    }
+    // The merged index is already unique and sorted, so assembling keeps its
+    // order and only lays out the arrays and the table.
+    assemble_operations(*next, std::move(pending));
+    next->merged = std::move(merged);
+    return next;
+}
+
+void RuntimeRegistry::publish(std::shared_ptr<const Snapshot> next) {
+    std::atomic_store(&current_, std::move(next));
+}
+
+// Build the snapshot that follows current. Inputs: the published snapshot, a
+// force flag that bypasses the manifest stamp comparison, and an out flag set
+// when any kit was added, removed or re-parsed. Unchanged kits are shared with
+// the previous snapshot rather than copied.
+std::shared_ptr<RuntimeRegistry::Snapshot> RuntimeRegistry::scan(const Snapshot &current, bool force, bool &changed) const {
+    auto next = std::make_shared<Snapshot>();
+    next->loaded = true;
+    changed = false;
+
+    std::error_code ec;
+    if (!fs::exists(clientkit_root_, ec)) {
+        log_info("No clientkit directory found at " + clientkit_root_.string());
+        changed = !current.kits.empty();
+        return next;
+    }
 
-            std::ifstream manifest(manifest_path);
-            std::string line;
-            while (std::getline(manifest, line)) {
-                const std::string prefix = "operation:";
-                if (line.rfind(prefix, 0) == 0) {
-                    auto op_id = line.substr(prefix.size());
-                    OperationDescriptor descriptor{version, kit_name, op_id, manifest_path};
-                    operations_[op_id] = descriptor;
+    const auto workers = scan_workers_.load();
+    const auto pool = std::atomic_load(&scan_executor_);
+    auto phase_start = std::chrono::steady_clock::now();
+
+    // Phase 1: directory walk. Version directories are listed in parallel and
+    // the kit list is sorted afterwards so results never depend on scheduling.
+    std::vector<fs::path> version_dirs;
+    for (fs::directory_iterator it(clientkit_root_, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->is_directory(ec)) {
+            version_dirs.push_back(it->path());
+        }
+    }
+    std::vector<std::vector<fs::path>> kits_per_version(version_dirs.size());
+    // parallel_for bodies must not throw, so each one catches what the
+    // filesystem or allocator raises and drops only the item it was on.
+    parallel_for(version_dirs.size(), workers, [&version_dirs, &kits_per_version](std::size_t i) {
+        try {
+            std::error_code walk_ec;
+            for (fs::directory_iterator it(version_dirs[i], walk_ec), end; !walk_ec && it != end;
+                 it.increment(walk_ec)) {
+                // Hidden entries are kits still being staged by the generator.
+                if (it->path().filename().string().front() != '.' && it->is_directory(walk_ec)) {
+                    kits_per_version[i].push_back(it->path());
                 }
             }
+        } catch (const std::exception &e) {
+            log_error("Skipping version directory " + version_dirs[i].string() + ": " + e.what());
+            kits_per_version[i].clear();
         }
+    }, pool.get());
+    std::vector<fs::path> kit_dirs;
+    for (auto &kits : kits_per_version) {
+        kit_dirs.insert(kit_dirs.end(), std::make_move_iterator(kits.begin()), std::make_move_iterator(kits.end()));
     }
+    std::sort(kit_dirs.begin(), kit_dirs.end());
+    next->timings.walk_us = elapsed_us(phase_start);
+
+    // Phase 2: manifest read. Each worker stats its kits and either reuses the
+    // cached state or maps the route index / parses the manifest.
+    phase_start = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<const KitState>> results(kit_dirs.size());
+    std::vector<char> reparsed(kit_dirs.size(), 0);
+    auto read_scanned_kit = [&](std::size_t i) {
+        std::error_code kit_ec;
+        const auto &kit_dir = kit_dirs[i];
+        auto manifest_path = kit_dir / "manifest.txt";
+        auto size = fs::file_size(manifest_path, kit_ec);
+        if (kit_ec) {
+            // Skip partially generated or invalid kits that do not include a
+            // manifest file.
+            return;
+        }
+        auto mtime = fs::last_write_time(manifest_path, kit_ec);
+        if (kit_ec) {
+            return;
+        }
 
+        auto cached = current.kits.find(kit_dir);
+        if (!force && cached != current.kits.end() && cached->second->manifest_size == size &&
+            cached->second->manifest_mtime == mtime) {
+            results[i] = cached->second;
+            return;
+        }
+        results[i] = read_kit(kit_dir, size, mtime);
+        reparsed[i] = results[i] != nullptr;
+    };
+    parallel_for(kit_dirs.size(), workers, [&](std::size_t i) {
+        try {
+            read_scanned_kit(i);
+        } catch (const std::exception &e) {
+            log_error("Skipping client kit " + kit_dirs[i].string() + ": " + e.what());
+            results[i] = nullptr;
+            reparsed[i] = 0;
+        }
+    }, pool.get());
+
+    long long parsed = 0;
+    for (std::size_t i = 0; i < kit_dirs.size(); ++i) {
+        if (!results[i]) {
+            continue;
+        }
+        next->kits.emplace(kit_dirs[i], std::move(results[i]));
+        if (reparsed[i]) {
+            ++parsed;
+            changed = true;
+        }
+    }
+    next->timings.read_us = elapsed_us(phase_start);
+
+    // A snapshot served from the merged index has its arrays pointing into
+    // that index, which next does not keep, so they are always rebuilt.
+    changed = changed || current.merged != nullptr;
+    // Any kit that disappeared from disk also counts as a change.
+    for (const auto &entry : current.kits) {
+        if (next->kits.find(entry.first) == next->kits.end()) {
+            changed = true;
+            break;
+        }
+    }
+
+    // Phase 3: index build.
+    phase_start = std::chrono::steady_clock::now();
+    if (changed || force) {
+        build_operations(*next);
+    } else {
+        // Same kits as before: the arrays and table still point at them.
+        next->op_kit = current.op_kit;
+        next->op_offset = current.op_offset;
+        next->op_length = current.op_length;
+        next->kit_table = current.kit_table;
+        next->names = current.names;
+        next->table = current.table;
+    }
+    next->timings.build_us = elapsed_us(phase_start);
+    next->timings.kits = next->kits.size();
+    next->timings.workers = workers;
+
+    if (metrics_) {
+        if (parsed > 0) {
+            metrics_->record_registry_kits_parsed(parsed);
+        }
+        metrics_->record_registry_scan_phases(next->timings.walk_us, next->timings.read_us, next->timings.build_us);
+    }
+    log_debug("Registry scan of " + std::to_string(next->timings.kits) + " kits with " + std::to_string(workers) +
+              " workers: walk " + std::to_string(next->timings.walk_us) + "us, read " +
+              std::to_string(next->timings.read_us) + "us, build " + std::to_string(next->timings.build_us) + "us");
+    return next;
+}
+
+void RuntimeRegistry::record_load_latency(std::chrono::steady_clock::time_point start) {
     auto end = std::chrono::steady_clock::now();
-    last_load_latency_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    last_load_latency_ms_ = duration_ms;
     if (metrics_) {
-        metrics_->record_registry_load(last_load_latency_ms_);
+        metrics_->record_registry_load(duration_ms);
     }
-    log_info("Loaded " + std::to_string(operations_.size()) + " operations from client kits");
 }
 
 // Retrieve a snapshot of loaded operations. Returns a vector copy of the
-// descriptors and does not accept parameters. No explicit exceptions are
-// thrown; allocation failures may propagate.
+// descriptors sorted by operation id and does not accept parameters. No
+// explicit exceptions are thrown; allocation failures may propagate.
 std::vector<OperationDescriptor> RuntimeRegistry::list_operations() const {
     // Return a copy to keep the internal cache encapsulated.
+    auto current = snapshot();
     std::vector<OperationDescriptor> list;
-    list.reserve(operations_.size());
-    for (const auto &entry : operations_) {
-        list.push_back(entry.second);
+    list.reserve(current->size());
+    for (std::size_t i = 0; i < current->size(); ++i) {
+        list.push_back({std::string(current->version(i)), std::string(current->kit_name(i)),
+                        std::string(current->operation_id(i)), current->manifest_path(i)});
     }
     return list;
 }
 
-// Find an operation by identifier. Accepts the operation id string and returns
-// an optional descriptor populated when found. No explicit exceptions are
-// thrown; standard library errors from map lookups or allocations may
-// propagate.
-std::optional<OperationDescriptor> RuntimeRegistry::find_operation(const std::string &operation_id) const {
-    // Lookup without throwing to allow simple truthiness checks at call sites.
-    auto it = operations_.find(operation_id);
-    if (it != operations_.end()) {
-        return it->second;
+std::optional<std::size_t> RuntimeRegistry::Snapshot::find(std::string_view operation_id) const {
+    return table.find(operation_id, [this](std::size_t i) { return this->operation_id(i); });
+}
+
+std::size_t RuntimeRegistry::Snapshot::memory_bytes() const {
+    std::size_t bytes = (op_kit.capacity() + op_offset.capacity() + op_length.capacity()) * sizeof(std::uint32_t);
+    bytes += kit_table.capacity() * sizeof(KitRecord);
+    bytes += table.capacity() * 2 * sizeof(std::uint32_t);
+    bytes += names.memory_bytes();
+    for (const auto &entry : kits) {
+        const auto &kit = *entry.second;
+        bytes += sizeof(KitState) + kit.id_arena.capacity() + kit.id_ends.capacity() * sizeof(std::uint32_t);
+        bytes += kit.version.capacity() + kit.kit_name.capacity() + kit.manifest_path.native().capacity();
     }
-    return std::nullopt;
+    for (const auto &kit : merged_kits) {
+        bytes += sizeof(KitState) + kit->version.capacity() + kit->kit_name.capacity() + kit->manifest_path.native().capacity();
+    }
+    return bytes;
+}
+
+// Find an operation by identifier. Accepts any string view and returns a
+// handle that keeps the snapshot alive; the handle is empty when the id is
+// unknown. Reads the published snapshot without locking and does not
+// allocate beyond the shared_ptr reference count. Does not throw.
+RuntimeRegistry::OperationRef RuntimeRegistry::find_operation(std::string_view operation_id) const {
+    auto current = snapshot();
+    auto position = current->find(operation_id);
+    if (!position) {
+        return {};
+    }
+    return OperationRef(std::move(current), *position);
+}
+
+OperationDescriptor RuntimeRegistry::OperationRef::descriptor() const {
+    return {std::string(version()), std::string(kit_name()), std::string(operation_id()), manifest_path()};
 }
 
 RuntimeRegistry::Stats RuntimeRegistry::stats() const {
-    return {operations_.size(), last_load_latency_ms_};
+    auto current = snapshot();
+    return {current->size(), last_load_latency_ms_.load(), current->memory_bytes(), current->timings};
 }
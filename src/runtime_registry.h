@@ -2,12 +2,21 @@
 
 #include "logging.h"
 #include "metrics.h"
+#include "route_index.h"
+#include "route_table.h"
+#include "string_pool.h"
+#include "work_stealing_executor.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace fs = std::filesystem;
@@ -22,35 +31,211 @@ struct OperationDescriptor {
     fs::path manifest_path;
 };
 
+// A freshly generated kit, as announced by the generator. The stamps are the
+// generation stamp values immediately before and after the kit was written.
+struct KitDelta {
+    std::string version;
+    std::string kit_name;
+    std::vector<std::string> operation_ids;
+    std::string previous_stamp;
+    std::string stamp;
+};
+
 class RuntimeRegistry {
   public:
+    // Cached parse result for one client kit. The manifest size and mtime
+    // decide whether the kit must be re-parsed on the next refresh. Kit states
+    // are immutable once published and shared between snapshots.
+    struct KitState {
+        std::string version;
+        std::string kit_name;
+        fs::path manifest_path;
+        fs::file_time_type manifest_mtime{};
+        std::uintmax_t manifest_size{0};
+        // Mapped per-kit route index when one matches the manifest. Otherwise
+        // the ids parsed from the manifest text are concatenated in id_arena
+        // and id_ends holds the end offset of each one.
+        std::shared_ptr<const RouteIndex> index;
+        std::string id_arena;
+        std::vector<std::uint32_t> id_ends;
+
+        // Base pointer that operation offsets for this kit are relative to.
+        const char *strings() const { return index ? index->string_table() : id_arena.data(); }
+    };
+
+    // Per-phase wall-clock timings of the scan that produced a snapshot.
+    struct ScanTimings {
+        long long walk_us{0};
+        long long read_us{0};
+        long long build_us{0};
+        std::size_t kits{0};
+        std::size_t workers{0};
+    };
+
+    // Immutable view of the registry. Reloads build a new snapshot off to the
+    // side and publish it with an atomic pointer swap, so readers holding a
+    // snapshot never observe a partially rebuilt table.
+    //
+    // Operations are stored as a struct of arrays sorted by id: each one costs
+    // three 32-bit words (kit, id offset, id length) plus its hash bucket.
+    // Versions and kit names are interned once in names, and the manifest path
+    // lives once per kit in its KitState.
+    struct Snapshot {
+        struct KitRecord {
+            std::uint32_t version_id{0};
+            std::uint32_t name_id{0};
+            const char *strings{nullptr};
+            const KitState *state{nullptr};
+        };
+
+        std::vector<std::uint32_t> op_kit;
+        std::vector<std::uint32_t> op_offset;
+        std::vector<std::uint32_t> op_length;
+        std::vector<KitRecord> kit_table;
+        StringPool names;
+        // Flat hash index over the operation arrays.
+        RouteTable table;
+
+        std::map<fs::path, std::shared_ptr<const KitState>> kits;
+        // Set when the snapshot is served from the merged root index; kit
+        // records then point into it and into merged_kits.
+        std::shared_ptr<const RouteIndex> merged;
+        std::vector<std::shared_ptr<const KitState>> merged_kits;
+        std::string generation_stamp;
+        ScanTimings timings;
+        bool loaded{false};
+
+        std::size_t size() const { return op_kit.size(); }
+        std::string_view operation_id(std::size_t i) const {
+            return {kit_table[op_kit[i]].strings + op_offset[i], op_length[i]};
+        }
+        std::string_view version(std::size_t i) const { return names.view(kit_table[op_kit[i]].version_id); }
+        std::string_view kit_name(std::size_t i) const { return names.view(kit_table[op_kit[i]].name_id); }
+        const fs::path &manifest_path(std::size_t i) const { return kit_table[op_kit[i]].state->manifest_path; }
+
+        // Return the position of operation_id, if present.
+        std::optional<std::size_t> find(std::string_view operation_id) const;
+
+        // Approximate heap footprint of the operation storage (excluding
+        // mapped index files, which live in the page cache).
+        std::size_t memory_bytes() const;
+    };
+
+    // Lightweight handle to an operation in a published snapshot. Accessors
+    // return views into the snapshot, which the handle keeps alive, so a
+    // lookup copies no strings. Test with has_value() or operator bool.
+    class OperationRef {
+      public:
+        OperationRef() = default;
+
+        bool has_value() const { return snapshot_ != nullptr; }
+        explicit operator bool() const { return has_value(); }
+
+        std::string_view operation_id() const { return snapshot_->operation_id(position_); }
+        std::string_view version() const { return snapshot_->version(position_); }
+        std::string_view kit_name() const { return snapshot_->kit_name(position_); }
+        const fs::path &manifest_path() const { return snapshot_->manifest_path(position_); }
+
+        // Materialize an owning descriptor, e.g. to hand to another thread.
+        OperationDescriptor descriptor() const;
+
+      private:
+        friend class RuntimeRegistry;
+        OperationRef(std::shared_ptr<const Snapshot> snapshot, std::size_t position)
+            : snapshot_(std::move(snapshot)), position_(position) {}
+
+        std::shared_ptr<const Snapshot> snapshot_;
+        std::size_t position_{0};
+    };
+
     // Initialize a registry rooted at clientkit_root where generated client
     // kits are stored on disk. The registry can be reloaded multiple times to
     // pick up new kits without restarting the process.
     explicit RuntimeRegistry(fs::path clientkit_root, std::shared_ptr<MetricsRegistry> metrics = nullptr);
 
-    // Scan the client kit directory and rebuild the in-memory operation map.
-    // The method is idempotent and safe to call before every operation lookup.
+    // Copies share the currently published snapshot (it is immutable) but get
+    // their own reload lock, so each copy reloads independently.
+    RuntimeRegistry(const RuntimeRegistry &other);
+    RuntimeRegistry &operator=(const RuntimeRegistry &other);
+
+    // Scan the client kit directory and rebuild the in-memory operation table.
+    // Every manifest is re-parsed, so this is the authoritative full reload.
+    // Blocks while another reload of this registry is in flight.
     void load();
 
-    // Return a copy of the known operations in arbitrary iteration order. The
+    // Incrementally bring the registry up to date. When the generation stamp
+    // under clientkit_root is unchanged since the last load the directory walk
+    // is skipped entirely; otherwise only kits whose manifest size or mtime
+    // changed are re-parsed. If another thread is already reloading, the call
+    // returns immediately and readers keep using the current snapshot.
+    // Returns true when a new snapshot with changed operations was published.
+    bool refresh();
+
+    // True when refresh() would return without walking clientkit_root: the
+    // registry has loaded and the generation stamp is unchanged. Costs one
+    // read of the stamp file.
+    bool is_current() const;
+
+    // Patch the published snapshot with a single generated kit, replacing any
+    // previous state for it, without walking clientkit_root. Ignored until
+    // the registry has loaded once. Returns true when a snapshot was
+    // published.
+    bool apply_kit(const KitDelta &delta);
+
+    // Set how many threads a scan may use to walk version directories and read
+    // kit manifests. Results are merged in path order, so the published
+    // snapshot is identical for any worker count. Defaults to 1 (serial).
+    void set_scan_workers(std::size_t workers);
+
+    // Run a scan's extra workers as tasks on executor instead of threads
+    // started for each scan. The scanning thread may be one of executor's.
+    void set_scan_executor(std::shared_ptr<WorkStealingExecutor> executor);
+
+    // Return the currently published snapshot without taking any lock. The
+    // snapshot stays valid for as long as the caller holds the pointer.
+    std::shared_ptr<const Snapshot> snapshot() const;
+
+    // Return a copy of the known operations sorted by operation id. The
     // descriptors include version, kit name, operation id, and manifest path.
     std::vector<OperationDescriptor> list_operations() const;
 
-    // Lookup a specific operation by identifier. Returns an optional descriptor
-    // so callers can branch on existence without throwing.
-    std::optional<OperationDescriptor> find_operation(const std::string &operation_id) const;
+    // Lookup a specific operation by identifier without copying it. Returns
+    // an empty handle when the operation is unknown.
+    OperationRef find_operation(std::string_view operation_id) const;
 
     struct Stats {
         std::size_t operation_count{0};
         long long last_load_latency_ms{0};
+        std::size_t memory_bytes{0};
+        ScanTimings last_scan;
     };
 
     Stats stats() const;
 
   private:
+    // Walk clientkit_root_ and build the snapshot that follows current. When
+    // force is set every manifest is re-parsed regardless of its stamp. Sets
+    // changed when any kit was added, removed or re-parsed.
+    std::shared_ptr<Snapshot> scan(const Snapshot &current, bool force, bool &changed) const;
+
+    // Return a snapshot backed by the merged root index when one exists and
+    // was built against stamp; nullptr otherwise.
+    std::shared_ptr<Snapshot> open_merged(const std::string &stamp) const;
+
+    // Publish a snapshot for lock-free readers.
+    void publish(std::shared_ptr<const Snapshot> next);
+
+    // Record the latency of a load or refresh pass.
+    void record_load_latency(std::chrono::steady_clock::time_point start);
+
     fs::path clientkit_root_;
-    std::map<std::string, OperationDescriptor> operations_;
     std::shared_ptr<MetricsRegistry> metrics_;
-    long long last_load_latency_ms_{0};
+    // Only ever accessed through std::atomic_load / std::atomic_store.
+    std::shared_ptr<const Snapshot> current_;
+    // Serializes writers; readers never take it.
+    std::mutex reload_mutex_;
+    std::atomic<long long> last_load_latency_ms_{0};
+    std::atomic<std::size_t> scan_workers_{1};
+    // Only ever accessed through std::atomic_load / std::atomic_store.
+    std::shared_ptr<WorkStealingExecutor> scan_executor_;
 };
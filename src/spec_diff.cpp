@@ -0,0 +1,168 @@
+#include "spec_diff.h"
+
+#include "hash_utils.h"
+#include "spec_extractor.h"
+
+#include <exception>
+#include <map>
+
+namespace {
+const std::string kSharedHashPrefix = "shared_hash:";
+const std::string kOperationHashPrefix = "op_hash:";
+
+// Key of a "key: value" line, or empty when the line is not a mapping entry.
+std::string_view mapping_key(std::string_view trimmed) {
+    std::string_view key;
+    std::string_view value;
+    return split_spec_entry(trimmed, key, value) ? key : std::string_view{};
+}
+} // namespace
+
+// Fingerprint a spec. Input: spec text. Output: shared and per-operation
+// hashes. Lines are attributed by indentation only; no YAML parsing happens.
+SpecFingerprint fingerprint_spec(std::string_view content) {
+    SpecFingerprint fingerprint;
+    fingerprint.shared_hash = kFnv1aSeed;
+    bool in_paths = false;
+    std::size_t path_indent = 0;
+    bool have_path_indent = false;
+    std::string current_path;
+    bool in_operation = false;
+    std::size_t operation_indent = 0;
+
+    std::size_t pos = 0;
+    while (pos < content.size()) {
+        auto end = content.find('\n', pos);
+        auto next = end == std::string_view::npos ? content.size() : end + 1;
+        auto line = content.substr(pos, next - pos);
+        pos = next;
+
+        auto indent = line.find_first_not_of(' ');
+        auto first = line.find_first_not_of(" \t\r\n");
+        auto trimmed = first == std::string_view::npos
+                           ? std::string_view{}
+                           : line.substr(first, line.find_last_not_of(" \t\r\n") - first + 1);
+        bool blank = trimmed.empty() || trimmed.front() == '#';
+
+        if (in_operation && (blank || indent > operation_indent)) {
+            auto &operation = fingerprint.operations.back();
+            operation.hash = fnv1a_64(line, operation.hash);
+            std::string_view key;
+            std::string_view value;
+            if (!blank && split_spec_entry(trimmed, key, value) && key == "operationId") {
+                operation.operation_id = std::string(value);
+            }
+            continue;
+        }
+        in_operation = false;
+
+        if (!blank && indent == 0) {
+            in_paths = mapping_key(trimmed) == "paths";
+            have_path_indent = false;
+        } else if (in_paths && !blank) {
+            if (!have_path_indent) {
+                path_indent = indent;
+                have_path_indent = true;
+            }
+            auto key = mapping_key(trimmed);
+            if (indent == path_indent) {
+                // Path keys are covered by the operation keys beneath them,
+                // so adding a path is not a shared change.
+                current_path = std::string(key);
+                continue;
+            } else if (indent > path_indent && !current_path.empty() && is_http_method(key)) {
+                fingerprint.operations.push_back({std::string(key) + " " + current_path, {}, fnv1a_64(line)});
+                in_operation = true;
+                operation_indent = indent;
+                continue;
+            }
+        }
+        fingerprint.shared_hash = fnv1a_64(line, fingerprint.shared_hash);
+    }
+    return fingerprint;
+}
+
+// Compare two fingerprints. Inputs: the fingerprint recorded for the kit and
+// the one for the new spec. Output: whether a full regeneration is needed
+// and, if not, which operations to regenerate.
+SpecDiff diff_spec_fingerprints(const SpecFingerprint &previous, const SpecFingerprint &current) {
+    SpecDiff diff;
+    if (previous.shared_hash != current.shared_hash) {
+        diff.full = true;
+        return diff;
+    }
+    std::map<std::string_view, const SpecOperationHash *> before;
+    for (const auto &operation : previous.operations) {
+        before[operation.key] = &operation;
+    }
+    for (const auto &operation : current.operations) {
+        auto it = before.find(operation.key);
+        if (it != before.end()) {
+            // A renamed operation leaves sources generated under its old id
+            // behind, just like a removed one.
+            if (it->second->operation_id != operation.operation_id) {
+                diff.full = true;
+                diff.changed_operation_ids.clear();
+                return diff;
+            }
+            auto unchanged = it->second->hash == operation.hash;
+            before.erase(it);
+            if (unchanged) {
+                continue;
+            }
+        }
+        if (operation.operation_id.empty()) {
+            diff.full = true;
+            return diff;
+        }
+        diff.changed_operation_ids.push_back(operation.operation_id);
+    }
+    // Removed operations leave generated sources behind unless the whole
+    // kit is rebuilt.
+    diff.full = !before.empty();
+    if (diff.full) {
+        diff.changed_operation_ids.clear();
+    }
+    return diff;
+}
+
+std::string format_fingerprint_lines(const SpecFingerprint &fingerprint) {
+    std::string lines = kSharedHashPrefix + to_hex(fingerprint.shared_hash) + "\n";
+    for (const auto &operation : fingerprint.operations) {
+        lines += kOperationHashPrefix + to_hex(operation.hash) + "\t" + operation.key + "\t" + operation.operation_id + "\n";
+    }
+    return lines;
+}
+
+// Parse fingerprint lines out of a manifest. Input: manifest text. Output:
+// true when a shared hash line was found; malformed operation lines are
+// skipped, which at worst forces a full regeneration.
+bool parse_fingerprint_lines(std::string_view manifest, SpecFingerprint &fingerprint) {
+    fingerprint = SpecFingerprint{};
+    bool found = false;
+    std::size_t pos = 0;
+    while (pos < manifest.size()) {
+        auto end = manifest.find('\n', pos);
+        auto line = manifest.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+        pos = end == std::string_view::npos ? manifest.size() : end + 1;
+        try {
+            if (line.substr(0, kSharedHashPrefix.size()) == kSharedHashPrefix) {
+                fingerprint.shared_hash = std::stoull(std::string(line.substr(kSharedHashPrefix.size())), nullptr, 16);
+                found = true;
+            } else if (line.substr(0, kOperationHashPrefix.size()) == kOperationHashPrefix) {
+                auto fields = line.substr(kOperationHashPrefix.size());
+                auto first = fields.find('\t');
+                auto second = first == std::string_view::npos ? first : fields.find('\t', first + 1);
+                if (second == std::string_view::npos) {
+                    continue;
+                }
+                fingerprint.operations.push_back({std::string(fields.substr(first + 1, second - first - 1)),
+                                                  std::string(fields.substr(second + 1)),
+                                                  std::stoull(std::string(fields.substr(0, first)), nullptr, 16)});
+            }
+        } catch (const std::exception &) {
+            continue;
+        }
+    }
+    return found;
+}
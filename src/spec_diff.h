@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One operation block of a spec: everything nested under a method key in
+// `paths`. key is "<method> <path>"; operation_id is empty when the block
+// declares none.
+struct SpecOperationHash {
+    std::string key;
+    std::string operation_id;
+    std::uint64_t hash{0};
+};
+
+// Per-operation hashes plus one hash over everything else (info, servers,
+// components, path-level parameters), which every operation may depend on.
+struct SpecFingerprint {
+    std::uint64_t shared_hash{0};
+    std::vector<SpecOperationHash> operations;
+};
+
+// Fingerprint a YAML spec by indentation. JSON or other layouts yield no
+// operations, so every change to them shows up as a shared change.
+SpecFingerprint fingerprint_spec(std::string_view content);
+
+struct SpecDiff {
+    // The whole kit must be regenerated: shared content changed, an operation
+    // was removed or had its operationId changed, or a changed operation has
+    // no operationId to target.
+    bool full{false};
+    // operationIds of added or changed operations when full is false.
+    std::vector<std::string> changed_operation_ids;
+};
+
+SpecDiff diff_spec_fingerprints(const SpecFingerprint &previous, const SpecFingerprint &current);
+
+// Manifest lines recording a fingerprint, and the parser for them. Returns
+// false when the manifest holds no fingerprint.
+std::string format_fingerprint_lines(const SpecFingerprint &fingerprint);
+bool parse_fingerprint_lines(std::string_view manifest, SpecFingerprint &fingerprint);
@@ -0,0 +1,238 @@
+#include "spec_extractor.h"
+
+#include "filesystem_utils.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+constexpr std::size_t kNone = std::string_view::npos;
+
+constexpr std::array<std::string_view, 8> kHttpMethods = {"get", "put", "post", "delete",
+                                                          "options", "head", "patch", "trace"};
+
+std::string_view trim(std::string_view value, std::string_view chars = " \t\r") {
+    auto start = value.find_first_not_of(chars);
+    if (start == kNone) {
+        return {};
+    }
+    return value.substr(start, value.find_last_not_of(chars) - start + 1);
+}
+
+std::string upper(std::string_view value) {
+    std::string out(value);
+    for (auto &c : out) {
+        if (c >= 'a' && c <= 'z') {
+            c = static_cast<char>(c - 'a' + 'A');
+        }
+    }
+    return out;
+}
+
+// JSON fallback: every "operationId" key, found with the library's
+// vectorized substring search.
+void extract_json_operation_ids(std::string_view content, SpecRoutes &out) {
+    constexpr std::string_view needle = "\"operationId\"";
+    for (auto pos = content.find(needle); pos != kNone; pos = content.find(needle, pos + needle.size())) {
+        auto open = content.find('"', content.find(':', pos + needle.size()));
+        auto close = open == kNone ? kNone : content.find('"', open + 1);
+        if (close == kNone) {
+            break;
+        }
+        out.routes.push_back({{}, {}, std::string(content.substr(open + 1, close - open - 1)), {}});
+    }
+}
+} // namespace
+
+// Split "key: value" into key and value. The key ends at the first ": " or at
+// a trailing ':', so path keys such as "/items:batchGet" survive. Returns
+// false for lines that are not mapping entries.
+bool split_spec_entry(std::string_view content, std::string_view &key, std::string_view &value) {
+    auto colon = content.find(": ");
+    if (colon == kNone) {
+        if (content.empty() || content.back() != ':') {
+            return false;
+        }
+        colon = content.size() - 1;
+    }
+    key = trim(content.substr(0, colon), " \t\"'");
+    value = colon + 1 < content.size() ? content.substr(colon + 1) : std::string_view{};
+    auto comment = value.find(" #");
+    if (comment != kNone) {
+        value = value.substr(0, comment);
+    }
+    value = trim(value, " \t\r\"'");
+    return true;
+}
+
+bool is_http_method(std::string_view key) {
+    return std::find(kHttpMethods.begin(), kHttpMethods.end(), key) != kHttpMethods.end();
+}
+
+// Extract routes. Input: spec text. Output: servers and routes in document
+// order. Lines are located with memchr, which glibc and most other C
+// libraries vectorize; no YAML tree is built and nothing is copied except
+// the emitted fields.
+SpecRoutes extract_spec_routes(std::string_view content) {
+    SpecRoutes out;
+    auto first = content.find_first_not_of(" \t\r\n");
+    if (first != kNone && content[first] == '{') {
+        extract_json_operation_ids(content, out);
+        return out;
+    }
+
+    enum class Section { Other, Servers, Paths } section = Section::Other;
+    std::size_t path_indent = kNone;
+    std::size_t path_child_indent = kNone;
+    std::string_view current_path;
+    // Routes of current_path start here; path-level parameters are appended
+    // to them once the path ends.
+    std::size_t path_routes_begin = 0;
+    std::vector<std::string> path_parameters;
+
+    bool in_operation = false;
+    std::size_t operation_indent = 0;
+    std::size_t operation_child_indent = kNone;
+
+    bool in_parameters = false;
+    bool parameters_on_path = false;
+    std::size_t parameters_indent = 0;
+    std::size_t item_indent = kNone;
+
+    auto finish_path = [&]() {
+        for (auto i = path_routes_begin; i < out.routes.size(); ++i) {
+            auto &names = out.routes[i].parameters;
+            names.insert(names.end(), path_parameters.begin(), path_parameters.end());
+        }
+        path_parameters.clear();
+        path_routes_begin = out.routes.size();
+        path_child_indent = kNone;
+        in_operation = false;
+        in_parameters = false;
+    };
+
+    const char *data = content.data();
+    const char *end = data + content.size();
+    for (const char *line_start = data; line_start < end;) {
+        auto *newline = static_cast<const char *>(std::memchr(line_start, '\n', static_cast<std::size_t>(end - line_start)));
+        auto *line_end = newline ? newline : end;
+        std::string_view line(line_start, static_cast<std::size_t>(line_end - line_start));
+        line_start = line_end + 1;
+
+        auto indent = line.find_first_not_of(' ');
+        if (indent == kNone) {
+            continue;
+        }
+        auto body = trim(line.substr(indent));
+        if (body.empty() || body.front() == '#') {
+            continue;
+        }
+
+        std::string_view key;
+        std::string_view value;
+        if (indent == 0) {
+            if (section == Section::Paths) {
+                finish_path();
+            }
+            split_spec_entry(body, key, value);
+            section = key == "paths" ? Section::Paths : key == "servers" ? Section::Servers : Section::Other;
+            continue;
+        }
+
+        if (section == Section::Servers) {
+            if (body.substr(0, 2) == "- ") {
+                body = trim(body.substr(2));
+            }
+            if (split_spec_entry(body, key, value) && key == "url") {
+                out.servers.emplace_back(value);
+            }
+            continue;
+        }
+        if (section != Section::Paths) {
+            continue;
+        }
+
+        if (in_parameters && indent > parameters_indent) {
+            auto content_indent = indent;
+            if (body.substr(0, 2) == "- ") {
+                body = trim(body.substr(2));
+                content_indent = indent + 2;
+                if (item_indent == kNone) {
+                    item_indent = content_indent;
+                }
+            }
+            // Only an item's own name counts, not names nested in schemas.
+            if (content_indent == item_indent && split_spec_entry(body, key, value) && key == "name") {
+                (parameters_on_path ? path_parameters : out.routes.back().parameters).emplace_back(value);
+            }
+            continue;
+        }
+        in_parameters = false;
+
+        if (in_operation && indent > operation_indent) {
+            if (operation_child_indent == kNone) {
+                operation_child_indent = indent;
+            }
+            if (indent == operation_child_indent && split_spec_entry(body, key, value)) {
+                if (key == "operationId") {
+                    out.routes.back().operation_id = std::string(value);
+                } else if (key == "parameters") {
+                    in_parameters = true;
+                    parameters_on_path = false;
+                    parameters_indent = indent;
+                    item_indent = kNone;
+                }
+            }
+            continue;
+        }
+        in_operation = false;
+
+        if (path_indent == kNone) {
+            path_indent = indent;
+        }
+        if (!split_spec_entry(body, key, value)) {
+            continue;
+        }
+        if (indent == path_indent) {
+            finish_path();
+            current_path = key;
+            continue;
+        }
+        if (indent < path_indent || current_path.empty()) {
+            continue;
+        }
+        if (path_child_indent == kNone) {
+            path_child_indent = indent;
+        }
+        if (indent != path_child_indent) {
+            continue;
+        }
+        if (key == "parameters") {
+            in_parameters = true;
+            parameters_on_path = true;
+            parameters_indent = indent;
+            item_indent = kNone;
+            continue;
+        }
+        if (is_http_method(key)) {
+            out.routes.push_back({upper(key), std::string(current_path), {}, {}});
+            in_operation = true;
+            operation_indent = indent;
+            operation_child_indent = kNone;
+        }
+    }
+    if (section == Section::Paths) {
+        finish_path();
+    }
+    return out;
+}
+
+bool extract_spec_routes(const fs::path &path, SpecRoutes &routes, std::error_code &ec) {
+    MappedFile file;
+    if (!file.open(path, ec)) {
+        return false;
+    }
+    routes = extract_spec_routes(file.view());
+    return true;
+}
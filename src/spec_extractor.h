@@ -0,0 +1,44 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// One operation of a spec. method is upper case; parameters lists the names
+// declared on the operation followed by those inherited from its path, with
+// $ref parameters omitted.
+struct SpecRoute {
+    std::string method;
+    std::string path;
+    std::string operation_id;
+    std::vector<std::string> parameters;
+};
+
+struct SpecRoutes {
+    // Top-level server URLs, in declaration order.
+    std::vector<std::string> servers;
+    std::vector<SpecRoute> routes;
+};
+
+// Split a YAML "key: value" line, already stripped of indentation, into key
+// and value with quotes and trailing comments removed. The key ends at the
+// first ": " or a trailing ':', so path keys such as "/items:batchGet" stay
+// whole. Returns false for lines that are not mapping entries. Shared by
+// every line-based spec walker.
+bool split_spec_entry(std::string_view content, std::string_view &key, std::string_view &value);
+
+// True when key names an OpenAPI operation ("get", "post", ...).
+bool is_http_method(std::string_view key);
+
+// Extract routes from spec text in a single pass over its lines, following
+// YAML block indentation. Content that starts with '{' is treated as JSON and
+// only its operationIds are recovered, with method and path left empty.
+SpecRoutes extract_spec_routes(std::string_view content);
+
+// Map the spec at path and extract its routes without copying the file.
+// Returns false and sets ec when the file cannot be mapped.
+bool extract_spec_routes(const fs::path &path, SpecRoutes &routes, std::error_code &ec);
@@ -2,37 +2,178 @@
 
 #include <algorithm>
 
-// Construct a validator with a maximum allowed payload size in bytes. Throws
-// only on allocation failures during member initialization.
-SpecValidator::SpecValidator(std::size_t max_bytes) : max_bytes_(max_bytes) {}
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-// Validate an OpenAPI specification payload. Input: raw content string. Output:
-// ValidationResult indicating success and a message. The method is noexcept in
-// intent but may propagate standard exceptions from string operations.
-ValidationResult SpecValidator::validate(const std::string &content) const {
-    if (content.empty()) {
-        return {false, "Specification is empty"};
+namespace {
+// Longest span a marker covers: the keyword, up to eight quote, colon or
+// blank characters, and the version digit.
+constexpr std::size_t kMarkerLength = 16;
+
+enum class Match { None, Incomplete, OpenApiKeyword, OpenApi3, Swagger2 };
+
+// ASCII lower-casing by setting bit 5. Only used for comparisons against
+// lower-case letters, where no other byte maps onto the same value.
+char fold(char c) { return static_cast<char>(c | 0x20); }
+
+// Offset of the first byte in text[from, last) that could start a marker, or
+// last. Both keywords are seven letters and start with 'o' or 's', so
+// candidates are found sixteen bytes at a time where SSE2 is available.
+std::size_t next_candidate(std::string_view text, std::size_t from, std::size_t last) {
+#if defined(__SSE2__)
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i o = _mm_set1_epi8('o');
+    const __m128i s = _mm_set1_epi8('s');
+    for (; from + 16 <= last; from += 16) {
+        auto block = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(text.data() + from)), case_bit);
+        auto mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, o), _mm_cmpeq_epi8(block, s)));
+        if (mask != 0) {
+            return from + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+        }
+    }
+#endif
+    for (; from < last; ++from) {
+        auto c = fold(text[from]);
+        if (c == 'o' || c == 's') {
+            return from;
+        }
     }
+    return last;
+}
 
-    if (content.size() > max_bytes_) {
-        return {false, "Specification exceeds maximum allowed size"};
+// Classify the text at pos. Accepts `openapi: 3`, `OpenAPI:3` and
+// `"openapi": "3.0.0"` alike; the bare keyword still counts as a sign the
+// document meant to be OpenAPI.
+Match match_at(std::string_view text, std::size_t pos, bool final) {
+    const std::string_view keyword = fold(text[pos]) == 'o' ? "openapi" : "swagger";
+    for (std::size_t k = 0; k < keyword.size(); ++k) {
+        if (pos + k >= text.size()) {
+            return final ? Match::None : Match::Incomplete;
+        }
+        if (fold(text[pos + k]) != keyword[k]) {
+            return Match::None;
+        }
     }
+    bool openapi = keyword[0] == 'o';
+    auto keyword_only = openapi ? Match::OpenApiKeyword : Match::None;
+    bool colon = false;
+    auto i = pos + keyword.size();
+    for (; i < pos + kMarkerLength - 1; ++i) {
+        if (i >= text.size()) {
+            return final ? keyword_only : Match::Incomplete;
+        }
+        auto c = text[i];
+        if (c == ':' && !colon) {
+            colon = true;
+        } else if (c != '"' && c != '\'' && c != ' ' && c != '\t') {
+            break;
+        }
+    }
+    if (i >= text.size()) {
+        return final ? keyword_only : Match::Incomplete;
+    }
+    if (colon && text[i] == (openapi ? '3' : '2')) {
+        return openapi ? Match::OpenApi3 : Match::Swagger2;
+    }
+    return keyword_only;
+}
+} // namespace
 
-    // Lowercase the content for case-insensitive checks of required markers.
-    auto lowered = content;
-    std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+SpecValidationStream::SpecValidationStream(std::size_t max_bytes) : max_bytes_(max_bytes) {}
 
-    if (lowered.find("openapi") == std::string::npos) {
-        return {false, "Document does not appear to be an OpenAPI specification"};
+// Feed a chunk. Input: the next bytes of the document. Output: false when
+// the size limit is exceeded or the header already rules the document out.
+bool SpecValidationStream::feed(std::string_view chunk) {
+    auto base = bytes_;
+    bytes_ += chunk.size();
+    if (bytes_ > max_bytes_) {
+        return false;
+    }
+    if (header_ != Header::Pending) {
+        return header_ == Header::OpenApi3;
     }
 
-    if (lowered.find("swagger: 2") != std::string::npos) {
-        return {false, "Swagger 2.0 documents are not supported"};
+    if (!tail_.empty()) {
+        // Markers that began in the previous chunk, now with enough bytes
+        // after them to be classified.
+        auto joint = tail_;
+        joint.append(chunk.substr(0, kMarkerLength));
+        scan(joint, base - tail_.size(), 0, tail_.size(), false);
+    }
+    if (header_ == Header::Pending) {
+        scan(chunk, base, 0, chunk.size(), false);
+    }
+
+    if (chunk.size() >= kMarkerLength - 1) {
+        tail_.assign(chunk.substr(chunk.size() - (kMarkerLength - 1)));
+    } else {
+        tail_.append(chunk);
+        tail_.erase(0, tail_.size() - std::min(tail_.size(), kMarkerLength - 1));
     }
+    if (header_ == Header::Pending && bytes_ >= kHeaderWindow + kMarkerLength) {
+        header_ = Header::Exhausted;
+    }
+    return header_ == Header::Pending || header_ == Header::OpenApi3;
+}
 
-    if (lowered.find("openapi: 3") == std::string::npos) {
+// Final verdict. Output: the same results validate() gives for the whole
+// document; markers cut off by the end of the stream are resolved here.
+ValidationResult SpecValidationStream::finish() {
+    if (bytes_ == 0) {
+        return {false, "Specification is empty"};
+    }
+    if (bytes_ > max_bytes_) {
+        return {false, "Specification exceeds maximum allowed size"};
+    }
+    if (header_ == Header::Pending) {
+        scan(tail_, bytes_ - tail_.size(), 0, tail_.size(), true);
+    }
+    if (header_ == Header::Swagger2) {
+        return {false, "Swagger 2.0 documents are not supported"};
+    }
+    if (header_ == Header::OpenApi3) {
+        return {true, "Valid specification"};
+    }
+    if (saw_openapi_) {
         return {false, "Only OpenAPI 3.x documents are supported"};
     }
+    return {false, "Document does not appear to be an OpenAPI specification"};
+}
+
+void SpecValidationStream::scan(std::string_view text, std::size_t base, std::size_t first, std::size_t last,
+                                bool final) {
+    if (base >= kHeaderWindow) {
+        return;
+    }
+    last = std::min(last, kHeaderWindow - base);
+    for (auto pos = next_candidate(text, first, last); pos < last; pos = next_candidate(text, pos + 1, last)) {
+        switch (match_at(text, pos, final)) {
+        case Match::OpenApi3:
+            header_ = Header::OpenApi3;
+            return;
+        case Match::Swagger2:
+            header_ = Header::Swagger2;
+            return;
+        case Match::OpenApiKeyword:
+            saw_openapi_ = true;
+            break;
+        case Match::None:
+        case Match::Incomplete:
+            break;
+        }
+    }
+}
+
+// Construct a validator with a maximum allowed payload size in bytes. Throws
+// only on allocation failures during member initialization.
+SpecValidator::SpecValidator(std::size_t max_bytes) : max_bytes_(max_bytes) {}
 
-    return {true, "Valid specification"};
+// Validate an OpenAPI specification payload. Input: raw content. Output:
+// ValidationResult indicating success and a message. The scan stops at the
+// first version marker, so the cost does not grow with the document.
+ValidationResult SpecValidator::validate(std::string_view content) const {
+    auto checker = stream();
+    checker.feed(content);
+    return checker.finish();
 }
@@ -2,12 +2,48 @@
 
 #include <cstddef>
 #include <string>
+#include <string_view>
 
 struct ValidationResult {
     bool ok{false};
     std::string message;
 };
 
+// Incremental validation of a spec arriving in chunks. The version marker
+// (`openapi: 3...` or `swagger: 2...`, case-insensitive, optionally quoted as
+// in JSON) must start within the first kHeaderWindow bytes; the first marker
+// found decides the verdict and later bytes are only counted against the size
+// limit. Chunks are scanned in place; at most a marker's length is carried
+// between them.
+class SpecValidationStream {
+  public:
+    static constexpr std::size_t kHeaderWindow = 64 * 1024;
+
+    explicit SpecValidationStream(std::size_t max_bytes);
+
+    // Feed the next chunk. Returns false once the document is certain to be
+    // rejected, so the caller can stop reading.
+    bool feed(std::string_view chunk);
+
+    // Verdict for everything fed so far, taken as the complete document.
+    ValidationResult finish();
+
+  private:
+    enum class Header { Pending, OpenApi3, Swagger2, Exhausted };
+
+    // Look for markers starting at text[first, last), where text begins at
+    // stream offset base. When final is false, markers cut off by the end of
+    // text are left for the next call.
+    void scan(std::string_view text, std::size_t base, std::size_t first, std::size_t last, bool final);
+
+    std::size_t max_bytes_;
+    std::size_t bytes_{0};
+    Header header_{Header::Pending};
+    bool saw_openapi_{false};
+    // Last bytes of the stream, whose markers may continue into the next chunk.
+    std::string tail_;
+};
+
 class SpecValidator {
   public:
     // Create a validator that enforces a maximum payload size (in bytes) for
@@ -16,8 +52,12 @@ class SpecValidator {
 
     // Validate an OpenAPI specification payload. The validator ensures content
     // is non-empty, within the configured size limit, and appears to be an
-    // OpenAPI 3.x document (rejecting Swagger 2.0).
-    ValidationResult validate(const std::string &content) const;
+    // OpenAPI 3.x document (rejecting Swagger 2.0). Only the header window is
+    // inspected and nothing is copied.
+    ValidationResult validate(std::string_view content) const;
+
+    // Start validating a payload that arrives in chunks.
+    SpecValidationStream stream() const { return SpecValidationStream(max_bytes_); }
 
   private:
     std::size_t max_bytes_;
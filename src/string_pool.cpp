@@ -0,0 +1,37 @@
+#include "string_pool.h"
+
+StringPool::StringPool(const StringPool &other) { *this = other; }
+
+StringPool &StringPool::operator=(const StringPool &other) {
+    if (this != &other) {
+        strings_.clear();
+        ids_.clear();
+        for (const auto &value : other.strings_) {
+            intern(value);
+        }
+    }
+    return *this;
+}
+
+// Intern a value. Input: string view. Output: its dense id; ids are assigned
+// in first-use order. Only allocation failures may throw.
+std::uint32_t StringPool::intern(std::string_view value) {
+    auto it = ids_.find(value);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+    auto id = static_cast<std::uint32_t>(strings_.size());
+    strings_.emplace_back(value);
+    ids_.emplace(strings_.back(), id);
+    return id;
+}
+
+std::size_t StringPool::memory_bytes() const {
+    std::size_t bytes = 0;
+    for (const auto &value : strings_) {
+        bytes += sizeof(std::string) + value.capacity();
+    }
+    // Rough per-node cost of the lookup map.
+    bytes += ids_.size() * (sizeof(std::string_view) + sizeof(std::uint32_t) + 2 * sizeof(void *));
+    return bytes;
+}
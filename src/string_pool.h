@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// StringPool interns short, highly repeated strings (versions, kit names) and
+// hands out dense 32-bit ids. Each distinct value is stored once; views
+// returned by view() stay valid for the lifetime of the pool.
+class StringPool {
+  public:
+    StringPool() = default;
+    // Views and ids refer into the pool, so copies re-intern rather than
+    // share storage.
+    StringPool(const StringPool &other);
+    StringPool &operator=(const StringPool &other);
+
+    // Return the id of value, adding it on first use.
+    std::uint32_t intern(std::string_view value);
+
+    std::string_view view(std::uint32_t id) const { return strings_[id]; }
+    std::size_t size() const { return strings_.size(); }
+
+    // Approximate heap footprint of the pool, for registry statistics.
+    std::size_t memory_bytes() const;
+
+  private:
+    // deque keeps element addresses stable as the pool grows, which the
+    // string_view keys of ids_ rely on.
+    std::deque<std::string> strings_;
+    std::unordered_map<std::string_view, std::uint32_t> ids_;
+};
@@ -0,0 +1,99 @@
+#include "work_stealing_executor.h"
+
+#include <algorithm>
+
+namespace {
+// The executor and worker index of the calling thread, if it is a pool thread.
+thread_local const WorkStealingExecutor *t_executor = nullptr;
+thread_local std::size_t t_worker = 0;
+} // namespace
+
+WorkStealingExecutor::WorkStealingExecutor(std::size_t threads) {
+    threads = std::max<std::size_t>(1, threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (std::size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back([this, i]() { run(i); });
+    }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &thread : threads_) {
+        thread.join();
+    }
+}
+
+// Queue a task. Input: the task. A pool thread pushes onto its own deque;
+// any other thread appends to the shared queue. Wakes one sleeping worker.
+void WorkStealingExecutor::post(Task task) {
+    ++pending_;
+    if (t_executor == this) {
+        auto &own = *workers_[t_worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.tasks.push_back(std::move(task));
+    } else {
+        std::lock_guard<std::mutex> lock(injected_mutex_);
+        injected_.push_back(std::move(task));
+    }
+    // Taking the lock orders this notify after a sleeper's predicate check.
+    { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+    wake_.notify_one();
+}
+
+WorkStealingExecutor::Stats WorkStealingExecutor::stats() const { return {executed_.load(), stolen_.load()}; }
+
+bool WorkStealingExecutor::take(std::size_t self, Task &task) {
+    {
+        auto &own = *workers_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(injected_mutex_);
+        if (!injected_.empty()) {
+            task = std::move(injected_.front());
+            injected_.pop_front();
+            return true;
+        }
+    }
+    for (std::size_t offset = 1; offset < workers_.size(); ++offset) {
+        auto &victim = *workers_[(self + offset) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            ++stolen_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingExecutor::run(std::size_t self) {
+    t_executor = this;
+    t_worker = self;
+    while (true) {
+        Task task;
+        if (take(self, task)) {
+            --pending_;
+            task();
+            ++executed_;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wake_.wait(lock, [this]() { return pending_ > 0 || stopping_; });
+        if (stopping_ && pending_ == 0) {
+            return;
+        }
+    }
+}
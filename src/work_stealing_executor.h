@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed pool of threads, each with its own task deque. Tasks a worker posts
+// go on its own deque and run newest first, which keeps a continuation on
+// the thread whose cache already holds its data. Tasks posted from outside
+// the pool go to a shared FIFO queue, so external callers are served in
+// order. A worker with nothing of its own takes from the shared queue, then
+// steals the oldest task of another worker.
+//
+// A pool sized for CPU work, like the gateway's, must only get tasks that do
+// not block for long; work that waits on I/O should be split into a task per
+// step or handed to a pool dedicated to blocking work, sized for how many
+// calls may wait at once (HttpClient keeps one for its downstream calls).
+class WorkStealingExecutor {
+  public:
+    using Task = std::function<void()>;
+
+    // Start threads workers (at least one).
+    explicit WorkStealingExecutor(std::size_t threads);
+
+    // Run every task already posted, then join the threads. Tasks posted by
+    // those tasks still run.
+    ~WorkStealingExecutor();
+
+    WorkStealingExecutor(const WorkStealingExecutor &) = delete;
+    WorkStealingExecutor &operator=(const WorkStealingExecutor &) = delete;
+
+    // Queue task. Safe from any thread, including the pool's own; tasks must
+    // not throw.
+    void post(Task task);
+
+    std::size_t size() const { return workers_.size(); }
+
+    struct Stats {
+        std::uint64_t executed{0};
+        // Tasks a worker took from another worker's deque.
+        std::uint64_t stolen{0};
+    };
+
+    Stats stats() const;
+
+  private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // Pop from worker self's own deque, else the shared queue, else steal.
+    // Returns false when everything was empty.
+    bool take(std::size_t self, Task &task);
+    void run(std::size_t self);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::mutex injected_mutex_;
+    std::deque<Task> injected_;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    // Tasks posted but not yet taken; raised before a task is pushed so an
+    // idle worker never sleeps past it.
+    std::atomic<std::size_t> pending_{0};
+    std::atomic<std::uint64_t> executed_{0};
+    std::atomic<std::uint64_t> stolen_{0};
+    bool stopping_{false};
+};
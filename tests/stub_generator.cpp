@@ -0,0 +1,67 @@
+// Stand-in for a warm openapi-generator process, speaking the
+// GeneratorProcessPool protocol on stdin/stdout. For each request it writes
+// <output_dir>/generated.txt holding its pid, the batch size and the
+// requested operation filter. Spec file
+// names steer it: "slow*" takes 200 ms, "hang*" never answers and "fail*"
+// reports an error.
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+int main() {
+    std::string header;
+    while (std::getline(std::cin, header)) {
+        if (header.rfind("BATCH ", 0) != 0) {
+            return 2;
+        }
+        auto count = std::stoul(header.substr(6));
+        struct Request {
+            fs::path spec;
+            fs::path output_dir;
+            std::string operations;
+        };
+        std::vector<Request> requests;
+        for (std::size_t i = 0; i < count; ++i) {
+            std::string line;
+            if (!std::getline(std::cin, line)) {
+                return 2;
+            }
+            auto tab = line.find('\t');
+            auto ops = line.find('\t', tab + 1);
+            requests.push_back({line.substr(0, tab), line.substr(tab + 1, ops == std::string::npos ? ops : ops - tab - 1),
+                                ops == std::string::npos ? std::string() : line.substr(ops + 1)});
+        }
+
+        for (std::size_t i = 0; i < requests.size(); ++i) {
+            auto name = requests[i].spec.stem().string();
+            std::cout << "LOG " << i << " generating " << name << std::endl;
+            if (name.rfind("hang", 0) == 0) {
+                std::this_thread::sleep_for(std::chrono::hours(1));
+            }
+            if (name.rfind("slow", 0) == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+            if (name.rfind("fail", 0) == 0) {
+                std::cout << "ERR " << i << " cannot generate " << name << std::endl;
+                continue;
+            }
+            fs::create_directories(requests[i].output_dir);
+            std::ofstream out(requests[i].output_dir / "generated.txt");
+            out << "pid=" << ::getpid() << "\n";
+            out << "batch=" << count << "\n";
+            out << "operations=" << requests[i].operations << "\n";
+            out.close();
+            std::cout << "OK " << i << std::endl;
+        }
+    }
+    return 0;
+}
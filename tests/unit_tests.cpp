@@ -1,20 +1,51 @@
+#include "concurrency_limiter.h"
+#include "content_store.h"
 #include "filesystem_utils.h"
+#include "generation_journal.h"
 #include "generation_queue.h"
+#include "generator_pool.h"
+#include "hash_utils.h"
+#include "http_client.h"
 #include "logging.h"
+#include "json.h"
 #include "mcp_gateway.h"
+#include "mcp_rpc.h"
+#include "mcp_server.h"
 #include "registration_service.h"
+#include "route_index.h"
+#include "route_table.h"
 #include "runtime_registry.h"
+#include "spec_diff.h"
+#include "spec_extractor.h"
 #include "spec_validation.h"
+#include "work_stealing_executor.h"
 
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <chrono>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iterator>
+#include <map>
+#include <mutex>
 #include <random>
 #include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
 
 namespace fs = std::filesystem;
 
@@ -59,6 +90,85 @@ struct LoggingGuard {
 
 } // namespace
 
+TEST(SpecDiffTest, TargetsChangedOperationsOnly) {
+    const std::string base = "openapi: 3.0.0\ninfo:\n  title: Example\npaths:\n"
+                             "  /hello:\n    get:\n      operationId: sayHello\n      summary: hi\n"
+                             "  /bye:\n    post:\n      operationId: sayBye\n";
+    auto previous = fingerprint_spec(base);
+    ASSERT_EQ(previous.operations.size(), 2u);
+    EXPECT_EQ(previous.operations[0].key, "get /hello");
+    EXPECT_EQ(previous.operations[1].operation_id, "sayBye");
+
+    SpecFingerprint parsed;
+    ASSERT_TRUE(parse_fingerprint_lines("version:v1\n" + format_fingerprint_lines(previous), parsed));
+    EXPECT_EQ(parsed.shared_hash, previous.shared_hash);
+    ASSERT_EQ(parsed.operations.size(), 2u);
+    EXPECT_EQ(parsed.operations[1].hash, previous.operations[1].hash);
+
+    // Editing one operation and adding a path touch only those operations.
+    auto edited = base;
+    edited.replace(edited.find("summary: hi"), 11, "summary: hello");
+    edited += "  /new:\n    get:\n      operationId: sayNew\n";
+    auto diff = diff_spec_fingerprints(previous, fingerprint_spec(edited));
+    EXPECT_FALSE(diff.full);
+    EXPECT_EQ(diff.changed_operation_ids, (std::vector<std::string>{"sayHello", "sayNew"}));
+
+    // Shared content, removals and operations without ids force a full run.
+    auto retitled = base;
+    retitled.replace(retitled.find("Example"), 7, "Renamed");
+    EXPECT_TRUE(diff_spec_fingerprints(previous, fingerprint_spec(retitled)).full);
+    EXPECT_TRUE(diff_spec_fingerprints(fingerprint_spec(edited), previous).full);
+    EXPECT_TRUE(diff_spec_fingerprints(previous, fingerprint_spec(base + "  /anon:\n    get:\n      summary: x\n")).full);
+    EXPECT_FALSE(diff_spec_fingerprints(previous, fingerprint_spec(base)).full);
+
+    // Renaming an operation in place removes the sources under its old id.
+    auto renamed = base;
+    renamed.replace(renamed.find("sayBye"), 6, "sayGoodbye");
+    auto rename_diff = diff_spec_fingerprints(previous, fingerprint_spec(renamed));
+    EXPECT_TRUE(rename_diff.full);
+    EXPECT_TRUE(rename_diff.changed_operation_ids.empty());
+
+    // Path keys keep colons after the first, as in custom methods.
+    auto custom = fingerprint_spec(base + "  \"/hello:batchGet\":\n    post:\n      operationId: 'batchGet'\n");
+    ASSERT_EQ(custom.operations.size(), 3u);
+    EXPECT_EQ(custom.operations[2].key, "post /hello:batchGet");
+    EXPECT_EQ(custom.operations[2].operation_id, "batchGet");
+    EXPECT_EQ(diff_spec_fingerprints(previous, custom).changed_operation_ids, (std::vector<std::string>{"batchGet"}));
+}
+
+TEST(SpecExtractorTest, EmitsRouteRecords) {
+    const std::string spec = "openapi: 3.0.0\n"
+                             "servers:\n  - url: https://api.example.com/v1\n  - description: staging\n"
+                             "    url: 'https://staging.example.com'\n"
+                             "paths:\n"
+                             "  /pets/{petId}:\n"
+                             "    parameters:\n      - name: petId\n        in: path\n"
+                             "    get:\n      operationId: getPet # fetch\n"
+                             "      parameters:\n        - in: query\n          name: fields\n"
+                             "          schema:\n            name: ignored\n"
+                             "        - $ref: '#/components/parameters/Trace'\n"
+                             "    delete:\n      summary: no id\n"
+                             "  \"/items:batchGet\":\n    post:\n      operationId: batchGetItems\n"
+                             "components:\n  links:\n    operationId: notARoute\n";
+    auto extracted = extract_spec_routes(spec);
+    EXPECT_EQ(extracted.servers,
+              (std::vector<std::string>{"https://api.example.com/v1", "https://staging.example.com"}));
+    ASSERT_EQ(extracted.routes.size(), 3u);
+    EXPECT_EQ(extracted.routes[0].method, "GET");
+    EXPECT_EQ(extracted.routes[0].path, "/pets/{petId}");
+    EXPECT_EQ(extracted.routes[0].operation_id, "getPet");
+    EXPECT_EQ(extracted.routes[0].parameters, (std::vector<std::string>{"fields", "petId"}));
+    EXPECT_EQ(extracted.routes[1].method, "DELETE");
+    EXPECT_TRUE(extracted.routes[1].operation_id.empty());
+    EXPECT_EQ(extracted.routes[1].parameters, (std::vector<std::string>{"petId"}));
+    EXPECT_EQ(extracted.routes[2].path, "/items:batchGet");
+    EXPECT_EQ(extracted.routes[2].operation_id, "batchGetItems");
+
+    auto json = extract_spec_routes("{\"paths\": {\"/a\": {\"get\": {\"operationId\": \"getA\"}}}}");
+    ASSERT_EQ(json.routes.size(), 1u);
+    EXPECT_EQ(json.routes[0].operation_id, "getA");
+}
+
 TEST(SpecValidatorTest, RejectsInvalidContent) {
     SpecValidator validator(50);
     EXPECT_FALSE(validator.validate("").ok);
@@ -73,6 +183,32 @@ TEST(SpecValidatorTest, AcceptsValidOpenApi3) {
     EXPECT_TRUE(result.ok);
 }
 
+TEST(SpecValidatorTest, ValidatesChunkedStreamsFromTheHeader) {
+    SpecValidator validator;
+    EXPECT_TRUE(validator.validate("{\"OpenAPI\": \"3.1.0\", \"info\": {}}").ok);
+    EXPECT_EQ(validator.validate("openapi: 2.0\n").message, "Only OpenAPI 3.x documents are supported");
+
+    // Markers split across chunk boundaries at every offset are still found.
+    const std::string spec = "# generated\ninfo:\n  title: t\nopenapi: 3.0.3\npaths: {}\n";
+    for (std::size_t size = 1; size <= spec.size(); ++size) {
+        auto stream = validator.stream();
+        for (std::size_t pos = 0; pos < spec.size(); pos += size) {
+            EXPECT_TRUE(stream.feed(std::string_view(spec).substr(pos, size)));
+        }
+        EXPECT_TRUE(stream.finish().ok) << "chunk size " << size;
+    }
+
+    // The first marker decides and the reader can stop early.
+    auto swagger = validator.stream();
+    EXPECT_FALSE(swagger.feed("swagger: '2.0'\ninfo: {}\n"));
+    EXPECT_EQ(swagger.finish().message, "Swagger 2.0 documents are not supported");
+
+    // Markers past the header window do not count.
+    auto late = std::string(SpecValidationStream::kHeaderWindow, '#') + "\nopenapi: 3.0.0\n";
+    EXPECT_FALSE(validator.validate(late).ok);
+    EXPECT_FALSE(SpecValidator(8).stream().feed("openapi: 3"));
+}
+
 TEST(LoggingSetupTest, UsesEnvironmentConfiguration) {
     auto temp_root = make_unique_temp_dir("logging-");
     auto log_file = (temp_root / "env.log").string();
@@ -109,6 +245,77 @@ TEST(FileSystemUtilsTest, ReadWriteAndCopy) {
     fs::remove_all(temp_root);
 }
 
+TEST(FileSystemUtilsTest, LinksAndMergesTrees) {
+    auto temp_root = make_unique_temp_dir("fs-link-");
+    auto live = temp_root / "live";
+    auto staged = temp_root / "staged";
+    auto delta = temp_root / "delta";
+    fs::create_directories(live / "sub");
+    fs::create_directories(delta / "sub");
+    ASSERT_TRUE(write_file(live / "x", "old"));
+    ASSERT_TRUE(write_file(live / "sub" / "y", "kept"));
+    ASSERT_TRUE(write_file(delta / "x", "new"));
+    ASSERT_TRUE(write_file(delta / "sub" / "z", "added"));
+
+    std::error_code ec;
+    ASSERT_TRUE(link_tree(live, staged, ec));
+    EXPECT_EQ(fs::hard_link_count(staged / "sub" / "y"), 2u);
+    ASSERT_TRUE(merge_tree(delta, staged, ec));
+
+    // Merged files replace the links instead of writing through them.
+    EXPECT_EQ(read_file_to_string(live / "x"), "old");
+    EXPECT_EQ(read_file_to_string(staged / "x"), "new");
+    EXPECT_EQ(read_file_to_string(staged / "sub" / "y"), "kept");
+    EXPECT_EQ(read_file_to_string(staged / "sub" / "z"), "added");
+    EXPECT_FALSE(link_tree(live, staged, ec));
+
+    fs::remove_all(temp_root);
+}
+
+TEST(FileSystemUtilsTest, GroupCommitsConcurrentWrites) {
+    auto temp_root = make_unique_temp_dir("fs-durable-");
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    constexpr int kWriters = 8;
+    constexpr int kFilesPerWriter = 10;
+    auto before = durable_write_stats();
+    std::vector<std::thread> writers;
+    for (int w = 0; w < kWriters; ++w) {
+        writers.emplace_back([&, w]() {
+            for (int i = 0; i < kFilesPerWriter; ++i) {
+                // Every writer rewrites the same file too, racing on one name.
+                EXPECT_TRUE(write_file(temp_root / ("w" + std::to_string(w) + "-" + std::to_string(i)), "payload"));
+                EXPECT_TRUE(write_file(temp_root / "shared", "writer " + std::to_string(w)));
+            }
+        });
+    }
+    for (auto &writer : writers) {
+        writer.join();
+    }
+
+    auto after = durable_write_stats();
+    EXPECT_EQ(after.files - before.files, static_cast<std::uint64_t>(2 * kWriters * kFilesPerWriter));
+    EXPECT_GE(after.batches - before.batches, 1u);
+    EXPECT_LE(after.batches - before.batches, after.files - before.files);
+    EXPECT_EQ(read_file_to_string(temp_root / "shared").rfind("writer ", 0), 0u);
+    // Only the published names remain: no temp files are left behind.
+    EXPECT_EQ(std::distance(fs::directory_iterator(temp_root), fs::directory_iterator{}), kWriters * kFilesPerWriter + 2);
+
+    // A failed publish removes its temp file.
+    fs::create_directories(temp_root / "occupied" / "child");
+    auto temp = temp_path_for(temp_root / "occupied");
+    ASSERT_TRUE(write_file(temp, "x"));
+    std::error_code ec;
+    EXPECT_FALSE(publish_file(temp, temp_root / "occupied", ec));
+    EXPECT_TRUE(ec);
+    EXPECT_FALSE(fs::exists(temp));
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
 TEST(RegistrationServiceTest, FailsWhenSpecMissing) {
     auto temp_root = make_unique_temp_dir("registration-");
     RegistrationService service(temp_root / "mappings", nullptr);
@@ -117,51 +324,2134 @@ TEST(RegistrationServiceTest, FailsWhenSpecMissing) {
     fs::remove_all(temp_root);
 }
 
-TEST(IntegrationTest, GeneratesClientKitAndExecutesOperation) {
-    auto temp_root = make_unique_temp_dir("gateway-");
+#ifndef _WIN32
+TEST(RegistrationServiceTest, StreamsChunkedUploadsIntoMappings) {
+    auto temp_root = make_unique_temp_dir("registration-stream-");
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+    RegistrationService service(temp_root / "mappings", nullptr);
+
+    // Write the upload through a pipe in pieces smaller than a marker.
+    auto upload = [&](const std::string &content) {
+        int fds[2];
+        EXPECT_EQ(::pipe(fds), 0);
+        std::thread writer([&]() {
+            for (std::size_t pos = 0; pos < content.size(); pos += 5) {
+                auto piece = content.substr(pos, 5);
+                EXPECT_EQ(::write(fds[1], piece.data(), piece.size()), static_cast<ssize_t>(piece.size()));
+            }
+            ::close(fds[1]);
+        });
+        auto result = service.register_stream("v1", "pets.yaml", fds[0]);
+        writer.join();
+        ::close(fds[0]);
+        return result;
+    };
+
+    std::string spec = "openapi: 3.0.0\ninfo:\n  title: Pets\npaths: {}\n" + std::string(3 * kStreamChunkSize, '#');
+    auto accepted = upload(spec);
+    ASSERT_TRUE(accepted.ok) << accepted.message;
+    EXPECT_EQ(read_file_to_string(accepted.stored_path), spec);
+    EXPECT_EQ(accepted.content_hash, to_hex(fnv1a_64(spec)));
+
+    // A rejected upload leaves the stored spec and no partial file behind.
+    auto rejected = upload("swagger: '2.0'\ninfo: {}\n");
+    EXPECT_FALSE(rejected.ok);
+    EXPECT_EQ(read_file_to_string(accepted.stored_path), spec);
+    EXPECT_EQ(std::distance(fs::directory_iterator(temp_root / "mappings" / "v1"), fs::directory_iterator{}), 1);
+    EXPECT_FALSE(service.register_stream("v1", "../escape.yaml", 0).ok);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+#endif
+
+TEST(RegistrationServiceTest, StoresIdenticalSpecsOnce) {
+    auto temp_root = make_unique_temp_dir("registration-dedup-");
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
     auto mappings_root = temp_root / "mappings";
+    auto metrics = std::make_shared<MetricsRegistry>();
+    RegistrationService service(mappings_root, nullptr, metrics);
+    auto spec = temp_root / "pets.yaml";
+    ASSERT_TRUE(write_file(spec, "openapi: 3.0.0\ninfo:\n  title: Pets\npaths: {}\n"));
+
+    auto first = service.register_spec("v1", spec);
+    auto second = service.register_spec("v2", spec);
+    ASSERT_TRUE(first.ok && second.ok);
+    EXPECT_FALSE(first.deduplicated);
+    EXPECT_TRUE(second.deduplicated);
+    EXPECT_EQ(metrics->snapshot().registrations_deduplicated, 1);
+    EXPECT_TRUE(fs::equivalent(first.stored_path, second.stored_path));
+    // Re-registering the same bytes leaves the link alone.
+    EXPECT_TRUE(service.register_spec("v1", spec).deduplicated);
+    EXPECT_EQ(fs::hard_link_count(first.stored_path), 3u);
+
+    // Blobs are pruned once no version links to them and their grace is up.
+    ContentStore store(mappings_root);
+    ASSERT_TRUE(write_file(spec, "openapi: 3.0.1\ninfo:\n  title: Pets\npaths: {}\n"));
+    ASSERT_TRUE(service.register_spec("v1", spec).ok);
+    EXPECT_EQ(store.prune(std::chrono::seconds(0)), 0u);
+    ASSERT_TRUE(service.register_spec("v2", spec).ok);
+    EXPECT_EQ(store.prune(), 0u);
+    EXPECT_EQ(store.prune(std::chrono::seconds(0)), 1u);
+    EXPECT_EQ(std::distance(fs::directory_iterator(mappings_root / kBlobDirectory), fs::directory_iterator{}), 1);
+    EXPECT_EQ(read_file_to_string(second.stored_path), "openapi: 3.0.1\ninfo:\n  title: Pets\npaths: {}\n");
+
+    // An existing blob is only a duplicate when its bytes match; other bytes
+    // under the same address go to a suffixed blob.
+    auto existing = fs::directory_iterator(mappings_root / kBlobDirectory)->path().filename().string();
+    auto staged = temp_root / "staged";
+    ASSERT_TRUE(write_file(staged, "colliding bytes"));
+    auto address = existing;
+    bool duplicate = true;
+    std::error_code ec;
+    ASSERT_TRUE(store.adopt(staged, address, duplicate, ec)) << ec.message();
+    EXPECT_FALSE(duplicate);
+    EXPECT_EQ(address, existing + "~1");
+    EXPECT_EQ(read_file_to_string(store.blob_path(existing)), read_file_to_string(second.stored_path));
+    EXPECT_EQ(read_file_to_string(store.blob_path(address)), "colliding bytes");
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(RegistrationServiceTest, RegistersBatchesInParallel) {
+    auto temp_root = make_unique_temp_dir("registration-bulk-");
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+    auto metrics = std::make_shared<MetricsRegistry>();
+    // Room for two tasks only; the generator is never started.
+    auto generator = std::make_shared<GenerationQueue>(temp_root / "clientkit", 1, 2, metrics);
+    RegistrationService service(temp_root / "mappings", generator, metrics);
+
+    fs::create_directories(temp_root / "in");
+    fs::create_directories(temp_root / "other");
+    std::vector<fs::path> sources;
+    for (const auto *name : {"a", "b", "bad", "c"}) {
+        sources.push_back(temp_root / "in" / (std::string(name) + ".yaml"));
+        ASSERT_TRUE(write_file(sources.back(), std::string(name) == "bad" ? "swagger: 2.0\n"
+                                                                          : "openapi: 3.0.0\ntitle: " + std::string(name) + "\n"));
+    }
+    sources.push_back(temp_root / "other" / "a.yaml");
+    ASSERT_TRUE(write_file(sources.back(), "openapi: 3.0.0\ntitle: other\n"));
+
+    auto results = service.register_specs("v1", sources, GenerationPriority::Bulk, 4);
+    ASSERT_EQ(results.size(), sources.size());
+    EXPECT_TRUE(results[0].ok);
+    EXPECT_TRUE(results[1].ok);
+    EXPECT_EQ(results[2].message, "Swagger 2.0 documents are not supported");
+    EXPECT_EQ(results[3].message, "Generation queue is full; try again later");
+    EXPECT_FALSE(fs::exists(temp_root / "mappings" / "v1" / "c.yaml"));
+    EXPECT_FALSE(results[4].ok);
+    EXPECT_EQ(read_file_to_string(temp_root / "mappings" / "v1" / "a.yaml"), "openapi: 3.0.0\ntitle: a\n");
+
+    auto stats = generator->stats();
+    EXPECT_EQ(stats.queue_depth, 2u);
+    EXPECT_EQ(stats.classes[static_cast<std::size_t>(GenerationPriority::Bulk)].depth, 2u);
+    EXPECT_EQ(metrics->snapshot().registrations_total, 5);
+    EXPECT_EQ(metrics->snapshot().registrations_failed, 3);
+
+    // A new version of a stored spec that cannot be queued leaves the stored
+    // one as it was, and no hidden copy behind.
+    auto stored = temp_root / "in" / "stored.yaml";
+    ASSERT_TRUE(write_file(stored, "openapi: 3.0.0\ntitle: stored\n"));
+    ASSERT_TRUE(RegistrationService(temp_root / "mappings", nullptr).register_spec("v1", stored).ok);
+    ASSERT_TRUE(write_file(stored, "openapi: 3.0.0\ntitle: replaced\n"));
+    EXPECT_EQ(service.register_spec("v1", stored).message, "Generation queue is full; try again later");
+    EXPECT_EQ(read_file_to_string(temp_root / "mappings" / "v1" / "stored.yaml"), "openapi: 3.0.0\ntitle: stored\n");
+    EXPECT_EQ(std::distance(fs::directory_iterator(temp_root / "mappings" / "v1"), fs::directory_iterator{}), 3);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(RuntimeRegistryTest, RefreshOnlyReparsesChangedKits) {
+    auto temp_root = make_unique_temp_dir("registry-");
     auto clientkit_root = temp_root / "clientkit";
-    fs::create_directories(mappings_root);
-    fs::create_directories(clientkit_root);
+    auto metrics = std::make_shared<MetricsRegistry>();
 
-    auto log_path = (temp_root / "test.log").string();
-    set_env_var("GATEWAY_LOG_FILE", log_path);
-    set_env_var("GATEWAY_LOG_LEVEL", "debug");
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
     SetupLogging::configure_from_env();
     LoggingGuard guard;
 
-    auto generator = std::make_shared<GenerationQueue>(clientkit_root, 1);
-    generator->start();
+    ASSERT_TRUE(ensure_directory(clientkit_root / "v1" / "alpha"));
+    ASSERT_TRUE(write_file(clientkit_root / "v1" / "alpha" / "manifest.txt", "version:v1\noperation:opAlpha\n"));
+    ASSERT_TRUE(touch_generation_stamp(clientkit_root));
 
-    RegistrationService registration(mappings_root, generator);
+    RuntimeRegistry registry(clientkit_root, metrics);
+    EXPECT_TRUE(registry.refresh());
+    EXPECT_TRUE(registry.find_operation("opAlpha").has_value());
 
-    auto spec_path = temp_root / "example.yaml";
-    write_spec(spec_path);
+    // Nothing was generated since the last pass, so the walk is skipped.
+    EXPECT_FALSE(registry.refresh());
+    EXPECT_EQ(metrics->snapshot().registry_refresh_skipped, 1);
 
-    auto result = registration.register_spec("v1", spec_path);
-    ASSERT_TRUE(result.ok);
-    ASSERT_TRUE(fs::exists(result.stored_path));
+    ASSERT_TRUE(ensure_directory(clientkit_root / "v1" / "beta"));
+    ASSERT_TRUE(write_file(clientkit_root / "v1" / "beta" / "manifest.txt", "version:v1\noperation:opBeta\n"));
+    ASSERT_TRUE(touch_generation_stamp(clientkit_root));
 
-    generator->wait_for_idle();
-    generator->stop();
+    EXPECT_TRUE(registry.refresh());
+    EXPECT_TRUE(registry.find_operation("opBeta").has_value());
+    EXPECT_EQ(registry.stats().operation_count, 2u);
+    // Only the new kit was parsed on the second walk.
+    EXPECT_EQ(metrics->snapshot().registry_kits_parsed, 2);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(RuntimeRegistryTest, LookupsSeeCompleteSnapshotsDuringReloads) {
+    auto temp_root = make_unique_temp_dir("registry-snapshot-");
+    auto clientkit_root = temp_root / "clientkit";
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    set_env_var("GATEWAY_LOG_LEVEL", "error");
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    for (int kit = 0; kit < 4; ++kit) {
+        auto kit_dir = clientkit_root / "v1" / ("kit" + std::to_string(kit));
+        ASSERT_TRUE(ensure_directory(kit_dir));
+        ASSERT_TRUE(write_file(kit_dir / "manifest.txt", "operation:op" + std::to_string(kit) + "\n"));
+    }
 
     RuntimeRegistry registry(clientkit_root);
     registry.load();
 
-    auto op = registry.find_operation("sayHello");
+    std::atomic<bool> done{false};
+    std::atomic<int> misses{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&registry, &done, &misses]() {
+            while (!done.load()) {
+                auto snapshot = registry.snapshot();
+                if (snapshot->size() != 4 || !registry.find_operation("op3")) {
+                    ++misses;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < 50; ++i) {
+        registry.load();
+    }
+    done = true;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(misses.load(), 0);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(RuntimeRegistryTest, StoresOperationsCompactly) {
+    auto temp_root = make_unique_temp_dir("registry-compact-");
+    auto clientkit_root = temp_root / "clientkit";
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    for (const std::string kit : {"alpha", "beta"}) {
+        std::string manifest = "version:v1\n";
+        for (int i = 0; i < 1000; ++i) {
+            manifest += "operation:" + kit + "_operation_number_" + std::to_string(i) + "\n";
+        }
+        ASSERT_TRUE(ensure_directory(clientkit_root / "v1" / kit));
+        ASSERT_TRUE(write_file(clientkit_root / "v1" / kit / "manifest.txt", manifest));
+    }
+
+    RuntimeRegistry registry(clientkit_root);
+    registry.load();
+    auto snapshot = registry.snapshot();
+    ASSERT_EQ(snapshot->size(), 2000u);
+    // One version and two kit names, each interned once.
+    EXPECT_EQ(snapshot->names.size(), 3u);
+
+    auto op = registry.find_operation("beta_operation_number_42");
     ASSERT_TRUE(op.has_value());
-    EXPECT_EQ(op->version, "v1");
-    EXPECT_EQ(op->kit_name, "example");
+    EXPECT_EQ(op.version(), "v1");
+    EXPECT_EQ(op.kit_name(), "beta");
+    EXPECT_EQ(op.manifest_path(), clientkit_root / "v1" / "beta" / "manifest.txt");
 
-    McpGateway gateway(registry);
-    auto listed = gateway.list_operations();
-    EXPECT_NE(listed.find("sayHello"), std::string::npos);
+    // Id bytes plus a few words per operation; no per-operation strings.
+    EXPECT_LT(registry.stats().memory_bytes / snapshot->size(), 64u);
 
-    auto response = gateway.execute_operation("sayHello", "{}");
-    EXPECT_NE(response.find("sayHello"), std::string::npos);
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
 
-    auto missing = gateway.execute_operation("missing", "{}");
-    EXPECT_NE(missing.find("Operation not found"), std::string::npos);
+TEST(RuntimeRegistryTest, ParallelScanMatchesSerialScan) {
+    auto temp_root = make_unique_temp_dir("registry-parallel-");
+    auto clientkit_root = temp_root / "clientkit";
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    for (int version = 0; version < 4; ++version) {
+        for (int kit = 0; kit < 10; ++kit) {
+            auto kit_dir = clientkit_root / ("v" + std::to_string(version)) / ("kit" + std::to_string(kit));
+            ASSERT_TRUE(ensure_directory(kit_dir));
+            // Every kit also exposes "shared"; the kit that sorts last wins.
+            ASSERT_TRUE(write_file(kit_dir / "manifest.txt", "operation:op_" + std::to_string(version) + "_" +
+                                                                 std::to_string(kit) + "\noperation:shared\n"));
+        }
+    }
+
+    RuntimeRegistry serial(clientkit_root);
+    serial.load();
+    RuntimeRegistry parallel(clientkit_root);
+    parallel.set_scan_workers(8);
+    parallel.load();
+
+    auto serial_ops = serial.list_operations();
+    auto parallel_ops = parallel.list_operations();
+    ASSERT_EQ(serial_ops.size(), 41u);
+    ASSERT_EQ(parallel_ops.size(), serial_ops.size());
+    for (std::size_t i = 0; i < serial_ops.size(); ++i) {
+        EXPECT_EQ(parallel_ops[i].operation_id, serial_ops[i].operation_id);
+        EXPECT_EQ(parallel_ops[i].manifest_path, serial_ops[i].manifest_path);
+    }
+    auto shared = parallel.find_operation("shared");
+    ASSERT_TRUE(shared.has_value());
+    EXPECT_EQ(shared.version(), "v3");
+    EXPECT_EQ(shared.kit_name(), "kit9");
+
+    auto stats = parallel.stats();
+    EXPECT_EQ(stats.last_scan.kits, 40u);
+    EXPECT_EQ(stats.last_scan.workers, 8u);
+
+    // Borrowing a pool, even from one of its own threads, gives the same
+    // result without starting a thread per worker.
+    auto pool = std::make_shared<WorkStealingExecutor>(2);
+    RuntimeRegistry pooled(clientkit_root);
+    pooled.set_scan_workers(8);
+    pooled.set_scan_executor(pool);
+#ifdef __linux__
+    auto thread_count = []() {
+        return std::distance(fs::directory_iterator("/proc/self/task"), fs::directory_iterator{});
+    };
+    auto threads_before = thread_count();
+#endif
+    std::promise<void> loaded;
+    pool->post([&pooled, &loaded]() {
+        pooled.load();
+        loaded.set_value();
+    });
+    loaded.get_future().wait();
+#ifdef __linux__
+    EXPECT_EQ(thread_count(), threads_before);
+#endif
+    auto pooled_ops = pooled.list_operations();
+    ASSERT_EQ(pooled_ops.size(), serial_ops.size());
+    for (std::size_t i = 0; i < serial_ops.size(); ++i) {
+        EXPECT_EQ(pooled_ops[i].manifest_path, serial_ops[i].manifest_path);
+    }
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(RuntimeRegistryTest, ParallelScanSkipsUnreadableKits) {
+    auto temp_root = make_unique_temp_dir("registry-unreadable-");
+    auto clientkit_root = temp_root / "clientkit";
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    for (const std::string kit : {"alpha", "locked", "omega"}) {
+        ASSERT_TRUE(ensure_directory(clientkit_root / "v1" / kit));
+        ASSERT_TRUE(write_file(clientkit_root / "v1" / kit / "manifest.txt", "operation:" + kit + "Op\n"));
+    }
+    auto locked = clientkit_root / "v1" / "locked" / "manifest.txt";
+    fs::permissions(locked, fs::perms::none);
+    if (std::ifstream(locked)) {
+        fs::permissions(locked, fs::perms::owner_all);
+        fs::remove_all(temp_root);
+        GTEST_SKIP() << "permissions are not enforced for this user";
+    }
+
+    RuntimeRegistry registry(clientkit_root);
+    registry.set_scan_workers(4);
+    registry.load();
+    EXPECT_TRUE(registry.find_operation("alphaOp").has_value());
+    EXPECT_TRUE(registry.find_operation("omegaOp").has_value());
+    EXPECT_FALSE(registry.find_operation("lockedOp").has_value());
+
+    // Once readable again the kit is picked up without a forced reload.
+    fs::permissions(locked, fs::perms::owner_all);
+    registry.refresh();
+    EXPECT_TRUE(registry.find_operation("lockedOp").has_value());
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(RouteIndexTest, RoundTripsAndRejectsCorruption) {
+    auto temp_root = make_unique_temp_dir("route-index-");
+    auto index_path = temp_root / kRouteIndexFile;
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    std::vector<RouteIndexRecord> records{{"zeta", "v1", "kit"}, {"alpha", "v1", "kit"}, {"alpha", "v2", "other"}};
+    ASSERT_TRUE(write_route_index(index_path, records, RouteIndexSource{}));
+
+    auto index = RouteIndex::open(index_path);
+    ASSERT_NE(index, nullptr);
+    EXPECT_EQ(index->size(), 2u);
+    auto alpha = index->find("alpha");
+    ASSERT_TRUE(alpha.has_value());
+    // Later records win on duplicate operation ids.
+    EXPECT_EQ(alpha->version, "v2");
+    EXPECT_EQ(alpha->kit_name, "other");
+    EXPECT_FALSE(index->find("missing").has_value());
+
+    // Flip a byte in the string table; the checksum must reject the file.
+    auto bytes = read_file_to_string(index_path);
+    bytes.back() ^= 0x1;
+    index.reset();
+    ASSERT_TRUE(write_file(index_path, bytes));
+    EXPECT_EQ(RouteIndex::open(index_path), nullptr);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(RouteTableTest, FindsEveryKeyWithoutFalsePositives) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 10000; ++i) {
+        keys.push_back("operation_" + std::to_string(i));
+    }
+    auto key_at = [&keys](std::size_t i) { return std::string_view(keys[i]); };
+
+    RouteTable table;
+    table.build(keys.size(), key_at);
+    EXPECT_GE(table.capacity(), keys.size() * 2);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        auto position = table.find(keys[i], key_at);
+        ASSERT_TRUE(position.has_value());
+        EXPECT_EQ(*position, i);
+    }
+    EXPECT_FALSE(table.find("operation_10000", key_at).has_value());
+    EXPECT_FALSE(RouteTable().find("anything", key_at).has_value());
+}
+
+TEST(GenerationQueueTest, WorkersDrainQueueAndChainStamps) {
+    auto temp_root = make_unique_temp_dir("generation-workers-");
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    // Two copies of every spec in different directories: distinct tasks that
+    // write the same kit, so workers must serialize them.
+    std::vector<fs::path> specs;
+    for (int round = 0; round < 2; ++round) {
+        auto dir = temp_root / ("round" + std::to_string(round));
+        fs::create_directories(dir);
+        for (int i = 0; i < 6; ++i) {
+            specs.push_back(dir / ("kit" + std::to_string(i) + ".yaml"));
+            write_spec(specs.back());
+        }
+    }
+
+    GenerationQueue generator(clientkit_root, 1, 64, nullptr, 3);
+    std::mutex events_mutex;
+    std::vector<GenerationEvent> events;
+    generator.subscribe([&](const GenerationEvent &event) {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        events.push_back(event);
+    });
+    generator.start();
+    for (const auto &spec : specs) {
+        ASSERT_TRUE(generator.enqueue({"v1", spec}));
+    }
+    generator.wait_for_idle();
+
+    auto stats = generator.stats();
+    ASSERT_EQ(stats.workers.size(), 3u);
+    std::size_t completed = 0;
+    for (const auto &worker : stats.workers) {
+        completed += worker.tasks_completed;
+        EXPECT_GE(worker.utilization, 0.0);
+        EXPECT_LE(worker.utilization, 1.0);
+    }
+    EXPECT_EQ(completed, 12u);
+    generator.stop();
+
+    // Stamp updates are serialized across workers, so the events form one
+    // unbroken chain from the empty stamp to the stamp on disk.
+    ASSERT_EQ(events.size(), 12u);
+    std::map<std::string, std::string> next;
+    for (const auto &event : events) {
+        EXPECT_TRUE(next.emplace(event.previous_stamp, event.stamp).second);
+    }
+    std::string stamp;
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        ASSERT_EQ(next.count(stamp), 1u);
+        stamp = next[stamp];
+    }
+    EXPECT_EQ(stamp, read_generation_stamp(clientkit_root));
+    for (int i = 0; i < 6; ++i) {
+        EXPECT_TRUE(fs::exists(clientkit_root / "v1" / ("kit" + std::to_string(i)) / kRouteIndexFile));
+    }
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(GenerationQueueTest, CoalescesPendingTasksAndSkipsUnchangedSpecs) {
+    auto temp_root = make_unique_temp_dir("generation-dedup-");
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto spec = temp_root / "hello.yaml";
+    write_spec(spec);
+
+    auto metrics = std::make_shared<MetricsRegistry>();
+    GenerationQueue generator(clientkit_root, 1, 2, metrics);
+    std::atomic<int> events{0};
+    generator.subscribe([&](const GenerationEvent &) { ++events; });
+
+    // Queued before the worker starts, so the repeats supersede the first
+    // task instead of filling the two-slot queue.
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_TRUE(generator.enqueue({"v1", spec}));
+    }
+    EXPECT_EQ(generator.stats().queue_depth, 1u);
+    generator.start();
+    generator.wait_for_idle();
+    EXPECT_EQ(events.load(), 1);
+    auto stamp = read_generation_stamp(clientkit_root);
+
+    // Identical content leaves the kit and the stamp untouched.
+    ASSERT_TRUE(generator.enqueue({"v1", spec}));
+    generator.wait_for_idle();
+    EXPECT_EQ(events.load(), 1);
+    EXPECT_EQ(read_generation_stamp(clientkit_root), stamp);
+
+    // Changed content regenerates.
+    {
+        std::ofstream out(spec, std::ios::app);
+        out << "  /bye:\n    get:\n      operationId: sayBye\n";
+    }
+    ASSERT_TRUE(generator.enqueue({"v1", spec}));
+    generator.wait_for_idle();
+    generator.stop();
+    EXPECT_EQ(events.load(), 2);
+    EXPECT_NE(read_generation_stamp(clientkit_root), stamp);
+
+    auto snapshot = metrics->snapshot();
+    EXPECT_EQ(snapshot.generation_coalesced, 2);
+    EXPECT_EQ(snapshot.generation_unchanged, 1);
+    EXPECT_EQ(snapshot.generation_success, 2);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(GenerationQueueTest, FailedAttemptsDoNotStallOtherTasks) {
+    auto temp_root = make_unique_temp_dir("generation-retry-");
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto good = temp_root / "good.yaml";
+    write_spec(good);
+
+    auto metrics = std::make_shared<MetricsRegistry>();
+    GenerationQueue generator(clientkit_root, 3, 8, metrics);
+    std::atomic<std::size_t> retries_when_generated{0};
+    generator.subscribe([&](const GenerationEvent &) { retries_when_generated = generator.stats().retry_pending; });
+
+    // The missing spec fails first; while it backs off, the single worker
+    // generates the good spec instead of sleeping.
+    ASSERT_TRUE(generator.enqueue({"v1", temp_root / "missing.yaml"}));
+    ASSERT_TRUE(generator.enqueue({"v1", good}));
+    generator.start();
+    generator.wait_for_idle();
+    generator.stop();
+
+    EXPECT_EQ(retries_when_generated.load(), 1u);
+    EXPECT_EQ(generator.stats().retry_pending, 0u);
+    auto snapshot = metrics->snapshot();
+    EXPECT_EQ(snapshot.generation_success, 1);
+    EXPECT_EQ(snapshot.generation_failure, 1);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(GenerationQueueTest, RejectedEnqueueKeepsPendingRetry) {
+    auto temp_root = make_unique_temp_dir("generation-retry-full-");
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto missing = temp_root / "missing.yaml";
+    std::vector<fs::path> good;
+    for (int i = 0; i < 3; ++i) {
+        good.push_back(temp_root / ("good" + std::to_string(i) + ".yaml"));
+        write_spec(good.back());
+    }
+
+    auto metrics = std::make_shared<MetricsRegistry>();
+    GenerationQueue generator(clientkit_root, 2, 2, metrics);
+    std::promise<void> entered;
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    std::atomic<bool> first{true};
+    // Hold the only worker in the first completion so the retry stays parked
+    // while the queue fills up behind it.
+    generator.subscribe([&](const GenerationEvent &) {
+        if (first.exchange(false)) {
+            entered.set_value();
+            released.wait();
+        }
+    });
+
+    ASSERT_TRUE(generator.enqueue({"v1", missing}));
+    ASSERT_TRUE(generator.enqueue({"v1", good[0]}));
+    generator.start();
+    entered.get_future().wait();
+    ASSERT_EQ(generator.stats().retry_pending, 1u);
+    ASSERT_TRUE(generator.enqueue({"v1", good[1]}));
+    ASSERT_TRUE(generator.enqueue({"v1", good[2]}));
+    EXPECT_FALSE(generator.enqueue({"v1", missing}));
+    EXPECT_EQ(generator.stats().retry_pending, 1u);
+    release.set_value();
+    generator.wait_for_idle();
+    generator.stop();
+
+    // The parked retry still ran its final attempt.
+    auto snapshot = metrics->snapshot();
+    EXPECT_EQ(snapshot.generation_success, 3);
+    EXPECT_EQ(snapshot.generation_failure, 1);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(GenerationQueueTest, DueRetriesWaitBehindHigherClasses) {
+    auto temp_root = make_unique_temp_dir("generation-retry-class-");
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto metrics = std::make_shared<MetricsRegistry>();
+    GenerationQueue generator(clientkit_root, 2, 32, metrics);
+    std::vector<long long> failures_seen;
+    std::size_t bulk_depth_seen = 0;
+    generator.subscribe([&](const GenerationEvent &) {
+        failures_seen.push_back(metrics->snapshot().generation_failure);
+        auto stats = generator.stats();
+        bulk_depth_seen =
+            std::max(bulk_depth_seen, stats.classes[static_cast<std::size_t>(GenerationPriority::Bulk)].depth);
+        // Keep the normal work going past the retry's backoff.
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    });
+
+    ASSERT_TRUE(generator.enqueue({"v1", temp_root / "missing.yaml", GenerationPriority::Bulk}));
+    generator.start();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (generator.stats().retry_pending == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(generator.stats().retry_pending, 1u);
+    for (int i = 0; i < 12; ++i) {
+        auto spec = temp_root / ("normal" + std::to_string(i) + ".yaml");
+        write_spec(spec);
+        ASSERT_TRUE(generator.enqueue({"v2", spec, GenerationPriority::Normal}));
+    }
+    generator.wait_for_idle();
+    generator.stop();
+
+    // The bulk retry fell due mid-way but queued behind the normal class, so
+    // its final attempt only ran once that class was empty.
+    ASSERT_EQ(failures_seen.size(), 12u);
+    EXPECT_EQ(bulk_depth_seen, 1u);
+    for (auto failures : failures_seen) {
+        EXPECT_EQ(failures, 0);
+    }
+    EXPECT_EQ(metrics->snapshot().generation_failure, 1);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(GenerationQueueTest, ResumesUnfinishedTasksFromJournal) {
+    auto temp_root = make_unique_temp_dir("generation-journal-");
+    auto clientkit_root = temp_root / "clientkit";
+    auto journal_path = clientkit_root / kGenerationJournalFile;
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto done = temp_root / "done.yaml";
+    auto started = temp_root / "started.yaml";
+    auto queued = temp_root / "queued.yaml";
+    for (const auto &spec : {done, started, queued}) {
+        write_spec(spec);
+    }
+    // A previous process finished one task, crashed mid-way through another
+    // with a third still queued, and tore its final record.
+    ASSERT_TRUE(write_file(journal_path, "E\t1\tv1\t" + done.string() + "\nE\t2\tv1\t" + started.string() +
+                                             "\nE\t3\tv1\t" + queued.string() + "\nS\t1\nS\t2\nD\t1\nD\t3"));
+
+    {
+        GenerationQueue generator(clientkit_root, 1, 8);
+        ASSERT_TRUE(generator.enable_journal(journal_path));
+        EXPECT_EQ(generator.stats().queue_depth, 2u);
+        generator.start();
+        generator.wait_for_idle();
+    }
+    EXPECT_FALSE(fs::exists(clientkit_root / "v1" / "done"));
+    EXPECT_TRUE(fs::exists(clientkit_root / "v1" / "started" / kRouteIndexFile));
+    EXPECT_TRUE(fs::exists(clientkit_root / "v1" / "queued" / kRouteIndexFile));
+
+    // Everything finished, so a second restart has nothing to resume, and
+    // new ids continue past the replayed ones.
+    GenerationJournal journal(journal_path);
+    std::vector<JournalEntry> pending;
+    ASSERT_TRUE(journal.open(pending));
+    EXPECT_TRUE(pending.empty());
+    auto compacted_size = fs::file_size(journal_path);
+    EXPECT_EQ(journal.record_enqueue("v1", done, 1), 4u);
+    EXPECT_EQ(journal.record_enqueue("v1\tbad", done, 1), 0u);
+    // Records are only buffered until flushed, so callers can journal under
+    // a lock and do the I/O after releasing it.
+    EXPECT_EQ(fs::file_size(journal_path), compacted_size);
+    journal.flush();
+    EXPECT_GT(fs::file_size(journal_path), compacted_size);
+
+    // While this journal is open no other process (or queue) may replay it.
+    GenerationJournal rival(journal_path);
+    EXPECT_FALSE(rival.open(pending));
+    GenerationQueue other(clientkit_root, 1, 8);
+    EXPECT_FALSE(other.enable_journal(journal_path));
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(GenerationQueueTest, SchedulesByPriorityThenWeightedVersion) {
+    auto temp_root = make_unique_temp_dir("generation-priority-");
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    GenerationQueue generator(clientkit_root, 1, 16);
+    generator.set_version_weight("v2", 2);
+    std::vector<std::string> order;
+    generator.subscribe([&](const GenerationEvent &event) { order.push_back(event.kit_name); });
+
+    auto enqueue = [&](const std::string &version, const std::string &name, GenerationPriority priority) {
+        auto spec = temp_root / (name + ".yaml");
+        write_spec(spec);
+        ASSERT_TRUE(generator.enqueue({version, spec, priority}));
+    };
+    // A bulk import under v2 and a smaller one under v3 are queued ahead of
+    // an urgent v1 fix.
+    for (const auto *name : {"a", "b", "c", "d"}) {
+        enqueue("v2", name, GenerationPriority::Normal);
+    }
+    enqueue("v3", "x", GenerationPriority::Normal);
+    enqueue("v3", "y", GenerationPriority::Normal);
+    enqueue("v1", "hotfix", GenerationPriority::High);
+
+    auto stats = generator.stats();
+    EXPECT_EQ(stats.classes[static_cast<std::size_t>(GenerationPriority::High)].depth, 1u);
+    EXPECT_EQ(stats.classes[static_cast<std::size_t>(GenerationPriority::Normal)].depth, 6u);
+
+    generator.start();
+    generator.wait_for_idle();
+    generator.stop();
+
+    std::vector<std::string> expected{"hotfix", "a", "b", "x", "c", "d", "y"};
+    EXPECT_EQ(order, expected);
+    stats = generator.stats();
+    EXPECT_EQ(stats.classes[static_cast<std::size_t>(GenerationPriority::High)].dispatched, 1u);
+    EXPECT_EQ(stats.classes[static_cast<std::size_t>(GenerationPriority::Normal)].dispatched, 6u);
+    EXPECT_EQ(stats.classes[static_cast<std::size_t>(GenerationPriority::Normal)].depth, 0u);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+#ifdef STUB_GENERATOR_PATH
+TEST(GeneratorProcessPoolTest, BatchesOnWarmProcessesAndRecoversFromHangs) {
+    auto temp_root = make_unique_temp_dir("generator-pool-");
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    GeneratorProcessPool::Options options;
+    options.command = {STUB_GENERATOR_PATH};
+    options.max_batch = 8;
+    options.task_timeout = std::chrono::milliseconds(1000);
+    GeneratorProcessPool pool(options);
+
+    auto request = [&](const std::string &name) {
+        return GeneratorRequest{temp_root / (name + ".yaml"), temp_root / "out" / name, {}};
+    };
+    auto generated = [&](const std::string &name) { return read_file_to_string(temp_root / "out" / name / "generated.txt"); };
+
+    // While the single process works on the slow spec, the others queue up
+    // and go to the same process as one batch.
+    GeneratorResult slow;
+    std::thread leader([&]() { slow = pool.generate(request("slow")); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::vector<GeneratorResult> results(3);
+    std::vector<std::thread> followers;
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        followers.emplace_back([&, i]() { results[i] = pool.generate(request("spec" + std::to_string(i))); });
+    }
+    leader.join();
+    for (auto &follower : followers) {
+        follower.join();
+    }
+    ASSERT_TRUE(slow.ok);
+    EXPECT_NE(slow.output.find("generating slow"), std::string::npos);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        ASSERT_TRUE(results[i].ok) << results[i].message;
+        EXPECT_NE(generated("spec" + std::to_string(i)).find("batch=3"), std::string::npos);
+    }
+    auto pid = generated("slow").substr(0, generated("slow").find('\n'));
+    EXPECT_EQ(generated("spec0").rfind(pid, 0), 0u);
+
+    auto failed = pool.generate(request("fail"));
+    EXPECT_FALSE(failed.ok);
+    EXPECT_NE(failed.message.find("cannot generate"), std::string::npos);
+
+    auto hung = pool.generate(request("hang"));
+    EXPECT_FALSE(hung.ok);
+    EXPECT_EQ(hung.message, "generator timed out");
+    EXPECT_TRUE(pool.generate(request("after")).ok);
+
+    auto stats = pool.stats();
+    EXPECT_EQ(stats.processes_spawned, 2u);
+    EXPECT_EQ(stats.batches, 5u);
+    EXPECT_EQ(stats.requests, 7u);
+    EXPECT_EQ(stats.timeouts, 1u);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(GeneratorProcessPoolTest, AdapterRunsOneShotGeneratorPerRequest) {
+    auto temp_root = make_unique_temp_dir("generator-adapter-");
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    // A fake openapi-generator-cli that records its arguments in the output
+    // directory and fails for specs named fail*.
+    auto cli = temp_root / "fake-cli.sh";
+    ASSERT_TRUE(write_file(cli, "#!/bin/sh\n"
+                                "echo \"args: $*\"\n"
+                                "case \"$3\" in *fail*) echo broken >&2; exit 3;; esac\n"
+                                "mkdir -p \"$7\" && echo \"$*\" > \"$7/args.txt\"\n"));
+    fs::permissions(cli, fs::perms::owner_all);
+    set_env_var("OPENAPI_GENERATOR_CLI", cli.string());
+
+    GeneratorProcessPool::Options options;
+    options.command = {GENERATOR_ADAPTER_PATH};
+    GeneratorProcessPool pool(options);
+    auto full = pool.generate({temp_root / "pets.yaml", temp_root / "out" / "pets", {}});
+    ASSERT_TRUE(full.ok) << full.message;
+    EXPECT_NE(full.output.find("args: generate -i"), std::string::npos);
+    EXPECT_EQ(read_file_to_string(temp_root / "out" / "pets" / "args.txt"),
+              "generate -i " + (temp_root / "pets.yaml").string() + " -g cpp-restsdk -o " +
+                  (temp_root / "out" / "pets").string() + "\n");
+
+    auto partial = pool.generate({temp_root / "pets.yaml", temp_root / "out" / "delta", {"addPet", "getPet"}});
+    ASSERT_TRUE(partial.ok) << partial.message;
+    EXPECT_NE(read_file_to_string(temp_root / "out" / "delta" / "args.txt")
+                  .find("--openapi-normalizer FILTER=operationId:addPet|getPet"),
+              std::string::npos);
+
+    auto failed = pool.generate({temp_root / "fail.yaml", temp_root / "out" / "fail", {}});
+    EXPECT_FALSE(failed.ok);
+    EXPECT_NE(failed.message.find("status 3"), std::string::npos);
+    EXPECT_NE(failed.output.find("broken"), std::string::npos);
+
+    set_env_var("OPENAPI_GENERATOR_CLI", "");
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(GeneratorProcessPoolTest, TimedOutProcessStaysReservedUntilReleased) {
+    auto temp_root = make_unique_temp_dir("generator-pool-timeout-");
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    GeneratorProcessPool::Options options;
+    options.command = {STUB_GENERATOR_PATH};
+    options.processes = 2;
+    options.max_batch = 1;
+    options.task_timeout = std::chrono::milliseconds(300);
+    GeneratorProcessPool pool(options);
+
+    auto request = [&](const std::string &name) {
+        return GeneratorRequest{temp_root / (name + ".yaml"), temp_root / "out" / name, {}};
+    };
+
+    // One process hangs until it is killed while the other keeps finishing
+    // slow specs, so waiters wake up right around the kill. The killed slot
+    // must only be reused once its own caller has released it.
+    GeneratorResult hung;
+    std::thread hanging([&]() { hung = pool.generate(request("hang")); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::vector<GeneratorResult> results(6);
+    std::vector<std::thread> callers;
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        callers.emplace_back([&, i]() { results[i] = pool.generate(request("slow" + std::to_string(i))); });
+    }
+    hanging.join();
+    for (auto &caller : callers) {
+        caller.join();
+    }
+
+    EXPECT_FALSE(hung.ok);
+    EXPECT_EQ(hung.message, "generator timed out");
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        ASSERT_TRUE(results[i].ok) << results[i].message;
+        auto generated = read_file_to_string(temp_root / "out" / ("slow" + std::to_string(i)) / "generated.txt");
+        EXPECT_NE(generated.find("batch=1\n"), std::string::npos);
+    }
+    auto stats = pool.stats();
+    EXPECT_EQ(stats.processes_spawned, 3u);
+    EXPECT_EQ(stats.batches, 7u);
+    EXPECT_EQ(stats.timeouts, 1u);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(GenerationQueueTest, RunsBackendBeforeWritingManifest) {
+    auto temp_root = make_unique_temp_dir("generation-backend-");
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto good = temp_root / "hello.yaml";
+    auto bad = temp_root / "failing.yaml";
+    write_spec(good);
+    write_spec(bad);
+    // Distinct bytes, so the failing kit cannot reuse hello's sources.
+    std::ofstream(bad, std::ios::app) << "# failing\n";
+
+    GeneratorProcessPool::Options options;
+    options.command = {STUB_GENERATOR_PATH};
+    GenerationQueue generator(clientkit_root, 1, 8);
+    generator.set_backend(std::make_shared<GeneratorProcessPool>(options));
+    generator.start();
+    ASSERT_TRUE(generator.enqueue({"v1", good}));
+    ASSERT_TRUE(generator.enqueue({"v1", bad}));
+    generator.wait_for_idle();
+    generator.stop();
+
+    EXPECT_TRUE(fs::exists(clientkit_root / "v1" / "hello" / "generated.txt"));
+    EXPECT_TRUE(fs::exists(clientkit_root / "v1" / "hello" / "manifest.txt"));
+    EXPECT_FALSE(fs::exists(clientkit_root / "v1" / "failing"));
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(GenerationQueueTest, RegeneratesOnlyChangedOperations) {
+    auto temp_root = make_unique_temp_dir("generation-incremental-");
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto spec = temp_root / "hello.yaml";
+    auto generated = clientkit_root / "v1" / "hello" / "generated.txt";
+    GeneratorProcessPool::Options options;
+    options.command = {STUB_GENERATOR_PATH};
+    auto metrics = std::make_shared<MetricsRegistry>();
+    GenerationQueue generator(clientkit_root, 1, 8, metrics);
+    generator.set_backend(std::make_shared<GeneratorProcessPool>(options));
+    generator.start();
+    auto generate = [&](const std::string &bye_summary) {
+        std::ofstream(spec) << "openapi: 3.0.0\npaths:\n  /hello:\n    get:\n      operationId: sayHello\n"
+                               "  /bye:\n    get:\n      operationId: sayBye\n      summary: "
+                            << bye_summary << "\n";
+        EXPECT_TRUE(generator.enqueue({"v1", spec}));
+        generator.wait_for_idle();
+        return read_file_to_string(generated);
+    };
+
+    EXPECT_NE(generate("first").find("operations=\n"), std::string::npos);
+    // Sources the backend does not regenerate are carried over.
+    ASSERT_TRUE(write_file(clientkit_root / "v1" / "hello" / "kept.txt", "kept"));
+    EXPECT_NE(generate("second").find("operations=sayBye\n"), std::string::npos);
+    generator.stop();
+    EXPECT_EQ(read_file_to_string(clientkit_root / "v1" / "hello" / "kept.txt"), "kept");
+
+    auto manifest = read_file_to_string(clientkit_root / "v1" / "hello" / "manifest.txt");
+    EXPECT_NE(manifest.find("operation:sayHello\n"), std::string::npos);
+    EXPECT_NE(manifest.find("operation:sayBye\n"), std::string::npos);
+    EXPECT_NE(manifest.find("route:sayBye\tGET\t/bye\t\n"), std::string::npos);
+    EXPECT_EQ(metrics->snapshot().generation_incremental, 1);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(GenerationQueueTest, FailedRegenerationKeepsLastGoodKit) {
+    auto temp_root = make_unique_temp_dir("generation-staging-");
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    // Writes a source file, or leaves a partial one behind and fails.
+    struct FlakyBackend : GeneratorBackend {
+        std::atomic<bool> fail{false};
+        GeneratorResult generate(const GeneratorRequest &request) override {
+            std::ofstream(request.output_dir / (fail ? "partial.txt" : "generated.txt")) << "sources";
+            return {!fail, fail ? "boom" : "", ""};
+        }
+    };
+    auto backend = std::make_shared<FlakyBackend>();
+    GenerationQueue generator(clientkit_root, 1, 8);
+    generator.set_backend(backend);
+    generator.start();
+    auto spec = temp_root / "hello.yaml";
+    auto kit = clientkit_root / "v1" / "hello";
+    write_spec(spec);
+    ASSERT_TRUE(generator.enqueue({"v1", spec}));
+    generator.wait_for_idle();
+    ASSERT_TRUE(fs::exists(kit / "generated.txt"));
+    auto manifest = read_file_to_string(kit / "manifest.txt");
+
+    // A failed full regeneration leaves the kit as it was, with no staging
+    // directory behind.
+    std::ofstream(spec, std::ios::app) << "servers:\n  - url: http://example.com\n";
+    backend->fail = true;
+    ASSERT_TRUE(generator.enqueue({"v1", spec}));
+    generator.wait_for_idle();
+    EXPECT_TRUE(fs::exists(kit / "generated.txt"));
+    EXPECT_FALSE(fs::exists(kit / "partial.txt"));
+    EXPECT_EQ(read_file_to_string(kit / "manifest.txt"), manifest);
+    EXPECT_EQ(std::distance(fs::directory_iterator(clientkit_root / "v1"), fs::directory_iterator{}), 1);
+
+    // The next successful run replaces it whole.
+    backend->fail = false;
+    ASSERT_TRUE(generator.enqueue({"v1", spec}));
+    generator.wait_for_idle();
+    generator.stop();
+    EXPECT_NE(read_file_to_string(kit / "manifest.txt").find("server:http://example.com\n"), std::string::npos);
+    EXPECT_EQ(std::distance(fs::directory_iterator(clientkit_root / "v1"), fs::directory_iterator{}), 1);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(GenerationQueueTest, SharesSourcesAcrossIdenticalSpecs) {
+    auto temp_root = make_unique_temp_dir("generation-shared-");
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto spec = temp_root / "hello.yaml";
+    write_spec(spec);
+    GeneratorProcessPool::Options options;
+    options.command = {STUB_GENERATOR_PATH};
+    auto pool = std::make_shared<GeneratorProcessPool>(options);
+    auto metrics = std::make_shared<MetricsRegistry>();
+    auto generator = std::make_shared<GenerationQueue>(clientkit_root, 1, 8, metrics);
+    generator->set_backend(pool);
+    generator->start();
+    RegistrationService service(temp_root / "mappings", generator, metrics);
+    ASSERT_TRUE(service.register_spec("v1", spec).ok);
+    generator->wait_for_idle();
+    ASSERT_TRUE(service.register_spec("v2", spec).ok);
+    generator->wait_for_idle();
+    generator->stop();
+
+    // The generator ran once; v2 received a copy of v1's sources.
+    EXPECT_EQ(pool->stats().requests, 1u);
+    EXPECT_EQ(metrics->snapshot().generation_shared, 1);
+    EXPECT_EQ(read_file_to_string(clientkit_root / "v2" / "hello" / "generated.txt"),
+              read_file_to_string(clientkit_root / "v1" / "hello" / "generated.txt"));
+    auto manifest = read_file_to_string(clientkit_root / "v2" / "hello" / "manifest.txt");
+    EXPECT_NE(manifest.find("version:v2\n"), std::string::npos);
+    EXPECT_NE(manifest.find("operation:sayHello\n"), std::string::npos);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+#endif
+
+TEST(WorkStealingExecutorTest, IdleWorkersStealFromABusyOne) {
+    WorkStealingExecutor executor(4);
+    std::atomic<int> done{0};
+    std::promise<void> finished;
+    // One task fans out onto its own deque and then stays busy, so every
+    // child must be stolen by the other workers.
+    executor.post([&]() {
+        for (int i = 0; i < 1000; ++i) {
+            executor.post([&]() { ++done; });
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (done < 1000 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        finished.set_value();
+    });
+    finished.get_future().wait();
+    EXPECT_EQ(done, 1000);
+    EXPECT_EQ(executor.stats().stolen, 1000u);
+}
+
+TEST(McpGatewayTest, AsyncOperationsHoldSlotsNotThreads) {
+    auto temp_root = make_unique_temp_dir("gateway-async-");
+    auto mappings_root = temp_root / "mappings";
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto generator = std::make_shared<GenerationQueue>(clientkit_root, 1);
+    generator->start();
+    RegistrationService registration(mappings_root, generator);
+    auto spec_path = temp_root / "example.yaml";
+    write_spec(spec_path);
+    ASSERT_TRUE(registration.register_spec("v1", spec_path).ok);
+    generator->wait_for_idle();
+    generator->stop();
+
+    auto executor = std::make_shared<WorkStealingExecutor>(1);
+    auto metrics = std::make_shared<MetricsRegistry>();
+    McpGateway gateway(RuntimeRegistry(clientkit_root, metrics), 4, metrics);
+    gateway.set_executor(executor);
+    ConcurrencyLimiter::Options admission;
+    admission.initial_limit = 4;
+    admission.adaptive = false;
+    admission.max_queue = 0;
+    gateway.configure_admission(admission, std::chrono::milliseconds(0));
+    // Load the registry first so lookups are decided on the calling thread.
+    gateway.operations();
+
+    // Park the only executor thread: admitted operations queue behind it
+    // while still counting against the limit.
+    std::promise<void> parked;
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    executor->post([&parked, released]() {
+        parked.set_value();
+        released.wait();
+    });
+    parked.get_future().wait();
+
+    std::vector<std::future<ExecuteResult>> admitted;
+    for (int i = 0; i < 4; ++i) {
+        admitted.push_back(gateway.execute_operation_async("sayHello", "call " + std::to_string(i)));
+    }
+    auto rejected = gateway.execute_operation_async("sayHello", "one too many");
+    ASSERT_EQ(rejected.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_EQ(rejected.get().status, ExecuteResult::Status::Rejected);
+
+    release.set_value();
+    for (int i = 0; i < 4; ++i) {
+        auto result = admitted[i].get();
+        EXPECT_TRUE(result.ok());
+        EXPECT_EQ(result.message, "Executed sayHello for version v1 with payload: call " + std::to_string(i));
+    }
+    // Slots are returned before the callbacks run, so capacity is back.
+    EXPECT_TRUE(gateway.execute_operation_async("sayHello", "again").get().ok());
+    EXPECT_EQ(gateway.execute_operation_async("missing", "{}").get().status, ExecuteResult::Status::NotFound);
+    auto snapshot = metrics->snapshot();
+    EXPECT_EQ(snapshot.mcp_execute_rejected, 1);
+    EXPECT_EQ(snapshot.mcp_execute_success, 5);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(ConcurrencyLimiterTest, AdaptsLimitToLatency) {
+    ConcurrencyLimiter::Options options;
+    options.initial_limit = 4;
+    options.max_limit = 64;
+    ConcurrencyLimiter limiter(options);
+    auto forever = std::chrono::steady_clock::now() + std::chrono::hours(1);
+
+    // Run rounds that fill every slot, then release them with the given
+    // latency.
+    auto round = [&](std::chrono::microseconds latency) {
+        auto slots = limiter.stats().limit;
+        std::size_t granted = 0;
+        for (std::size_t i = 0; i < slots; ++i) {
+            limiter.acquire(forever, [&](ConcurrencyLimiter::Admission admission, std::chrono::steady_clock::duration) {
+                granted += admission == ConcurrencyLimiter::Admission::Admitted;
+            });
+        }
+        EXPECT_EQ(granted, slots);
+        for (std::size_t i = 0; i < slots; ++i) {
+            limiter.release(latency);
+        }
+    };
+
+    // Steady latency under full load: the limit climbs.
+    for (int i = 0; i < 10; ++i) {
+        round(std::chrono::microseconds(1000));
+    }
+    auto grown = limiter.stats().limit;
+    EXPECT_GT(grown, 4u);
+
+    // Latency jumps well past the tolerance: the limit backs off.
+    for (int i = 0; i < 5; ++i) {
+        round(std::chrono::microseconds(10000));
+    }
+    auto shrunk = limiter.stats().limit;
+    EXPECT_LT(shrunk, grown);
+    EXPECT_GE(shrunk, 1u);
+
+    // Samples taken at low utilization never raise the limit.
+    for (int i = 0; i < 20; ++i) {
+        limiter.acquire(forever, [](ConcurrencyLimiter::Admission, std::chrono::steady_clock::duration) {});
+        limiter.release(std::chrono::microseconds(100));
+    }
+    EXPECT_LE(limiter.stats().limit, shrunk);
+}
+
+TEST(ConcurrencyLimiterTest, TimedOutGrantMayDestroyItsLimiter) {
+    ConcurrencyLimiter::Options options;
+    options.initial_limit = 1;
+    options.adaptive = false;
+    auto limiter = std::make_shared<ConcurrencyLimiter>(options);
+    auto now = std::chrono::steady_clock::now();
+    limiter->acquire(now + std::chrono::hours(1), [](ConcurrencyLimiter::Admission, std::chrono::steady_clock::duration) {});
+
+    // The queued grant owns the last reference, so the limiter is destroyed
+    // on the shared deadline thread once the grant has run.
+    std::promise<ConcurrencyLimiter::Admission> refused;
+    auto refusal = refused.get_future();
+    limiter->acquire(now + std::chrono::milliseconds(20),
+                     [&refused, owner = limiter](ConcurrencyLimiter::Admission admission,
+                                                 std::chrono::steady_clock::duration) { refused.set_value(admission); });
+    limiter.reset();
+    ASSERT_EQ(refusal.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(refusal.get(), ConcurrencyLimiter::Admission::TimedOut);
+
+    // The thread keeps serving other limiters afterwards.
+    ConcurrencyLimiter other(options);
+    other.acquire(now + std::chrono::hours(1), [](ConcurrencyLimiter::Admission, std::chrono::steady_clock::duration) {});
+    std::promise<ConcurrencyLimiter::Admission> later;
+    other.acquire(std::chrono::steady_clock::now() + std::chrono::milliseconds(20),
+                  [&later](ConcurrencyLimiter::Admission admission, std::chrono::steady_clock::duration) {
+                      later.set_value(admission);
+                  });
+    auto later_refusal = later.get_future();
+    ASSERT_EQ(later_refusal.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(later_refusal.get(), ConcurrencyLimiter::Admission::TimedOut);
+}
+
+TEST(McpGatewayTest, QueuesCallsUntilSlotsFreeOrDeadlinesPass) {
+    auto temp_root = make_unique_temp_dir("gateway-admission-");
+    auto mappings_root = temp_root / "mappings";
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto generator = std::make_shared<GenerationQueue>(clientkit_root, 1);
+    generator->start();
+    RegistrationService registration(mappings_root, generator);
+    auto spec_path = temp_root / "example.yaml";
+    write_spec(spec_path);
+    ASSERT_TRUE(registration.register_spec("v1", spec_path).ok);
+    generator->wait_for_idle();
+    generator->stop();
+
+    auto executor = std::make_shared<WorkStealingExecutor>(1);
+    auto metrics = std::make_shared<MetricsRegistry>();
+    McpGateway gateway(RuntimeRegistry(clientkit_root, metrics), 1, metrics);
+    gateway.set_executor(executor);
+    ConcurrencyLimiter::Options admission;
+    admission.initial_limit = 1;
+    admission.adaptive = false;
+    admission.max_queue = 2;
+    gateway.configure_admission(admission, std::chrono::milliseconds(5000));
+    gateway.operations();
+
+    std::promise<void> parked;
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    executor->post([&parked, released]() {
+        parked.set_value();
+        released.wait();
+    });
+    parked.get_future().wait();
+
+    // One call takes the only slot, two wait in the queue, and the fourth is
+    // turned away because the queue is full.
+    auto first = gateway.execute_operation_async("sayHello", "1");
+    auto second = gateway.execute_operation_async("sayHello", "2");
+    auto third = gateway.execute_operation_async("sayHello", "3");
+    auto overflow = gateway.execute_operation_async("sayHello", "4");
+    ASSERT_EQ(overflow.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_EQ(overflow.get().message, "Backpressure: too many concurrent operations");
+    EXPECT_EQ(gateway.admission_stats().queued, 2u);
+    EXPECT_EQ(metrics->snapshot().mcp_execute_queue_depth, 2);
+
+    // The queued calls run once the slot frees up instead of failing.
+    release.set_value();
+    EXPECT_TRUE(first.get().ok());
+    EXPECT_TRUE(second.get().ok());
+    EXPECT_TRUE(third.get().ok());
+    auto snapshot = metrics->snapshot();
+    EXPECT_EQ(snapshot.mcp_execute_queued, 2);
+    EXPECT_EQ(snapshot.mcp_execute_rejected, 1);
+    EXPECT_EQ(snapshot.mcp_concurrency_limit, 1);
+
+    // A waiter whose deadline passes is refused by the limiter's own timer,
+    // even though no slot is ever released.
+    gateway.configure_admission(admission, std::chrono::milliseconds(30));
+    std::promise<void> parked_again;
+    std::promise<void> hold;
+    auto held = hold.get_future().share();
+    executor->post([&parked_again, held]() {
+        parked_again.set_value();
+        held.wait();
+    });
+    parked_again.get_future().wait();
+    auto running = gateway.execute_operation_async("sayHello", "runs");
+    auto waiting = gateway.execute_operation_async("sayHello", "waits");
+    ASSERT_EQ(waiting.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(waiting.get().message, "Backpressure: timed out waiting for a concurrency slot");
+    EXPECT_EQ(metrics->snapshot().mcp_execute_queue_timeouts, 1);
+    hold.set_value();
+    EXPECT_TRUE(running.get().ok());
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(McpGatewayTest, BulkheadsIsolateDownstreamHosts) {
+    auto temp_root = make_unique_temp_dir("gateway-bulkheads-");
+    auto mappings_root = temp_root / "mappings";
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto generator = std::make_shared<GenerationQueue>(clientkit_root, 1);
+    generator->start();
+    RegistrationService registration(mappings_root, generator);
+    // Two kits behind different hosts, and one without servers.
+    auto write_kit_spec = [&](const std::string &name, const std::string &server, const std::string &operation) {
+        auto path = temp_root / (name + ".yaml");
+        std::ofstream out(path);
+        out << "openapi: 3.0.0\ninfo:\n  title: " << name << "\n";
+        if (!server.empty()) {
+            out << "servers:\n  - url: " << server << "\n";
+        }
+        out << "paths:\n  /" << operation << ":\n    get:\n      operationId: " << operation << "\n";
+        return path;
+    };
+    ASSERT_TRUE(registration.register_spec("v1", write_kit_spec("slow", "https://Slow.example.com/api", "slowCall")).ok);
+    ASSERT_TRUE(registration.register_spec("v1", write_kit_spec("fast", "http://fast.example.com:8080", "fastCall")).ok);
+    ASSERT_TRUE(registration.register_spec("v1", write_kit_spec("local", "", "localCall")).ok);
+    generator->wait_for_idle();
+    generator->stop();
+
+    auto executor = std::make_shared<WorkStealingExecutor>(1);
+    McpGateway gateway(RuntimeRegistry(clientkit_root), 1);
+    gateway.set_executor(executor);
+    ConcurrencyLimiter::Options admission;
+    admission.initial_limit = 1;
+    admission.adaptive = false;
+    admission.max_queue = 0;
+    gateway.configure_admission(admission, std::chrono::milliseconds(0));
+    gateway.configure_bulkheads(BulkheadKey::Host, {{"fast.example.com:8080", 2}});
+    // One call per kit caches its routes, so later calls pick their bulkhead
+    // without reading a manifest.
+    auto warm_up = [](McpGateway &target) {
+        for (const char *operation : {"slowCall", "fastCall", "localCall"}) {
+            ASSERT_TRUE(target.execute(operation, "warm").ok());
+        }
+    };
+    warm_up(gateway);
+
+    std::promise<void> parked;
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    executor->post([&parked, released]() {
+        parked.set_value();
+        released.wait();
+    });
+    parked.get_future().wait();
+
+    // The slow host's only slot is taken, so its next call is refused, while
+    // the fast host and the server-less kit still admit from their own pools.
+    auto slow = gateway.execute_operation_async("slowCall", "1");
+    auto refused = gateway.execute_operation_async("slowCall", "2");
+    ASSERT_EQ(refused.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_EQ(refused.get().status, ExecuteResult::Status::Rejected);
+    auto fast = gateway.execute_operation_async("fastCall", "1");
+    auto fast_again = gateway.execute_operation_async("fastCall", "2");
+    auto local = gateway.execute_operation_async("localCall", "1");
+    EXPECT_EQ(fast_again.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+
+    auto stats = gateway.bulkhead_stats();
+    ASSERT_EQ(stats.size(), 3u);
+    EXPECT_EQ(stats[0].name, "fast.example.com:8080");
+    EXPECT_EQ(stats[0].stats.limit, 2u);
+    EXPECT_EQ(stats[0].stats.in_flight, 2u);
+    EXPECT_EQ(stats[1].name, "slow.example.com");
+    EXPECT_EQ(stats[1].stats.in_flight, 1u);
+    EXPECT_EQ(stats[2].name, "v1/local");
+    EXPECT_EQ(gateway.admission_stats().in_flight, 4u);
+
+    // Calls queued in several bulkheads share the limiters' one deadline
+    // thread rather than each bulkhead starting its own.
+    McpGateway queued_gateway(RuntimeRegistry(clientkit_root), 1);
+    queued_gateway.set_executor(executor);
+    admission.max_queue = 4;
+    queued_gateway.configure_admission(admission, std::chrono::milliseconds(50));
+    queued_gateway.configure_bulkheads(BulkheadKey::Host);
+    warm_up(queued_gateway);
+    std::vector<std::future<ExecuteResult>> holding;
+    for (const char *operation : {"slowCall", "fastCall", "localCall"}) {
+        holding.push_back(queued_gateway.execute_operation_async(operation, "held"));
+    }
+#ifdef __linux__
+    auto thread_count = []() {
+        return std::distance(fs::directory_iterator("/proc/self/task"), fs::directory_iterator{});
+    };
+    auto threads_before = thread_count();
+#endif
+    std::vector<std::future<ExecuteResult>> waiting;
+    for (const char *operation : {"slowCall", "fastCall", "localCall"}) {
+        waiting.push_back(queued_gateway.execute_operation_async(operation, "queued"));
+    }
+    EXPECT_EQ(queued_gateway.admission_stats().queued, 3u);
+#ifdef __linux__
+    EXPECT_LE(thread_count() - threads_before, 1);
+#endif
+    for (auto &call : waiting) {
+        EXPECT_EQ(call.get().status, ExecuteResult::Status::Rejected);
+    }
+
+    release.set_value();
+    EXPECT_TRUE(slow.get().ok());
+    EXPECT_TRUE(fast.get().ok());
+    EXPECT_TRUE(fast_again.get().ok());
+    EXPECT_TRUE(local.get().ok());
+    for (auto &call : holding) {
+        EXPECT_TRUE(call.get().ok());
+    }
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(McpGatewayTest, LooksUpOnExecutorWhileRegistryIsStale) {
+    auto temp_root = make_unique_temp_dir("gateway-stale-");
+    auto mappings_root = temp_root / "mappings";
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto generator = std::make_shared<GenerationQueue>(clientkit_root, 1);
+    generator->start();
+    RegistrationService registration(mappings_root, generator);
+    auto spec_path = temp_root / "example.yaml";
+    write_spec(spec_path);
+    ASSERT_TRUE(registration.register_spec("v1", spec_path).ok);
+    generator->wait_for_idle();
+    generator->stop();
+
+    auto executor = std::make_shared<WorkStealingExecutor>(1);
+    McpGateway gateway(RuntimeRegistry(clientkit_root), 1);
+    gateway.set_executor(executor);
+
+    std::promise<void> parked;
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    executor->post([&parked, released]() {
+        parked.set_value();
+        released.wait();
+    });
+    parked.get_future().wait();
+
+    // Nothing is loaded yet, so neither the scan nor an unknown operation is
+    // answered on the calling thread; both wait for the executor.
+    auto call = gateway.execute_operation_async("sayHello", "cold");
+    auto missing = gateway.execute_operation_async("missing", "cold");
+    std::promise<std::size_t> listed;
+    gateway.operations_async([&listed](std::vector<OperationDescriptor> operations) {
+        listed.set_value(operations.size());
+    });
+    auto listed_count = listed.get_future();
+    EXPECT_EQ(call.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+    EXPECT_EQ(missing.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+    EXPECT_EQ(listed_count.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+
+    release.set_value();
+    EXPECT_TRUE(call.get().ok());
+    EXPECT_EQ(missing.get().status, ExecuteResult::Status::NotFound);
+    EXPECT_EQ(listed_count.get(), 1u);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(McpGatewayTest, AppliesGenerationEventsWithoutRescan) {
+    auto temp_root = make_unique_temp_dir("gateway-events-");
+    auto mappings_root = temp_root / "mappings";
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto metrics = std::make_shared<MetricsRegistry>();
+    auto generator = std::make_shared<GenerationQueue>(clientkit_root, 1);
+    RuntimeRegistry registry(clientkit_root, metrics);
+    registry.load();
+    McpGateway gateway(registry, 8, metrics);
+    gateway.follow(generator);
+    generator->start();
+
+    RegistrationService registration(mappings_root, generator);
+    auto spec_path = temp_root / "example.yaml";
+    write_spec(spec_path);
+    ASSERT_TRUE(registration.register_spec("v1", spec_path).ok);
+    generator->wait_for_idle();
+
+    // The event patched the registry and adopted the new stamp, so the
+    // request path neither walks nor parses anything.
+    auto response = gateway.execute_operation("sayHello", "{}");
+    EXPECT_NE(response.find("Executed sayHello"), std::string::npos);
+    auto snapshot = metrics->snapshot();
+    EXPECT_EQ(snapshot.registry_kits_parsed, 0);
+    EXPECT_EQ(snapshot.registry_refresh_skipped, 1);
+
+    generator->stop();
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+#ifdef __linux__
+// Read one HTTP response from a blocking socket, leaving any pipelined bytes
+// after it in buffer. Returns the status line plus body, or "" on EOF.
+std::string read_http_response(int fd, std::string &buffer) {
+    while (true) {
+        auto header_end = buffer.find("\r\n\r\n");
+        if (header_end != std::string::npos) {
+            auto length_at = buffer.find("Content-Length: ");
+            std::size_t length = std::stoul(buffer.substr(length_at + 16));
+            if (buffer.size() >= header_end + 4 + length) {
+                auto response = buffer.substr(0, buffer.find("\r\n")) + "\n" + buffer.substr(header_end + 4, length);
+                buffer.erase(0, header_end + 4 + length);
+                return response;
+            }
+        }
+        char chunk[4096];
+        auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return {};
+        }
+        buffer.append(chunk, static_cast<std::size_t>(n));
+    }
+}
+
+std::string http_post(const std::string &body, const std::string &connection = "keep-alive") {
+    return "POST /mcp HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/json\r\nConnection: " + connection +
+           "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+// A keep-alive HTTP/1.1 server on an ephemeral loopback port, one thread per
+// connection. respond turns each request into a reply; a reply with close
+// set ends the connection after it is written.
+class StubHttpServer {
+  public:
+    struct Reply {
+        std::string text;
+        bool close{false};
+    };
+    using Respond = std::function<Reply(const std::string &method, const std::string &target, const std::string &body)>;
+
+    explicit StubHttpServer(Respond respond) : respond_(std::move(respond)) {
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+        ::listen(listen_fd_, 16);
+        socklen_t length = sizeof(addr);
+        ::getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &length);
+        port_ = ntohs(addr.sin_port);
+        acceptor_ = std::thread([this]() {
+            for (int fd; (fd = ::accept(listen_fd_, nullptr, nullptr)) >= 0;) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++accepted_;
+                open_.push_back(fd);
+                workers_.emplace_back([this, fd]() { serve(fd); });
+            }
+        });
+    }
+
+    ~StubHttpServer() {
+        ::shutdown(listen_fd_, SHUT_RDWR);
+        acceptor_.join();
+        ::close(listen_fd_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int fd : open_) {
+                ::shutdown(fd, SHUT_RDWR);
+            }
+        }
+        for (auto &worker : workers_) {
+            worker.join();
+        }
+    }
+
+    std::uint16_t port() const { return port_; }
+
+    int accepted() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return accepted_;
+    }
+
+  private:
+    void serve(int fd) {
+        std::string buffer;
+        while (true) {
+            auto header_end = buffer.find("\r\n\r\n");
+            if (header_end == std::string::npos) {
+                char chunk[4096];
+                auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) {
+                    break;
+                }
+                buffer.append(chunk, static_cast<std::size_t>(n));
+                continue;
+            }
+            std::size_t length = 0;
+            auto length_at = buffer.find("Content-Length: ");
+            if (length_at != std::string::npos && length_at < header_end) {
+                length = std::stoul(buffer.substr(length_at + 16));
+            }
+            if (buffer.size() < header_end + 4 + length) {
+                char chunk[4096];
+                auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) {
+                    break;
+                }
+                buffer.append(chunk, static_cast<std::size_t>(n));
+                continue;
+            }
+            auto first_space = buffer.find(' ');
+            auto second_space = buffer.find(' ', first_space + 1);
+            auto reply = respond_(buffer.substr(0, first_space),
+                                  buffer.substr(first_space + 1, second_space - first_space - 1),
+                                  buffer.substr(header_end + 4, length));
+            buffer.erase(0, header_end + 4 + length);
+            ::send(fd, reply.text.data(), reply.text.size(), MSG_NOSIGNAL);
+            if (reply.close) {
+                break;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_.erase(std::find(open_.begin(), open_.end(), fd));
+        ::close(fd);
+    }
+
+    Respond respond_;
+    int listen_fd_{-1};
+    std::uint16_t port_{0};
+    std::thread acceptor_;
+    std::mutex mutex_;
+    int accepted_{0};
+    std::vector<int> open_;
+    std::vector<std::thread> workers_;
+};
+
+std::string http_ok(const std::string &body, const std::string &headers = "") {
+    return "HTTP/1.1 200 OK\r\n" + headers + "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+TEST(HttpClientTest, PoolsKeepAliveConnections) {
+    StubHttpServer stub([](const std::string &method, const std::string &target, const std::string &body) {
+        if (target == "/slow") {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        }
+        if (target == "/chunked") {
+            return StubHttpServer::Reply{
+                "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n6;x=y\r\n world\r\n0\r\n\r\n"};
+        }
+        if (target == "/close") {
+            return StubHttpServer::Reply{http_ok("closing", "Connection: close\r\n"), true};
+        }
+        // Closed by the server without warning, as an idle timeout would.
+        if (target == "/drop") {
+            return StubHttpServer::Reply{http_ok("dropped"), true};
+        }
+        if (method == "HEAD") {
+            return StubHttpServer::Reply{"HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n"};
+        }
+        return StubHttpServer::Reply{http_ok(method + " " + target + (body.empty() ? "" : " " + body))};
+    });
+    auto metrics = std::make_shared<MetricsRegistry>();
+    HttpClient::Options options;
+    options.read_timeout = std::chrono::milliseconds(100);
+    HttpClient client(options, metrics);
+    auto request = [&](const std::string &method, const std::string &target, const std::string &body = "") {
+        HttpRequest r;
+        r.method = method;
+        r.host = "127.0.0.1";
+        r.port = stub.port();
+        r.target = target;
+        r.body = body;
+        return r;
+    };
+
+    // Sequential calls share one kept-alive connection.
+    for (int i = 0; i < 3; ++i) {
+        auto result = client.send(request("GET", "/items/" + std::to_string(i)));
+        ASSERT_TRUE(result.ok()) << result.message;
+        EXPECT_EQ(result.response.status, 200);
+        EXPECT_EQ(result.response.body, "GET /items/" + std::to_string(i));
+    }
+    EXPECT_EQ(client.send(request("POST", "/items", R"({"a":1})")).response.body, R"(POST /items {"a":1})");
+    EXPECT_EQ(client.send(request("GET", "/chunked")).response.body, "hello world");
+    EXPECT_EQ(stub.accepted(), 1);
+    auto pools = client.pool_stats();
+    ASSERT_EQ(pools.size(), 1u);
+    EXPECT_EQ(pools[0].name, "127.0.0.1:" + std::to_string(stub.port()));
+    EXPECT_EQ(pools[0].open, 1u);
+    EXPECT_EQ(pools[0].idle, 1u);
+
+    // GETs in a batch are pipelined on that same connection, in order.
+    auto batch = client.send_batch({request("GET", "/a"), request("HEAD", "/b"), request("GET", "/c")});
+    ASSERT_EQ(batch.size(), 3u);
+    EXPECT_EQ(batch[0].response.body, "GET /a");
+    EXPECT_TRUE(batch[1].ok());
+    EXPECT_TRUE(batch[1].response.body.empty());
+    EXPECT_EQ(batch[2].response.body, "GET /c");
+    EXPECT_EQ(stub.accepted(), 1);
+
+    // A connection the server closes is not reused, whether or not it said so.
+    EXPECT_EQ(client.send(request("GET", "/close")).response.body, "closing");
+    EXPECT_EQ(client.send(request("GET", "/drop")).response.body, "dropped");
+    EXPECT_EQ(client.send(request("GET", "/after")).response.body, "GET /after");
+    EXPECT_EQ(stub.accepted(), 3);
+
+    auto slow = client.send(request("GET", "/slow"));
+    EXPECT_EQ(slow.error, HttpResult::Error::Timeout);
+    EXPECT_TRUE(client.send(request("GET", "/again")).ok());
+
+    // Nothing listens on a port just released.
+    int probe = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    socklen_t length = sizeof(addr);
+    ::getsockname(probe, reinterpret_cast<sockaddr *>(&addr), &length);
+    ::close(probe);
+    auto refused = request("GET", "/");
+    refused.port = ntohs(addr.sin_port);
+    EXPECT_EQ(client.send(refused).error, HttpResult::Error::Connect);
+
+    auto snapshot = metrics->snapshot();
+    EXPECT_EQ(snapshot.downstream_timeouts, 1);
+    EXPECT_EQ(snapshot.downstream_failures, 2);
+    EXPECT_EQ(snapshot.downstream_connections_opened, 4);
+    EXPECT_EQ(snapshot.downstream_connections_open, 1);
+    EXPECT_EQ(snapshot.downstream_connections_idle, 1);
+
+    // A host name is looked up on its own thread, within connect_timeout.
+    auto named = request("GET", "/named");
+    named.host = "localhost";
+    EXPECT_EQ(client.send(named).response.body, "GET /named");
+}
+
+TEST(HttpClientTest, StalledHostKeepsToItsShareOfIoThreads) {
+    std::promise<void> unstall;
+    auto unstalled = unstall.get_future().share();
+    StubHttpServer stalled([unstalled](const std::string &, const std::string &target, const std::string &) {
+        unstalled.wait();
+        return StubHttpServer::Reply{http_ok("late " + target)};
+    });
+    StubHttpServer healthy([](const std::string &, const std::string &target, const std::string &) {
+        return StubHttpServer::Reply{http_ok("quick " + target)};
+    });
+    HttpClient::Options options;
+    options.io_threads = 2;
+    options.io_threads_per_host = 1;
+    HttpClient client(options);
+    auto call = [&client](const StubHttpServer &server, const std::string &target) {
+        HttpRequest request;
+        request.host = "127.0.0.1";
+        request.port = server.port();
+        request.target = target;
+        auto result = std::make_shared<std::promise<HttpResult>>();
+        auto future = result->get_future();
+        client.send_async(std::move(request), [result](HttpResult r) { result->set_value(std::move(r)); });
+        return future;
+    };
+
+    // Three calls to the stalled host hold one I/O thread between them, so a
+    // call to the healthy host still gets the other one.
+    std::vector<std::future<HttpResult>> late;
+    for (int i = 0; i < 3; ++i) {
+        late.push_back(call(stalled, "/" + std::to_string(i)));
+    }
+    auto quick = call(healthy, "/now");
+    ASSERT_EQ(quick.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(quick.get().response.body, "quick /now");
+    for (auto &pending : late) {
+        EXPECT_EQ(pending.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+    }
+
+    unstall.set_value();
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(late[i].get().response.body, "late /" + std::to_string(i));
+    }
+}
+
+TEST(McpGatewayTest, ForwardsCallsToDownstreamServer) {
+    auto temp_root = make_unique_temp_dir("gateway-forward-");
+    auto mappings_root = temp_root / "mappings";
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    StubHttpServer stub([](const std::string &method, const std::string &target, const std::string &body) {
+        if (target == "/base/busy") {
+            return StubHttpServer::Reply{"HTTP/1.1 503 Service Unavailable\r\nContent-Length: 4\r\n\r\nbusy"};
+        }
+        return StubHttpServer::Reply{http_ok(method + " " + target + (body.empty() ? "" : " " + body))};
+    });
+    auto generator = std::make_shared<GenerationQueue>(clientkit_root, 1);
+    generator->start();
+    RegistrationService registration(mappings_root, generator);
+    auto spec_path = temp_root / "items.yaml";
+    {
+        std::ofstream out(spec_path);
+        out << "openapi: 3.0.0\ninfo:\n  title: Items\n"
+            << "servers:\n  - url: http://127.0.0.1:" << stub.port() << "/base/\n"
+            << "paths:\n"
+            << "  /items/{id}:\n    get:\n      operationId: getItem\n"
+            << "      parameters:\n        - name: id\n          in: path\n        - name: q\n          in: query\n"
+            << "  /items:\n    post:\n      operationId: createItem\n"
+            << "  /busy:\n    get:\n      operationId: busyCall\n";
+    }
+    ASSERT_TRUE(registration.register_spec("v1", spec_path).ok);
+    auto secure_path = temp_root / "secure.yaml";
+    {
+        std::ofstream out(secure_path);
+        out << "openapi: 3.0.0\ninfo:\n  title: Secure\n"
+            << "servers:\n  - url: https://127.0.0.1:" << stub.port() << "\n"
+            << "paths:\n  /secure:\n    get:\n      operationId: secureCall\n";
+    }
+    ASSERT_TRUE(registration.register_spec("v2", secure_path).ok);
+    generator->wait_for_idle();
+    generator->stop();
+
+    McpGateway gateway(RuntimeRegistry(clientkit_root), 4);
+    gateway.set_http_client(std::make_shared<HttpClient>(HttpClient::Options{}));
+
+    auto fetched = gateway.execute("getItem", R"({"id":"a b","q":"x&y"})");
+    EXPECT_TRUE(fetched.ok()) << fetched.message;
+    EXPECT_EQ(fetched.message, "GET /base/items/a%20b?q=x%26y");
+    auto created = gateway.execute("createItem", R"({"body":{"name":"n"}})");
+    EXPECT_EQ(created.message, R"(POST /base/items {"name":"n"})");
+    auto busy = gateway.execute("busyCall", "{}");
+    EXPECT_EQ(busy.status, ExecuteResult::Status::Failed);
+    EXPECT_EQ(busy.message, "Downstream returned 503: busy");
+    EXPECT_EQ(gateway.execute("getItem", "{}").message, "Missing path parameter: id");
+    // Every call went over the one pooled connection.
+    EXPECT_EQ(stub.accepted(), 1);
+    // The client cannot speak TLS, so an https server keeps the echo.
+    auto secure = gateway.execute("secureCall", "{}");
+    EXPECT_TRUE(secure.ok());
+    EXPECT_EQ(secure.message, "Executed secureCall for version v2 with payload: {}");
+    EXPECT_EQ(stub.accepted(), 1);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(McpGatewayTest, ForwardedCallsDoNotHoldExecutorThreads) {
+    auto temp_root = make_unique_temp_dir("gateway-forward-async-");
+    auto mappings_root = temp_root / "mappings";
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    std::promise<void> unblock;
+    auto unblocked = unblock.get_future().share();
+    StubHttpServer stub([unblocked](const std::string &, const std::string &, const std::string &) {
+        unblocked.wait();
+        return StubHttpServer::Reply{http_ok("slow")};
+    });
+    auto generator = std::make_shared<GenerationQueue>(clientkit_root, 1);
+    generator->start();
+    RegistrationService registration(mappings_root, generator);
+    auto spec_path = temp_root / "slow.yaml";
+    {
+        std::ofstream out(spec_path);
+        out << "openapi: 3.0.0\ninfo:\n  title: Slow\n"
+            << "servers:\n  - url: http://127.0.0.1:" << stub.port() << "\n"
+            << "paths:\n  /slow:\n    get:\n      operationId: slowCall\n";
+    }
+    ASSERT_TRUE(registration.register_spec("v1", spec_path).ok);
+    generator->wait_for_idle();
+    generator->stop();
+
+    McpGateway gateway(RuntimeRegistry(clientkit_root), 4);
+    auto executor = std::make_shared<WorkStealingExecutor>(1);
+    gateway.set_executor(executor);
+    gateway.set_http_client(std::make_shared<HttpClient>(HttpClient::Options{}));
+
+    auto slow = gateway.execute_operation_async("slowCall", "{}");
+    // With the downstream still answering, the only executor thread is free.
+    std::promise<void> ran;
+    auto ran_future = ran.get_future();
+    executor->post([&ran]() { ran.set_value(); });
+    EXPECT_EQ(ran_future.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(slow.wait_for(std::chrono::milliseconds(0)), std::future_status::timeout);
+
+    unblock.set_value();
+    auto result = slow.get();
+    EXPECT_TRUE(result.ok()) << result.message;
+    EXPECT_EQ(result.message, "slow");
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+
+TEST(McpServerTest, ServesJsonRpcOverHttpAndStdio) {
+    auto temp_root = make_unique_temp_dir("mcp-server-");
+    auto mappings_root = temp_root / "mappings";
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(clientkit_root);
+
+    set_env_var("GATEWAY_LOG_FILE", (temp_root / "test.log").string());
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto generator = std::make_shared<GenerationQueue>(clientkit_root, 1);
+    generator->start();
+    RegistrationService registration(mappings_root, generator);
+    auto spec_path = temp_root / "example.yaml";
+    write_spec(spec_path);
+    ASSERT_TRUE(registration.register_spec("v1", spec_path).ok);
+    generator->wait_for_idle();
+    generator->stop();
+
+    McpGateway gateway(RuntimeRegistry(clientkit_root), 8);
+    McpRpcHandler handler(gateway);
+    int stdin_pipe[2];
+    int stdout_pipe[2];
+    ASSERT_EQ(::pipe(stdin_pipe), 0);
+    ASSERT_EQ(::pipe(stdout_pipe), 0);
+
+    McpServer::Options options;
+    options.stdio = true;
+    options.port = 0;
+    options.io_threads = 2;
+    options.stdin_fd = stdin_pipe[0];
+    options.stdout_fd = stdout_pipe[1];
+    McpServer server(handler, options);
+    std::string error;
+    ASSERT_TRUE(server.start(error)) << error;
+    ASSERT_NE(server.port(), 0);
+
+    int client = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(server.port());
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(::connect(client, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+
+    // Four pipelined requests on one kept-alive connection, answered in order.
+    std::string requests =
+        http_post(R"({"jsonrpc":"2.0","id":1,"method":"initialize","params":{"protocolVersion":"2025-03-26"}})") +
+        http_post(R"({"jsonrpc":"2.0","method":"notifications/initialized"})") +
+        http_post(R"({"jsonrpc":"2.0","id":"list","method":"tools/list"})") +
+        http_post(R"({"jsonrpc":"2.0","id":3,"method":"tools/call","params":{"name":"sayHello","arguments":{"payload":"hi"}}})");
+    ASSERT_EQ(::send(client, requests.data(), requests.size(), 0), static_cast<ssize_t>(requests.size()));
+    std::string buffer;
+    auto initialized = read_http_response(client, buffer);
+    EXPECT_EQ(initialized.rfind("HTTP/1.1 200 OK\n", 0), 0u);
+    EXPECT_NE(initialized.find(R"("id":1,"result":{"protocolVersion":"2025-03-26")"), std::string::npos);
+    EXPECT_EQ(read_http_response(client, buffer), "HTTP/1.1 202 Accepted\n");
+
+    JsonValue listed;
+    auto list_response = read_http_response(client, buffer);
+    ASSERT_TRUE(parse_json(list_response.substr(list_response.find('\n') + 1), listed, error)) << error;
+    EXPECT_EQ(listed.find("id")->string, "list");
+    const auto &tools = listed.find("result")->find("tools")->items;
+    ASSERT_EQ(tools.size(), 1u);
+    EXPECT_EQ(tools[0].find("name")->string, "sayHello");
+
+    JsonValue called;
+    auto call_response = read_http_response(client, buffer);
+    ASSERT_TRUE(parse_json(call_response.substr(call_response.find('\n') + 1), called, error)) << error;
+    const auto *result = called.find("result");
+    ASSERT_NE(result, nullptr);
+    EXPECT_FALSE(result->find("isError")->boolean);
+    EXPECT_EQ(result->find("content")->items[0].find("text")->string,
+              "Executed sayHello for version v1 with payload: hi");
+
+    // Errors come back as JSON-RPC errors; Connection: close ends the socket.
+    auto bad = http_post(R"({"jsonrpc":"2.0","id":4,"method":"tools/unknown"})", "close");
+    ::send(client, bad.data(), bad.size(), 0);
+    EXPECT_NE(read_http_response(client, buffer).find(R"("error":{"code":-32601)"), std::string::npos);
+    EXPECT_EQ(read_http_response(client, buffer), "");
+    ::close(client);
+
+    // stdio: one message per line, one reply per line, and a parse error for
+    // garbage.
+    std::string lines = "{\"jsonrpc\":\"2.0\",\"id\":7,\"method\":\"ping\"}\nnot json\n";
+    ASSERT_EQ(::write(stdin_pipe[1], lines.data(), lines.size()), static_cast<ssize_t>(lines.size()));
+    ::close(stdin_pipe[1]);
+    // End of input stops the server.
+    server.wait();
+    ::close(stdout_pipe[1]);
+    std::string output;
+    char chunk[4096];
+    for (ssize_t n; (n = ::read(stdout_pipe[0], chunk, sizeof(chunk))) > 0;) {
+        output.append(chunk, static_cast<std::size_t>(n));
+    }
+    ::close(stdin_pipe[0]);
+    ::close(stdout_pipe[0]);
+    auto newline = output.find('\n');
+    ASSERT_NE(newline, std::string::npos);
+    EXPECT_EQ(output.substr(0, newline), R"({"jsonrpc":"2.0","id":7,"result":{}})");
+    EXPECT_NE(output.find(R"("id":null,"error":{"code":-32700)", newline), std::string::npos);
+
+    spdlog::shutdown();
+    fs::remove_all(temp_root);
+}
+#endif
+
+TEST(IntegrationTest, GeneratesClientKitAndExecutesOperation) {
+    auto temp_root = make_unique_temp_dir("gateway-");
+    auto mappings_root = temp_root / "mappings";
+    auto clientkit_root = temp_root / "clientkit";
+    fs::create_directories(mappings_root);
+    fs::create_directories(clientkit_root);
+
+    auto log_path = (temp_root / "test.log").string();
+    set_env_var("GATEWAY_LOG_FILE", log_path);
+    set_env_var("GATEWAY_LOG_LEVEL", "debug");
+    SetupLogging::configure_from_env();
+    LoggingGuard guard;
+
+    auto generator = std::make_shared<GenerationQueue>(clientkit_root, 1);
+    generator->start();
+
+    RegistrationService registration(mappings_root, generator);
+
+    auto spec_path = temp_root / "example.yaml";
+    write_spec(spec_path);
+
+    auto result = registration.register_spec("v1", spec_path);
+    ASSERT_TRUE(result.ok);
+    ASSERT_TRUE(fs::exists(result.stored_path));
+
+    generator->wait_for_idle();
+    generator->stop();
+
+    RuntimeRegistry registry(clientkit_root);
+    registry.load();
+
+    auto op = registry.find_operation("sayHello");
+    ASSERT_TRUE(op.has_value());
+    EXPECT_EQ(op.version(), "v1");
+    EXPECT_EQ(op.kit_name(), "example");
+
+    McpGateway gateway(registry);
+    auto listed = gateway.list_operations();
+    EXPECT_NE(listed.find("sayHello"), std::string::npos);
+
+    auto response = gateway.execute_operation("sayHello", "{}");
+    EXPECT_NE(response.find("sayHello"), std::string::npos);
+
+    auto missing = gateway.execute_operation("missing", "{}");
+    EXPECT_NE(missing.find("Operation not found"), std::string::npos);
+
+    // The merged root index serves the same lookups without walking kits.
+    ASSERT_TRUE(build_merged_route_index(clientkit_root));
+    RuntimeRegistry merged_registry(clientkit_root);
+    merged_registry.load();
+    ASSERT_NE(merged_registry.snapshot()->merged, nullptr);
+    auto merged_op = merged_registry.find_operation("sayHello");
+    ASSERT_TRUE(merged_op.has_value());
+    EXPECT_EQ(merged_op.kit_name(), "example");
+    EXPECT_EQ(merged_op.manifest_path(), op.manifest_path());
+
+    // Once the merged index is stale, a walk that finds no kits publishes
+    // its own empty table rather than one pointing into the old index.
+    fs::remove_all(clientkit_root / "v1");
+    ASSERT_TRUE(touch_generation_stamp(clientkit_root));
+    merged_registry.refresh();
+    EXPECT_EQ(merged_registry.snapshot()->merged, nullptr);
+    EXPECT_FALSE(merged_registry.find_operation("sayHello").has_value());
+    EXPECT_TRUE(merged_registry.list_operations().empty());
 
     spdlog::shutdown();
     fs::remove_all(temp_root);
@@ -0,0 +1,50 @@
+#!/usr/bin/env bash
+# Adapter between GeneratorProcessPool and the one-shot openapi-generator CLI.
+# Point CPP_MCP_GENERATOR_COMMAND at this script. It speaks the pool's line
+# protocol (see src/generator_pool.h) on stdin/stdout and runs one
+# `openapi-generator-cli generate` per request, so the pool's batching and
+# process count bound how many generator runs happen at once. The CLI still
+# starts a JVM per request; a resident generator speaking the same protocol
+# can replace this script without changes to the gateway.
+#
+# Environment:
+#   OPENAPI_GENERATOR_CLI   generator command (default: openapi-generator-cli)
+#   OPENAPI_GENERATOR_NAME  generator target (default: cpp-restsdk)
+#   OPENAPI_GENERATOR_ARGS  extra arguments, split on whitespace
+set -u
+
+cli=${OPENAPI_GENERATOR_CLI:-openapi-generator-cli}
+target=${OPENAPI_GENERATOR_NAME:-cpp-restsdk}
+read -r -a extra_args <<< "${OPENAPI_GENERATOR_ARGS:-}"
+log_file=$(mktemp)
+trap 'rm -f "$log_file"' EXIT
+
+while IFS= read -r header; do
+    case $header in
+        "BATCH "*) count=${header#BATCH } ;;
+        *) exit 2 ;;
+    esac
+    specs=() outputs=() filters=()
+    for ((i = 0; i < count; i++)); do
+        IFS=$'\t' read -r spec output operations || exit 2
+        specs+=("$spec") outputs+=("$output") filters+=("${operations:-}")
+    done
+
+    for ((i = 0; i < count; i++)); do
+        args=(generate -i "${specs[i]}" -g "$target" -o "${outputs[i]}" ${extra_args[@]+"${extra_args[@]}"})
+        if [[ -n ${filters[i]} ]]; then
+            # Regenerate only the changed operations.
+            args+=(--openapi-normalizer "FILTER=operationId:${filters[i]//,/|}")
+        fi
+        "$cli" "${args[@]}" > "$log_file" 2>&1 < /dev/null
+        status=$?
+        while IFS= read -r line; do
+            printf 'LOG %d %s\n' "$i" "$line"
+        done < "$log_file"
+        if ((status == 0)); then
+            printf 'OK %d\n' "$i"
+        else
+            printf 'ERR %d %s exited with status %d\n' "$i" "$cli" "$status"
+        fi
+    done
+done